@@ -50,10 +50,14 @@
 #endif
 
 /* Pointer type -- depends on memory implementation */
-#ifdef EB_USE_MALLOC
+#if defined(EB_USE_MALLOC)
 #define EB_POINTER(typ) struct typ*
 #define EB_NULL 0
 #define EB_MEMORY_MODEL 0x0001U
+#elif defined(EB_USE_SLAB)
+#define EB_POINTER(typ) uint32_t
+#define EB_NULL ((uint32_t)-1)
+#define EB_MEMORY_MODEL 0x0002U
 #else
 #define EB_POINTER(typ) uint16_t
 #define EB_NULL ((uint16_t)-1)
@@ -253,7 +257,10 @@ struct sdb_table {
 
 /* Handler descriptor */
 struct eb_handler {
-  /* This pointer must remain valid until after you detach the device */
+  /* This pointer must remain valid until after you detach the device.
+   * If its record_type is sdb_record_bridge, it must be the bridge of a
+   * union sdb_record: the handler then serves the nested table at sdb_child.
+   */
   const struct sdb_device* device;
   
   eb_user_data_t data;
@@ -261,6 +268,18 @@ struct eb_handler {
   eb_status_t (*write)(eb_user_data_t, eb_address_t, eb_width_t, eb_data_t);
 };
 
+/* Optional block access for a handler.
+ * When a record touches 'count' consecutive words of one device, these
+ * receive them at once: word i is at address + i*(width&EB_DATAX).
+ * They return how many words succeeded, stopping at the first failure.
+ * That word is reported as an error and the rest are offered again.
+ * A null pointer leaves that direction to the word-at-a-time callback.
+ */
+struct eb_block_handler {
+  int (*read_block) (eb_user_data_t, eb_address_t, eb_width_t,       eb_data_t*, int count);
+  int (*write_block)(eb_user_data_t, eb_address_t, eb_width_t, const eb_data_t*, int count);
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -335,10 +354,85 @@ eb_status_t eb_socket_close(eb_socket_t socket);
  * This function is useful if your program has no event loop of its own.
  * If timeout_us == 0, return immediately. If timeout_us == -1, wait forever.
  * It returns the time expended while waiting.
+ * On Linux it waits in epoll; if the environment variable EB_SOCKET_RUN is
+ * "select" when a socket first runs, that socket uses select() instead.
  */
 EB_PUBLIC
 long eb_socket_run(eb_socket_t socket, long timeout_us);
 
+/* Latency histograms hold EB_STATS_BUCKETS counters.
+ * Bucket i counts samples in [eb_stats_bucket(i), eb_stats_bucket(i+1))
+ * microseconds; there are four equal buckets per power of two.
+ */
+#define EB_STATS_BUCKETS 124
+
+EB_PUBLIC
+uint32_t eb_stats_bucket(int i);
+
+/* Event loop statistics of a socket, collected by eb_socket_run.
+ * Time spent in eb_socket_run is either waiting in poll or working
+ * (sending cycles, dispatching responses and running callbacks).
+ */
+struct eb_socket_stats {
+  uint64_t runs;       /* calls to eb_socket_run */
+  uint64_t wakeups;    /* polls which returned a ready descriptor */
+  uint64_t wait_us;    /* total time waiting in poll */
+  uint64_t work_us;    /* total time working */
+  uint64_t poll[EB_STATS_BUCKETS]; /* polls by time spent waiting */
+};
+
+/* Start collecting statistics for this socket.
+ * Counting takes no locks and allocates nothing; it is cheap enough to leave on.
+ * Statistics are collected by eb_socket_run; not by eb_socket_check.
+ *
+ * Return codes:
+ *   OK		- statistics are being collected
+ *   OOM	- out of memory
+ *   FAIL	- the platform has no eb_socket_run
+ */
+EB_PUBLIC
+eb_status_t eb_socket_stats_enable(eb_socket_t socket);
+
+/* Read the statistics of this socket.
+ * Call this from the thread which runs the socket.
+ *
+ * Return codes:
+ *   OK		- stats has been filled in
+ *   FAIL	- statistics were not enabled
+ */
+EB_PUBLIC
+eb_status_t eb_socket_stats(eb_socket_t socket, struct eb_socket_stats* stats);
+
+/* Record every packet the socket sends or receives in a pcapng file.
+ * Each device is an interface named by its address; datagrams carry an
+ * IPv4/UDP header so that Wireshark decodes them as Etherbone.
+ * A background thread writes the file; if it cannot keep up, packets are
+ * dropped and counted rather than stalling the socket.
+ * A filename of 0 stops the capture. Setting the environment variable
+ * EB_CAPTURE captures every socket opened from then on.
+ * Call this from the thread which runs the socket.
+ *
+ * Return codes:
+ *   OK		- the capture has started (or stopped)
+ *   FAIL	- the file could not be created, or the platform has no threads
+ *   OOM	- out of memory
+ */
+EB_PUBLIC
+eb_status_t eb_socket_capture(eb_socket_t socket, const char* filename);
+
+/* Datagram batching counters of the UDP transport (shared by all sockets).
+ * packets/calls gives the average number of datagrams per system call.
+ */
+struct eb_udp_counters {
+  unsigned long tx_packets;
+  unsigned long tx_calls;
+  unsigned long rx_packets;
+  unsigned long rx_calls;
+};
+
+EB_PUBLIC
+void eb_udp_counters_read(struct eb_udp_counters* counters);
+
 /* Integrate this Etherbone socket into your own event loop.
  *
  * You must call eb_socket_check whenever:
@@ -361,6 +455,12 @@ void eb_socket_descriptors(eb_socket_t socket, eb_user_data_t user, eb_descripto
 EB_PUBLIC
 uint32_t eb_socket_timeout(eb_socket_t socket);
 
+/* Returns -1 if there are no timeouts pending, otherwise microseconds from now.
+ * Prefer this to eb_socket_timeout; cycle timeouts need not be whole seconds.
+ */
+EB_PUBLIC
+long eb_socket_timeout_us(eb_socket_t socket);
+
 /* Add a device to the virtual bus.
  * This handler receives all reads and writes to the specified address.
  * The handler structure passed to eb_socket_attach need not be preserved.
@@ -375,6 +475,13 @@ uint32_t eb_socket_timeout(eb_socket_t socket);
 EB_PUBLIC
 eb_status_t eb_socket_attach(eb_socket_t socket, const struct eb_handler* handler);
 
+/* As eb_socket_attach, but consecutive words may go to the block handler.
+ * The handler still needs read and write for isolated words.
+ * The block structure need not be preserved; 0 is the same as eb_socket_attach.
+ */
+EB_PUBLIC
+eb_status_t eb_socket_attach_block(eb_socket_t socket, const struct eb_handler* handler, const struct eb_block_handler* block);
+
 /* Detach the device from the virtual bus.
  *
  * Return codes:
@@ -450,6 +557,71 @@ eb_status_t eb_device_close(eb_device_t device);
 EB_PUBLIC
 eb_socket_t eb_device_socket(eb_device_t device);
 
+/* Sender flow control of a device.
+ * Cycles are only sent while fewer than 'window' request bytes await a response.
+ * The window grows while responses return promptly, shrinks as the round-trip
+ * time shows requests queueing at the device, and halves when a cycle is lost.
+ * A cycle is lost when it times out; its callback then receives EB_TIMEOUT.
+ * Once several later cycles are answered first, the window halves early and
+ * the cycle gets only a few round-trip times more to be answered.
+ * Cycles without read-backs hold their bytes until a later read-back returns;
+ * once they hold half the window, the next such cycle is sent with a status
+ * read-back, and its callback waits for that answer.
+ */
+struct eb_device_flow {
+  uint32_t window;     /* bytes of requests allowed in flight */
+  uint32_t inflight;   /* bytes of requests awaiting a response */
+  uint32_t rtt_us;     /* smoothed round-trip time (0 = unknown) */
+  uint32_t min_rtt_us; /* shortest round-trip time seen */
+  uint32_t lost;       /* cycles lost so far */
+};
+
+/* Read the flow control state of a device.
+ *
+ * Return codes:
+ *   OK         - flow has been filled in
+ *   FAIL       - the device is passive and sends no requests
+ */
+EB_PUBLIC
+eb_status_t eb_device_flow(eb_device_t device, struct eb_device_flow* flow);
+
+/* Traffic statistics of a device.
+ * Latency is measured from sending a cycle until its response is processed.
+ * Cycles without reads or error checks receive no response.
+ */
+struct eb_device_stats {
+  uint64_t cycles;     /* cycles sent */
+  uint64_t records;    /* records sent */
+  uint64_t packets;    /* packets (or stream writes) sent */
+  uint64_t bytes;      /* bytes sent, including headers */
+  uint64_t responses;  /* cycles answered */
+  uint64_t timeouts;   /* cycles lost (callback received EB_TIMEOUT) */
+  uint64_t latency_us; /* total latency of answered cycles */
+  uint64_t coalesced;  /* bytes kept off the wire by eb_cycle_close_coalesced */
+  uint64_t latency[EB_STATS_BUCKETS]; /* answered cycles by latency */
+};
+
+/* Start collecting statistics for this device.
+ * Counting takes no locks and allocates nothing; it is cheap enough to leave on.
+ *
+ * Return codes:
+ *   OK		- statistics are being collected
+ *   OOM	- out of memory
+ *   FAIL	- the device is passive and sends no requests
+ */
+EB_PUBLIC
+eb_status_t eb_device_stats_enable(eb_device_t device);
+
+/* Read the statistics of this device.
+ * Call this from the thread which runs the socket.
+ *
+ * Return codes:
+ *   OK		- stats has been filled in
+ *   FAIL	- statistics were not enabled
+ */
+EB_PUBLIC
+eb_status_t eb_device_stats(eb_device_t device, struct eb_device_stats* stats);
+
 /* Begin a wishbone cycle on the remote device.
  * Read/write operations within a cycle hold the device locked.
  * Read/write operations are executed in the order they are queued.
@@ -503,6 +675,20 @@ eb_status_t eb_cycle_close(eb_cycle_t cycle);
 EB_PUBLIC
 eb_status_t eb_cycle_close_silently(eb_cycle_t cycle);
 
+/* End a wishbone cycle like eb_cycle_close, sending fewer operations.
+ * Only use this when the merged accesses have no side-effects (memory, not FIFOs):
+ *   EB_COALESCE_READS  - a read of the address read just before is not sent;
+ *                        it reports the earlier read's value and error status
+ *   EB_COALESCE_WRITES - a write overwritten before the next read is dropped;
+ *                        it no longer appears in the operation list
+ * Config space accesses are never merged. The order of what is sent is kept.
+ * The bytes saved are counted in eb_device_stats.
+ */
+#define EB_COALESCE_READS  0x1
+#define EB_COALESCE_WRITES 0x2
+EB_PUBLIC
+eb_status_t eb_cycle_close_coalesced(eb_cycle_t cycle, int coalesce);
+
 /* End a wishbone cycle.
  * The cycle is discarded, freed, and the callback never invoked.
  */
@@ -513,6 +699,15 @@ void eb_cycle_abort(eb_cycle_t cycle);
 EB_PUBLIC
 eb_device_t eb_cycle_device(eb_cycle_t cycle);
 
+/* Fail the cycle with EB_TIMEOUT if it is not answered within 'timeout_us'
+ * microseconds of being sent. Cycles start with EB_TIMEOUT_DEFAULT.
+ * 0 restores the default; anything above EB_TIMEOUT_MAX is cut to it.
+ */
+#define EB_TIMEOUT_DEFAULT 5000000
+#define EB_TIMEOUT_MAX     1000000000
+EB_PUBLIC
+void eb_cycle_timeout(eb_cycle_t cycle, uint32_t timeout_us);
+
 /* Prepare a wishbone read operation.
  * The given address is read from the remote device.
  * The result is written to the data address.
@@ -551,6 +746,73 @@ void eb_cycle_write_config(eb_cycle_t    cycle,
                            eb_format_t   format,
                            eb_data_t     data);
 
+/* Submit cycles from threads other than the one running the socket.
+ * 
+ * A socket and its devices/cycles may only be used by a single thread.
+ * That thread obtains the socket's queue with eb_socket_queue; any number
+ * of other threads may then share the queue. Each thread stages a cycle
+ * in its own memory with eb_batch_*, and eb_batch_close hands the cycle
+ * over without blocking. The socket's thread opens and sends the cycle
+ * during its next eb_socket_{run,check}, and runs the callback there.
+ * 
+ * eb_socket_queue returns 0 if the platform has no thread support.
+ * The device must stay open until the callback has run.
+ * 
+ * eb_batch_open returns:
+ *    OK        - batch created successfully (your callback will be run)
+ *    OOM       - insufficient memory
+ *    FAIL      - the platform has no thread support
+ * 
+ * The callback (if not 0) receives the same status codes as for cycles.
+ * FAIL with operations = EB_NULL means the device refused the cycle.
+ */
+typedef struct eb_queue* eb_queue_t;
+typedef struct eb_batch* eb_batch_t;
+
+EB_PUBLIC
+eb_queue_t eb_socket_queue(eb_socket_t socket);
+
+EB_PUBLIC
+eb_status_t eb_batch_open(eb_queue_t     queue,
+                          eb_device_t    device,
+                          eb_user_data_t user_data,
+                          eb_callback_t  cb,
+                          eb_batch_t*    result);
+
+/* Submit the cycle to the socket's thread */
+EB_PUBLIC
+void eb_batch_close(eb_batch_t batch);
+
+/* Discard the cycle; the callback is never invoked */
+EB_PUBLIC
+void eb_batch_abort(eb_batch_t batch);
+
+/* Same as eb_cycle_timeout */
+EB_PUBLIC
+void eb_batch_timeout(eb_batch_t batch, uint32_t timeout_us);
+
+/* Same as the eb_cycle_* equivalents; 'data' is written by the socket's thread */
+EB_PUBLIC
+void eb_batch_read(eb_batch_t    batch,
+                   eb_address_t  address,
+                   eb_format_t   format,
+                   eb_data_t*    data);
+EB_PUBLIC
+void eb_batch_read_config(eb_batch_t    batch,
+                          eb_address_t  address,
+                          eb_format_t   format,
+                          eb_data_t*    data);
+EB_PUBLIC
+void eb_batch_write(eb_batch_t    batch,
+                    eb_address_t  address,
+                    eb_format_t   format,
+                    eb_data_t     data);
+EB_PUBLIC
+void eb_batch_write_config(eb_batch_t    batch,
+                           eb_address_t  address,
+                           eb_format_t   format,
+                           eb_data_t     data);
+
 /* Operation result accessors */
 
 /* The next operation in the list. EB_NULL = end-of-list */
@@ -586,6 +848,47 @@ EB_PUBLIC eb_status_t eb_device_write(eb_device_t    device,
                                       eb_user_data_t user_data,
                                       eb_callback_t  cb);
 
+/* Transfer length bytes between a buffer and consecutive bus addresses.
+ * Equivalent to a sequence of cycles, each packed to fill one packet.
+ *
+ * The format selects the usable operation widths and the byte order of
+ * the buffer (big endian if unspecified). The widest width is used for
+ * the aligned bulk; the narrowest for any unaligned head or tail.
+ * Both address and length must be aligned to the narrowest width.
+ *
+ * Up to window cycles are kept in flight (0 = default). A cycle which
+ * fails stops the transfer, but cycles already in flight still complete.
+ * The buffer must remain valid until the callback runs.
+ *
+ * Your callback is called once, when the whole transfer has finished.
+ * It receives these arguments: (user_data, device, EB_NULL, status)
+ * If status != OK, part of the transfer may have been applied.
+ *
+ * Return codes:
+ *   OK         - the transfer was started (or completed if cb = eb_block)
+ *   WIDTH      - the format allows no width supported by the device
+ *   ADDRESS    - address or length is not aligned
+ *   OOM        - insufficient memory to start the transfer
+ *   ...        - with eb_block, the first failure of any cycle
+ */
+EB_PUBLIC eb_status_t eb_device_read_block(eb_device_t    device,
+                                           eb_address_t   address,
+                                           eb_format_t    format,
+                                           uint8_t*       data,
+                                           eb_address_t   length,
+                                           int            window,
+                                           eb_user_data_t user_data,
+                                           eb_callback_t  cb);
+
+EB_PUBLIC eb_status_t eb_device_write_block(eb_device_t    device,
+                                            eb_address_t   address,
+                                            eb_format_t    format,
+                                            const uint8_t* data,
+                                            eb_address_t   length,
+                                            int            window,
+                                            eb_user_data_t user_data,
+                                            eb_callback_t  cb);
+
 /* Read the SDB information from the remote bus.
  * If there is not enough memory to initiate the request, EB_OOM is returned.
  * To scan the root bus, Etherbone config space is used to locate the SDB record.
@@ -623,6 +926,10 @@ EB_PUBLIC eb_status_t eb_sdb_find_by_address(eb_device_t device, eb_address_t ad
  * The resulting value of *devices is the number of matching SDB records found.
  * If there are more records than fit in output, they are counted but unwritten.
  * On success, EB_OK is returned. Do not forget to check *devices as well!
+ *
+ * If the environment variable EB_SDB_CACHE names a directory, the crawled
+ * SDB tree is saved there. Later calls only read the root SDB header and, 
+ * if it (including its date) is unchanged, answer from the saved copy.
  */
 EB_PUBLIC eb_status_t eb_sdb_find_by_identity(eb_device_t device, uint64_t vendor_id, uint32_t device_id, struct sdb_device* output, int* devices);
 
@@ -638,6 +945,12 @@ EB_PUBLIC eb_status_t eb_sdb_find_by_identity_at(eb_device_t device, const struc
 
 #include <vector>
 #include <ostream>
+#if __cplusplus >= 201103L
+#include <future>
+#endif
+#ifdef __cpp_impl_coroutine
+#include <coroutine>
+#endif
 
 /****************************************************************************/
 /*                                 C++ API                                  */
@@ -656,6 +969,7 @@ typedef eb_descriptor_t descriptor_t;
 class Socket;
 class Device;
 class Cycle;
+class Batch;
 class Operation;
 
 #if ETHERBONE_THROWS
@@ -674,12 +988,46 @@ inline std::ostream& operator << (std::ostream& o, const exception_t& e) {
 #define EB_RETURN_OR_THROW(m, x) return x
 #endif
 
+#if __cplusplus >= 201103L
+/* Where a Cycle or Batch opened with a future reports its status */
+typedef std::future<EB_STATUS_OR_VOID_T> future_t;
+typedef std::promise<EB_STATUS_OR_VOID_T> promise_t;
+#endif
+
+#ifdef __cpp_impl_coroutine
+/* Resumes a coroutine once a Cycle opened with it has completed:
+ *   Completion done; cycle.open(device, done); ... cycle.close(); co_await done;
+ * The coroutine resumes inside Socket::run, on the thread running the Socket.
+ * It must not await a cycle that was aborted.
+ */
+class Completion {
+  public:
+    Completion() : done(false), status(EB_OK) { }
+    
+    bool await_ready() const { return done; }
+    void await_suspend(std::coroutine_handle<> h) { waiter = h; }
+    EB_STATUS_OR_VOID_T await_resume() const { EB_RETURN_OR_THROW("Cycle::close", status); }
+    
+  protected:
+    bool done;
+    status_t status;
+    std::coroutine_handle<> waiter;
+  
+  friend void wrap_completion_callback(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status);
+};
+#endif
+
 class Handler {
   public:
     EB_PUBLIC virtual ~Handler();
 
     virtual status_t read (address_t address, width_t width, data_t* data) = 0;
     virtual status_t write(address_t address, width_t width, data_t  data) = 0;
+    
+    /* Consecutive words of a record; returns how many succeeded.
+     * By default, one read/write each. */
+    EB_PUBLIC virtual int read_block (address_t address, width_t width,       data_t* data, int count);
+    EB_PUBLIC virtual int write_block(address_t address, width_t width, const data_t* data, int count);
 };
 
 class Socket {
@@ -697,11 +1045,19 @@ class Socket {
     
     int run(int timeout_us = -1);
     
+    EB_STATUS_OR_VOID_T enableStats();
+    EB_STATUS_OR_VOID_T stats(struct eb_socket_stats* stats) const;
+    EB_STATUS_OR_VOID_T capture(const char* filename);
+    
     /* These can be used to implement your own 'block': */
     uint32_t timeout() const;
+    long timeout_us() const;
     void descriptors(eb_user_data_t user, eb_descriptor_callback_t list) const;
     int check(uint32_t now, eb_user_data_t user, eb_descriptor_callback_t ready);
     
+    /* Used by other threads to submit a Batch */
+    eb_queue_t queue();
+    
   protected:
     Socket(eb_socket_t sock);
     eb_socket_t socket;
@@ -720,6 +1076,9 @@ class Device {
     Socket socket();
     
     width_t width() const;
+    EB_STATUS_OR_VOID_T flow(struct eb_device_flow* flow) const;
+    EB_STATUS_OR_VOID_T enableStats();
+    EB_STATUS_OR_VOID_T stats(struct eb_device_stats* stats) const;
     
     template <typename T>
     EB_STATUS_OR_VOID_T sdb_scan_bus (const struct sdb_bridge* bridge, T* user, sdb_callback_t);
@@ -737,11 +1096,20 @@ class Device {
     EB_STATUS_OR_VOID_T write(eb_address_t address, eb_format_t format, eb_data_t data, T* user, eb_callback_t cb);
     EB_STATUS_OR_VOID_T write(eb_address_t address, eb_format_t format, eb_data_t data);
     
+    template <typename T>
+    EB_STATUS_OR_VOID_T readBlock(eb_address_t address, eb_format_t format, uint8_t* data, eb_address_t length, T* user, eb_callback_t cb, int window = 0);
+    EB_STATUS_OR_VOID_T readBlock(eb_address_t address, eb_format_t format, uint8_t* data, eb_address_t length, int window = 0);
+    
+    template <typename T>
+    EB_STATUS_OR_VOID_T writeBlock(eb_address_t address, eb_format_t format, const uint8_t* data, eb_address_t length, T* user, eb_callback_t cb, int window = 0);
+    EB_STATUS_OR_VOID_T writeBlock(eb_address_t address, eb_format_t format, const uint8_t* data, eb_address_t length, int window = 0);
+    
   protected:
     Device(eb_device_t device);
     eb_device_t device;
   
   friend class Cycle;
+  friend class Batch;
   template <typename T, void (T::*cb)(Device, Operation, status_t)>
   friend void wrap_member_callback(eb_user_data_t object, eb_device_t dev, eb_operation_t op, eb_status_t status);
   template <typename T, void (*cb)(T*, Device, Operation, status_t)>
@@ -760,10 +1128,19 @@ class Cycle {
     template <typename T>
     EB_STATUS_OR_VOID_T open(Device device, T* user, eb_callback_t);
     EB_STATUS_OR_VOID_T open(Device device);
+#if __cplusplus >= 201103L
+    // Instead of a callback, done gets the status; close() does not block.
+    // done becomes ready while some thread runs the Socket. abort() breaks it.
+    EB_STATUS_OR_VOID_T open(Device device, future_t& done);
+#endif
+#ifdef __cpp_impl_coroutine
+    EB_STATUS_OR_VOID_T open(Device device, Completion& done);
+#endif
     
     void abort();
     EB_STATUS_OR_VOID_T close();
     EB_STATUS_OR_VOID_T close_silently();
+    EB_STATUS_OR_VOID_T close_coalesced(int coalesce);
     
     void read (address_t address, format_t format = EB_DATAX, data_t* data = 0);
     void write(address_t address, format_t format, data_t  data);
@@ -771,12 +1148,45 @@ class Cycle {
     void read_config (address_t address, format_t format = EB_DATAX, data_t* data = 0);
     void write_config(address_t address, format_t format, data_t  data);
     
+    // Microseconds from sending until the cycle fails with EB_TIMEOUT
+    void timeout(uint32_t timeout_us);
+    
     const Device device() const;
     Device device();
     
   protected:
     Cycle(eb_cycle_t cycle);
     eb_cycle_t cycle;
+    eb_user_data_t pending; /* promise_t of open(.., future_t&) until close */
+};
+
+/* A Cycle staged by a thread other than the one running the Socket */
+class Batch {
+  public:
+    Batch();
+    
+    template <typename T>
+    EB_STATUS_OR_VOID_T open(eb_queue_t queue, Device device, T* user, eb_callback_t);
+    EB_STATUS_OR_VOID_T open(eb_queue_t queue, Device device);
+#if __cplusplus >= 201103L
+    // done gets the status once the Socket's thread has run the cycle
+    EB_STATUS_OR_VOID_T open(eb_queue_t queue, Device device, future_t& done);
+#endif
+    
+    void abort();
+    void close();
+    
+    void timeout(uint32_t timeout_us);
+    
+    void read (address_t address, format_t format = EB_DATAX, data_t* data = 0);
+    void write(address_t address, format_t format, data_t  data);
+    
+    void read_config (address_t address, format_t format = EB_DATAX, data_t* data = 0);
+    void write_config(address_t address, format_t format, data_t  data);
+    
+  protected:
+    eb_batch_t batch;
+    eb_user_data_t pending; /* promise_t of open(.., future_t&) until close */
 };
 
 class Operation {
@@ -826,6 +1236,31 @@ void sdb_wrap_function_callback(eb_user_data_t user, eb_device_t dev, const stru
   return (*cb)(reinterpret_cast<T*>(user), Device(dev), sdb, status);
 }
 
+#if __cplusplus >= 201103L
+/* The callback of cycles opened with a future; it owns the promise */
+inline void wrap_promise_callback(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  promise_t* promise = reinterpret_cast<promise_t*>(user);
+#if ETHERBONE_THROWS
+  if (status == EB_OK)
+    promise->set_value();
+  else
+    promise->set_exception(std::make_exception_ptr(exception_t("Cycle::close", status)));
+#else
+  promise->set_value(status);
+#endif
+  delete promise;
+}
+#endif
+
+#ifdef __cpp_impl_coroutine
+inline void wrap_completion_callback(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  Completion* done = reinterpret_cast<Completion*>(user);
+  done->done = true;
+  done->status = status;
+  if (done->waiter) done->waiter.resume();
+}
+#endif
+
 /****************************************************************************/
 /*                            C++ Implementation                            */
 /****************************************************************************/
@@ -833,6 +1268,8 @@ void sdb_wrap_function_callback(eb_user_data_t user, eb_device_t dev, const stru
 /* Proxy functions needed by C++ -- ignore these */
 EB_PUBLIC eb_status_t eb_proxy_read_handler(eb_user_data_t data, eb_address_t address, eb_width_t width, eb_data_t* ptr);
 EB_PUBLIC eb_status_t eb_proxy_write_handler(eb_user_data_t data, eb_address_t address, eb_width_t width, eb_data_t value);
+EB_PUBLIC int eb_proxy_read_block_handler(eb_user_data_t data, eb_address_t address, eb_width_t width, eb_data_t* ptr, int count);
+EB_PUBLIC int eb_proxy_write_block_handler(eb_user_data_t data, eb_address_t address, eb_width_t width, const eb_data_t* ptr, int count);
 
 inline Socket::Socket(eb_socket_t sock)
  : socket(sock) { 
@@ -858,11 +1295,14 @@ inline EB_STATUS_OR_VOID_T Socket::passive(const char* address) {
 
 inline EB_STATUS_OR_VOID_T Socket::attach(const struct sdb_device* device, Handler* handler) {
   struct eb_handler h;
+  struct eb_block_handler b;
   h.device = device;
   h.data = handler;
   h.read  = &eb_proxy_read_handler;
   h.write = &eb_proxy_write_handler;
-  EB_RETURN_OR_THROW("Socket::attach", eb_socket_attach(socket, &h));
+  b.read_block  = &eb_proxy_read_block_handler;
+  b.write_block = &eb_proxy_write_block_handler;
+  EB_RETURN_OR_THROW("Socket::attach", eb_socket_attach_block(socket, &h, &b));
 }
 
 inline EB_STATUS_OR_VOID_T Socket::detach(const struct sdb_device* device) {
@@ -873,10 +1313,26 @@ inline int Socket::run(int timeout_us) {
   return eb_socket_run(socket, timeout_us);
 }
 
+inline EB_STATUS_OR_VOID_T Socket::enableStats() {
+  EB_RETURN_OR_THROW("Socket::enableStats", eb_socket_stats_enable(socket));
+}
+
+inline EB_STATUS_OR_VOID_T Socket::stats(struct eb_socket_stats* stats) const {
+  EB_RETURN_OR_THROW("Socket::stats", eb_socket_stats(socket, stats));
+}
+
+inline EB_STATUS_OR_VOID_T Socket::capture(const char* filename) {
+  EB_RETURN_OR_THROW("Socket::capture", eb_socket_capture(socket, filename));
+}
+
 inline uint32_t Socket::timeout() const {
   return eb_socket_timeout(socket);
 }
 
+inline long Socket::timeout_us() const {
+  return eb_socket_timeout_us(socket);
+}
+
 inline void Socket::descriptors(eb_user_data_t user, eb_descriptor_callback_t list) const {
   return eb_socket_descriptors(socket, user, list);
 }
@@ -885,6 +1341,10 @@ inline int Socket::check(uint32_t now, eb_user_data_t user, eb_descriptor_callba
   return eb_socket_check(socket, now, user, ready);
 }
 
+inline eb_queue_t Socket::queue() {
+  return eb_socket_queue(socket);
+}
+
 inline Device::Device(eb_device_t dev)
  : device(dev) {
 }
@@ -915,6 +1375,18 @@ inline width_t Device::width() const {
   return eb_device_width(device);
 }
 
+inline EB_STATUS_OR_VOID_T Device::flow(struct eb_device_flow* flow) const {
+  EB_RETURN_OR_THROW("Device::flow", eb_device_flow(device, flow));
+}
+
+inline EB_STATUS_OR_VOID_T Device::enableStats() {
+  EB_RETURN_OR_THROW("Device::enableStats", eb_device_stats_enable(device));
+}
+
+inline EB_STATUS_OR_VOID_T Device::stats(struct eb_device_stats* stats) const {
+  EB_RETURN_OR_THROW("Device::stats", eb_device_stats(device, stats));
+}
+
 template <typename T>
 inline EB_STATUS_OR_VOID_T Device::sdb_scan_bus(const struct sdb_bridge* bridge, T* user, sdb_callback_t cb) {
   EB_RETURN_OR_THROW("Device::sdb_scan_bus", eb_sdb_scan_bus(device, bridge, user, cb));
@@ -947,8 +1419,26 @@ inline EB_STATUS_OR_VOID_T Device::write(eb_address_t address, eb_format_t forma
   EB_RETURN_OR_THROW("Device::write", eb_device_write(device, address, format, data, 0, eb_block));
 }
 
+template <typename T>
+inline EB_STATUS_OR_VOID_T Device::readBlock(eb_address_t address, eb_format_t format, uint8_t* data, eb_address_t length, T* user, eb_callback_t cb, int window) {
+  EB_RETURN_OR_THROW("Device::readBlock", eb_device_read_block(device, address, format, data, length, window, user, cb));
+}
+
+inline EB_STATUS_OR_VOID_T Device::readBlock(eb_address_t address, eb_format_t format, uint8_t* data, eb_address_t length, int window) {
+  EB_RETURN_OR_THROW("Device::readBlock", eb_device_read_block(device, address, format, data, length, window, 0, eb_block));
+}
+
+template <typename T>
+inline EB_STATUS_OR_VOID_T Device::writeBlock(eb_address_t address, eb_format_t format, const uint8_t* data, eb_address_t length, T* user, eb_callback_t cb, int window) {
+  EB_RETURN_OR_THROW("Device::writeBlock", eb_device_write_block(device, address, format, data, length, window, user, cb));
+}
+
+inline EB_STATUS_OR_VOID_T Device::writeBlock(eb_address_t address, eb_format_t format, const uint8_t* data, eb_address_t length, int window) {
+  EB_RETURN_OR_THROW("Device::writeBlock", eb_device_write_block(device, address, format, data, length, window, 0, eb_block));
+}
+
 inline Cycle::Cycle()
- : cycle(EB_NULL) {
+ : cycle(EB_NULL), pending(0) {
 }
 
 template <typename T>
@@ -960,15 +1450,40 @@ inline EB_STATUS_OR_VOID_T Cycle::open(Device device) {
   EB_RETURN_OR_THROW("Cycle::open", eb_cycle_open(device.device, 0, eb_block, &cycle));
 }
 
+#if __cplusplus >= 201103L
+inline EB_STATUS_OR_VOID_T Cycle::open(Device device, future_t& done) {
+  promise_t* promise = new promise_t;
+  status_t status = eb_cycle_open(device.device, promise, &wrap_promise_callback, &cycle);
+  if (status == EB_OK) {
+    done = promise->get_future();
+    pending = promise;
+  } else {
+    delete promise;
+  }
+  EB_RETURN_OR_THROW("Cycle::open", status);
+}
+#endif
+
+#ifdef __cpp_impl_coroutine
+inline EB_STATUS_OR_VOID_T Cycle::open(Device device, Completion& done) {
+  EB_RETURN_OR_THROW("Cycle::open", eb_cycle_open(device.device, &done, &wrap_completion_callback, &cycle));
+}
+#endif
+
 inline void Cycle::abort() {
   eb_cycle_abort(cycle);
   cycle = EB_NULL;
+#if __cplusplus >= 201103L
+  delete reinterpret_cast<promise_t*>(pending); /* the future sees broken_promise */
+#endif
+  pending = 0;
 }
 
 inline EB_STATUS_OR_VOID_T Cycle::close() {
   status_t status;
   status = eb_cycle_close(cycle);
   cycle = EB_NULL;
+  pending = 0;
   EB_RETURN_OR_THROW("Cycle::close", status);
 }
 
@@ -976,9 +1491,18 @@ inline EB_STATUS_OR_VOID_T Cycle::close_silently() {
   status_t status;
   status = eb_cycle_close_silently(cycle);
   cycle = EB_NULL;
+  pending = 0;
   EB_RETURN_OR_THROW("Cycle::close_silently", status);
 }
 
+inline EB_STATUS_OR_VOID_T Cycle::close_coalesced(int coalesce) {
+  status_t status;
+  status = eb_cycle_close_coalesced(cycle, coalesce);
+  cycle = EB_NULL;
+  pending = 0;
+  EB_RETURN_OR_THROW("Cycle::close_coalesced", status);
+}
+
 inline void Cycle::read(address_t address, format_t format, data_t* data) {
   eb_cycle_read(cycle, address, format, data);
 }
@@ -995,6 +1519,10 @@ inline void Cycle::write_config(address_t address, format_t format, data_t data)
   eb_cycle_write_config(cycle, address, format, data);
 }
 
+inline void Cycle::timeout(uint32_t timeout_us) {
+  eb_cycle_timeout(cycle, timeout_us);
+}
+
 inline const Device Cycle::device() const {
   return Device(eb_cycle_device(cycle));
 }
@@ -1003,6 +1531,68 @@ inline Device Cycle::device() {
   return Device(eb_cycle_device(cycle));
 }
 
+inline Batch::Batch()
+ : batch(0), pending(0) {
+}
+
+template <typename T>
+inline EB_STATUS_OR_VOID_T Batch::open(eb_queue_t queue, Device device, T* user, eb_callback_t cb) {
+  EB_RETURN_OR_THROW("Batch::open", eb_batch_open(queue, device.device, user, cb, &batch));
+}
+
+inline EB_STATUS_OR_VOID_T Batch::open(eb_queue_t queue, Device device) {
+  EB_RETURN_OR_THROW("Batch::open", eb_batch_open(queue, device.device, 0, 0, &batch));
+}
+
+#if __cplusplus >= 201103L
+inline EB_STATUS_OR_VOID_T Batch::open(eb_queue_t queue, Device device, future_t& done) {
+  promise_t* promise = new promise_t;
+  status_t status = eb_batch_open(queue, device.device, promise, &wrap_promise_callback, &batch);
+  if (status == EB_OK) {
+    done = promise->get_future();
+    pending = promise;
+  } else {
+    delete promise;
+  }
+  EB_RETURN_OR_THROW("Batch::open", status);
+}
+#endif
+
+inline void Batch::abort() {
+  eb_batch_abort(batch);
+  batch = 0;
+#if __cplusplus >= 201103L
+  delete reinterpret_cast<promise_t*>(pending); /* the future sees broken_promise */
+#endif
+  pending = 0;
+}
+
+inline void Batch::close() {
+  eb_batch_close(batch);
+  batch = 0;
+  pending = 0;
+}
+
+inline void Batch::timeout(uint32_t timeout_us) {
+  eb_batch_timeout(batch, timeout_us);
+}
+
+inline void Batch::read(address_t address, format_t format, data_t* data) {
+  eb_batch_read(batch, address, format, data);
+}
+
+inline void Batch::write(address_t address, format_t format, data_t data) {
+  eb_batch_write(batch, address, format, data);
+}
+
+inline void Batch::read_config(address_t address, format_t format, data_t* data) {
+  eb_batch_read_config(batch, address, format, data);
+}
+
+inline void Batch::write_config(address_t address, format_t format, data_t data) {
+  eb_batch_write_config(batch, address, format, data);
+}
+
 inline Operation::Operation(eb_operation_t op)
  : operation(op) {
 }
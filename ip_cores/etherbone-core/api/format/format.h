@@ -49,6 +49,11 @@ typedef union {
   eb_address_t address;
 } eb_max_align_t;
 
+/* Byte widths of a record's address/data fields and of its header (also the packet header) */
+EB_PRIVATE void eb_device_alignment(eb_width_t width, int* alignment, int* record_alignment);
+/* Bytes taken in a packet by one record of wcount writes and rcount reads */
+EB_PRIVATE int eb_record_length(int alignment, int record_alignment, int wcount, int rcount);
+
 EB_PRIVATE int eb_device_slave(eb_socket_t socketp, eb_transport_t transportp, eb_device_t devicep, eb_user_data_t data, eb_descriptor_callback_t ready, int *completed);
 EB_PRIVATE eb_status_t eb_device_flush(eb_device_t device, int *completed);
 
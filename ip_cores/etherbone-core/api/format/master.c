@@ -40,6 +40,7 @@
 #include "../transport/transport.h"
 #include "../memory/memory.h"
 #include "format.h"
+#include "vector.h"
 #include "bigendian.h"
 
 static void EB_mWRITE(uint8_t* wptr, eb_data_t val, int alignment) {
@@ -50,6 +51,75 @@ static void EB_mWRITE(uint8_t* wptr, eb_data_t val, int alignment) {
   }
 }
 
+/* Encode a whole run of values; alignment 4 is the common case */
+static void EB_mWRITEV(uint8_t* wptr, eb_data_t* in, int count, int alignment) {
+  int i;
+  
+  if (alignment == 4) {
+    eb_vector_store32(wptr, in, count);
+  } else {
+    for (i = 0; i < count; ++i)
+      EB_mWRITE(wptr + i*alignment, in[i], alignment);
+  }
+}
+
+static void eb_device_header(uint8_t* buffer, eb_width_t width, int header_alignment) {
+  memset(buffer, 0, header_alignment);
+  buffer[0] = 0x4E;
+  buffer[1] = 0x6F;
+  buffer[2] = 0x10; /* V1. no probe. */
+  buffer[3] = width;
+}
+
+void eb_device_alignment(eb_width_t width, int* alignment, int* record_alignment) {
+  eb_width_t biggest;
+  
+  biggest = (width >> 4) | (width & EB_DATAX);
+  *alignment = 2;
+  *alignment += (biggest >= EB_DATA32)*2;
+  *alignment += (biggest >= EB_DATA64)*4;
+  *record_alignment = 4;
+  *record_alignment += (biggest >= EB_DATA64)*4;
+}
+
+int eb_record_length(int alignment, int record_alignment, int wcount, int rcount) {
+  int total;
+  
+  total = (wcount > 0) + wcount
+        + (rcount > 0) + rcount;
+  
+  return record_alignment + total*alignment;
+}
+
+/* Hand len bytes of buffer to the transport and return where to format next.
+ * With zero-copy transports this is a fresh transport buffer, else the same stack buffer.
+ */
+static uint8_t* eb_device_emit(eb_device_t devicep, struct eb_transport_ops* tops, struct eb_transport* transport, struct eb_link* link, uint8_t* buffer, int len, int claimed, int* size) {
+  struct eb_device* device;
+  
+  device = EB_DEVICE(devicep);
+  eb_socket_capture_packet(device->socket, device->transport, devicep, 1, buffer, len);
+  
+  if (claimed) {
+    (*tops->commit)(transport, link, len);
+    return (*tops->claim)(transport, link, size);
+  } else {
+    (*tops->send)(transport, link, buffer, len);
+    return buffer;
+  }
+}
+
+/* The window is full, and some read-back is due to return credit */
+static int eb_device_blocked(eb_device_t devicep) {
+  struct eb_device* device;
+  
+  device = EB_DEVICE(devicep);
+  if (!eb_flow_blocked(device->flow)) return 0;
+  
+  /* Otherwise the credit of unanswered cycles could never return */
+  return EB_DEVICE_AUX(device->aux)->first_response != EB_RESPONSE_NONE;
+}
+
 /* This method is tricky.
  * Whenever a callback or an allocation happens, dereferenced pointers become invalid.
  * Thus, the EB_<TYPE>(x) conversions appear late and near their use.
@@ -57,27 +127,36 @@ static void EB_mWRITE(uint8_t* wptr, eb_data_t val, int alignment) {
 eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
   struct eb_socket* socket;
   struct eb_socket_aux* aux;
+  struct eb_device_aux* device_aux;
   struct eb_device* device;
   struct eb_link* link;
   struct eb_transport* transport;
   struct eb_cycle* cycle;
   struct eb_response* response;
   struct eb_transport_ops* tops;
+  eb_socket_t socketp;
   eb_cycle_t cyclep, nextp, prevp;
   eb_response_t responsep;
-  eb_width_t biggest, data, addr, width;
+  eb_flow_t flowp;
+  eb_width_t data, addr, width;
   eb_format_t format, size, endian;
   eb_address_t address_mask;
-  uint8_t buffer[sizeof(eb_max_align_t)*(255+255+1+1)+8]; /* big enough for worst-case record */
-  uint8_t * wptr, * cptr, * eob;
-  int alignment, record_alignment, header_alignment, stride, mtu, readback, has_reads;
+  uint8_t stack[sizeof(eb_max_align_t)*(255+255+1+1)+8]; /* big enough for worst-case record */
+  uint8_t * buffer, * wptr, * cptr, * eob;
+  int alignment, record_alignment, header_alignment, stride, mtu, readback, has_reads, claimed, bufsize, cycle_bytes;
+  int sent_cycles, sent_records, sent_packets, sent_bytes;
+  uint32_t now, held;
   
   device = EB_DEVICE(devicep);
   transport = EB_TRANSPORT(device->transport);
+  socketp = device->socket;
   width = device->widths;
   
   if (device->link == EB_NULL) return EB_FAIL;
   
+  /* Nothing to send: spare the transport its buffering calls */
+  if (device->un_link.ready == EB_NULL || eb_device_blocked(devicep)) return EB_OK;
+  
   /*
   assert (device->un_link.passive != devicep);
   assert (eb_width_refined(width) != 0);
@@ -86,12 +165,7 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
   /* Calculate alignment values */
   data = width & EB_DATAX;
   addr = width >> 4;
-  biggest = addr | data;
-  alignment = 2;
-  alignment += (biggest >= EB_DATA32)*2;
-  alignment += (biggest >= EB_DATA64)*4;
-  record_alignment = 4;
-  record_alignment += (biggest >= EB_DATA64)*4;
+  eb_device_alignment(width, &alignment, &record_alignment);
   header_alignment = record_alignment;
   stride = data;
   
@@ -104,22 +178,26 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
   link = EB_LINK(device->link);
   tops->send_buffer(transport, link, 1);
   
+  /* Format straight into the transport's buffers if it lends them */
+  buffer = tops->claim ? (*tops->claim)(transport, link, &bufsize) : 0;
+  claimed = buffer != 0;
+  if (!claimed) {
+    buffer = &stack[0];
+    bufsize = sizeof(stack);
+  }
+  
   /* Non-streaming sockets need a header */
   mtu = tops->mtu;
   if (mtu != 0) {
-    memset(&buffer[0], 0, header_alignment);
-    buffer[0] = 0x4E;
-    buffer[1] = 0x6F;
-    buffer[2] = 0x10; /* V1. no probe. */
-    buffer[3] = width;
+    eb_device_header(buffer, width, header_alignment);
     cptr = wptr = &buffer[header_alignment];
     eob = &buffer[mtu];
   } else {
     cptr = wptr = &buffer[0];
-    eob = &buffer[sizeof(buffer)];
+    eob = &buffer[bufsize];
   }
   
-  /* Invert the list of cycles */
+  /* Invert the list of cycles; callbacks below may queue new ones */
   prevp = EB_NULL;
   for (cyclep = device->un_link.ready; cyclep != EB_NULL; cyclep = nextp) {
     cycle = EB_CYCLE(cyclep);
@@ -127,18 +205,33 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
     cycle->un_link.next = prevp;
     prevp = cyclep;
   }
+  device->un_link.ready = EB_NULL;
+  
+  flowp = device->flow;
+  
+  /* Responses are due relative to this; bring the wheel up to date first */
+  now = eb_socket_clock(socketp);
+  socket = EB_SOCKET(socketp);
+  eb_timer_advance(&EB_SOCKET_AUX(socket->aux)->state->timers, now);
   
   has_reads = 0;
+  sent_cycles = sent_records = sent_packets = sent_bytes = 0;
   for (cyclep = prevp; cyclep != EB_NULL; cyclep = nextp) {
     struct eb_operation* operation;
     struct eb_operation* scan;
     eb_operation_t operationp;
     eb_operation_t scanp;
     eb_data_t data_mask;
-    int needs_check, cycle_end;
+    int needs_check, pace, checking, cycle_end;
     unsigned int ops, maxops;
     eb_status_t reason;
     
+    /* The rest waits for responses to return credit */
+    if (eb_device_blocked(devicep)) break;
+    
+    /* ... or for a read-back address to come free */
+    if (!eb_response_rba(socketp)) break;
+    
     cycle = EB_CYCLE(cyclep);
     nextp = cycle->un_link.next;
     
@@ -245,6 +338,10 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
     operation = EB_OPERATION(operationp);
     
     needs_check = (operation->flags & EB_OP_CHECKED) != 0;
+    
+    /* Unanswered cycles hold credit; once they hold enough, ask for a status read-back */
+    pace = !needs_check && eb_flow_pace(flowp, EB_DEVICE_AUX(device->aux)->silent);
+    
     if (needs_check) {
       maxops = stride * 8;
     } else {
@@ -255,10 +352,12 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
     ops = 0;
     readback = 0;
     cycle_end = 0;
+    cycle_bytes = 0;
     while (!cycle_end) {
-      int wcount, rcount, rxcount, total, length, fifo;
+      int wcount, rcount, rxcount, length, fifo, i;
       eb_address_t bwa;
       eb_data_t wv;
+      eb_data_t values[255];
       eb_operation_flags_t rcfg, wcfg;
       uint8_t op_shift, low_addr;
       
@@ -354,7 +453,7 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
         if (rcfg == 0) ++ops;
         
         rcount = 1;
-        for (scanp = scan->next; scanp != EB_NULL; scanp = scan->next) {
+        for (scanp = eb_find_sent(scan->next); scanp != EB_NULL; scanp = eb_find_sent(scan->next)) {
           scan = EB_OPERATION(scanp);
           if ((scan->flags & EB_OP_MASK) == EB_OP_WRITE) break;
           if ((scan->flags & EB_OP_CFG_SPACE) != rcfg) break;
@@ -367,9 +466,12 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
         }
       }
       
+      /* A paced cycle needs one read-back, if it has none of its own */
+      checking = needs_check || (pace && !readback && rcount == 0);
+      
       if (rcount == 0 && 
           (format == EB_DATAX || format == data) && 
-          (ops >= maxops || (scanp == EB_NULL && needs_check && ops > 0))) {
+          (ops >= maxops || (scanp == EB_NULL && checking && ops > 0))) {
         /* Insert error-flag read */
         format = data;
         rxcount = 1;
@@ -379,10 +481,7 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
       }
       
       /* Compute total request length */
-      total = (wcount  > 0) + wcount
-            + (rxcount > 0) + rxcount;
-      
-      length = record_alignment + total*alignment;
+      length = eb_record_length(alignment, record_alignment, wcount, rxcount);
       
       /* Ensure sufficient buffer space */
       if (length > eob - wptr) {
@@ -392,27 +491,38 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
         
         if (mtu == 0) {
           /* Overflow in a streaming device => flush and continue */
-          (*tops->send)(transport, link, &buffer[0], wptr - &buffer[0]);
+          ++sent_packets;
+          sent_bytes += wptr - &buffer[0];
+          buffer = eb_device_emit(devicep, tops, transport, link, buffer, wptr - &buffer[0], claimed, &bufsize);
           wptr = &buffer[0];
+          eob = &buffer[bufsize];
         } else {
           /* Overflow in a packet-based device, send any previous cycles and keep current */
           
           /* Already contains a prior cycle -- flush it */
           if (cptr != &buffer[header_alignment]) {
+            uint8_t* next;
             int send, keep;
             
             /* If we've sent no reads, toggle the header */
             if (has_reads == 0) buffer[2] |= EB_HEADER_NR;
-            has_reads = 0;
+            
+            /* Only the records of the current cycle move on */
+            has_reads = readback;
             
             send = cptr - &buffer[0];
-            (*tops->send)(transport, link, &buffer[0], send);
+            ++sent_packets;
+            sent_bytes += send;
+            next = eb_device_emit(devicep, tops, transport, link, buffer, send, claimed, &bufsize);
             
-            /* Shift any existing records over */
+            /* Shift any existing records over (the committed buffer is still intact) */
             keep = wptr - cptr;
-            memmove(&buffer[header_alignment], cptr, keep);
+            memmove(&next[header_alignment], cptr, keep);
+            eb_device_header(next, width, header_alignment);
+            buffer = next;
             cptr = &buffer[header_alignment];
             wptr = cptr + keep;
+            eob = &buffer[mtu];
           }
           
           /* Test for cycle overflow of MTU */
@@ -433,11 +543,13 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
       
       /* If we have reads, we don't promise none! */
       has_reads |= rxcount > 0;
+      cycle_bytes += length;
+      ++sent_records;
       
       /* The last record in a cycle if: */
       cycle_end = 
         scanp == EB_NULL &&
-        (!needs_check || ops == 0 || rxcount != rcount);
+        (!checking || ops == 0 || rxcount != rcount);
         
       /* The low address bits determine how far to shift values */
       size = format & EB_DATAX;
@@ -466,15 +578,17 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
         EB_mWRITE(wptr, operation->address, alignment);
         wptr += alignment;
         
-        for (; wcount--; operationp = operation->next) {
+        for (i = 0; i < wcount; ++i, operationp = operation->next) {
           operation = EB_OPERATION(operationp);
           
           wv = operation->un_value.write_value;
           wv <<= (op_shift<<3);
           
-          EB_mWRITE(wptr, wv, alignment);
-          wptr += alignment;
+          values[i] = wv;
         }
+        
+        EB_mWRITEV(wptr, values, wcount, alignment);
+        wptr += wcount*alignment;
       }
       
       /* Insert the read-back */
@@ -498,18 +612,25 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
         EB_mWRITE(wptr, aux->rba, alignment);
         wptr += alignment;
         
-        for (; rcount--; operationp = operation->next) {
+        for (i = 0; i < rcount; ++i, operationp = eb_find_sent(operation->next)) {
           operation = EB_OPERATION(operationp);
-          
-          EB_mWRITE(wptr, operation->address, alignment);
-          wptr += alignment;
+          values[i] = operation->address;
         }
+        
+        EB_mWRITEV(wptr, values, rcount, alignment);
+        wptr += rcount*alignment;
       }
     }
     
     /* Did we finish the while loop? */
     if (cycle_end) {
+      ++sent_cycles;
+      
       if (readback == 0) {
+        /* Its credit waits for the next read-back to return */
+        eb_flow_sent(flowp, cycle_bytes);
+        EB_DEVICE_AUX(device->aux)->silent += cycle_bytes;
+        
         /* No response will arrive, so call callback now */
         /* Invalidates pointers, but jumps to top of loop afterwards */
         (*cycle->callback)(cycle->user_data, cycle->un_link.device, cycle->un_ops.first, EB_OK); 
@@ -519,18 +640,24 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
         eb_free_response(responsep);
       } else {
         /* Setup a response */
-        response->deadline = aux->time_cache + 5;
         response->cycle = cyclep;
         response->write_cursor = eb_find_read(cycle->un_ops.first);
         response->status_cursor = needs_check ? eb_find_bus(cycle->un_ops.first) : EB_NULL;
         
-        /* Claim response address */
-        response->address = aux->rba;
-        aux->rba = 0x8000 | (aux->rba + 2);
+        /* Hold flow control credit until the response is freed */
+        response->length = cycle_bytes < 0xFFFF ? cycle_bytes : 0xFFFF;
+        response->sent = now;
+        eb_flow_sent(flowp, response->length);
         
-        /* Chain it for response processing in FIFO order */
-        response->next = socket->last_response;
-        socket->last_response = responsep;
+        /* ... along with that of unanswered cycles sent before it */
+        device_aux = EB_DEVICE_AUX(device->aux);
+        held = 0xFFFF - response->length;
+        if (held > device_aux->silent) held = device_aux->silent;
+        response->length += held;
+        device_aux->silent -= held;
+        
+        /* Claim the response address for eb_socket_write_config to find */
+        eb_response_add(devicep, responsep);
       }
       
       /* Update end pointer */
@@ -543,22 +670,50 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
   transport = EB_TRANSPORT(device->transport);
   link = EB_LINK(device->link);
   
-  if (mtu == 0) {
-    if (wptr != &buffer[0]) {
-      (*tops->send)(transport, link, &buffer[0], wptr - &buffer[0]);
-    }
-  } else {
-    if (wptr != &buffer[header_alignment]) {
-      if (has_reads == 0) buffer[2] |= EB_HEADER_NR;
-      (*tops->send)(transport, link, &buffer[0], wptr - &buffer[0]);
-    }
+  if (mtu != 0 && wptr == &buffer[header_alignment]) {
+    /* Nothing but the header */
+    wptr = &buffer[0];
+  } else if (mtu != 0 && has_reads == 0) {
+    buffer[2] |= EB_HEADER_NR;
+  }
+  
+  eb_socket_capture_packet(device->socket, device->transport, devicep, 1, &buffer[0], wptr - &buffer[0]);
+  
+  if (claimed) {
+    (*tops->commit)(transport, link, wptr - &buffer[0]);
+  } else if (wptr != &buffer[0]) {
+    (*tops->send)(transport, link, &buffer[0], wptr - &buffer[0]);
+  }
+  
+  if (wptr != &buffer[0]) {
+    ++sent_packets;
+    sent_bytes += wptr - &buffer[0];
   }
   
+  eb_stats_sent(EB_DEVICE_AUX(device->aux)->stats, sent_cycles, sent_records, sent_packets, sent_bytes);
+  
   /* Done sending */
   tops->send_buffer(transport, link, 0);
   
-  /* Clear the queue */
-  device->un_link.ready = EB_NULL;
+  /* Requeue what the window held back, behind cycles queued meanwhile */
+  if (cyclep != EB_NULL) {
+    prevp = EB_NULL;
+    for (; cyclep != EB_NULL; cyclep = nextp) {
+      cycle = EB_CYCLE(cyclep);
+      nextp = cycle->un_link.next;
+      cycle->un_link.next = prevp;
+      prevp = cyclep;
+    }
+    
+    device = EB_DEVICE(devicep);
+    if (device->un_link.ready == EB_NULL) {
+      device->un_link.ready = prevp;
+    } else {
+      cycle = EB_CYCLE(device->un_link.ready);
+      while (cycle->un_link.next != EB_NULL) cycle = EB_CYCLE(cycle->un_link.next);
+      cycle->un_link.next = prevp;
+    }
+  }
   
   return EB_OK;
 }
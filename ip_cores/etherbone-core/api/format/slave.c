@@ -39,6 +39,7 @@
 #include "../memory/memory.h"
 #include "bigendian.h"
 #include "format.h"
+#include "vector.h"
 
 static eb_data_t EB_LOAD(uint8_t* rptr, int alignment) {
   switch (alignment) {
@@ -57,6 +58,29 @@ static void EB_sWRITE(uint8_t* wptr, eb_data_t val, int alignment) {
   }
 }
 
+/* Decode/encode a whole run of values; alignment 4 is the common case */
+static void EB_LOADV(eb_data_t* out, uint8_t* rptr, int count, int alignment) {
+  int i;
+  
+  if (alignment == 4) {
+    eb_vector_load32(out, rptr, count);
+  } else {
+    for (i = 0; i < count; ++i)
+      out[i] = EB_LOAD(rptr + i*alignment, alignment);
+  }
+}
+
+static void EB_sWRITEV(uint8_t* wptr, eb_data_t* in, int count, int alignment) {
+  int i;
+  
+  if (alignment == 4) {
+    eb_vector_store32(wptr, in, count);
+  } else {
+    for (i = 0; i < count; ++i)
+      EB_sWRITE(wptr + i*alignment, in[i], alignment);
+  }
+}
+
 /* Find the offset */
 static uint8_t eb_log2_table[8] = { 0, 1, 2, 4, 7, 3, 6, 5 };
 static uint8_t eb_log2(uint8_t x) { return eb_log2_table[(uint8_t)(x * 0x17) >> 5]; }
@@ -121,6 +145,7 @@ int eb_device_slave(eb_socket_t socketp, eb_transport_t transportp, eb_device_t
   reply = 0;
   len = eb_transports[transport->link_type].poll(transport, link, user_data, ready, buffer, sizeof(buffer));
   if (len == 0) return 0; /* no data ready */
+  if (len > 0) eb_socket_capture_packet(socketp, transportp, devicep, 0, buffer, len);
   if (len < 2) goto kill; /* EB is always 2 byte aligned */
   
   /* Expect and require an EB header */
@@ -143,6 +168,7 @@ int eb_device_slave(eb_socket_t socketp, eb_transport_t transportp, eb_device_t
       if (passive) device->widths = widths; /* This will be the negotiated width */
       
       /* Bytes 4-7 are echoed back */
+      eb_socket_capture_packet(socketp, transportp, devicep, 1, buffer, 8);
       eb_transports[transport->link_type].send(transport, link, buffer, 8);
       
       /* Kill the link if negotiation is impossible */
@@ -172,7 +198,8 @@ int eb_device_slave(eb_socket_t socketp, eb_transport_t transportp, eb_device_t
       
       dev->widths = buffer[3];
       
-      return 0; /* don't poll again */
+      /* don't poll again, unless a transport burst may still be queued */
+      return devicep == EB_NULL;
     } 
     
     /* Not V1 ? */
@@ -220,11 +247,12 @@ resume_cycle:
 
   /* Start processing the payload */
   while (rptr <= eos - record_alignment) {
-    int total, wconfig, wfifo, rconfig, rfifo, bconfig, sel_ok;
+    int total, wconfig, wfifo, rconfig, rfifo, bconfig, sel_ok, i, j, run;
     eb_address_t bwa, bwa_b, bwa_l;
     eb_address_t ra, ra_b, ra_l;
     eb_address_t bra;
     eb_data_t wv, data_mask;
+    eb_data_t values[255];
     eb_width_t op_width, op_widths;
     uint8_t op_shift, bits, bits1;
     uint8_t addr_low_big_endian, addr_low_little_endian;
@@ -291,6 +319,7 @@ resume_cycle:
       rptr -= record_alignment;
       
       if (reply) {
+        eb_socket_capture_packet(socketp, transportp, devicep, 1, buffer, wptr - &buffer[0]);
         eb_transports[transport->link_type].send(transport, link, buffer, wptr - &buffer[0]);
       }
       
@@ -299,6 +328,7 @@ resume_cycle:
       
       len = eb_transports[transport->link_type].recv(transport, link, buffer+keep, sizeof(buffer)-keep);
       if (len <= 0) goto kill;
+      eb_socket_capture_packet(socketp, transportp, devicep, 0, buffer+keep, len);
       len += keep;
       
       wptr = &buffer[0];
@@ -324,28 +354,27 @@ resume_cycle:
         bwa_l = bwa | addr_low_little_endian;
       }
         
-      while (wcount--) {
-        wv = EB_LOAD(rptr, alignment);
-        rptr += alignment;
-        
+      EB_LOADV(values, rptr, wcount, alignment);
+      rptr += wcount*alignment;
+      
+      for (i = 0; i < wcount; ++i) {
+        wv = values[i];
         wv >>= (op_shift<<3);
         wv &= data_mask;
-        
-        if (wconfig) {
-          if (sel_ok)
-            *completed += eb_socket_write_config(socketp, op_width, bwa, wv);
-        } else {
-          if (sel_ok)
-            eb_socket_write(socketp, op_width, bwa_b, bwa_l, wv, &error);
-          else
-            error = (error<<1) | 1;
-        }
-        
-        if (wfifo == 0) {
-          bwa += stride;
-          bwa_l += stride;
-          bwa_b += stride;
+        values[i] = wv;
+      }
+      
+      if (wconfig) {
+        for (i = 0; sel_ok && i < wcount; ++i) {
+          *completed += eb_socket_write_config(socketp, op_width, bwa, values[i]);
+          if (wfifo == 0) bwa += stride;
         }
+      } else if (sel_ok) {
+        /* A fifo writes every word to the same address */
+        eb_socket_write_block(socketp, op_width, bwa_b, bwa_l, wfifo ? 0 : stride, values, wcount, &error);
+      } else {
+        for (i = 0; i < wcount; ++i)
+          error = (error<<1) | 1;
       }
     }
     
@@ -378,9 +407,12 @@ resume_cycle:
       EB_sWRITE(wptr, bra, alignment);
       wptr += alignment;
       
-      while (rcount--) {
-        ra = EB_LOAD(rptr, alignment);
-        rptr += alignment;
+      /* Every address is loaded before the replies overwrite them */
+      EB_LOADV(values, rptr, rcount, alignment);
+      rptr += rcount*alignment;
+      
+      for (i = 0; i < rcount; i += run) {
+        ra = values[i];
         
         /* Wishbone devices ignore the low address bits and use the select lines */
         ra &= address_filter_bits;
@@ -388,26 +420,33 @@ resume_cycle:
         ra_l = ra | addr_low_little_endian;
         
         if (rconfig) {
+          run = 1;
           if (sel_ok) {
-            wv = eb_socket_read_config(socketp, op_width, ra_b, error);
+            values[i] = eb_socket_read_config(socketp, op_width, ra_b, error);
           } else {
-            wv = 0;
+            values[i] = 0;
           }
+        } else if (sel_ok) {
+          /* Reads of consecutive addresses are served together */
+          for (run = 1; i+run < rcount; ++run)
+            if ((values[i+run] & address_filter_bits) != ra + run*stride) break;
+          eb_socket_read_block(socketp, op_width, ra_b, ra_l, stride, &values[i], run, &error);
         } else {
-          if (sel_ok) {
-            wv = eb_socket_read(socketp, op_width, ra_b, ra_l, &error);
-          } else {
-            wv = 0;
-            error = (error<<1) | 1;
-          }
+          run = 1;
+          values[i] = 0;
+          error = (error<<1) | 1;
         }
         
-        wv &= data_mask;
-        wv <<= (op_shift<<3);
-        
-        EB_sWRITE(wptr, wv, alignment);
-        wptr += alignment;
+        for (j = i; j < i+run; ++j) {
+          wv = values[j];
+          wv &= data_mask;
+          wv <<= (op_shift<<3);
+          values[j] = wv;
+        }
       }
+      
+      EB_sWRITEV(wptr, values, rcount, alignment);
+      wptr += rcount*alignment;
     }
     
     /* We need to terminate the cycle */
@@ -420,6 +459,7 @@ resume_cycle:
   
   /* Reply if needed */
   if (reply) {
+    eb_socket_capture_packet(socketp, transportp, devicep, 1, buffer, wptr - &buffer[0]);
     eb_transports[transport->link_type].send(transport, link, buffer, wptr - &buffer[0]);
   }
   
@@ -433,6 +473,7 @@ resume_cycle:
     
     len = eb_transports[transport->link_type].recv(transport, link, buffer+keep, sizeof(buffer)-keep);
     if (len <= 0) goto kill;
+    eb_socket_capture_packet(socketp, transportp, devicep, 0, buffer+keep, len);
     len += keep;
     
     wptr = rptr = &buffer[0];
@@ -447,11 +488,14 @@ resume_cycle:
   
 kill:
   /* Destroy the connection */
-  if (devicep == EB_NULL) return 0;
+  if (devicep == EB_NULL) return len > 0; /* drop the datagram, but keep draining */
   
   if (passive) {
     eb_device_close(devicep);
   } else {
+    device = EB_DEVICE(devicep);
+    eb_socket_run_del(device->socket, transportp, linkp);
+    
     device = EB_DEVICE(devicep);
     transport = EB_TRANSPORT(transportp);
     link = EB_LINK(linkp);
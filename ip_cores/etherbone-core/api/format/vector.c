@@ -0,0 +1,186 @@
+/** @file vector.c
+ *  @brief Batch conversion of 32-bit big-endian record payload.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  The implementation is picked on first use from what the CPU supports.
+ *  Each vector path finishes any odd tail with the scalar loop.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#include <string.h>
+
+#include "bigendian.h"
+#include "vector.h"
+
+#ifdef EB_VECTOR_X86
+#include <immintrin.h>
+#endif
+
+/* Records need not be 4-byte aligned; memcpy compiles to a plain load where that is safe */
+void eb_vector_load32_scalar(eb_data_t* out, const uint8_t* in, int count) {
+  uint32_t word;
+  int i;
+
+  for (i = 0; i < count; ++i) {
+    memcpy(&word, in + i*4, 4);
+    out[i] = be32toh(word);
+  }
+}
+
+void eb_vector_store32_scalar(uint8_t* out, const eb_data_t* in, int count) {
+  uint32_t word;
+  int i;
+
+  for (i = 0; i < count; ++i) {
+    word = htobe32(in[i]);
+    memcpy(out + i*4, &word, 4);
+  }
+}
+
+#ifdef EB_VECTOR_X86
+
+/* Reverse the bytes of each 32-bit word */
+#define EB_BSWAP32 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+/* Swap the low words of both 64-bit lanes into the low 8 bytes */
+#define EB_NARROW32 3, 2, 1, 0, 11, 10, 9, 8, -1, -1, -1, -1, -1, -1, -1, -1
+
+__attribute__((target("sse4.1")))
+void eb_vector_load32_sse4(eb_data_t* out, const uint8_t* in, int count) {
+  __m128i swap, x;
+  int i;
+
+  swap = _mm_setr_epi8(EB_BSWAP32);
+  for (i = 0; i + 4 <= count; i += 4) {
+    x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + i*4)), swap);
+    _mm_storeu_si128((__m128i*)(out + i),   _mm_cvtepu32_epi64(x));
+    _mm_storeu_si128((__m128i*)(out + i+2), _mm_cvtepu32_epi64(_mm_srli_si128(x, 8)));
+  }
+  eb_vector_load32_scalar(out + i, in + i*4, count - i);
+}
+
+__attribute__((target("sse4.1")))
+void eb_vector_store32_sse4(uint8_t* out, const eb_data_t* in, int count) {
+  __m128i narrow, lo, hi;
+  int i;
+
+  narrow = _mm_setr_epi8(EB_NARROW32);
+  for (i = 0; i + 4 <= count; i += 4) {
+    lo = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + i)),   narrow);
+    hi = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + i+2)), narrow);
+    _mm_storeu_si128((__m128i*)(out + i*4), _mm_unpacklo_epi64(lo, hi));
+  }
+  eb_vector_store32_scalar(out + i*4, in + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void eb_vector_load32_avx2(eb_data_t* out, const uint8_t* in, int count) {
+  __m256i swap, x;
+  int i;
+
+  swap = _mm256_setr_epi8(EB_BSWAP32, EB_BSWAP32);
+  for (i = 0; i + 8 <= count; i += 8) {
+    x = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(in + i*4)), swap);
+    _mm256_storeu_si256((__m256i*)(out + i),   _mm256_cvtepu32_epi64(_mm256_castsi256_si128(x)));
+    _mm256_storeu_si256((__m256i*)(out + i+4), _mm256_cvtepu32_epi64(_mm256_extracti128_si256(x, 1)));
+  }
+  _mm256_zeroupper(); /* the tail is not VEX encoded */
+  eb_vector_load32_sse4(out + i, in + i*4, count - i);
+}
+
+__attribute__((target("avx2")))
+void eb_vector_store32_avx2(uint8_t* out, const eb_data_t* in, int count) {
+  __m256i narrow, lo, hi;
+  int i;
+
+  narrow = _mm256_setr_epi8(EB_NARROW32, EB_NARROW32);
+  for (i = 0; i + 8 <= count; i += 8) {
+    /* Each 128-bit lane keeps its two words in its low 8 bytes */
+    lo = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(in + i)),   narrow);
+    hi = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(in + i+4)), narrow);
+    lo = _mm256_permute4x64_epi64(lo, _MM_SHUFFLE(3, 1, 2, 0));
+    hi = _mm256_permute4x64_epi64(hi, _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256((__m256i*)(out + i*4), _mm256_permute2x128_si256(lo, hi, 0x20));
+  }
+  _mm256_zeroupper();
+  eb_vector_store32_sse4(out + i*4, in + i, count - i);
+}
+
+int eb_vector_has_sse4(void) {
+  return __builtin_cpu_supports("sse4.1");
+}
+
+int eb_vector_has_avx2(void) {
+  return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+static void eb_vector_select(void);
+static void eb_vector_load32_first(eb_data_t* out, const uint8_t* in, int count);
+static void eb_vector_store32_first(uint8_t* out, const eb_data_t* in, int count);
+
+/* Racing threads all select the same functions, so no lock is needed */
+static void (*eb_vector_load32_fn)(eb_data_t* out, const uint8_t* in, int count) = &eb_vector_load32_first;
+static void (*eb_vector_store32_fn)(uint8_t* out, const eb_data_t* in, int count) = &eb_vector_store32_first;
+static const char* eb_vector_name = "scalar";
+
+static void eb_vector_select(void) {
+#ifdef EB_VECTOR_X86
+  if (eb_vector_has_avx2()) {
+    eb_vector_name = "avx2";
+    eb_vector_store32_fn = &eb_vector_store32_avx2;
+    eb_vector_load32_fn = &eb_vector_load32_avx2;
+    return;
+  }
+  if (eb_vector_has_sse4()) {
+    eb_vector_name = "sse4.1";
+    eb_vector_store32_fn = &eb_vector_store32_sse4;
+    eb_vector_load32_fn = &eb_vector_load32_sse4;
+    return;
+  }
+#endif
+  eb_vector_store32_fn = &eb_vector_store32_scalar;
+  eb_vector_load32_fn = &eb_vector_load32_scalar;
+}
+
+static void eb_vector_load32_first(eb_data_t* out, const uint8_t* in, int count) {
+  eb_vector_select();
+  (*eb_vector_load32_fn)(out, in, count);
+}
+
+static void eb_vector_store32_first(uint8_t* out, const eb_data_t* in, int count) {
+  eb_vector_select();
+  (*eb_vector_store32_fn)(out, in, count);
+}
+
+void eb_vector_load32(eb_data_t* out, const uint8_t* in, int count) {
+  (*eb_vector_load32_fn)(out, in, count);
+}
+
+void eb_vector_store32(uint8_t* out, const eb_data_t* in, int count) {
+  (*eb_vector_store32_fn)(out, in, count);
+}
+
+const char* eb_vector_isa(void) {
+  if (eb_vector_load32_fn == &eb_vector_load32_first) eb_vector_select();
+  return eb_vector_name;
+}
@@ -0,0 +1,57 @@
+/** @file vector.h
+ *  @brief Batch conversion of 32-bit big-endian record payload.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  Records carry up to 255 values packed at the record alignment. When the
+ *  alignment is 4 the whole run is converted at once, using SSE4.1 or AVX2
+ *  if the CPU has them. Build with EB_DISABLE_SIMD to keep the scalar loop.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#ifndef EB_VECTOR_H
+#define EB_VECTOR_H
+
+#include "../etherbone.h"
+
+/* The vector paths widen into 64-bit eb_data_t */
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(EB_DISABLE_SIMD) && !defined(EB_FORCE_32) && !defined(EB_FORCE_16)
+#define EB_VECTOR_X86 1
+#endif
+
+/* Convert count big-endian 32-bit words from in to out (and back) */
+EB_PRIVATE void eb_vector_load32(eb_data_t* out, const uint8_t* in, int count);
+EB_PRIVATE void eb_vector_store32(uint8_t* out, const eb_data_t* in, int count);
+
+/* Name of the implementation chosen for this CPU */
+EB_PRIVATE const char* eb_vector_isa(void);
+
+/* The individual implementations; only for the benchmark */
+EB_PRIVATE void eb_vector_load32_scalar(eb_data_t* out, const uint8_t* in, int count);
+EB_PRIVATE void eb_vector_store32_scalar(uint8_t* out, const eb_data_t* in, int count);
+#ifdef EB_VECTOR_X86
+EB_PRIVATE void eb_vector_load32_sse4(eb_data_t* out, const uint8_t* in, int count);
+EB_PRIVATE void eb_vector_store32_sse4(uint8_t* out, const eb_data_t* in, int count);
+EB_PRIVATE void eb_vector_load32_avx2(eb_data_t* out, const uint8_t* in, int count);
+EB_PRIVATE void eb_vector_store32_avx2(uint8_t* out, const eb_data_t* in, int count);
+EB_PRIVATE int eb_vector_has_sse4(void);
+EB_PRIVATE int eb_vector_has_avx2(void);
+#endif
+
+#endif
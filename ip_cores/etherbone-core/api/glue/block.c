@@ -0,0 +1,297 @@
+/** @file block.c
+ *  @brief Stream a buffer to or from a device.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  A block transfer is cut into cycles which each fill about one packet.
+ *  A fixed number of these cycles are kept in flight; every completed
+ *  cycle issues the next one until the buffer is exhausted.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#include <stdlib.h>
+
+#include "device.h"
+#include "../format/format.h"
+#include "../transport/transport.h"
+#include "../memory/memory.h"
+
+#define EB_TRANSFER_WINDOW 8    /* default cycles in flight */
+#define EB_TRANSFER_STREAM 1472 /* cycle size used on streaming links */
+
+struct eb_transfer {
+  eb_device_t device;
+  uint8_t* buffer;
+
+  eb_address_t base, next, end;
+  eb_address_t bulk_first, bulk_end; /* [bulk_first, bulk_end) uses bulk ops */
+
+  eb_format_t bulk, edge, endian;
+  int bulk_ops, edge_ops; /* operations which fit one packet */
+  int write, window, inflight, done;
+  eb_status_t status;
+
+  eb_user_data_t user_data;
+  eb_callback_t cb;
+};
+
+/* Bytes eb_device_flush spends on a run of ops checked operations: records
+ * of up to run operations each, plus the error-flag read which closes them.
+ */
+static int eb_transfer_bytes(int ops, int run, int write, int alignment, int record_alignment) {
+  int bytes, count, ride;
+
+  /* Only full-width writes leave room for the check in their last record */
+  ride = write && run > 1;
+
+  bytes = 0;
+  for (; ops > 0; ops -= count) {
+    count = ops < run ? ops : run;
+    if (write)
+      bytes += eb_record_length(alignment, record_alignment, count, ride && count == ops);
+    else
+      bytes += eb_record_length(alignment, record_alignment, 0, count);
+  }
+
+  if (!ride) bytes += eb_record_length(alignment, record_alignment, 0, 1);
+
+  return bytes;
+}
+
+/* How many checked operations of this size fit into a single packet */
+static int eb_transfer_ops(struct eb_device* device, eb_format_t size, int write) {
+  struct eb_transport* transport;
+  int data, alignment, record_alignment;
+  int maxops, run, budget, group, ops, rest;
+
+  data = device->widths & EB_DATAX;
+  eb_device_alignment(device->widths, &alignment, &record_alignment);
+
+  /* eb_device_flush checks the bus after this many operations */
+  maxops = data * 8;
+  /* Narrow operations change byte lanes, which ends the record */
+  run = size == data ? maxops : 1;
+
+  transport = EB_TRANSPORT(device->transport);
+  budget = eb_transports[transport->link_type].mtu;
+  if (budget == 0) budget = EB_TRANSFER_STREAM;
+  budget -= record_alignment; /* the packet header */
+
+  group = eb_transfer_bytes(maxops, run, write, alignment, record_alignment);
+  ops = (budget / group) * maxops;
+
+  budget %= group;
+  for (rest = maxops-1; rest > 0; --rest) {
+    if (eb_transfer_bytes(rest, run, write, alignment, record_alignment) <= budget) {
+      ops += rest;
+      break;
+    }
+  }
+
+  return ops > 0 ? ops : 1;
+}
+
+static eb_data_t eb_transfer_get(const uint8_t* buf, eb_format_t size, eb_format_t endian) {
+  eb_data_t data;
+  int i;
+
+  data = 0;
+  if (endian == EB_BIG_ENDIAN) {
+    for (i = 0; i < size; ++i)
+      data = (data << 8) | buf[i];
+  } else {
+    for (i = size-1; i >= 0; --i)
+      data = (data << 8) | buf[i];
+  }
+
+  return data;
+}
+
+static void eb_transfer_put(uint8_t* buf, eb_format_t size, eb_format_t endian, eb_data_t data) {
+  int i;
+
+  if (endian == EB_BIG_ENDIAN) {
+    for (i = size-1; i >= 0; --i) {
+      buf[i] = data & 0xFF;
+      data >>= 8;
+    }
+  } else {
+    for (i = 0; i < size; ++i) {
+      buf[i] = data & 0xFF;
+      data >>= 8;
+    }
+  }
+}
+
+static void eb_transfer_done(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status);
+
+/* Top up the window; on failure, status records why */
+static void eb_transfer_pump(struct eb_transfer* transfer) {
+  eb_cycle_t cycle;
+  eb_address_t stop;
+  eb_format_t size, format;
+  eb_status_t status;
+  int ops;
+
+  while (transfer->status == EB_OK && transfer->inflight < transfer->window && transfer->next < transfer->end) {
+    /* A cycle never spans a change of operation size */
+    if (transfer->next < transfer->bulk_first) {
+      size = transfer->edge;
+      ops = transfer->edge_ops;
+      stop = transfer->bulk_first;
+    } else if (transfer->next < transfer->bulk_end) {
+      size = transfer->bulk;
+      ops = transfer->bulk_ops;
+      stop = transfer->bulk_end;
+    } else {
+      size = transfer->edge;
+      ops = transfer->edge_ops;
+      stop = transfer->end;
+    }
+
+    if ((status = eb_cycle_open(transfer->device, transfer, &eb_transfer_done, &cycle)) != EB_OK) {
+      transfer->status = status;
+      break;
+    }
+
+    format = size | transfer->endian;
+    for (; ops > 0 && transfer->next < stop; --ops, transfer->next += size) {
+      if (transfer->write)
+        eb_cycle_write(cycle, transfer->next, format,
+          eb_transfer_get(&transfer->buffer[transfer->next - transfer->base], size, transfer->endian));
+      else
+        eb_cycle_read(cycle, transfer->next, format, 0);
+    }
+
+    eb_cycle_close(cycle);
+    ++transfer->inflight;
+  }
+}
+
+static void eb_transfer_done(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  struct eb_transfer* transfer;
+
+  transfer = (struct eb_transfer*)user;
+  --transfer->inflight;
+
+  if (status != EB_OK) {
+    if (transfer->status == EB_OK) transfer->status = status;
+  } else if (!transfer->write) {
+    for (; op != EB_NULL; op = eb_operation_next(op))
+      eb_transfer_put(&transfer->buffer[eb_operation_address(op) - transfer->base],
+                      eb_operation_format(op) & EB_DATAX, transfer->endian, eb_operation_data(op));
+  }
+
+  eb_transfer_pump(transfer);
+  if (transfer->inflight > 0) return;
+
+  if (transfer->cb == eb_block) {
+    transfer->done = 1;
+  } else {
+    (*transfer->cb)(transfer->user_data, transfer->device, EB_NULL, transfer->status);
+    free(transfer);
+  }
+}
+
+static eb_status_t eb_device_transfer(eb_device_t devicep, eb_address_t address, eb_format_t format, uint8_t* buffer, eb_address_t length, int write, int window, eb_user_data_t user_data, eb_callback_t cb) {
+  struct eb_device* device;
+  struct eb_transfer* transfer;
+  struct eb_transfer stack;
+  eb_socket_t socketp;
+  eb_cycle_t cycle;
+  eb_format_t sizes, data;
+  eb_status_t status;
+
+  device = EB_DEVICE(devicep);
+
+  /* Only operations no wider than the device's data bus are usable */
+  data = device->widths & EB_DATAX;
+  sizes = format & EB_DATAX;
+  if (sizes == 0) sizes = EB_DATAX;
+  sizes &= (data << 1) - 1;
+  if (sizes == 0) return EB_WIDTH;
+
+  if (((address | length) & ((sizes & -sizes) - 1)) != 0) return EB_ADDRESS;
+
+  if (length == 0) {
+    /* Still report completion exactly once */
+    if ((status = eb_cycle_open(devicep, user_data, cb, &cycle)) != EB_OK) return status;
+    return eb_cycle_close(cycle);
+  }
+
+  if (cb == eb_block) {
+    transfer = &stack;
+  } else {
+    transfer = (struct eb_transfer*)malloc(sizeof(struct eb_transfer));
+    if (transfer == 0) return EB_OOM;
+  }
+
+  transfer->device = devicep;
+  transfer->buffer = buffer;
+  transfer->base = address;
+  transfer->next = address;
+  transfer->end = address + length;
+
+  transfer->edge = sizes & -sizes;
+  transfer->bulk = EB_DATA64;
+  while ((transfer->bulk & sizes) == 0) transfer->bulk >>= 1;
+  transfer->endian = format & EB_ENDIAN_MASK;
+  if (transfer->endian == 0) transfer->endian = EB_BIG_ENDIAN;
+
+  /* Narrow operations only at the unaligned head and tail */
+  transfer->bulk_first = (address + transfer->bulk-1) & ~(eb_address_t)(transfer->bulk-1);
+  if (transfer->bulk_first > transfer->end) transfer->bulk_first = transfer->end;
+  transfer->bulk_end = transfer->bulk_first + ((transfer->end - transfer->bulk_first) & ~(eb_address_t)(transfer->bulk-1));
+
+  transfer->write = write;
+  transfer->bulk_ops = eb_transfer_ops(device, transfer->bulk, write);
+  transfer->edge_ops = eb_transfer_ops(device, transfer->edge, write);
+  transfer->window = window > 0 ? window : EB_TRANSFER_WINDOW;
+  transfer->inflight = 0;
+  transfer->done = 0;
+  transfer->status = EB_OK;
+  transfer->user_data = user_data;
+  transfer->cb = cb;
+
+  eb_transfer_pump(transfer);
+
+  if (transfer->inflight == 0) {
+    /* Nothing was issued, so no callback will come */
+    status = transfer->status;
+    if (transfer != &stack) free(transfer);
+    return status;
+  }
+
+  if (transfer != &stack) return EB_OK;
+
+  socketp = eb_device_socket(devicep);
+  while (!transfer->done) eb_socket_run(socketp, -1);
+
+  return transfer->status;
+}
+
+eb_status_t eb_device_read_block(eb_device_t devicep, eb_address_t address, eb_format_t format, uint8_t* data, eb_address_t length, int window, eb_user_data_t user_data, eb_callback_t cb) {
+  return eb_device_transfer(devicep, address, format, data, length, 0, window, user_data, cb);
+}
+
+eb_status_t eb_device_write_block(eb_device_t devicep, eb_address_t address, eb_format_t format, const uint8_t* data, eb_address_t length, int window, eb_user_data_t user_data, eb_callback_t cb) {
+  return eb_device_transfer(devicep, address, format, (uint8_t*)data, length, 1, window, user_data, cb);
+}
@@ -41,9 +41,35 @@ eb_status_t eb_proxy_write_handler(eb_user_data_t data, eb_address_t address, eb
   return handler->write(address, width, value);
 }
 
+int eb_proxy_read_block_handler(eb_user_data_t data, eb_address_t address, eb_width_t width, eb_data_t* ptr, int count) {
+  Handler* handler = reinterpret_cast<Handler*>(data);
+  return handler->read_block(address, width, ptr, count);
+}
+
+int eb_proxy_write_block_handler(eb_user_data_t data, eb_address_t address, eb_width_t width, const eb_data_t* ptr, int count) {
+  Handler* handler = reinterpret_cast<Handler*>(data);
+  return handler->write_block(address, width, ptr, count);
+}
+
 Handler::~Handler() {
 }
 
+int Handler::read_block(address_t address, width_t width, data_t* data, int count) {
+  int i;
+  
+  for (i = 0; i < count; ++i, address += width & EB_DATAX)
+    if (read(address, width, &data[i]) != EB_OK) break;
+  return i;
+}
+
+int Handler::write_block(address_t address, width_t width, const data_t* data, int count) {
+  int i;
+  
+  for (i = 0; i < count; ++i, address += width & EB_DATAX)
+    if (write(address, width, data[i]) != EB_OK) break;
+  return i;
+}
+
 eb_status_t Device::sdb_find_by_identity(uint64_t vendor_id, uint32_t device_id, std::vector<struct sdb_device>& output) {
   eb_status_t status;
   int size = 32; /* initial size */
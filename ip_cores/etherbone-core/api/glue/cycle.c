@@ -31,6 +31,7 @@
 #include "operation.h"
 #include "cycle.h"
 #include "device.h"
+#include "socket.h"
 #include "../memory/memory.h"
 
 static void eb_block_f(eb_user_data_t user, eb_device_t device, eb_operation_t operation, eb_status_t status) {
@@ -69,6 +70,7 @@ eb_status_t eb_cycle_open(eb_device_t devicep, eb_user_data_t user, eb_callback_
   cycle->user_data = user;
   cycle->un_ops.first = EB_NULL;
   cycle->un_link.device = devicep;
+  cycle->timeout = EB_TIMEOUT_DEFAULT;
   
   if (cb) {
     cycle->callback = cb;
@@ -82,6 +84,16 @@ eb_status_t eb_cycle_open(eb_device_t devicep, eb_user_data_t user, eb_callback_
   return EB_OK;
 }
 
+void eb_cycle_timeout(eb_cycle_t cyclep, uint32_t timeout_us) {
+  struct eb_cycle* cycle;
+  
+  if (timeout_us == 0) timeout_us = EB_TIMEOUT_DEFAULT;
+  if (timeout_us > EB_TIMEOUT_MAX) timeout_us = EB_TIMEOUT_MAX;
+  
+  cycle = EB_CYCLE(cyclep);
+  cycle->timeout = timeout_us;
+}
+
 void eb_cycle_destroy(eb_cycle_t cyclep) {
   struct eb_cycle* cycle;
   eb_operation_t i, next;
@@ -115,9 +127,11 @@ static void eb_raw_cycle_close(eb_cycle_t cyclep) {
   struct eb_operation* op;
   struct eb_device* device;
   eb_operation_t prev, i, next;
+  eb_device_t devicep;
   
   cycle = EB_CYCLE(cyclep);
-  device = EB_DEVICE(cycle->un_link.device);
+  devicep = cycle->un_link.device;
+  device = EB_DEVICE(devicep);
 
   /* Reverse the linked-list so it's FIFO */
   if (cycle->un_ops.dead != cyclep) {
@@ -137,6 +151,8 @@ static void eb_raw_cycle_close(eb_cycle_t cyclep) {
   
   /* Remove us from the incomplete cycle counter */
   --device->unready;
+  
+  eb_socket_wake(device->socket, devicep, EB_DEVICE_FLUSH);
 }
 
 static eb_status_t eb_cycle_block(eb_device_t devicep, eb_cycle_t cyclep) {
@@ -187,6 +203,88 @@ eb_status_t eb_cycle_close(eb_cycle_t cyclep) {
   return eb_cycle_block(devicep, cyclep);
 }
 
+/* Writes per run remembered by eb_cycle_coalesce; older ones are kept as is */
+#define EB_COALESCE_WINDOW 16
+
+/* Merge operations of a still open cycle; its list runs newest first.
+ * Returns how many operations will not go on the wire.
+ */
+static int eb_cycle_coalesce(eb_cycle_t cyclep, int coalesce) {
+  struct eb_cycle* cycle;
+  struct eb_operation* op;
+  struct eb_operation* older;
+  eb_operation_t recent[EB_COALESCE_WINDOW];
+  eb_operation_t* opp;
+  eb_operation_t i;
+  int merged, writes, j;
+  
+  cycle = EB_CYCLE(cyclep);
+  if (cycle->un_ops.dead == cyclep) return 0;
+  
+  merged = 0;
+  writes = 0;
+  for (opp = &cycle->un_ops.first; (i = *opp) != EB_NULL; ) {
+    op = EB_OPERATION(i);
+    
+    if ((op->flags & EB_OP_CFG_SPACE) != 0) {
+      /* Config space is never merged, nor merged across */
+      writes = 0;
+    } else if ((op->flags & EB_OP_MASK) != EB_OP_WRITE) {
+      /* A read repeating the one just before it shares its answer */
+      if ((coalesce & EB_COALESCE_READS) != 0 && op->next != EB_NULL) {
+        older = EB_OPERATION(op->next);
+        if ((older->flags & EB_OP_MASK) != EB_OP_WRITE &&
+            (older->flags & EB_OP_CFG_SPACE) == 0 &&
+            older->address == op->address &&
+            older->format == op->format) {
+          op->flags |= EB_OP_MERGED;
+          ++merged;
+        }
+      }
+      writes = 0;
+    } else if ((coalesce & EB_COALESCE_WRITES) != 0) {
+      /* A write overwritten later in the same run of writes is dropped */
+      for (j = 0; j < writes; ++j) {
+        older = EB_OPERATION(recent[j]);
+        if (older->address == op->address && older->format == op->format) break;
+      }
+      
+      if (j != writes) {
+        *opp = op->next;
+        eb_free_operation(i);
+        ++merged;
+        continue;
+      }
+      
+      if (writes < EB_COALESCE_WINDOW) recent[writes++] = i;
+    }
+    
+    opp = &op->next;
+  }
+  
+  return merged;
+}
+
+eb_status_t eb_cycle_close_coalesced(eb_cycle_t cyclep, int coalesce) {
+  struct eb_cycle* cycle;
+  struct eb_device* device;
+  eb_width_t biggest;
+  int merged, word;
+  
+  merged = eb_cycle_coalesce(cyclep, coalesce);
+  
+  /* Each merged operation would have sent an address or data word */
+  cycle = EB_CYCLE(cyclep);
+  device = EB_DEVICE(cycle->un_link.device);
+  biggest = (device->widths >> 4) | (device->widths & EB_DATAX);
+  word = 2;
+  word += (biggest >= EB_DATA32)*2;
+  word += (biggest >= EB_DATA64)*4;
+  eb_stats_coalesced(EB_DEVICE_AUX(device->aux)->stats, merged*word);
+  
+  return eb_cycle_close(cyclep);
+}
+
 static struct eb_operation* eb_cycle_doop(eb_cycle_t cyclep) {
   eb_operation_t opp;
   struct eb_cycle* cycle;
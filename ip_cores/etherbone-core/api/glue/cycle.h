@@ -45,6 +45,8 @@ struct eb_cycle {
     eb_cycle_t next;
     eb_device_t device;
   } un_link;
+  
+  uint32_t timeout; /* microseconds from sending until EB_TIMEOUT */
 };
 
 /* Recursively free the operations. Does not free cycle. */
@@ -27,6 +27,8 @@
 
 #define ETHERBONE_IMPL
 
+#include <stdlib.h>
+
 #include "socket.h"
 #include "device.h"
 #include "socket.h"
@@ -39,11 +41,14 @@ eb_status_t eb_device_open(eb_socket_t socketp, const char* address, eb_width_t
   eb_device_t devicep;
   eb_transport_t transportp;
   eb_link_t linkp;
+  eb_flow_t flowp;
+  eb_device_aux_t auxp;
   struct eb_transport* transport;
   struct eb_link* link;
   struct eb_device* device;
   struct eb_socket* socket;
   struct eb_socket_aux* aux;
+  struct eb_device_aux* device_aux;
   eb_status_t status;
   
   devicep = eb_new_device();
@@ -59,22 +64,53 @@ eb_status_t eb_device_open(eb_socket_t socketp, const char* address, eb_width_t
     return EB_OOM;
   }
   
+  flowp = eb_new_flow();
+  if (flowp == EB_NULL) {
+    eb_free_link(linkp);
+    eb_free_device(devicep);
+    *result = EB_NULL;
+    return EB_OOM;
+  }
+  
+  auxp = eb_new_device_aux();
+  if (auxp == EB_NULL) {
+    eb_free_flow(flowp);
+    eb_free_link(linkp);
+    eb_free_device(devicep);
+    *result = EB_NULL;
+    return EB_OOM;
+  }
+  
   socket = EB_SOCKET(socketp);
   aux = EB_SOCKET_AUX(socket->aux);
   
   proposed_widths &= socket->widths;
   if (eb_width_possible(proposed_widths) == 0) {
+    eb_free_device_aux(auxp);
+    eb_free_flow(flowp);
     eb_free_link(linkp);
     eb_free_device(devicep);
     *result = EB_NULL;
     return EB_WIDTH;
   }
   
+  eb_flow_init(flowp);
+  
+  device_aux = EB_DEVICE_AUX(auxp);
+  device_aux->stats = 0;
+  device_aux->first_response = EB_RESPONSE_NONE;
+  device_aux->last_response = EB_RESPONSE_NONE;
+  device_aux->overtaken = 0;
+  device_aux->silent = 0;
+  
   device = EB_DEVICE(devicep);
   device->socket = socketp;
   device->un_link.ready = EB_NULL;
   device->unready = 0;
+  device->wake = 0;
   device->link = linkp;
+  device->flow = flowp;
+  device->aux = auxp;
   
   link = EB_LINK(linkp);
   
@@ -87,6 +123,8 @@ eb_status_t eb_device_open(eb_socket_t socketp, const char* address, eb_width_t
   }
   
   if (transportp == EB_NULL) {
+    eb_free_device_aux(auxp);
+    eb_free_flow(flowp);
     eb_free_link(linkp);
     eb_free_device(devicep);
     *result = EB_NULL;
@@ -94,6 +132,8 @@ eb_status_t eb_device_open(eb_socket_t socketp, const char* address, eb_width_t
   }
   
   if (status != EB_OK) {
+    eb_free_device_aux(auxp);
+    eb_free_flow(flowp);
     eb_free_link(linkp);
     eb_free_device(devicep);
     *result = EB_NULL;
@@ -104,6 +144,9 @@ eb_status_t eb_device_open(eb_socket_t socketp, const char* address, eb_width_t
   device->next = socket->first_device;
   socket->first_device = devicep;
   
+  eb_socket_run_add(socketp, transportp, linkp, devicep);
+  eb_socket_capture_device(socketp, transportp, devicep, address);
+  
   /* If the connection is streaming, we must do exactly one handshake */
   if (eb_transports[transport->link_type].mtu == 0)
     attempts = 1;
@@ -128,6 +171,7 @@ eb_status_t eb_device_open(eb_socket_t socketp, const char* address, eb_width_t
       transport = EB_TRANSPORT(device->transport);
       
       *(uint32_t*)(buf+4) = htobe32((uint32_t)(uintptr_t)devicep);
+      eb_socket_capture_packet(socketp, device->transport, devicep, 1, buf, sizeof(buf));
       eb_transports[transport->link_type].send(transport, link, buf, sizeof(buf));
       
       timeout = 3000000; /* 3 seconds */
@@ -193,8 +237,11 @@ eb_status_t eb_socket_passive(eb_socket_t socketp, const char* address) {
   device->socket = socketp;
   device->un_link.passive = devicep;
   device->unready = 0;
+  device->wake = 0;
   device->widths = 0;
   device->link = linkp;
+  device->flow = EB_NULL;
+  device->aux = EB_NULL;
   
   link = EB_LINK(linkp);
   
@@ -222,6 +269,9 @@ eb_status_t eb_socket_passive(eb_socket_t socketp, const char* address) {
   device->next = socket->first_device;
   socket->first_device = devicep;
   
+  eb_socket_run_add(socketp, transportp, linkp, devicep);
+  eb_socket_capture_device(socketp, transportp, devicep, address);
+  
   return EB_OK;
 }
 
@@ -245,12 +295,21 @@ eb_link_t eb_device_new_slave(eb_socket_t socketp, eb_transport_t transportp, eb
   device->socket = socketp;
   device->un_link.passive = devicep;
   device->unready = 0;
+  device->wake = 0;
   device->widths = 0;
   device->link = linkp;
+  device->flow = EB_NULL;
+  device->aux = EB_NULL;
   device->transport = transportp;
   device->next = socket->first_device;
   socket->first_device = devicep;
   
+  eb_socket_run_add(socketp, transportp, linkp, devicep);
+  eb_socket_capture_device(socketp, transportp, devicep, 0);
+  
+  /* The peer may have written already */
+  eb_socket_wake(socketp, devicep, EB_DEVICE_READABLE);
+  
   return new_linkp;
 
 fail1:
@@ -337,11 +396,21 @@ eb_status_t eb_device_close(eb_device_t devicep) {
   /* Close the link */
   linkp = device->link;
   if (linkp != EB_NULL) {
+    eb_socket_run_del(socketp, device->transport, linkp);
     link = EB_LINK(linkp);
     eb_transports[transport->link_type].disconnect(transport, link);
     eb_free_link(linkp);
   }
   
+  if (device->flow != EB_NULL)
+    eb_free_flow(device->flow);
+  if (device->aux != EB_NULL) {
+    free(EB_DEVICE_AUX(device->aux)->stats);
+    eb_free_device_aux(device->aux);
+  }
+  if (device->wake != 0)
+    eb_socket_unwake(socketp, devicep);
+  
   eb_free_device(devicep);
   
   return EB_OK;
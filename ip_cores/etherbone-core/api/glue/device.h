@@ -32,6 +32,33 @@
 
 #include "../etherbone.h"
 #include "../transport/transport.h"
+#include "flow.h"
+#include "stats.h"
+
+/* Reasons for eb_socket_check to visit a device; see eb_socket_wake */
+#define EB_DEVICE_READABLE 1 /* the link's descriptor has input */
+#define EB_DEVICE_FLUSH    2 /* cycles are queued to send */
+
+/* Responses in flight link to each other by their slot in the socket's
+ * response table (see eb_socket_state), which is smaller than a handle.
+ */
+typedef uint16_t eb_response_slot_t;
+#define EB_RESPONSE_NONE 0xFFFF
+
+typedef EB_POINTER(eb_device_aux) eb_device_aux_t;
+struct eb_device_aux {
+  struct eb_device_stats* stats; /* 0 until enabled */
+  
+  /* Read-backs in flight, in the order they were sent */
+  eb_response_slot_t first_response;
+  eb_response_slot_t last_response;
+  
+  /* Request bytes answered ahead of the first read-back (up to eb_flow_reorder) */
+  uint16_t overtaken;
+  
+  /* Request bytes of unanswered cycles; their credit returns with a later read-back */
+  uint32_t silent;
+};
 
 struct eb_device {
   eb_socket_t socket;
@@ -44,9 +71,12 @@ struct eb_device {
   
   uint8_t unready;
   uint8_t widths;
+  uint8_t wake; /* EB_DEVICE_*; non-zero while on the socket's wake list */
   
   eb_link_t link; /* if connection is broken => EB_NULL */
   eb_transport_t transport;
+  eb_flow_t flow; /* EB_NULL for passive devices */
+  eb_device_aux_t aux; /* EB_NULL for passive devices */
 };
 
 /* Create a new slave device */
@@ -0,0 +1,177 @@
+/** @file flow.c
+ *  @brief Sender flow control for active devices.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  eb_device_flush stops sending once the window is full.
+ *  The window grows by about one packet per round-trip while the link keeps
+ *  up, shrinks as the round-trip time shows requests queueing at the far
+ *  end, and halves on loss (at most once per round-trip).
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#include "flow.h"
+#include "device.h"
+#include "../transport/transport.h"
+#include "../memory/memory.h"
+
+/* Bytes the window may leave queued at the far end before it stops growing/starts shrinking */
+#define EB_FLOW_QUEUE_LOW  (2*EB_FLOW_PACKET)
+#define EB_FLOW_QUEUE_HIGH (8*EB_FLOW_PACKET)
+
+/* Slack on top of two round-trips before an overtaken request is given up */
+#define EB_FLOW_GRACE 1000
+
+void eb_flow_init(eb_flow_t flowp) {
+  struct eb_flow* flow;
+
+  flow = EB_FLOW(flowp);
+  flow->window = EB_FLOW_INITIAL;
+  flow->inflight = 0;
+  flow->srtt = 0;
+  flow->min_rtt = 0;
+  flow->cut = 0;
+  flow->lost = 0;
+}
+
+int eb_flow_blocked(eb_flow_t flowp) {
+  struct eb_flow* flow;
+
+  if (flowp == EB_NULL) return 0;
+
+  flow = EB_FLOW(flowp);
+  return flow->inflight >= flow->window;
+}
+
+void eb_flow_sent(eb_flow_t flowp, int length) {
+  struct eb_flow* flow;
+
+  if (flowp == EB_NULL) return;
+
+  flow = EB_FLOW(flowp);
+  flow->inflight += length;
+}
+
+int eb_flow_pace(eb_flow_t flowp, uint32_t silent) {
+  if (flowp == EB_NULL) return 0;
+
+  return silent >= EB_FLOW(flowp)->window/2;
+}
+
+/* Halve the window for a loss of the request sent at 'sent' */
+static void eb_flow_cut(struct eb_flow* flow, uint32_t sent, uint32_t now) {
+  /* Requests sent before the last cut were lost to the same congestion */
+  if (now == 0 || flow->cut == 0 || (int32_t)(sent - flow->cut) >= 0) {
+    flow->window /= 2;
+    if (flow->window < EB_FLOW_MINIMUM) flow->window = EB_FLOW_MINIMUM;
+    flow->cut = now;
+  }
+}
+
+void eb_flow_done(eb_flow_t flowp, int length, uint32_t sent, int lost) {
+  struct eb_flow* flow;
+  uint32_t now, rtt, queued, step;
+  int limited;
+
+  if (flowp == EB_NULL) return;
+
+  flow = EB_FLOW(flowp);
+  limited = flow->inflight + EB_FLOW_PACKET >= flow->window;
+  flow->inflight = (flow->inflight > (uint32_t)length) ? flow->inflight - length : 0;
+  now = eb_socket_run_clock();
+
+  if (lost) {
+    ++flow->lost;
+    eb_flow_cut(flow, sent, now);
+    return;
+  }
+
+  if (now != 0 && sent != 0) {
+    rtt = now - sent;
+    if (flow->srtt == 0)
+      flow->srtt = rtt;
+    else
+      flow->srtt += ((int32_t)(rtt - flow->srtt)) / 8;
+    if (flow->min_rtt == 0 || rtt < flow->min_rtt)
+      flow->min_rtt = rtt;
+  }
+
+  /* Estimate the bytes waiting at the far end from the round-trip inflation */
+  if (flow->srtt > flow->min_rtt)
+    queued = (uint64_t)flow->window * (flow->srtt - flow->min_rtt) / flow->srtt;
+  else
+    queued = 0;
+
+  /* About one packet per round-trip */
+  step = (uint64_t)EB_FLOW_PACKET * length / flow->window;
+  if (step == 0) step = 1;
+
+  if (queued > EB_FLOW_QUEUE_HIGH) {
+    flow->window -= step;
+    if (flow->window < EB_FLOW_MINIMUM) flow->window = EB_FLOW_MINIMUM;
+  } else if (limited && queued < EB_FLOW_QUEUE_LOW) {
+    flow->window += step;
+    if (flow->window > EB_FLOW_MAXIMUM) flow->window = EB_FLOW_MAXIMUM;
+  }
+}
+
+uint32_t eb_flow_reorder(eb_flow_t flowp) {
+  struct eb_flow* flow;
+
+  if (flowp == EB_NULL) return EB_FLOW_REORDER;
+
+  /* A small window never has that much behind a loss; half of it must do */
+  flow = EB_FLOW(flowp);
+  return flow->window/2 < EB_FLOW_REORDER ? flow->window/2 : EB_FLOW_REORDER;
+}
+
+void eb_flow_overtaken(eb_flow_t flowp, uint32_t sent) {
+  if (flowp == EB_NULL) return;
+
+  /* Datagrams may be reordered, but rarely this far; treat it as a loss */
+  eb_flow_cut(EB_FLOW(flowp), sent, eb_socket_run_clock());
+}
+
+uint32_t eb_flow_grace(eb_flow_t flowp) {
+  struct eb_flow* flow;
+
+  if (flowp == EB_NULL) return EB_TIMEOUT_DEFAULT;
+
+  flow = EB_FLOW(flowp);
+  return 2*flow->srtt + EB_FLOW_GRACE;
+}
+
+eb_status_t eb_device_flow(eb_device_t devicep, struct eb_device_flow* out) {
+  struct eb_device* device;
+  struct eb_flow* flow;
+
+  device = EB_DEVICE(devicep);
+  if (device->flow == EB_NULL) return EB_FAIL;
+
+  flow = EB_FLOW(device->flow);
+  out->window = flow->window;
+  out->inflight = flow->inflight;
+  out->rtt_us = flow->srtt;
+  out->min_rtt_us = flow->min_rtt;
+  out->lost = flow->lost;
+
+  return EB_OK;
+}
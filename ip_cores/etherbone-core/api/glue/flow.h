@@ -0,0 +1,72 @@
+/** @file flow.h
+ *  @brief The Etherbone sender flow control data structure.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  Every active device limits the bytes of requests awaiting a response.
+ *  Responses return credit; the window follows the round-trip time and loss.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#ifndef EB_FLOW_H
+#define EB_FLOW_H
+
+#include "../etherbone.h"
+
+#define EB_FLOW_PACKET  1500              /* unit of window growth */
+#define EB_FLOW_INITIAL (8*EB_FLOW_PACKET)
+#define EB_FLOW_MINIMUM (1*EB_FLOW_PACKET)
+#define EB_FLOW_MAXIMUM (256*EB_FLOW_PACKET)
+#define EB_FLOW_REORDER (3*EB_FLOW_PACKET) /* answered past an older request before it counts as lost */
+
+typedef EB_POINTER(eb_flow) eb_flow_t;
+struct eb_flow {
+  uint32_t window;   /* bytes */
+  uint32_t inflight; /* bytes */
+  uint32_t srtt;     /* microseconds; 0 = no sample yet */
+  uint32_t min_rtt;  /* microseconds */
+  uint32_t cut;      /* clock when the window was last halved */
+  uint32_t lost;
+};
+
+/* Prepare a new flow; EB_NULL is a device without flow control */
+EB_PRIVATE void eb_flow_init(eb_flow_t flowp);
+
+/* Is the window exhausted? */
+EB_PRIVATE int eb_flow_blocked(eb_flow_t flowp);
+
+/* A request of length bytes was sent; eb_flow_done returns the credit */
+EB_PRIVATE void eb_flow_sent(eb_flow_t flowp, int length);
+
+/* Do 'silent' bytes of unanswered requests hold so much credit that the next must be answered? */
+EB_PRIVATE int eb_flow_pace(eb_flow_t flowp, uint32_t silent);
+
+/* The request sent at clock time 'sent' was answered or lost */
+EB_PRIVATE void eb_flow_done(eb_flow_t flowp, int length, uint32_t sent, int lost);
+
+/* Bytes of later requests answered first before an older one counts as lost */
+EB_PRIVATE uint32_t eb_flow_reorder(eb_flow_t flowp);
+
+/* eb_flow_reorder bytes of later requests were answered before the one sent at 'sent' */
+EB_PRIVATE void eb_flow_overtaken(eb_flow_t flowp, uint32_t sent);
+
+/* Microseconds an overtaken request may still be answered in */
+EB_PRIVATE uint32_t eb_flow_grace(eb_flow_t flowp);
+
+#endif
@@ -33,18 +33,133 @@
 #include "socket.h"
 #include "handler.h"
 
+#ifndef EB_USE_STATIC
+#include <stdlib.h>
+#endif
+
+/* EB_USE_STATIC promises no malloc, so there it leaves span 0 (list walk) */
+static void eb_handler_reindex(struct eb_handler_index* index) {
+#ifndef EB_USE_STATIC
+  struct eb_handler_span* span;
+  struct eb_handler_address* address;
+  eb_handler_address_t i;
+  int j;
+  
+  if (index->count == 0) {
+    span = 0;
+    free(index->span);
+  } else {
+    span = (struct eb_handler_span*)realloc(index->span, sizeof(struct eb_handler_span) * index->count);
+    if (span == 0) free(index->span); /* fall back to the list */
+  }
+  
+  index->span = span;
+  index->hit = 0;
+  if (span == 0) return;
+  
+  j = 0;
+  for (i = index->first; i != EB_NULL; i = address->next) {
+    address = EB_HANDLER_ADDRESS(i);
+    span[j].first = address->device->sdb_component.addr_first;
+    span[j].last  = address->device->sdb_component.addr_last;
+    span[j].handler = i;
+    ++j;
+  }
+#endif
+}
+
+eb_handler_address_t eb_handler_find(eb_handler_index_t indexp, eb_address_t address) {
+  struct eb_handler_index* index;
+  struct eb_handler_span* span;
+  struct eb_handler_address* handler;
+  eb_handler_address_t handlerp;
+  int lo, hi, mid;
+  
+  if (indexp == EB_NULL) return EB_NULL;
+  index = EB_HANDLER_INDEX(indexp);
+  
+  span = index->span;
+  if (span == 0) {
+    /* Without an index, walk the list */
+    for (handlerp = index->first; handlerp != EB_NULL; handlerp = handler->next) {
+      handler = EB_HANDLER_ADDRESS(handlerp);
+      if (handler->device->sdb_component.addr_first <= address && 
+          address <= handler->device->sdb_component.addr_last) break;
+    }
+    return handlerp;
+  }
+  
+  /* Records usually target one device repeatedly */
+  mid = index->hit;
+  if (span[mid].first <= address && address <= span[mid].last)
+    return span[mid].handler;
+  
+  /* First span which does not end before the address */
+  lo = 0;
+  hi = index->count;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (span[mid].last < address) {
+      lo = mid+1;
+    } else {
+      hi = mid;
+    }
+  }
+  
+  if (lo == index->count || address < span[lo].first)
+    return EB_NULL;
+  
+  index->hit = lo;
+  return span[lo].handler;
+}
+
+void eb_handler_index_free(eb_handler_index_t indexp) {
+  struct eb_handler_index* index;
+  struct eb_handler_address* handler;
+  eb_handler_address_t i, next;
+  
+  if (indexp == EB_NULL) return;
+  index = EB_HANDLER_INDEX(indexp);
+  
+  for (i = index->first; i != EB_NULL; i = next) {
+    handler = EB_HANDLER_ADDRESS(i);
+    next = handler->next;
+    
+    if (handler->block != EB_NULL) eb_free_handler_block(handler->block);
+    eb_free_handler_callback(handler->callback);
+    eb_free_handler_address(i);
+  }
+  
+#ifndef EB_USE_STATIC
+  free(index->span);
+#endif
+  eb_free_handler_index(indexp);
+}
+
+static void eb_handler_discard(eb_handler_address_t addressp, eb_handler_callback_t callbackp, eb_handler_block_t blockp) {
+  if (blockp != EB_NULL) eb_free_handler_block(blockp);
+  eb_free_handler_callback(callbackp);
+  eb_free_handler_address(addressp);
+}
+
 eb_status_t eb_socket_attach(eb_socket_t socketp, const struct eb_handler* handler) {
+  return eb_socket_attach_block(socketp, handler, 0);
+}
+
+eb_status_t eb_socket_attach_block(eb_socket_t socketp, const struct eb_handler* handler, const struct eb_block_handler* block) {
   eb_handler_address_t addressp, i;
   eb_handler_address_t *prev_ptr;
   eb_handler_callback_t callbackp;
+  eb_handler_block_t blockp;
+  eb_handler_index_t indexp;
   struct eb_socket* socket;
   struct eb_socket_aux* aux;
   struct eb_handler_address* address;
   struct eb_handler_callback* callback;
+  struct eb_handler_index* index;
   eb_address_t new_first, new_last;
   eb_address_t dev_first, dev_last;
   eb_address_t scan_last;
-  int num_devices;
   
   /* Get memory */
   addressp = eb_new_handler_address();
@@ -57,42 +172,61 @@ eb_status_t eb_socket_attach(eb_socket_t socketp, const struct eb_handler* handl
     return EB_OOM;
   }
   
+  blockp = EB_NULL;
+  if (block != 0 && (block->read_block != 0 || block->write_block != 0)) {
+    blockp = eb_new_handler_block();
+    if (blockp == EB_NULL) {
+      eb_free_handler_callback(callbackp);
+      eb_free_handler_address(addressp);
+      return EB_OOM;
+    }
+  }
+  
+  /* The first handler creates the index */
+  indexp = EB_SOCKET(socketp)->handlers;
+  if (indexp == EB_NULL) {
+    indexp = eb_new_handler_index();
+    if (indexp == EB_NULL) {
+      eb_handler_discard(addressp, callbackp, blockp);
+      return EB_OOM;
+    }
+    
+    index = EB_HANDLER_INDEX(indexp);
+    index->span = 0;
+    index->first = EB_NULL;
+    index->count = 0;
+    index->hit = 0;
+    EB_SOCKET(socketp)->handlers = indexp;
+  }
+  
   new_first = handler->device->sdb_component.addr_first;
   new_last  = handler->device->sdb_component.addr_last;
   
   /* Is the user an idiot? */
   if (new_first > new_last) {
-    eb_free_handler_callback(callbackp);
-    eb_free_handler_address(addressp);
+    eb_handler_discard(addressp, callbackp, blockp);
     return EB_ADDRESS;
   }
   
   /* Is the address range supported by our bus size? */
   if (new_first != handler->device->sdb_component.addr_first || new_last != handler->device->sdb_component.addr_last) {
-    eb_free_handler_callback(callbackp);
-    eb_free_handler_address(addressp);
+    eb_handler_discard(addressp, callbackp, blockp);
     return EB_ADDRESS;
   }
   
   socket = EB_SOCKET(socketp);
   aux = EB_SOCKET_AUX(socket->aux);
+  index = EB_HANDLER_INDEX(indexp);
   
   /* See if there are already too many devices */
-  num_devices = 0;
-  for (i = socket->first_handler; i != EB_NULL; i = address->next) {
-    address = EB_HANDLER_ADDRESS(i);
-    ++num_devices;
-  }
-  
-  if (num_devices >= SDB_REQUIRED_SIZE/sizeof(struct sdb_empty)) {
-    eb_free_handler_callback(callbackp);
-    eb_free_handler_address(addressp);
+  if (index->count >= SDB_REQUIRED_SIZE/sizeof(struct sdb_empty)) {
+    eb_handler_discard(addressp, callbackp, blockp);
     return EB_OOM;  
   }
   
   /* See if it overlaps other devices */
-  prev_ptr = &socket->first_handler;
-  for (i = socket->first_handler; i != EB_NULL; i = address->next) {
+  prev_ptr = &index->first;
+  for (i = index->first; i != EB_NULL; i = address->next) {
     address = EB_HANDLER_ADDRESS(i);
     
     dev_first = address->device->sdb_component.addr_first;
@@ -100,8 +234,7 @@ eb_status_t eb_socket_attach(eb_socket_t socketp, const struct eb_handler* handl
     
     /* Do the address ranges overlap? */
     if (new_first <= dev_last && dev_first <= new_last) {
-      eb_free_handler_callback(callbackp);
-      eb_free_handler_address(addressp);
+      eb_handler_discard(addressp, callbackp, blockp);
       return EB_ADDRESS;
     }
     
@@ -119,17 +252,23 @@ eb_status_t eb_socket_attach(eb_socket_t socketp, const struct eb_handler* handl
   
   address->device = handler->device;
   address->callback = callbackp;
+  address->block = blockp;
   
   callback->data = handler->data;
   callback->read = handler->read;
   callback->write = handler->write;
   
+  if (blockp != EB_NULL) {
+    EB_HANDLER_BLOCK(blockp)->read_block = block->read_block;
+    EB_HANDLER_BLOCK(blockp)->write_block = block->write_block;
+  }
+  
   *prev_ptr = addressp;
   address->next = i;
   
   /* Find a good place for the SDB record */
   scan_last = 0;
-  for (i = socket->first_handler; i != EB_NULL; i = address->next) {
+  for (i = index->first; i != EB_NULL; i = address->next) {
     address = EB_HANDLER_ADDRESS(i);
     
     if ((eb_address_t)address->device->sdb_component.addr_first - scan_last >= SDB_REQUIRED_SIZE) {
@@ -142,12 +281,11 @@ eb_status_t eb_socket_attach(eb_socket_t socketp, const struct eb_handler* handl
   }
   
   if (i == EB_NULL) {
-    if (socket->first_handler != EB_NULL &&
+    if (index->first != EB_NULL &&
         scan_last > (eb_address_t)(-1) - SDB_REQUIRED_SIZE) {
       /* No space => abort! */
-      *prev_ptr = address->next;
-      eb_free_handler_callback(callbackp);
-      eb_free_handler_address(addressp);
+      *prev_ptr = EB_HANDLER_ADDRESS(addressp)->next;
+      eb_handler_discard(addressp, callbackp, blockp);
       return EB_ADDRESS;
     } else {
       /* No gaps big enough, but after them all, there is */
@@ -155,18 +293,26 @@ eb_status_t eb_socket_attach(eb_socket_t socketp, const struct eb_handler* handl
     }
   }
   
+  ++index->count;
+  eb_handler_reindex(index);
+  
   return EB_OK;
 }
 
 eb_status_t eb_socket_detach(eb_socket_t socketp, const struct sdb_device* device) {
   eb_handler_address_t i, *ptr;
-  struct eb_socket* socket;
+  eb_handler_index_t indexp;
   struct eb_handler_address* address;
+  struct eb_handler_index* index;
   
-  socket = EB_SOCKET(socketp);
+  indexp = EB_SOCKET(socketp)->handlers;
+  if (indexp == EB_NULL)
+    return EB_ADDRESS;
+  
+  index = EB_HANDLER_INDEX(indexp);
   
   /* Find the device */
-  for (ptr = &socket->first_handler; (i = *ptr) != EB_NULL; ptr = &address->next) {
+  for (ptr = &index->first; (i = *ptr) != EB_NULL; ptr = &address->next) {
     address = EB_HANDLER_ADDRESS(i);
     if (address->device == device)
       break;
@@ -178,7 +324,11 @@ eb_status_t eb_socket_detach(eb_socket_t socketp, const struct sdb_device* devic
   
   /* Remove it */
   *ptr = address->next;
+  if (address->block != EB_NULL) eb_free_handler_block(address->block);
   eb_free_handler_callback(address->callback);
   eb_free_handler_address(i);
+  
+  --index->count;
+  eb_handler_reindex(index);
   return EB_OK;
 }
@@ -40,11 +40,42 @@ struct eb_handler_callback {
   eb_status_t (*write)(eb_user_data_t, eb_address_t, eb_width_t, eb_data_t);
 };
 
+/* Kept apart so handlers without block access cost no more memory */
+typedef EB_POINTER(eb_handler_block) eb_handler_block_t;
+struct eb_handler_block {
+  int (*read_block) (eb_user_data_t, eb_address_t, eb_width_t,       eb_data_t*, int);
+  int (*write_block)(eb_user_data_t, eb_address_t, eb_width_t, const eb_data_t*, int);
+};
+
 typedef EB_POINTER(eb_handler_address) eb_handler_address_t;
 struct eb_handler_address {
   const struct sdb_device* device;
   eb_handler_callback_t callback;
+  eb_handler_block_t block; /* EB_NULL => word at a time */
   eb_handler_address_t next;
 };
 
+/* Copy of one device's range, kept sorted for binary search */
+struct eb_handler_span {
+  eb_address_t first;
+  eb_address_t last;
+  eb_handler_address_t handler;
+};
+
+/* The index is a malloc'd array, so an EB_USE_STATIC build never has one:
+ * span stays 0 and every lookup walks the list, O(n) in attached devices.
+ */
+typedef EB_POINTER(eb_handler_index) eb_handler_index_t;
+struct eb_handler_index {
+  struct eb_handler_span* span; /* 0 => scan the list instead */
+  eb_handler_address_t first;   /* in ascending order, non-overlapping */
+  uint16_t count;
+  uint16_t hit;                 /* span of the last lookup */
+};
+
+/* Find the handler of an address, or EB_NULL */
+EB_PRIVATE eb_handler_address_t eb_handler_find(eb_handler_index_t indexp, eb_address_t address);
+/* Release the index and every handler in it */
+EB_PRIVATE void eb_handler_index_free(eb_handler_index_t indexp);
+
 #endif
@@ -74,7 +74,7 @@ eb_operation_t eb_find_bus(eb_operation_t opp) {
   
   for (; opp != EB_NULL; opp = op->next) {
     op = EB_OPERATION(opp);
-    if ((op->flags & EB_OP_CFG_SPACE) == 0) break;
+    if ((op->flags & (EB_OP_CFG_SPACE|EB_OP_MERGED)) == 0) break;
   }
   return opp;
 }
@@ -84,7 +84,41 @@ eb_operation_t eb_find_read(eb_operation_t opp) {
   
   for (; opp != EB_NULL; opp = op->next) {
     op = EB_OPERATION(opp);
-    if ((op->flags & EB_OP_MASK) != EB_OP_WRITE) break;
+    if ((op->flags & EB_OP_MASK) != EB_OP_WRITE && (op->flags & EB_OP_MERGED) == 0) break;
   }
   return opp;
 }
+
+eb_operation_t eb_find_sent(eb_operation_t opp) {
+  struct eb_operation* op;
+  
+  for (; opp != EB_NULL; opp = op->next) {
+    op = EB_OPERATION(opp);
+    if ((op->flags & EB_OP_MERGED) == 0) break;
+  }
+  return opp;
+}
+
+void eb_operation_unmerge(eb_operation_t opp) {
+  struct eb_operation* op;
+  eb_data_t value;
+  eb_operation_flags_t error;
+  
+  value = 0;
+  error = 0;
+  for (; opp != EB_NULL; opp = op->next) {
+    op = EB_OPERATION(opp);
+    if ((op->flags & EB_OP_MASK) == EB_OP_WRITE) continue;
+    
+    if ((op->flags & EB_OP_MERGED) == 0) {
+      value = eb_operation_data(opp);
+      error = op->flags & EB_OP_ERROR;
+    } else {
+      if ((op->flags & EB_OP_MASK) == EB_OP_READ_PTR)
+        *op->un_value.read_destination = value;
+      else
+        op->un_value.read_value = value;
+      op->flags |= error;
+    }
+  }
+}
@@ -40,6 +40,7 @@ typedef uint8_t eb_operation_flags_t;
 #define EB_OP_CFG_SPACE	0x04
 #define EB_OP_ERROR	0x08
 #define EB_OP_CHECKED	0x10
+#define EB_OP_MERGED	0x20 /* a read answered by the read before it; never sent */
 
 struct eb_operation {
   eb_address_t address;
@@ -56,5 +57,9 @@ struct eb_operation {
 
 EB_PRIVATE eb_operation_t eb_find_bus(eb_operation_t op);
 EB_PRIVATE eb_operation_t eb_find_read(eb_operation_t op);
+EB_PRIVATE eb_operation_t eb_find_sent(eb_operation_t op);
+
+/* Give EB_OP_MERGED reads the value and error status of the read they repeat */
+EB_PRIVATE void eb_operation_unmerge(eb_operation_t first);
 
 #endif
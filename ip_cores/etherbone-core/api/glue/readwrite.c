@@ -38,30 +38,18 @@
 int eb_socket_write_config(eb_socket_t socketp, eb_width_t widths, eb_address_t addr, eb_data_t value) {
   /* Write to config space => write-back */
   int fail;
-  eb_response_t *responsepp;
   eb_response_t responsep;
   eb_operation_t operationp;
   eb_cycle_t cyclep;
   eb_status_t status;
-  struct eb_socket* socket;
   struct eb_response* response;
   struct eb_operation* operation;
   struct eb_cycle* cycle;
   
-  /* Walk the response queue */
-  socket = EB_SOCKET(socketp);
-  responsepp = &socket->first_response;
-  while (1) {
-    if ((responsep = *responsepp) == EB_NULL) {
-      *responsepp = responsep = eb_response_flip(socket->last_response);
-      socket->last_response = EB_NULL;
-      if (responsep == EB_NULL) return 0; /* No matching response record */
-    }
-    response = EB_RESPONSE(responsep);
-    
-    if (response->address == (addr & 0xFFFE)) break;
-    responsepp = &response->next;
-  }
+  /* Find the request by its read-back address */
+  responsep = eb_response_find(socketp, addr & 0xFFFE);
+  if (responsep == EB_NULL) return 0; /* No matching response record */
+  response = EB_RESPONSE(responsep);
   
   /* Now, process the write */
   if ((addr & 1) == 0) {
@@ -92,16 +80,17 @@ int eb_socket_write_config(eb_socket_t socketp, eb_width_t widths, eb_address_t
     ops = 0;
     for (operationp = response->status_cursor; operationp != EB_NULL; operationp = operation->next) {
       operation = EB_OPERATION(operationp);
-      if ((operation->flags & EB_OP_CFG_SPACE) != 0) continue; /* skip config ops */
+      if ((operation->flags & (EB_OP_CFG_SPACE|EB_OP_MERGED)) != 0) continue; /* skip config and unsent ops */
       if (++ops == maxops) break;
     }
     
-    fail = (ops == 0); /* No reason to get error status if no ops! */
+    /* No reason to get error status if no ops! Unless it was asked for only to pace */
+    fail = (ops == 0 && response->status_cursor != EB_NULL);
     
     i = ops-1;
     for (operationp = response->status_cursor; i >= 0; operationp = operation->next) {
       operation = EB_OPERATION(operationp);
-      if ((operation->flags & EB_OP_CFG_SPACE) != 0) continue;
+      if ((operation->flags & (EB_OP_CFG_SPACE|EB_OP_MERGED)) != 0) continue;
       operation->flags |= EB_OP_ERROR * ((value >> i) & 1);
       --i;
     }
@@ -115,7 +104,8 @@ int eb_socket_write_config(eb_socket_t socketp, eb_width_t widths, eb_address_t
     cyclep = response->cycle;
     cycle = EB_CYCLE(cyclep);
 
-    *responsepp = response->next;
+    eb_response_done(responsep, 0);
+    eb_operation_unmerge(cycle->un_ops.first);
     
     /* Detect segfault */
     status = EB_OK;
@@ -139,23 +129,19 @@ void eb_socket_write(eb_socket_t socketp, eb_width_t widths, eb_address_t addr_b
   /* Write to local WB bus */
   eb_handler_address_t addressp;
   struct eb_handler_address* address;
+  struct eb_handler_callback* callback;
   struct eb_socket* socket;
-  eb_address_t dev_first, dev_last;
   int fail;
   
   socket = EB_SOCKET(socketp);
-  for (addressp = socket->first_handler; addressp != EB_NULL; addressp = address->next) {
-    address = EB_HANDLER_ADDRESS(addressp);
-    dev_first = address->device->sdb_component.addr_first;
-    dev_last  = address->device->sdb_component.addr_last;
-    if (dev_first <= addr_b && addr_b <= dev_last) break;
-  }
+  addressp = eb_handler_find(socket->handlers, addr_b);
   
   if (addressp == EB_NULL) {
     /* Segfault => shift in an error */
     fail = 1;
   } else {
-    struct eb_handler_callback* callback = EB_HANDLER_CALLBACK(address->callback);
+    address = EB_HANDLER_ADDRESS(addressp);
+    callback = EB_HANDLER_CALLBACK(address->callback);
     if (callback->write) {
       /* Run the virtual device */
       if ((address->device->bus_specific & SDB_WISHBONE_LITTLE_ENDIAN) != 0)
@@ -211,9 +197,9 @@ eb_data_t eb_socket_read(eb_socket_t socketp, eb_width_t widths, eb_address_t ad
   eb_data_t out;
   eb_handler_address_t addressp;
   struct eb_handler_address* address;
+  struct eb_handler_callback* callback;
   struct eb_socket* socket;
   struct eb_socket_aux* aux;
-  eb_address_t dev_first, dev_last;
   eb_address_t sdb;
   int fail;
   
@@ -227,19 +213,15 @@ eb_data_t eb_socket_read(eb_socket_t socketp, eb_width_t widths, eb_address_t ad
     return eb_sdb(socketp, widths, addr_b-sdb); /* always bigendian */
   }
   
-  for (addressp = socket->first_handler; addressp != EB_NULL; addressp = address->next) {
-    address = EB_HANDLER_ADDRESS(addressp);
-    dev_first = address->device->sdb_component.addr_first;
-    dev_last  = address->device->sdb_component.addr_last;
-    if (dev_first <= addr_b && addr_b <= dev_last) break;
-  }
+  addressp = eb_handler_find(socket->handlers, addr_b);
   
   if (addressp == EB_NULL) {
     /* Segfault => shift in an error */
     out = 0;
     fail = 1;
   } else {
-    struct eb_handler_callback* callback = EB_HANDLER_CALLBACK(address->callback);
+    address = EB_HANDLER_ADDRESS(addressp);
+    callback = EB_HANDLER_CALLBACK(address->callback);
     if (callback->read) {
       /* Run the virtual device */
       if ((address->device->bus_specific & SDB_WISHBONE_LITTLE_ENDIAN) != 0)
@@ -257,3 +239,99 @@ eb_data_t eb_socket_read(eb_socket_t socketp, eb_width_t widths, eb_address_t ad
   *error = (*error << 1) | fail;
   return out;
 }
+
+/* The device of a run of consecutive words, if it takes them as a block.
+ * Shortens *count to the words before the end of the device.
+ */
+static struct eb_handler_address* eb_socket_block_device(eb_socket_t socketp, eb_width_t widths, eb_address_t addr, eb_address_t stride, int* count) {
+  eb_handler_address_t addressp;
+  struct eb_handler_address* address;
+  eb_address_t room;
+  
+  /* Narrow operations or a fifo are not consecutive words */
+  if (*count < 2 || (widths & EB_DATAX) != stride) return 0;
+  
+  /* Devices never overlap the SDB records, so those stay word at a time */
+  addressp = eb_handler_find(EB_SOCKET(socketp)->handlers, addr);
+  if (addressp == EB_NULL) return 0;
+  
+  address = EB_HANDLER_ADDRESS(addressp);
+  if (address->block == EB_NULL) return 0;
+  
+  room = (address->device->sdb_component.addr_last - addr) / stride;
+  if (room < (eb_address_t)*count) *count = room + 1;
+  
+  return address;
+}
+
+/* Shift in the status of a block which did 'done' of 'run' words */
+static int eb_socket_block_error(int done, int run, uint64_t* error) {
+  if (done < 0) done = 0;
+  if (done > run) done = run;
+  
+  *error = (done >= 64) ? 0 : (*error << done);
+  if (done == run) return run;
+  
+  /* The failed word is skipped; the rest are offered again */
+  *error = (*error << 1) | 1;
+  return done+1;
+}
+
+void eb_socket_write_block(eb_socket_t socketp, eb_width_t widths, eb_address_t addr_b, eb_address_t addr_l, eb_address_t stride, const eb_data_t* values, int count, uint64_t* error) {
+  struct eb_handler_address* address;
+  struct eb_handler_callback* callback;
+  struct eb_handler_block* block;
+  eb_address_t addr;
+  int run, done;
+  
+  while (count > 0) {
+    run = count;
+    address = eb_socket_block_device(socketp, widths, addr_b, stride, &run);
+    block = address ? EB_HANDLER_BLOCK(address->block) : 0;
+    
+    if (block == 0 || block->write_block == 0) {
+      eb_socket_write(socketp, widths, addr_b, addr_l, *values, error);
+      run = 1;
+    } else {
+      callback = EB_HANDLER_CALLBACK(address->callback);
+      addr = (address->device->bus_specific & SDB_WISHBONE_LITTLE_ENDIAN) != 0 ? addr_l : addr_b;
+      done = (*block->write_block)(callback->data, addr, widths, values, run);
+      run = eb_socket_block_error(done, run, error);
+    }
+    
+    values += run;
+    count -= run;
+    addr_b += run*stride;
+    addr_l += run*stride;
+  }
+}
+
+void eb_socket_read_block(eb_socket_t socketp, eb_width_t widths, eb_address_t addr_b, eb_address_t addr_l, eb_address_t stride, eb_data_t* values, int count, uint64_t* error) {
+  struct eb_handler_address* address;
+  struct eb_handler_callback* callback;
+  struct eb_handler_block* block;
+  eb_address_t addr;
+  int run, done;
+  
+  while (count > 0) {
+    run = count;
+    address = eb_socket_block_device(socketp, widths, addr_b, stride, &run);
+    block = address ? EB_HANDLER_BLOCK(address->block) : 0;
+    
+    if (block == 0 || block->read_block == 0) {
+      *values = eb_socket_read(socketp, widths, addr_b, addr_l, error);
+      run = 1;
+    } else {
+      callback = EB_HANDLER_CALLBACK(address->callback);
+      addr = (address->device->bus_specific & SDB_WISHBONE_LITTLE_ENDIAN) != 0 ? addr_l : addr_b;
+      done = (*block->read_block)(callback->data, addr, widths, values, run);
+      run = eb_socket_block_error(done, run, error);
+      if (done < run) values[run-1] = 0; /* the failed word */
+    }
+    
+    values += run;
+    count -= run;
+    addr_b += run*stride;
+    addr_l += run*stride;
+  }
+}
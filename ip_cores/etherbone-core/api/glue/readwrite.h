@@ -36,4 +36,8 @@ EB_PRIVATE void      eb_socket_write       (eb_socket_t socket, eb_width_t width
 EB_PRIVATE eb_data_t eb_socket_read_config (eb_socket_t socket, eb_width_t width, eb_address_t addr,                  uint64_t  error);
 EB_PRIVATE int       eb_socket_write_config(eb_socket_t socket, eb_width_t width, eb_address_t addr, eb_data_t value);
 
+/* As above, for count words 'stride' apart; consecutive words go to a block handler */
+EB_PRIVATE void eb_socket_read_block (eb_socket_t socket, eb_width_t width, eb_address_t addr_b, eb_address_t addr_l, eb_address_t stride,       eb_data_t* values, int count, uint64_t* error);
+EB_PRIVATE void eb_socket_write_block(eb_socket_t socket, eb_width_t width, eb_address_t addr_b, eb_address_t addr_l, eb_address_t stride, const eb_data_t* values, int count, uint64_t* error);
+
 #endif
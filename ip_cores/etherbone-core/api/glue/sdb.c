@@ -35,6 +35,13 @@
 #include "../memory/memory.h"
 
 #include <string.h>
+#include <stdlib.h>
+
+#ifndef EB_DISABLE_SDB_CACHE
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
 
 #define SDB_MAGIC 0x5344422D
 
@@ -80,54 +87,69 @@ static eb_data_t eb_sdb_interconnect(eb_width_t width, eb_address_t addr, int de
 }
 
 static eb_data_t eb_sdb_device(const struct sdb_device* device, eb_width_t width, eb_address_t addr) {
-  struct sdb_device dev;
+  const union sdb_record* record;
+  union sdb_record rec;
   
-  dev.abi_class     = htobe16(device->abi_class);
-  dev.abi_ver_major = device->abi_ver_major;
-  dev.abi_ver_minor = device->abi_ver_minor;
-  dev.bus_specific  = htobe32(device->bus_specific);
+  /* A handler may describe a nested bus: its device is then a bridge */
+  record = (const union sdb_record*)device;
+  if (device->sdb_component.product.record_type == sdb_record_bridge) {
+    rec.bridge.sdb_child = htobe64(record->bridge.sdb_child);
+  } else {
+    rec.device.abi_class     = htobe16(device->abi_class);
+    rec.device.abi_ver_major = device->abi_ver_major;
+    rec.device.abi_ver_minor = device->abi_ver_minor;
+    rec.device.bus_specific  = htobe32(device->bus_specific);
+  }
   
-  dev.sdb_component.addr_first = htobe64(device->sdb_component.addr_first);
-  dev.sdb_component.addr_last  = htobe64(device->sdb_component.addr_last);
+  rec.device.sdb_component.addr_first = htobe64(device->sdb_component.addr_first);
+  rec.device.sdb_component.addr_last  = htobe64(device->sdb_component.addr_last);
   
-  dev.sdb_component.product.vendor_id   = htobe64(device->sdb_component.product.vendor_id);
-  dev.sdb_component.product.device_id   = htobe32(device->sdb_component.product.device_id);
-  dev.sdb_component.product.version     = htobe32(device->sdb_component.product.version);
-  dev.sdb_component.product.date        = htobe32(device->sdb_component.product.date);
-  dev.sdb_component.product.record_type = sdb_record_device;
+  rec.device.sdb_component.product.vendor_id   = htobe64(device->sdb_component.product.vendor_id);
+  rec.device.sdb_component.product.device_id   = htobe32(device->sdb_component.product.device_id);
+  rec.device.sdb_component.product.version     = htobe32(device->sdb_component.product.version);
+  rec.device.sdb_component.product.date        = htobe32(device->sdb_component.product.date);
+  rec.device.sdb_component.product.record_type =
+    (device->sdb_component.product.record_type == sdb_record_bridge) ? sdb_record_bridge : sdb_record_device;
   
-  memcpy(&dev.sdb_component.product.name[0], &device->sdb_component.product.name[0], sizeof(dev.sdb_component.product.name));
+  memcpy(&rec.device.sdb_component.product.name[0], &device->sdb_component.product.name[0], sizeof(rec.device.sdb_component.product.name));
   
-  return eb_sdb_extract(&dev, width, addr);
+  return eb_sdb_extract(&rec, width, addr);
 }
 
 eb_data_t eb_sdb(eb_socket_t socketp, eb_width_t width, eb_address_t addr) {
   struct eb_socket* socket;
+  struct eb_handler_index* index;
   struct eb_handler_address* address;
   eb_handler_address_t addressp;
   int dev;
   
   socket = EB_SOCKET(socketp);
   
-  if (addr < 0x40) {
-    /* Count the devices */
-    dev = 0;
-    for (addressp = socket->first_handler; addressp != EB_NULL; addressp = address->next) {
-      address = EB_HANDLER_ADDRESS(addressp);
-      ++dev;
-    }
-    return eb_sdb_interconnect(width, addr, dev);
+  if (socket->handlers == EB_NULL) {
+    /* Nothing attached yet: an empty interconnect */
+    return (addr < 0x40) ? eb_sdb_interconnect(width, addr, 0) : 0;
   }
   
+  index = EB_HANDLER_INDEX(socket->handlers);
+  
+  if (addr < 0x40)
+    return eb_sdb_interconnect(width, addr, index->count);
+  
   dev = addr >> 6;
   addr &= 0x3f;
   
-  for (addressp = socket->first_handler; addressp != EB_NULL; addressp = address->next) {
-    address = EB_HANDLER_ADDRESS(addressp);
-    if (--dev == 0) break;
+  if (dev > index->count) return 0;
+  
+  if (index->span) {
+    addressp = index->span[dev-1].handler;
+  } else {
+    for (addressp = index->first; addressp != EB_NULL; addressp = address->next) {
+      address = EB_HANDLER_ADDRESS(addressp);
+      if (--dev == 0) break;
+    }
   }
   
-  if (addressp == EB_NULL) return 0;
+  address = EB_HANDLER_ADDRESS(addressp);
   return eb_sdb_device(address->device, width, addr);
 }
 
@@ -256,7 +278,69 @@ EB_SDB_DECODE(64)
 EB_SDB_DECODE(128)
 EB_SDB_DECODE(256)
 
+static void eb_sdb_got_record(eb_user_data_t mydata, eb_device_t device, eb_operation_t ops, eb_status_t status);
+
+/* Request records [first, last) of a table; one cycle per record */
+static void eb_sdb_read_records(eb_device_t device, eb_sdb_record_t recordp, uint16_t first, uint16_t last) {
+  struct eb_sdb_record* record;
+  eb_address_t base, address, end;
+  eb_cycle_t cycle;
+  eb_status_t status;
+  int stride;
+  uint16_t i;
+  
+  stride = (eb_device_width(device) & EB_DATAX);
+  
+  /* Count them all first; a failed open completes a record immediately */
+  record = EB_SDB_RECORD(recordp);
+  record->pending += last - first;
+  record->issued = last;
+  base = record->base;
+  
+  for (i = first; i < last; ++i) {
+    if ((status = eb_cycle_open(device, (eb_user_data_t)(uintptr_t)recordp, &eb_sdb_got_record, &cycle)) != EB_OK) {
+      eb_sdb_got_record((eb_user_data_t)(uintptr_t)recordp, device, EB_NULL, status);
+      continue;
+    }
+    
+    address = base + (eb_address_t)i*64;
+    for (end = address + 64; address < end; address += stride)
+      eb_cycle_read(cycle, address, EB_DATAX, 0);
+    
+    eb_cycle_close(cycle);
+  }
+}
+
+/* Start reading the table at address.
+ * Only the header is read first: whatever follows a short table may be a
+ * device with read side effects (a FIFO), so nothing is read until the
+ * header says it belongs to the table. The records then go out together.
+ */
+static eb_status_t eb_sdb_read_table(eb_device_t device, eb_sdb_scan_t scanp, eb_address_t address) {
+  struct eb_sdb_record* record;
+  eb_sdb_record_t recordp;
+  
+  if ((recordp = eb_new_sdb_record()) == EB_NULL)
+    return EB_OOM;
+  
+  record = EB_SDB_RECORD(recordp);
+  record->scan = scanp;
+  record->ops = EB_NULL;
+  record->status = EB_OK;
+  record->pending = 0;
+  record->records = 0;
+  record->issued = 0;
+  record->base = address;
+  
+  eb_sdb_read_records(device, recordp, 0, 1);
+  return EB_OK;
+}
+
 static void eb_sdb_got_record(eb_user_data_t mydata, eb_device_t device, eb_operation_t ops, eb_status_t status) {
+  union {
+    struct sdb_interconnect interconnect;
+    uint8_t bytes[1];
+  } header;
   struct eb_sdb_record* record;
   struct eb_sdb_scan* scan;
   struct eb_operation* op;
@@ -272,154 +356,100 @@ static void eb_sdb_got_record(eb_user_data_t mydata, eb_device_t device, eb_oper
   
   recordp = (eb_sdb_record_t)(uintptr_t)mydata;
   record = EB_SDB_RECORD(recordp);
-
+  
   if (status != EB_OK) {
     record->status = status;
   } else if (ops == EB_NULL) {
     record->status = EB_FAIL;
-  } else if ((op2p = eb_new_operation()) == EB_NULL) {
-    record = EB_SDB_RECORD(recordp);
-    record->status = EB_OOM;
   } else {
-    record = EB_SDB_RECORD(recordp);
-    op = EB_OPERATION(ops);
-    op2 = EB_OPERATION(op2p);
-    
-    /* Clone the operation */
-    *op2 = *op;
-    /* Steal its children */
-    op->next = EB_NULL;
-    
-    /* Find the last operation */
-    opip = op2p;
-    opi = EB_OPERATION(opip);
-    while (opi->next != EB_NULL) {
-      opip = opi->next;
-      opi = EB_OPERATION(opip);
+    /* The header says how long the table is */
+    if (eb_operation_address(ops) == record->base) {
+      if (eb_sdb_fill_block(&header.bytes[0], sizeof(header), ops) != 0 ||
+          be32toh(header.interconnect.sdb_magic) != SDB_MAGIC) {
+        record->status = EB_FAIL;
+      } else {
+        record->records = be16toh(header.interconnect.sdb_records);
+      }
     }
     
-    /* Glue with previous list */
-    opi->next = record->ops;
-    record->ops = op2p;
-  }
-  
-  if (--record->pending == 0) {
-    scanp = record->scan;
-    scan = EB_SDB_SCAN(scanp);
-    cb = scan->cb;
-    data = scan->user_data;
-    
-    if (record->status != EB_OK) {
-      (*cb)(data, device, 0, record->status);
+    if ((op2p = eb_new_operation()) == EB_NULL) {
+      record = EB_SDB_RECORD(recordp);
+      record->status = EB_OOM;
     } else {
-      devices = record->records - 1;
+      record = EB_SDB_RECORD(recordp);
+      op = EB_OPERATION(ops);
+      op2 = EB_OPERATION(op2p);
       
-      if      (devices <   4) eb_sdb_decode4(scan, device, record->ops);
-      else if (devices <   8) eb_sdb_decode8(scan, device, record->ops);
-      else if (devices <  16) eb_sdb_decode16(scan, device, record->ops);
-      else if (devices <  32) eb_sdb_decode32(scan, device, record->ops);
-      else if (devices <  64) eb_sdb_decode64(scan, device, record->ops);
-      else if (devices < 128) eb_sdb_decode128(scan, device, record->ops);
-      else if (devices < 256) eb_sdb_decode256(scan, device, record->ops);
-      else (*cb)(data, device, 0, EB_OOM);
-    }
-    
-    /* Free everything */
-    record = EB_SDB_RECORD(recordp);
-    for (opip = record->ops; opip != EB_NULL; opip = op2p) {
-      op2p = EB_OPERATION(opip)->next;
-      eb_free_operation(opip);
+      /* Clone the operation */
+      *op2 = *op;
+      /* Steal its children */
+      op->next = EB_NULL;
+      
+      /* Find the last operation */
+      opip = op2p;
+      opi = EB_OPERATION(opip);
+      while (opi->next != EB_NULL) {
+        opip = opi->next;
+        opi = EB_OPERATION(opip);
+      }
+      
+      /* Glue with previous list */
+      opi->next = record->ops;
+      record->ops = op2p;
     }
-    
-    eb_free_sdb_record(recordp);
-    eb_free_sdb_scan(scanp);
   }
-}
-
-static void eb_sdb_got_header(eb_user_data_t mydata, eb_device_t device, eb_operation_t ops, eb_status_t status) {
-  union {
-    struct sdb_interconnect interconnect;
-    uint8_t bytes[1];
-  } header;
-  struct eb_sdb_scan* scan;
-  struct eb_sdb_record* record;
-  eb_sdb_scan_t scanp;
-  eb_sdb_record_t recordp;
-  eb_user_data_t data;
-  sdb_callback_t cb;
-  eb_address_t address, end;
-  eb_cycle_t cycle;
-  int stride;
-  uint16_t i, records;
   
-  scanp = (eb_sdb_scan_t)(uintptr_t)mydata;
-  scan = EB_SDB_SCAN(scanp);
-  cb = scan->cb;
-  data = scan->user_data;
+  if (--record->pending != 0) return;
   
-  stride = (eb_device_width(device) & EB_DATAX);
+  if (record->status == EB_OK && record->records == 0)
+    record->status = EB_FAIL;
   
-  if (status != EB_OK) {
-    eb_free_sdb_scan(scanp);
-    (*cb)(data, device, 0, status);
-    return;
-  }
+  /* Never read a table too long to decode */
+  if (record->status == EB_OK && record->records > 256)
+    record->status = EB_OOM;
   
-  /* Read in the header */
-  if (eb_sdb_fill_block(&header.bytes[0], sizeof(header), ops) != 0) {
-    eb_free_sdb_scan(scanp);
-    (*cb)(data, device, 0, EB_FAIL);
+  /* Only the header so far? Fetch the records it announced */
+  if (record->status == EB_OK && record->records > record->issued) {
+    eb_sdb_read_records(device, recordp, record->issued, record->records);
     return;
   }
   
-  /* Is the magic there? */
-  if (be32toh(header.interconnect.sdb_magic) != SDB_MAGIC) {
-    eb_free_sdb_scan(scanp);
-    (*cb)(data, device, 0, EB_FAIL);
-    return;
-  }
+  scanp = record->scan;
   
-  /* Allocate a new record */
-  if ((recordp = eb_new_sdb_record()) == EB_NULL) {
-    eb_free_sdb_scan(scanp);
-    (*cb)(data, device, 0, EB_OOM);
-    return;
-  }
+  scan = EB_SDB_SCAN(scanp);
+  cb = scan->cb;
+  data = scan->user_data;
   
-  /* Invalidate by the allocate above: scan = EB_SDB_SCAN(scanp); */
-  records = be16toh(header.interconnect.sdb_records);
+  if (record->status != EB_OK) {
+    (*cb)(data, device, 0, record->status);
+  } else {
+    devices = record->records - 1;
+    
+    if      (devices <   4) eb_sdb_decode4(scan, device, record->ops);
+    else if (devices <   8) eb_sdb_decode8(scan, device, record->ops);
+    else if (devices <  16) eb_sdb_decode16(scan, device, record->ops);
+    else if (devices <  32) eb_sdb_decode32(scan, device, record->ops);
+    else if (devices <  64) eb_sdb_decode64(scan, device, record->ops);
+    else if (devices < 128) eb_sdb_decode128(scan, device, record->ops);
+    else if (devices < 256) eb_sdb_decode256(scan, device, record->ops);
+    else (*cb)(data, device, 0, EB_OOM);
+  }
   
+  /* Free everything */
   record = EB_SDB_RECORD(recordp);
-  record->scan = scanp;
-  record->ops = EB_NULL;
-  record->status = EB_OK;
-  record->pending = records;
-  record->records = records;
-  
-  /* Now, we need to read: entire table */
-  address = eb_operation_address(ops);
-  for (i = 0; i < records; ++i) {
-    if ((status = eb_cycle_open(device, (eb_user_data_t)(uintptr_t)recordp, &eb_sdb_got_record, &cycle)) != EB_OK) {
-      eb_sdb_got_record((eb_user_data_t)(uintptr_t)recordp, device, EB_NULL, status);
-      continue;
-    }
-    
-    /* Read record */
-    for (end = address + 64; address < end; address += stride)
-      eb_cycle_read(cycle, address, EB_DATAX, 0);
-    
-    eb_cycle_close(cycle);
+  for (opip = record->ops; opip != EB_NULL; opip = op2p) {
+    op2p = EB_OPERATION(opip)->next;
+    eb_free_operation(opip);
   }
+  
+  eb_free_sdb_record(recordp);
+  eb_free_sdb_scan(scanp);
 }
 
 eb_status_t eb_sdb_scan_bus(eb_device_t device, const struct sdb_bridge* bridge, eb_user_data_t data, sdb_callback_t cb) {
   struct eb_sdb_scan* scan;
-  eb_cycle_t cycle;
   eb_sdb_scan_t scanp;
-  int stride;
   eb_status_t status;
-  eb_address_t header_address;
-  eb_address_t header_end;
   
   if (bridge->sdb_component.product.record_type != sdb_record_bridge)
     return EB_ADDRESS;
@@ -432,20 +462,11 @@ eb_status_t eb_sdb_scan_bus(eb_device_t device, const struct sdb_bridge* bridge,
   scan->user_data = data;
   scan->bus_base = bridge->sdb_component.addr_first;
   
-  stride = (eb_device_width(device) & EB_DATAX);
-  
-  /* scan invalidated by all the EB calls below (which allocate) */
-  if ((status = eb_cycle_open(device, (eb_user_data_t)(uintptr_t)scanp, &eb_sdb_got_header, &cycle)) != EB_OK) {
+  if ((status = eb_sdb_read_table(device, scanp, bridge->sdb_child)) != EB_OK) {
     eb_free_sdb_scan(scanp);
     return status;
   }
   
-  header_address = bridge->sdb_child;
-  for (header_end = header_address + 32; header_address < header_end; header_address += stride)
-    eb_cycle_read(cycle, header_address, EB_DATAX, 0);
-  
-  eb_cycle_close(cycle);
-  
   return EB_OK;
 }
 
@@ -454,9 +475,7 @@ static void eb_sdb_got_header_ptr(eb_user_data_t mydata, eb_device_t device, eb_
   eb_sdb_scan_t scanp;
   eb_user_data_t data;
   eb_address_t header_address;
-  eb_address_t header_end;
   sdb_callback_t cb;
-  eb_cycle_t cycle;
   int stride;
   
   scanp = (eb_sdb_scan_t)(uintptr_t)mydata;
@@ -484,17 +503,12 @@ static void eb_sdb_got_header_ptr(eb_user_data_t mydata, eb_device_t device, eb_
     header_address += eb_operation_data(ops);
   }
   
-  /* Now, we need to read the header */
-  if ((status = eb_cycle_open(device, (eb_user_data_t)(uintptr_t)scanp, &eb_sdb_got_header, &cycle)) != EB_OK) {
+  /* Now, we need to read the table */
+  if ((status = eb_sdb_read_table(device, scanp, header_address)) != EB_OK) {
     eb_free_sdb_scan(scanp);
     (*cb)(data, device, 0, status);
     return;
   }
-  
-  for (header_end = header_address + 32; header_address < header_end; header_address += stride)
-    eb_cycle_read(cycle, header_address, EB_DATAX, 0);
-  
-  eb_cycle_close(cycle);
 }
 
 eb_status_t eb_sdb_scan_root(eb_device_t device, eb_user_data_t data, sdb_callback_t cb) {
@@ -595,8 +609,24 @@ struct eb_find_by_identity {
   int fill;
   int pending;
   eb_status_t status;
+  
+  /* Every device and bridge seen, for the cache; seen_size < 0 when not wanted */
+  union sdb_record* seen;
+  int seen_size;
+  int seen_fill;
 };
 
+static void eb_sdb_match_identity(struct eb_find_by_identity* record, const union sdb_record* des) {
+  if ((des->empty.record_type == sdb_record_device || 
+      des->empty.record_type == sdb_record_bridge) && 
+      des->device.sdb_component.product.vendor_id == record->vendor_id &&
+      des->device.sdb_component.product.device_id == record->device_id) {
+    if (record->fill < record->size) 
+      memcpy(record->output+record->fill, des, sizeof(struct sdb_device));
+    ++record->fill;
+  }
+}
+
 static void eb_cb_find_by_identity(eb_user_data_t data, eb_device_t dev, const struct sdb_table* sdb, eb_status_t status) {
   int i, devices;
   const union sdb_record* des;
@@ -623,19 +653,339 @@ static void eb_cb_find_by_identity(eb_user_data_t data, eb_device_t dev, const s
       }
     }
     
-    if ((des->empty.record_type == sdb_record_device || 
-        des->empty.record_type == sdb_record_bridge) && 
-        des->device.sdb_component.product.vendor_id == record->vendor_id &&
-        des->device.sdb_component.product.device_id == record->device_id) {
-      if (record->fill < record->size) 
-        memcpy(record->output+record->fill, des, sizeof(struct sdb_device));
-      ++record->fill;
+    eb_sdb_match_identity(record, des);
+    
+    if (record->seen_size >= 0 &&
+        (des->empty.record_type == sdb_record_device || 
+         des->empty.record_type == sdb_record_bridge)) {
+      if (record->seen_fill == record->seen_size) {
+        union sdb_record* seen;
+        
+        record->seen_size = record->seen_size*2 + 16;
+        seen = (union sdb_record*)realloc(record->seen, record->seen_size * sizeof(union sdb_record));
+        if (seen == 0) {
+          /* Give up on caching */
+          free(record->seen);
+          record->seen = 0;
+          record->seen_size = -1;
+          continue;
+        }
+        record->seen = seen;
+      }
+      record->seen[record->seen_fill++] = *des;
+    }
+  }
+}
+
+#ifndef EB_DISABLE_SDB_CACHE
+
+/* A cache file is found by the root table (location, header, and date).
+ * Identical gateware shares a cache file; different gateware will not collide.
+ * Below a bridge the gateware can change on its own, so the file also holds
+ * the header of every nested table. They are read back, all in one round
+ * trip, before the file is trusted.
+ */
+struct eb_sdb_cache_key {
+  uint64_t root;
+  uint8_t header[64]; /* raw sdb_interconnect of the root table */
+};
+
+struct eb_sdb_cache_read {
+  struct eb_sdb_cache_key* key;
+  eb_status_t status;
+  int done;
+};
+
+#define EB_SDB_CACHE_MAGIC 0x4542534442433032ULL /* "EBSDBC02" in host endian */
+#define EB_SDB_CACHE_RECORDS 0x100000 /* far more than a crawl finds; files claiming more are bad */
+
+/* The header of one bridge's child table */
+struct eb_sdb_cache_child {
+  struct eb_sdb_cache_children* all;
+  uint8_t* header; /* 64 bytes */
+};
+
+struct eb_sdb_cache_children {
+  eb_status_t status;
+  int pending;
+};
+
+static void eb_sdb_cache_got_root(eb_user_data_t data, eb_device_t dev, eb_operation_t ops, eb_status_t status) {
+  struct eb_sdb_cache_read* read;
+  int stride;
+  
+  read = (struct eb_sdb_cache_read*)data;
+  read->done = 1;
+  read->status = status;
+  if (status != EB_OK) return;
+  
+  stride = (eb_device_width(dev) & EB_DATAX);
+  read->key->root = 0;
+  for (; ops != EB_NULL; ops = eb_operation_next(ops)) {
+    read->key->root <<= (stride*8);
+    read->key->root += eb_operation_data(ops);
+  }
+}
+
+static void eb_sdb_cache_got_header(eb_user_data_t data, eb_device_t dev, eb_operation_t ops, eb_status_t status) {
+  struct eb_sdb_cache_read* read;
+  
+  read = (struct eb_sdb_cache_read*)data;
+  read->done = 1;
+  read->status = status;
+  if (status != EB_OK) return;
+  
+  if (eb_sdb_fill_block(&read->key->header[0], sizeof(read->key->header), ops) != 0)
+    read->status = EB_FAIL;
+}
+
+/* Blocking: two round trips instead of a crawl */
+static eb_status_t eb_sdb_cache_key(eb_device_t device, struct eb_sdb_cache_key* key) {
+  struct eb_sdb_cache_read read;
+  eb_address_t address, end;
+  eb_cycle_t cycle;
+  eb_status_t status;
+  int stride;
+  
+  stride = (eb_device_width(device) & EB_DATAX);
+  memset(key, 0, sizeof(*key));
+  read.key = key;
+  
+  read.done = 0;
+  if ((status = eb_cycle_open(device, &read, &eb_sdb_cache_got_root, &cycle)) != EB_OK)
+    return status;
+  for (address = 8; address < 16; address += stride)
+    eb_cycle_read_config(cycle, address, EB_DATAX, 0);
+  eb_cycle_close(cycle);
+  
+  while (!read.done)
+    eb_socket_run(eb_device_socket(device), -1);
+  if (read.status != EB_OK) return read.status;
+  
+  read.done = 0;
+  if ((status = eb_cycle_open(device, &read, &eb_sdb_cache_got_header, &cycle)) != EB_OK)
+    return status;
+  for (address = key->root, end = address + 64; address < end; address += stride)
+    eb_cycle_read(cycle, address, EB_DATAX, 0);
+  eb_cycle_close(cycle);
+  
+  while (!read.done)
+    eb_socket_run(eb_device_socket(device), -1);
+  return read.status;
+}
+
+static void eb_sdb_cache_got_child(eb_user_data_t data, eb_device_t dev, eb_operation_t ops, eb_status_t status) {
+  struct eb_sdb_cache_child* child;
+  
+  child = (struct eb_sdb_cache_child*)data;
+  --child->all->pending;
+  
+  if (status == EB_OK && eb_sdb_fill_block(child->header, 64, ops) != 0)
+    status = EB_FAIL;
+  if (status != EB_OK)
+    child->all->status = status;
+}
+
+/* Blocking: read the header of every bridge's child table into headers (64 bytes each).
+ * The bridges are already known, so this is one round trip however deep they nest.
+ */
+static eb_status_t eb_sdb_cache_children(eb_device_t device, const union sdb_record* records, int count, uint8_t* headers) {
+  struct eb_sdb_cache_children all;
+  struct eb_sdb_cache_child* child;
+  eb_address_t address, end;
+  eb_cycle_t cycle;
+  eb_status_t status;
+  int i, bridges, stride;
+  
+  bridges = 0;
+  for (i = 0; i < count; ++i)
+    if (records[i].empty.record_type == sdb_record_bridge) ++bridges;
+  if (bridges == 0) return EB_OK;
+  
+  if ((child = (struct eb_sdb_cache_child*)malloc(sizeof(struct eb_sdb_cache_child) * bridges)) == 0)
+    return EB_OOM;
+  
+  stride = (eb_device_width(device) & EB_DATAX);
+  all.status = EB_OK;
+  all.pending = 0;
+  
+  bridges = 0;
+  for (i = 0; i < count; ++i) {
+    if (records[i].empty.record_type != sdb_record_bridge) continue;
+    
+    child[bridges].all = &all;
+    child[bridges].header = headers + bridges*64;
+    
+    if ((status = eb_cycle_open(device, &child[bridges], &eb_sdb_cache_got_child, &cycle)) != EB_OK) {
+      all.status = status;
+      break;
     }
+    
+    for (address = records[i].bridge.sdb_child, end = address + 64; address < end; address += stride)
+      eb_cycle_read(cycle, address, EB_DATAX, 0);
+    eb_cycle_close(cycle);
+    
+    ++all.pending;
+    ++bridges;
+  }
+  
+  while (all.pending > 0)
+    eb_socket_run(eb_device_socket(device), -1);
+  
+  free(child);
+  return all.status;
+}
+
+/* Room for the child header of every bridge among records */
+static uint8_t* eb_sdb_cache_headers(const union sdb_record* records, int count, uint32_t* bridges) {
+  int i;
+  
+  *bridges = 0;
+  for (i = 0; i < count; ++i)
+    if (records[i].empty.record_type == sdb_record_bridge) ++*bridges;
+  
+  return (uint8_t*)malloc(64 * ((size_t)*bridges + 1));
+}
+
+static char* eb_sdb_cache_path(const char* dir, const struct eb_sdb_cache_key* key) {
+  const uint8_t* bytes;
+  uint64_t hash;
+  unsigned i;
+  char* path;
+  size_t len;
+  
+  /* FNV-1a */
+  bytes = (const uint8_t*)key;
+  hash = 0xcbf29ce484222325ULL;
+  for (i = 0; i < sizeof(*key); ++i) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+  
+  len = strlen(dir) + 32;
+  if ((path = (char*)malloc(len)) == 0) return 0;
+  snprintf(path, len, "%s/sdb-%08lx%08lx", dir, (unsigned long)(hash >> 32), (unsigned long)(hash & 0xFFFFFFFFUL));
+  return path;
+}
+
+/* The length of a cache file holding n records, of which bridges are bridges */
+static size_t eb_sdb_cache_size(uint32_t n, uint32_t bridges) {
+  return sizeof(uint64_t) + sizeof(struct eb_sdb_cache_key) +
+         sizeof(uint32_t) + (size_t)n * sizeof(union sdb_record) +
+         sizeof(uint32_t) + (size_t)bridges * 64;
+}
+
+/* The records of a cache file, if its nested tables still match the bus.
+ * The directory may be writable by others, so counts are checked against
+ * the length of the file before anything is allocated for them.
+ */
+static union sdb_record* eb_sdb_cache_load(eb_device_t device, const char* path, const struct eb_sdb_cache_key* key, int* count) {
+  struct eb_sdb_cache_key file_key;
+  union sdb_record* records;
+  uint8_t* saved;
+  uint8_t* fresh;
+  uint64_t magic;
+  uint32_t n, bridges, file_bridges;
+  struct stat st;
+  FILE* f;
+  int ok;
+  
+  if ((f = fopen(path, "rb")) == 0) return 0;
+  
+  records = 0;
+  saved = 0;
+  fresh = 0;
+  ok = fstat(fileno(f), &st) == 0 &&
+       fread(&magic, sizeof(magic), 1, f) == 1 && magic == EB_SDB_CACHE_MAGIC &&
+       fread(&file_key, sizeof(file_key), 1, f) == 1 && memcmp(&file_key, key, sizeof(file_key)) == 0 &&
+       fread(&n, sizeof(n), 1, f) == 1 && n <= EB_SDB_CACHE_RECORDS &&
+       eb_sdb_cache_size(n, 0) <= (size_t)st.st_size &&
+       (records = (union sdb_record*)malloc(sizeof(union sdb_record) * ((size_t)n+1))) != 0 &&
+       fread(records, sizeof(union sdb_record), n, f) == n &&
+       (saved = eb_sdb_cache_headers(records, n, &bridges)) != 0 &&
+       eb_sdb_cache_size(n, bridges) == (size_t)st.st_size &&
+       fread(&file_bridges, sizeof(file_bridges), 1, f) == 1 && file_bridges == bridges &&
+       fread(saved, 64, bridges, f) == bridges;
+  fclose(f);
+  
+  /* A gateware change below a bridge shows in the header of its table */
+  ok = ok &&
+       (fresh = (uint8_t*)malloc(64 * ((size_t)bridges + 1))) != 0 &&
+       eb_sdb_cache_children(device, records, n, fresh) == EB_OK &&
+       memcmp(saved, fresh, 64 * bridges) == 0;
+  
+  free(saved);
+  free(fresh);
+  
+  if (!ok) {
+    free(records);
+    return 0;
   }
+  
+  *count = n;
+  return records;
 }
 
+static void eb_sdb_cache_save(eb_device_t device, const char* path, const struct eb_sdb_cache_key* key, const union sdb_record* records, int count) {
+  uint8_t* headers;
+  uint64_t magic;
+  uint32_t n, bridges;
+  char* tmp;
+  size_t len;
+  FILE* f;
+  int ok;
+  
+  if (count > EB_SDB_CACHE_RECORDS) return;
+  
+  /* The crawl decoded the nested headers; the cache compares them raw */
+  if ((headers = eb_sdb_cache_headers(records, count, &bridges)) == 0) return;
+  if (eb_sdb_cache_children(device, records, count, headers) != EB_OK) {
+    free(headers);
+    return;
+  }
+  
+  /* Write beside and rename, so concurrent tools never see half a file */
+  len = strlen(path) + 16;
+  if ((tmp = (char*)malloc(len)) == 0) {
+    free(headers);
+    return;
+  }
+  snprintf(tmp, len, "%s.%lu", path, (unsigned long)getpid());
+  
+  if ((f = fopen(tmp, "wb")) == 0) {
+    free(headers);
+    free(tmp);
+    return;
+  }
+  
+  magic = EB_SDB_CACHE_MAGIC;
+  n = count;
+  ok = fwrite(&magic, sizeof(magic), 1, f) == 1 &&
+       fwrite(key, sizeof(*key), 1, f) == 1 &&
+       fwrite(&n, sizeof(n), 1, f) == 1 &&
+       fwrite(records, sizeof(union sdb_record), n, f) == n &&
+       fwrite(&bridges, sizeof(bridges), 1, f) == 1 &&
+       fwrite(headers, 64, bridges, f) == bridges;
+  ok = (fclose(f) == 0) && ok;
+  
+  if (!ok || rename(tmp, path) != 0)
+    remove(tmp);
+  
+  free(headers);
+  free(tmp);
+}
+
+#endif
+
 eb_status_t eb_sdb_find_by_identity(eb_device_t device, uint64_t vendor_id, uint32_t device_id, struct sdb_device* output, int* devices) {
   struct eb_find_by_identity record;
+#ifndef EB_DISABLE_SDB_CACHE
+  struct eb_sdb_cache_key key;
+  union sdb_record* cached;
+  const char* dir;
+  char* path;
+  int i, count;
+#endif
   
   record.vendor_id = vendor_id;
   record.device_id = device_id;
@@ -643,11 +993,45 @@ eb_status_t eb_sdb_find_by_identity(eb_device_t device, uint64_t vendor_id, uint
   record.fill = 0;
   record.pending = 1;
   record.output = output;
+  record.seen = 0;
+  record.seen_size = -1;
+  record.seen_fill = 0;
+  
+#ifndef EB_DISABLE_SDB_CACHE
+  path = 0;
+  dir = getenv("EB_SDB_CACHE");
+  if (dir != 0 && *dir != 0 && eb_sdb_cache_key(device, &key) == EB_OK) {
+    path = eb_sdb_cache_path(dir, &key);
+    
+    if (path != 0 && (cached = eb_sdb_cache_load(device, path, &key, &count)) != 0) {
+      /* Answer without touching the bus */
+      for (i = 0; i < count; ++i)
+        eb_sdb_match_identity(&record, &cached[i]);
+      
+      free(cached);
+      free(path);
+      *devices = record.fill;
+      return EB_OK;
+    }
+    
+    /* Miss or stale: crawl as usual, remembering everything */
+    record.seen_size = 0;
+  }
+#endif
   
   if ((record.status = eb_sdb_scan_root(device, &record, eb_cb_find_by_identity)) == EB_OK)
     while (record.pending > 0) 
       eb_socket_run(eb_device_socket(device), -1);
   
+#ifndef EB_DISABLE_SDB_CACHE
+  if (path != 0) {
+    if (record.status == EB_OK && record.seen_size >= 0)
+      eb_sdb_cache_save(device, path, &key, record.seen, record.seen_fill);
+    free(path);
+  }
+#endif
+  free(record.seen);
+  
   *devices = record.fill;
   return record.status;
 }
@@ -661,6 +1045,9 @@ eb_status_t eb_sdb_find_by_identity_at(eb_device_t device, const struct sdb_brid
   record.fill = 0;
   record.pending = 1;
   record.output = output;
+  record.seen = 0;
+  record.seen_size = -1;
+  record.seen_fill = 0;
 
   if ((record.status = eb_sdb_scan_bus(device, bridge, &record, eb_cb_find_by_identity)) == EB_OK)
     while (record.pending > 0) 
@@ -43,7 +43,9 @@ struct eb_sdb_record {
   eb_operation_t ops;
   int32_t status;
   uint16_t pending;
-  uint16_t records;
+  uint16_t records; /* 0 until the header arrives */
+  uint16_t issued;  /* records requested so far */
+  eb_address_t base; /* address of the table */
 };
 
 EB_PRIVATE eb_data_t eb_sdb(eb_socket_t socket, eb_width_t width, eb_address_t addr);
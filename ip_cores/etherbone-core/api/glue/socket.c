@@ -29,6 +29,8 @@
 
 #define ETHERBONE_IMPL
 
+#include <stdlib.h>
+
 #include "socket.h"
 #include "device.h"
 #include "cycle.h"
@@ -49,7 +51,9 @@ eb_status_t eb_socket_open(uint16_t abi_code, const char* port, eb_width_t suppo
   struct eb_socket* socket;
   struct eb_socket_aux* aux;
   eb_status_t status;
+  const char* capture;
   uint8_t link_type;
+  int i;
 #ifdef  __WIN32
   WORD wVersionRequested;
   WSADATA wsaData;
@@ -131,19 +135,41 @@ eb_status_t eb_socket_open(uint16_t abi_code, const char* port, eb_width_t suppo
   
   socket = EB_SOCKET(socketp);
   socket->first_device = EB_NULL;
-  socket->first_handler = EB_NULL;
-  socket->first_response = EB_NULL;
-  socket->last_response = EB_NULL;
+  socket->handlers = EB_NULL;
   socket->widths = supported_widths;
   socket->aux = auxp;
+  socket->queue = 0;
   
   aux = EB_SOCKET_AUX(auxp);
   aux->time_cache = 0;
   aux->rba = 0x8000;
   aux->first_transport = first_transport;
   aux->sdb_offset = 0;
+  aux->state = (struct eb_socket_state*)malloc(sizeof(struct eb_socket_state));
   
-  if (link_type != eb_transport_size) {
+  if (aux->state == 0) {
+    status = EB_OOM;
+  } else {
+    aux->state->run = 0;
+    aux->state->capture = 0;
+    eb_timer_init(&aux->state->timers, eb_socket_run_clock());
+    aux->state->responses = (eb_response_t*)malloc(sizeof(eb_response_t)*EB_RESPONSE_SLOTS);
+    aux->state->responses_count = 0;
+    aux->state->responses_full = 0;
+    aux->state->woken = 0;
+    aux->state->woken_count = 0;
+    aux->state->woken_size = 0;
+    aux->state->woken_lost = 0;
+    
+    if (aux->state->responses == 0) {
+      status = EB_OOM;
+    } else {
+      for (i = 0; i < EB_RESPONSE_SLOTS; ++i)
+        aux->state->responses[i] = EB_NULL;
+    }
+  }
+  
+  if (link_type != eb_transport_size || aux->state == 0 || aux->state->responses == 0) {
     eb_socket_close(socketp);
     return status;
   }
@@ -151,34 +177,265 @@ eb_status_t eb_socket_open(uint16_t abi_code, const char* port, eb_width_t suppo
   /* Update time_cache */
   eb_socket_run(socketp, 0);
   
+  /* A capture which cannot start must not stop the program */
+  if ((capture = getenv("EB_CAPTURE")) != 0 && *capture != 0)
+    eb_socket_capture(socketp, capture);
+  
   *result = socketp;
   return status;
 }
 
-eb_response_t eb_response_flip(eb_response_t firstp) {
+int eb_response_rba(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_socket_aux* aux;
+  struct eb_socket_state* state;
+  
+  socket = EB_SOCKET(socketp);
+  aux = EB_SOCKET_AUX(socket->aux);
+  state = aux->state;
+  
+  if (state->responses_count == EB_RESPONSE_SLOTS) {
+    state->responses_full = 1;
+    return 0;
+  }
+  
+  /* Slots held by a slow device are skipped once per lap */
+  while (state->responses[EB_RESPONSE_SLOT(aux->rba)] != EB_NULL)
+    aux->rba = 0x8000 | (aux->rba + 2);
+  
+  return 1;
+}
+
+void eb_response_add(eb_device_t devicep, eb_response_t responsep) {
+  struct eb_device* device;
+  struct eb_device_aux* device_aux;
+  struct eb_socket* socket;
+  struct eb_socket_aux* aux;
+  struct eb_socket_state* state;
   struct eb_response* response;
-  eb_response_t responsep, prev_responsep, next_responsep;
+  eb_response_slot_t slot;
   
-  prev_responsep = EB_NULL;
-  for (responsep = firstp; responsep != EB_NULL; responsep = next_responsep) {
-    response = EB_RESPONSE(responsep);
-    next_responsep = response->next;
-    response->next = prev_responsep;
-    prev_responsep = responsep;
+  device = EB_DEVICE(devicep);
+  device_aux = EB_DEVICE_AUX(device->aux);
+  socket = EB_SOCKET(device->socket);
+  aux = EB_SOCKET_AUX(socket->aux);
+  state = aux->state;
+  response = EB_RESPONSE(responsep);
+  
+  slot = EB_RESPONSE_SLOT(aux->rba);
+  response->address = aux->rba;
+  aux->rba = 0x8000 | (aux->rba + 2);
+  
+  state->responses[slot] = responsep;
+  ++state->responses_count;
+  
+  /* Append to the device's responses */
+  response->prev = device_aux->last_response;
+  response->next = EB_RESPONSE_NONE;
+  if (device_aux->last_response == EB_RESPONSE_NONE)
+    device_aux->first_response = slot;
+  else
+    EB_RESPONSE(state->responses[device_aux->last_response])->next = slot;
+  device_aux->last_response = slot;
+  
+  eb_timer_add(&state->timers, responsep);
+}
+
+eb_response_t eb_response_find(eb_socket_t socketp, uint16_t address) {
+  struct eb_socket* socket;
+  eb_response_t responsep;
+  
+  socket = EB_SOCKET(socketp);
+  responsep = EB_SOCKET_AUX(socket->aux)->state->responses[EB_RESPONSE_SLOT(address)];
+  
+  if (responsep == EB_NULL || EB_RESPONSE(responsep)->address != address)
+    return EB_NULL;
+  
+  return responsep;
+}
+
+eb_response_t eb_response_first(eb_device_t devicep) {
+  struct eb_device* device;
+  struct eb_device_aux* device_aux;
+  struct eb_socket* socket;
+  
+  device = EB_DEVICE(devicep);
+  device_aux = EB_DEVICE_AUX(device->aux);
+  if (device_aux->first_response == EB_RESPONSE_NONE) return EB_NULL;
+  
+  socket = EB_SOCKET(device->socket);
+  return EB_SOCKET_AUX(socket->aux)->state->responses[device_aux->first_response];
+}
+
+/* Release the rba of a response and take it off its device's list and the timer wheel */
+static void eb_response_unlink(eb_response_t responsep) {
+  struct eb_response* response;
+  struct eb_device* device;
+  struct eb_device_aux* device_aux;
+  struct eb_socket* socket;
+  struct eb_socket_state* state;
+  
+  response = EB_RESPONSE(responsep);
+  device = EB_DEVICE(EB_CYCLE(response->cycle)->un_link.device);
+  device_aux = EB_DEVICE_AUX(device->aux);
+  socket = EB_SOCKET(device->socket);
+  state = EB_SOCKET_AUX(socket->aux)->state;
+  
+  if (response->prev == EB_RESPONSE_NONE)
+    device_aux->first_response = response->next;
+  else
+    EB_RESPONSE(state->responses[response->prev])->next = response->next;
+  
+  if (response->next == EB_RESPONSE_NONE)
+    device_aux->last_response = response->prev;
+  else
+    EB_RESPONSE(state->responses[response->next])->prev = response->prev;
+  
+  state->responses[EB_RESPONSE_SLOT(response->address)] = EB_NULL;
+  --state->responses_count;
+  eb_timer_del(&state->timers, responsep);
+  
+  /* Some device stopped sending for want of a slot; it is not on the wake list */
+  if (state->responses_full) {
+    state->responses_full = 0;
+    state->woken_lost = 1;
+  }
+}
+
+/* An answer arrived before those to older read-backs of the same device.
+ * Datagrams may be reordered, so they may yet be answered. Once eb_flow_reorder
+ * bytes were answered ahead of the first, the window is cut, and the timers of
+ * older read-backs fail them unless they are answered within a grace period.
+ */
+static void eb_response_overtaken(eb_response_t responsep) {
+  struct eb_response* response;
+  struct eb_cycle* cycle;
+  struct eb_device* device;
+  struct eb_device_aux* device_aux;
+  struct eb_socket* socket;
+  struct eb_socket_state* state;
+  eb_response_t scanp;
+  uint32_t reorder, deadline;
+  
+  response = EB_RESPONSE(responsep);
+  device = EB_DEVICE(EB_CYCLE(response->cycle)->un_link.device);
+  device_aux = EB_DEVICE_AUX(device->aux);
+  socket = EB_SOCKET(device->socket);
+  state = EB_SOCKET_AUX(socket->aux)->state;
+  
+  reorder = eb_flow_reorder(device->flow);
+  if (device_aux->overtaken < reorder) {
+    device_aux->overtaken += response->length < reorder ? response->length : reorder;
+    if (device_aux->overtaken < reorder) return;
+    
+    scanp = state->responses[device_aux->first_response];
+    eb_flow_overtaken(device->flow, EB_RESPONSE(scanp)->sent);
+  }
+  
+  /* Newest first; older ones were already hurried by an earlier answer */
+  deadline = eb_socket_clock(device->socket) + eb_flow_grace(device->flow);
+  while (response->prev != EB_RESPONSE_NONE) {
+    scanp = state->responses[response->prev];
+    response = EB_RESPONSE(scanp);
+    cycle = EB_CYCLE(response->cycle);
+    
+    if ((int32_t)(response->sent + cycle->timeout - deadline) <= 0) break;
+    
+    eb_timer_del(&state->timers, scanp);
+    cycle->timeout = deadline - response->sent;
+    eb_timer_add(&state->timers, scanp);
+  }
+}
+
+void eb_response_done(eb_response_t responsep, int lost) {
+  struct eb_response* response;
+  struct eb_cycle* cycle;
+  struct eb_device* device;
+  
+  response = EB_RESPONSE(responsep);
+  if (response->prev == EB_RESPONSE_NONE) {
+    /* The oldest is settled; count afresh for the next */
+    device = EB_DEVICE(EB_CYCLE(response->cycle)->un_link.device);
+    EB_DEVICE_AUX(device->aux)->overtaken = 0;
+  } else if (!lost) {
+    eb_response_overtaken(responsep);
   }
   
-  return prev_responsep;
+  eb_response_unlink(responsep);
+  
+  response = EB_RESPONSE(responsep);
+  cycle = EB_CYCLE(response->cycle);
+  device = EB_DEVICE(cycle->un_link.device);
+  
+  eb_flow_done(device->flow, response->length, response->sent, lost);
+  eb_stats_done(EB_DEVICE_AUX(device->aux)->stats, response->sent, lost);
+  
+  /* The returned credit may let held-back cycles go */
+  if (device->un_link.ready != EB_NULL)
+    eb_socket_wake(device->socket, cycle->un_link.device, EB_DEVICE_FLUSH);
+}
+
+void eb_socket_wake(eb_socket_t socketp, eb_device_t devicep, uint8_t why) {
+  struct eb_socket* socket;
+  struct eb_socket_state* state;
+  struct eb_device* device;
+  eb_device_t* woken;
+  int size;
+  
+  device = EB_DEVICE(devicep);
+  if (device->wake != 0) {
+    device->wake |= why;
+    return;
+  }
+  
+  socket = EB_SOCKET(socketp);
+  state = EB_SOCKET_AUX(socket->aux)->state;
+  
+  if (state->woken_count == state->woken_size) {
+    size = state->woken_size ? state->woken_size*2 : 32;
+    if ((woken = (eb_device_t*)realloc(state->woken, sizeof(eb_device_t)*size)) == 0) {
+      state->woken_lost = 1;
+      return;
+    }
+    state->woken = woken;
+    state->woken_size = size;
+  }
+  
+  state->woken[state->woken_count++] = devicep;
+  device->wake = why;
+}
+
+void eb_socket_unwake(eb_socket_t socketp, eb_device_t devicep) {
+  struct eb_socket* socket;
+  struct eb_socket_state* state;
+  int i;
+  
+  socket = EB_SOCKET(socketp);
+  state = EB_SOCKET_AUX(socket->aux)->state;
+  
+  for (i = 0; i < state->woken_count; ++i)
+    if (state->woken[i] == devicep)
+      state->woken[i] = EB_NULL;
+}
+
+uint32_t eb_socket_clock(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  uint32_t now;
+  
+  if ((now = eb_socket_run_clock()) != 0) return now;
+  
+  /* No microsecond clock: count whole seconds */
+  socket = EB_SOCKET(socketp);
+  return EB_SOCKET_AUX(socket->aux)->time_cache * 1000000;
 }
 
 eb_status_t eb_socket_close(eb_socket_t socketp) {
   struct eb_socket* socket;
   struct eb_socket_aux* aux;
-  struct eb_handler_address* handler;
   struct eb_transport* transport;
   struct eb_device* device;
   eb_transport_t transportp, next_transportp;
   eb_socket_aux_t auxp;
-  eb_handler_address_t i, next;
   eb_status_t status;
   
   socket = EB_SOCKET(socketp);
@@ -195,17 +452,17 @@ eb_status_t eb_socket_close(eb_socket_t socketp) {
   }
   
   /* All responses must be closed if devices are closed */
-  /* assert (socket->first_response == EB_NULL); */
+  /* assert (aux->state->responses_count == 0); */
   
   /* Flush handlers */
-  for (i = socket->first_handler; i != EB_NULL; i = next) {
-    handler = EB_HANDLER_ADDRESS(i);
-    next = handler->next;
-    
-    eb_free_handler_callback(handler->callback);
-    eb_free_handler_address(i);
-  }
+  eb_handler_index_free(socket->handlers);
+  
+  /* Release the event loop before the descriptors it watches */
+  eb_socket_queue_free(socketp);
+  eb_socket_run_free(socketp);
+  eb_socket_capture_free(socketp);
   
+  socket = EB_SOCKET(socketp);
   auxp = socket->aux;
   aux = EB_SOCKET_AUX(auxp);
   
@@ -216,6 +473,12 @@ eb_status_t eb_socket_close(eb_socket_t socketp) {
     eb_free_transport(transportp);
   }
   
+  if (aux->state != 0) {
+    free(aux->state->responses);
+    free(aux->state->woken);
+  }
+  free(aux->state);
+  
 #ifdef __WIN32
   WSACleanup();
 #endif
@@ -225,68 +488,39 @@ eb_status_t eb_socket_close(eb_socket_t socketp) {
   return EB_OK;
 }
 
-static void eb_socket_filter_inflight(eb_response_t* goodp, eb_response_t* badp, eb_device_t devicep, eb_response_t firstp) {
+void eb_socket_kill_inflight(eb_socket_t socketp, eb_device_t devicep) {
   struct eb_response* response;
   struct eb_cycle* cycle;
-  eb_response_t good, bad;
   eb_response_t responsep, next_responsep;
+  eb_response_t bad, last_bad;
   eb_cycle_t cyclep;
   
-  good = *goodp;
-  bad = *badp;
-  
-  /* Partiton the list */
-  for (responsep = firstp; responsep != EB_NULL; responsep = next_responsep) {
-    response = EB_RESPONSE(responsep);
-    next_responsep = response->next;
+  /* Take the device's responses out of the socket first; callbacks may run it.
+   * Off the wheel, timer_next is free to chain them.
+   */
+  bad = last_bad = EB_NULL;
+  while ((responsep = eb_response_first(devicep)) != EB_NULL) {
+    eb_response_unlink(responsep);
     
-    cyclep = response->cycle;
-    cycle = EB_CYCLE(cyclep);
-   
-    if (cycle->un_link.device == devicep) {
-      response->next = bad;
+    EB_RESPONSE(responsep)->timer_next = EB_NULL;
+    if (last_bad == EB_NULL)
       bad = responsep;
-    } else {
-      response->next = good;
-      good = responsep;
-    }
+    else
+      EB_RESPONSE(last_bad)->timer_next = responsep;
+    last_bad = responsep;
   }
   
-  *goodp = good;
-  *badp = bad;
-}
-
-void eb_socket_kill_inflight(eb_socket_t socketp, eb_device_t devicep) {
-  struct eb_socket* socket;
-  struct eb_response* response;
-  struct eb_cycle* cycle;
-  eb_response_t responsep, next_responsep;
-  eb_response_t good, bad;
-  eb_cycle_t cyclep;
-  
-  /* Split the list into good responses we keep, and bad responses we kill */
-  good = EB_NULL;
-  bad = EB_NULL;
-  socket = EB_SOCKET(socketp);
-  eb_socket_filter_inflight(&good, &bad, devicep, socket->last_response);
-  eb_socket_filter_inflight(&good, &bad, devicep, eb_response_flip(socket->first_response));
-  socket->first_response = good;
-  socket->last_response = EB_NULL;
-  
   /* Now kill all the bad responses */
   for (responsep = bad; responsep != EB_NULL; responsep = next_responsep) {
     response = EB_RESPONSE(responsep);
-    next_responsep = response->next;
+    next_responsep = response->timer_next;
     
     cyclep = response->cycle;
-    cycle = EB_CYCLE(response->cycle);
-    
-    /* Mark the response for clean-up */
-    response->cycle = EB_NULL;
+    cycle = EB_CYCLE(cyclep);
     
     /* Run the callback */
     (*cycle->callback)(cycle->user_data, cycle->un_link.device, cycle->un_ops.first, EB_TIMEOUT);
-      
+    
     /* Free it all */
     eb_cycle_destroy(cyclep);
     eb_free_cycle(cyclep);
@@ -319,6 +553,9 @@ void eb_socket_descriptors(eb_socket_t socketp, eb_user_data_t user, eb_descript
     eb_transports[transport->link_type].fdes(transport, 0, user, cb);
   }
   
+  /* Add the wakeup for cycles queued by other threads */
+  eb_socket_queue_fdes(socketp, user, cb);
+  
   /* Add all the sockets to the listen set */
   for (devicep = first_devicep; devicep != EB_NULL; devicep = next_devicep) {
     device = EB_DEVICE(devicep);
@@ -336,37 +573,81 @@ void eb_socket_descriptors(eb_socket_t socketp, eb_user_data_t user, eb_descript
   }
 }
 
+long eb_socket_timeout_us(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_timer_wheel* timers;
+  uint32_t elapsed;
+  long wait;
+  
+  socket = EB_SOCKET(socketp);
+  timers = &EB_SOCKET_AUX(socket->aux)->state->timers;
+  
+  if ((wait = eb_timer_next(timers)) <= 0) return wait;
+  
+  /* The wheel only knows the clock of the last check */
+  elapsed = eb_socket_clock(socketp) - timers->now;
+  if ((int32_t)elapsed < 0) return wait;
+  return (uint32_t)wait > elapsed ? wait - (long)elapsed : 0;
+}
+
 uint32_t eb_socket_timeout(eb_socket_t socketp) {
   struct eb_socket* socket;
   struct eb_socket_aux* aux;
-  struct eb_response* response;
-  uint16_t udelta;
-  int16_t sdelta;
+  long wait;
   
   socket = EB_SOCKET(socketp);
   aux = EB_SOCKET_AUX(socket->aux);
   
-  /* Find the first timeout */
-  if (socket->first_response == EB_NULL) {
-    socket->first_response = eb_response_flip(socket->last_response);
-    socket->last_response = EB_NULL;
-  }
+  /* Round up, so the deadline has passed by the time it is checked */
+  if ((wait = eb_socket_timeout_us(socketp)) < 0) return 0;
+  return aux->time_cache + (wait + 999999) / 1000000;
+}
+
+/* Visit the devices on the wake list; the list may grow meanwhile */
+static void eb_socket_check_list(eb_socket_t socketp, struct eb_socket_state* state, eb_user_data_t user, eb_descriptor_callback_t ready, int* completed) {
+  struct eb_device* device;
+  eb_device_t devicep;
+  uint8_t why;
+  int i;
   
-  /* Determine how long until deadline expires */ 
-  if (socket->first_response != EB_NULL) {
-    response = EB_RESPONSE(socket->first_response);
+  for (i = 0; i < state->woken_count; ++i) {
+    if ((devicep = state->woken[i]) == EB_NULL) continue; /* closed meanwhile */
     
-    udelta = response->deadline - ((uint16_t)aux->time_cache);
-    sdelta = udelta; /* Sign conversion */
-    return aux->time_cache + sdelta;
-  } else {
-    return 0;
+    device = EB_DEVICE(devicep);
+    why = device->wake;
+    device->wake = 0;
+    
+    if ((why & EB_DEVICE_READABLE) != 0) {
+      while (device->link != EB_NULL && 
+             eb_device_slave(socketp, device->transport, devicep, user, ready, completed) > 0) {
+        device = EB_DEVICE(devicep);
+      }
+    }
+    
+    if (device->un_link.passive != devicep)
+      eb_device_flush(devicep, completed);
   }
+  
+  state->woken_count = 0;
 }
 
-int eb_socket_check(eb_socket_t socketp, uint32_t now, eb_user_data_t user, eb_descriptor_callback_t ready) {
+/* Forget the wake list; every device is about to be visited anyway */
+static void eb_socket_check_clear(struct eb_socket_state* state) {
+  eb_device_t devicep;
+  int i;
+  
+  for (i = 0; i < state->woken_count; ++i)
+    if ((devicep = state->woken[i]) != EB_NULL)
+      EB_DEVICE(devicep)->wake = 0;
+  
+  state->woken_count = 0;
+  state->woken_lost = 0;
+}
+
+static int eb_socket_check_devices(eb_socket_t socketp, uint32_t now, eb_user_data_t user, eb_descriptor_callback_t ready, int woken) {
   struct eb_socket* socket;
   struct eb_socket_aux* aux;
+  struct eb_socket_state* state;
   struct eb_device* device;
   struct eb_transport* transport;
   struct eb_response* response;
@@ -377,6 +658,7 @@ int eb_socket_check(eb_socket_t socketp, uint32_t now, eb_user_data_t user, eb_d
   eb_response_t responsep;
   eb_cycle_t cyclep;
   eb_socket_aux_t auxp;
+  struct eb_timer_wheel* timers;
   int completed;
   
   socket = EB_SOCKET(socketp);
@@ -384,19 +666,21 @@ int eb_socket_check(eb_socket_t socketp, uint32_t now, eb_user_data_t user, eb_d
   completed = 0;
   
   /* Step 1. Kill any expired timeouts */
-  while (socket->first_response != EB_NULL &&
-         eb_socket_timeout(socketp) <= now) {
-    /* Kill first */
-    responsep = socket->first_response;
+  aux = EB_SOCKET_AUX(auxp);
+  aux->time_cache = now;
+  timers = &aux->state->timers;
+  eb_timer_advance(timers, eb_socket_clock(socketp));
+  
+  while (timers->due != EB_NULL) {
+    /* Kill the oldest */
+    responsep = timers->due;
     response = EB_RESPONSE(responsep);
     
     cyclep = response->cycle;
     cycle = EB_CYCLE(cyclep);
     
-    socket->first_response = response->next;
-    
+    eb_response_done(responsep, 1);
     (*cycle->callback)(cycle->user_data, cycle->un_link.device, cycle->un_ops.first, EB_TIMEOUT);
-    socket = EB_SOCKET(socketp); /* Restore pointer */
     
     ++completed;
     eb_cycle_destroy(cyclep);
@@ -407,12 +691,12 @@ int eb_socket_check(eb_socket_t socketp, uint32_t now, eb_user_data_t user, eb_d
   /* Get some memory for accepting connections */
   new_linkp = eb_new_link();
   
-  /* Update time */
-  aux = EB_SOCKET_AUX(auxp);
-  aux->time_cache = now;
-  
   /* Step 2. Check all devices */
   
+  /* Open cycles handed over by other threads, so they are flushed below */
+  eb_socket_queue_drain(socketp);
+  aux = EB_SOCKET_AUX(auxp);
+  
   /* Poll all the transports, potentially discovering new devices */
   for (transportp = aux->first_transport; transportp != EB_NULL; transportp = next_transportp) {
     transport = EB_TRANSPORT(transportp);
@@ -431,19 +715,26 @@ int eb_socket_check(eb_socket_t socketp, uint32_t now, eb_user_data_t user, eb_d
     }
   }
   
-  /* Poll all the connections */
-  socket = EB_SOCKET(socketp);
-  for (devicep = socket->first_device; devicep != EB_NULL; devicep = next_devicep) {
-    device = EB_DEVICE(devicep);
-    next_devicep = device->next;
+  /* Poll the connections: those with work, or all if we cannot know */
+  state = EB_SOCKET_AUX(auxp)->state;
+  if (woken && !state->woken_lost) {
+    eb_socket_check_list(socketp, state, user, ready, &completed);
+  } else {
+    eb_socket_check_clear(state);
     
-    while (device->link != EB_NULL && 
-           eb_device_slave(socketp, device->transport, devicep, user, ready, &completed) > 0) {
+    socket = EB_SOCKET(socketp);
+    for (devicep = socket->first_device; devicep != EB_NULL; devicep = next_devicep) {
       device = EB_DEVICE(devicep);
+      next_devicep = device->next;
+      
+      while (device->link != EB_NULL && 
+             eb_device_slave(socketp, device->transport, devicep, user, ready, &completed) > 0) {
+        device = EB_DEVICE(devicep);
+      }
+      
+      if (device->un_link.passive != devicep)
+        eb_device_flush(devicep, &completed);
     }
-    
-    if (device->un_link.passive != devicep)
-      eb_device_flush(devicep, &completed);
   }
   
   /* Free the temporary address */
@@ -452,3 +743,11 @@ int eb_socket_check(eb_socket_t socketp, uint32_t now, eb_user_data_t user, eb_d
   
   return completed;
 }
+
+int eb_socket_check(eb_socket_t socketp, uint32_t now, eb_user_data_t user, eb_descriptor_callback_t ready) {
+  return eb_socket_check_devices(socketp, now, user, ready, 0);
+}
+
+int eb_socket_check_woken(eb_socket_t socketp, uint32_t now, eb_user_data_t user, eb_descriptor_callback_t ready) {
+  return eb_socket_check_devices(socketp, now, user, ready, 1);
+}
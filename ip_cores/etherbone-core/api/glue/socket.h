@@ -33,10 +33,16 @@
 #include "../etherbone.h"
 #include "../transport/transport.h"
 #include "handler.h"
+#include "device.h"
+#include "timer.h"
 
 /* The size of space that sdb_offset points to */
 #define SDB_REQUIRED_SIZE 65536
 
+/* Each rba (0x8000-0xFFFE, even) has one slot in the response table */
+#define EB_RESPONSE_SLOTS 16384
+#define EB_RESPONSE_SLOT(address) (((address) & 0x7FFF) >> 1)
+
 typedef EB_POINTER(eb_response) eb_response_t;
 struct eb_response {
   /* xxxxxxxxxxxxxxxL
@@ -44,19 +50,48 @@ struct eb_response {
    * L=1 means status-back
    */
   uint16_t address;
-  uint16_t deadline; /* Low 16-bits of a UTC seconds counter */
+  uint16_t length; /* request bytes, credited back to the device's flow */
+  
+  /* Neighbours among the device's responses in flight, oldest first */
+  eb_response_slot_t prev;
+  eb_response_slot_t next;
   
-  eb_response_t next;
   eb_cycle_t cycle;
   
   eb_operation_t write_cursor;
   eb_operation_t status_cursor;
+  
+  /* Deadline list in the socket's timer wheel; due at sent+timeout of the cycle */
+  eb_response_t timer_next;
+  eb_response_t timer_prev;
+  
+  uint32_t sent; /* eb_socket_clock() when sent */
 };
 
 typedef EB_POINTER(eb_socket_aux) eb_socket_aux_t;
+struct eb_socket_run; /* private to the event loop */
+struct eb_capture; /* private to capture.c */
+struct eb_socket_state {
+  struct eb_socket_run* run;
+  struct eb_capture* capture; /* 0 unless eb_socket_capture is recording */
+  struct eb_timer_wheel timers;
+  
+  /* Responses in flight, by EB_RESPONSE_SLOT of their rba (EB_NULL if free) */
+  eb_response_t* responses;
+  int responses_count;
+  int responses_full; /* eb_device_flush ran out of slots; wake everyone when one frees */
+  
+  /* Devices with work for the next eb_socket_check (may hold EB_NULLs) */
+  eb_device_t* woken;
+  int woken_count;
+  int woken_size;
+  int woken_lost; /* out of memory: visit every device once */
+};
+
 struct eb_socket_aux {
   eb_address_t sdb_offset;
-  uint32_t time_cache;
+  struct eb_socket_state* state; /* too large for the memory pool */
+  uint32_t time_cache; /* UTC seconds of the last eb_socket_check */
   uint16_t rba;
   
   eb_transport_t first_transport;
@@ -64,18 +99,48 @@ struct eb_socket_aux {
 
 struct eb_socket {
   eb_device_t first_device;
-  eb_handler_address_t first_handler; /* in ascending order, non-overlapping */
-  
-  /* Functional-style queue using lists */
-  eb_response_t first_response;
-  eb_response_t last_response;
+  eb_handler_index_t handlers; /* created by the first eb_socket_attach */
   
   eb_socket_aux_t aux;
   uint8_t widths;
+  
+  struct eb_queue* queue; /* cycles from other threads; see queue.c */
 };
 
-/* Invert last_response, suitable for attaching to the end of first_response */
-EB_PRIVATE eb_response_t eb_response_flip(eb_response_t firstp);
+/* Move the socket's rba past slots with a response in flight.
+ * Returns 0 if every slot is in flight.
+ */
+EB_PRIVATE int eb_response_rba(eb_socket_t socketp);
+
+/* Claim the socket's rba for a response just sent by the device */
+EB_PRIVATE void eb_response_add(eb_device_t devicep, eb_response_t responsep);
+
+/* The response in flight for this read-back address, or EB_NULL */
+EB_PRIVATE eb_response_t eb_response_find(eb_socket_t socketp, uint16_t address);
+
+/* The oldest response in flight for the device, or EB_NULL */
+EB_PRIVATE eb_response_t eb_response_first(eb_device_t devicep);
+
+/* Retire a response about to be freed: release its rba, return its flow
+ * control credit and count it in the device statistics.
+ */
+EB_PRIVATE void eb_response_done(eb_response_t responsep, int lost);
+
+/* Microseconds for response deadlines: the event loop's clock, else time_cache */
+EB_PRIVATE uint32_t eb_socket_clock(eb_socket_t socketp);
+
+/* Queue a device for the next eb_socket_check_woken.
+ * 'why' is a mask of EB_DEVICE_*.
+ */
+EB_PRIVATE void eb_socket_wake(eb_socket_t socketp, eb_device_t devicep, uint8_t why);
+
+/* Drop a device that is closing from the wake list */
+EB_PRIVATE void eb_socket_unwake(eb_socket_t socketp, eb_device_t devicep);
+
+/* eb_socket_check, but visit only the woken devices.
+ * This relies on the caller waking every device whose descriptor is ready.
+ */
+EB_PRIVATE int eb_socket_check_woken(eb_socket_t socketp, uint32_t now, eb_user_data_t user, eb_descriptor_callback_t ready);
 
 /* Kill all responses inflight for this device */
 EB_PRIVATE void eb_socket_kill_inflight(eb_socket_t socketp, eb_device_t devicep);
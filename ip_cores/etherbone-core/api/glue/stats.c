@@ -0,0 +1,129 @@
+/** @file stats.c
+ *  @brief Per-device statistics and the latency histogram.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  Latencies are binned HDR-style: four linear buckets per power of two.
+ *  Recording a sample is a handful of shifts; no lock or allocation.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+#include "device.h"
+#include "../transport/transport.h"
+#include "../memory/memory.h"
+
+uint32_t eb_stats_bucket(int i) {
+  if (i >= EB_STATS_BUCKETS) return 0xFFFFFFFFUL;
+  if (i < 4) return i;
+  return (uint32_t)(4 + (i & 3)) << ((i >> 2) - 1);
+}
+
+void eb_stats_record(uint64_t* histogram, uint32_t us) {
+  uint32_t v;
+  int msb;
+  
+  if (us < 4) {
+    ++histogram[us];
+    return;
+  }
+  
+  msb = 0;
+  v = us;
+  if (v >= 0x10000) { v >>= 16; msb += 16; }
+  if (v >= 0x100)   { v >>= 8;  msb += 8;  }
+  if (v >= 0x10)    { v >>= 4;  msb += 4;  }
+  if (v >= 0x4)     { v >>= 2;  msb += 2;  }
+  if (v >= 0x2)     {           msb += 1;  }
+  
+  /* The two bits below the leading one pick the linear sub-bucket */
+  ++histogram[((msb-1) << 2) + ((us >> (msb-2)) & 3)];
+}
+
+void eb_stats_sent(struct eb_device_stats* stats, int cycles, int records, int packets, int bytes) {
+  if (stats == 0) return;
+  
+  stats->cycles += cycles;
+  stats->records += records;
+  stats->packets += packets;
+  stats->bytes += bytes;
+}
+
+void eb_stats_coalesced(struct eb_device_stats* stats, int bytes) {
+  if (stats == 0) return;
+  
+  stats->coalesced += bytes;
+}
+
+void eb_stats_done(struct eb_device_stats* stats, uint32_t sent, int lost) {
+  uint32_t now, latency;
+  
+  if (stats == 0) return;
+  
+  if (lost) {
+    ++stats->timeouts;
+    return;
+  }
+  
+  ++stats->responses;
+  if ((now = eb_socket_run_clock()) == 0) return; /* no clock */
+  
+  latency = now - sent;
+  stats->latency_us += latency;
+  eb_stats_record(&stats->latency[0], latency);
+}
+
+eb_status_t eb_device_stats_enable(eb_device_t devicep) {
+  struct eb_device* device;
+  struct eb_device_aux* aux;
+  struct eb_device_stats* counters;
+  
+  device = EB_DEVICE(devicep);
+  if (device->aux == EB_NULL) return EB_FAIL;
+  
+  aux = EB_DEVICE_AUX(device->aux);
+  if (aux->stats != 0) return EB_OK;
+  
+  if ((counters = (struct eb_device_stats*)malloc(sizeof(struct eb_device_stats))) == 0)
+    return EB_OOM;
+  
+  memset(counters, 0, sizeof(struct eb_device_stats));
+  aux->stats = counters;
+  
+  return EB_OK;
+}
+
+eb_status_t eb_device_stats(eb_device_t devicep, struct eb_device_stats* out) {
+  struct eb_device* device;
+  struct eb_device_aux* aux;
+  
+  device = EB_DEVICE(devicep);
+  if (device->aux == EB_NULL) return EB_FAIL;
+  
+  aux = EB_DEVICE_AUX(device->aux);
+  if (aux->stats == 0) return EB_FAIL;
+  
+  memcpy(out, aux->stats, sizeof(struct eb_device_stats));
+  return EB_OK;
+}
@@ -0,0 +1,44 @@
+/** @file stats.h
+ *  @brief The Etherbone per-device statistics.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  Statistics are collected only once enabled.  The counters are too large
+ *  for a memory item, so the item holds a buffer allocated by the enable.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#ifndef EB_STATS_H
+#define EB_STATS_H
+
+#include "../etherbone.h"
+
+/* Count a latency sample into a histogram of EB_STATS_BUCKETS */
+EB_PRIVATE void eb_stats_record(uint64_t* histogram, uint32_t us);
+
+/* eb_device_flush sent these cycles; no-op unless statistics are enabled */
+EB_PRIVATE void eb_stats_sent(struct eb_device_stats* stats, int cycles, int records, int packets, int bytes);
+
+/* eb_cycle_close_coalesced kept this many bytes off the wire */
+EB_PRIVATE void eb_stats_coalesced(struct eb_device_stats* stats, int bytes);
+
+/* The cycle sent at clock time 'sent' was answered or lost */
+EB_PRIVATE void eb_stats_done(struct eb_device_stats* stats, uint32_t sent, int lost);
+
+#endif
@@ -0,0 +1,250 @@
+/** @file timer.c
+ *  @brief A hierarchical timer wheel for response deadlines.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  A response is filed at the lowest level whose slots still reach its
+ *  deadline.  As the clock passes a slot, its responses are either due or
+ *  refiled at a lower level, so each response moves at most once per level.
+ *  Time is a wrapping 32-bit microsecond count; deadlines are compared by
+ *  their signed difference.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#include "timer.h"
+#include "socket.h"
+#include "cycle.h"
+#include "../memory/memory.h"
+
+static uint32_t eb_timer_deadline(eb_response_t responsep) {
+  struct eb_response* response;
+  
+  response = EB_RESPONSE(responsep);
+  return response->sent + EB_CYCLE(response->cycle)->timeout;
+}
+
+/* Index of the lowest set bit; x != 0 */
+static int eb_timer_lowest(uint64_t x) {
+  int i;
+  
+  i = 0;
+  if ((x & 0xFFFFFFFFUL) == 0) { x >>= 32; i += 32; }
+  if ((x & 0xFFFF) == 0)       { x >>= 16; i += 16; }
+  if ((x & 0xFF) == 0)         { x >>= 8;  i += 8;  }
+  if ((x & 0xF) == 0)          { x >>= 4;  i += 4;  }
+  if ((x & 0x3) == 0)          { x >>= 2;  i += 2;  }
+  if ((x & 0x1) == 0)          {           i += 1;  }
+  return i;
+}
+
+/* Slots of 'level' between the clock values a and b (modulo the wheel) */
+static uint32_t eb_timer_span(int level, uint32_t a, uint32_t b) {
+  int shift;
+  
+  shift = level * EB_TIMER_BITS;
+  return ((b >> shift) - (a >> shift)) & (0xFFFFFFFFUL >> shift);
+}
+
+static void eb_timer_file(struct eb_timer_wheel* wheel, eb_response_t responsep, uint32_t deadline) {
+  struct eb_response* response;
+  int level, index;
+  
+  /* Already due? File it where the next advance finds it */
+  if ((int32_t)(deadline - wheel->now) < 0) deadline = wheel->now;
+  
+  for (level = 0; level < EB_TIMER_LEVELS-1; ++level)
+    if (eb_timer_span(level, wheel->now, deadline) < EB_TIMER_SLOTS) break;
+  
+  /* Beyond the top level: park in its furthest slot and refile from there */
+  if (eb_timer_span(level, wheel->now, deadline) >= EB_TIMER_SLOTS)
+    deadline = wheel->now + ((uint32_t)(EB_TIMER_SLOTS-1) << (level*EB_TIMER_BITS));
+  
+  index = (deadline >> (level*EB_TIMER_BITS)) & (EB_TIMER_SLOTS-1);
+  
+  response = EB_RESPONSE(responsep);
+  response->timer_prev = EB_NULL;
+  response->timer_next = wheel->slot[level][index];
+  if (response->timer_next != EB_NULL)
+    EB_RESPONSE(response->timer_next)->timer_prev = responsep;
+  
+  wheel->slot[level][index] = responsep;
+  wheel->occupied[level] |= (uint64_t)1 << index;
+}
+
+void eb_timer_init(struct eb_timer_wheel* wheel, uint32_t now) {
+  int level, index;
+  
+  wheel->now = now;
+  wheel->due = EB_NULL;
+  wheel->due_last = EB_NULL;
+  
+  for (level = 0; level < EB_TIMER_LEVELS; ++level) {
+    wheel->occupied[level] = 0;
+    for (index = 0; index < EB_TIMER_SLOTS; ++index)
+      wheel->slot[level][index] = EB_NULL;
+  }
+}
+
+void eb_timer_add(struct eb_timer_wheel* wheel, eb_response_t responsep) {
+  eb_timer_file(wheel, responsep, eb_timer_deadline(responsep));
+}
+
+void eb_timer_del(struct eb_timer_wheel* wheel, eb_response_t responsep) {
+  struct eb_response* response;
+  eb_response_t prevp, nextp;
+  uint32_t deadline;
+  int level, index;
+  
+  response = EB_RESPONSE(responsep);
+  prevp = response->timer_prev;
+  nextp = response->timer_next;
+  
+  if (nextp != EB_NULL) {
+    EB_RESPONSE(nextp)->timer_prev = prevp;
+  } else if (wheel->due_last == responsep) {
+    wheel->due_last = prevp;
+  }
+  
+  if (prevp != EB_NULL) {
+    EB_RESPONSE(prevp)->timer_next = nextp;
+    return;
+  }
+  
+  /* First of its list: the due list, or the slot its deadline maps to */
+  if (wheel->due == responsep) {
+    wheel->due = nextp;
+    return;
+  }
+  
+  deadline = eb_timer_deadline(responsep);
+  for (level = 0; level < EB_TIMER_LEVELS; ++level) {
+    index = (deadline >> (level*EB_TIMER_BITS)) & (EB_TIMER_SLOTS-1);
+    if (wheel->slot[level][index] == responsep) break;
+  }
+  
+  /* Filed early or parked: search the whole wheel */
+  if (level == EB_TIMER_LEVELS) {
+    for (level = 0; level < EB_TIMER_LEVELS; ++level) {
+      for (index = 0; index < EB_TIMER_SLOTS; ++index)
+        if (wheel->slot[level][index] == responsep) break;
+      if (index != EB_TIMER_SLOTS) break;
+    }
+    if (level == EB_TIMER_LEVELS) return; /* not filed */
+  }
+  
+  wheel->slot[level][index] = nextp;
+  if (nextp == EB_NULL)
+    wheel->occupied[level] &= ~((uint64_t)1 << index);
+}
+
+void eb_timer_advance(struct eb_timer_wheel* wheel, uint32_t now) {
+  struct eb_response* response;
+  eb_response_t responsep, nextp;
+  uint64_t due, mask;
+  uint32_t span, old;
+  int level, index, first, empty;
+  
+  old = wheel->now;
+  
+  /* An idle wheel simply follows the clock */
+  empty = 1;
+  for (level = 0; level < EB_TIMER_LEVELS; ++level)
+    if (wheel->occupied[level] != 0) empty = 0;
+  
+  if (empty) {
+    wheel->now = now;
+    return;
+  }
+  
+  /* The clock never runs backwards */
+  if ((int32_t)(now - old) < 0) now = old;
+  
+  wheel->now = now;
+  
+  /* Top-down, so refiled responses are seen again by the lower levels */
+  for (level = EB_TIMER_LEVELS-1; level >= 0; --level) {
+    if (wheel->occupied[level] == 0) continue;
+    
+    /* Every slot from the old clock's to the new clock's, inclusive */
+    span = eb_timer_span(level, old, now);
+    if (span >= EB_TIMER_SLOTS-1) {
+      due = ~(uint64_t)0;
+    } else {
+      mask = ((uint64_t)1 << (span+1)) - 1;
+      first = (old >> (level*EB_TIMER_BITS)) & (EB_TIMER_SLOTS-1);
+      due = (mask << first) | (first ? mask >> (EB_TIMER_SLOTS-first) : 0);
+    }
+    
+    for (due &= wheel->occupied[level]; due != 0; due &= due-1) {
+      index = eb_timer_lowest(due);
+      responsep = wheel->slot[level][index];
+      wheel->slot[level][index] = EB_NULL;
+      wheel->occupied[level] &= ~((uint64_t)1 << index);
+      
+      for (; responsep != EB_NULL; responsep = nextp) {
+        response = EB_RESPONSE(responsep);
+        nextp = response->timer_next;
+        
+        if ((int32_t)(eb_timer_deadline(responsep) - now) > 0) {
+          eb_timer_file(wheel, responsep, eb_timer_deadline(responsep));
+        } else {
+          /* Append to the due list */
+          response->timer_next = EB_NULL;
+          response->timer_prev = wheel->due_last;
+          if (wheel->due_last == EB_NULL)
+            wheel->due = responsep;
+          else
+            EB_RESPONSE(wheel->due_last)->timer_next = responsep;
+          wheel->due_last = responsep;
+        }
+      }
+    }
+  }
+}
+
+long eb_timer_next(struct eb_timer_wheel* wheel) {
+  uint64_t occupied;
+  uint32_t position, slot, wait, best;
+  int level, shift, distance, found;
+  
+  if (wheel->due != EB_NULL) return 0;
+  
+  found = 0;
+  best = 0;
+  for (level = 0; level < EB_TIMER_LEVELS; ++level) {
+    if ((occupied = wheel->occupied[level]) == 0) continue;
+    
+    /* The first occupied slot at or after the clock */
+    shift = level * EB_TIMER_BITS;
+    position = (wheel->now >> shift) & (EB_TIMER_SLOTS-1);
+    occupied = (occupied >> position) | (position ? occupied << (EB_TIMER_SLOTS-position) : 0);
+    distance = eb_timer_lowest(occupied);
+    
+    /* The slot starts no earlier than any deadline it holds */
+    slot = ((wheel->now >> shift) + distance) << shift;
+    wait = (int32_t)(slot - wheel->now) > 0 ? slot - wheel->now : 0;
+    
+    if (!found || wait < best) best = wait;
+    found = 1;
+  }
+  
+  return found ? (long)best : -1;
+}
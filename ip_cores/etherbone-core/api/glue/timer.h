@@ -0,0 +1,64 @@
+/** @file timer.h
+ *  @brief The Etherbone response deadline wheel.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  Every response awaiting an answer sits in a hierarchical timer wheel,
+ *  keyed by its deadline in microseconds.  Adding, removing and finding
+ *  the next deadline cost O(1) no matter how many cycles are in flight.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#ifndef EB_TIMER_H
+#define EB_TIMER_H
+
+#include "../etherbone.h"
+
+/* Level n has slots 2^(6n) microseconds wide; the top level spans ~18 minutes */
+#define EB_TIMER_BITS   6
+#define EB_TIMER_SLOTS  (1 << EB_TIMER_BITS)
+#define EB_TIMER_LEVELS 5
+
+struct eb_timer_wheel {
+  uint32_t now; /* clock of the last advance */
+  uint64_t occupied[EB_TIMER_LEVELS]; /* one bit per non-empty slot */
+  EB_POINTER(eb_response) slot[EB_TIMER_LEVELS][EB_TIMER_SLOTS];
+  
+  /* Responses past their deadline, oldest first */
+  EB_POINTER(eb_response) due;
+  EB_POINTER(eb_response) due_last;
+};
+
+EB_PRIVATE void eb_timer_init(struct eb_timer_wheel* wheel, uint32_t now);
+
+/* Track a response which was just sent; its deadline is sent+timeout of its cycle */
+EB_PRIVATE void eb_timer_add(struct eb_timer_wheel* wheel, EB_POINTER(eb_response) responsep);
+
+/* Stop tracking a response (answered, lost or due) */
+EB_PRIVATE void eb_timer_del(struct eb_timer_wheel* wheel, EB_POINTER(eb_response) responsep);
+
+/* Move the clock forward; responses whose deadline passed are appended to due */
+EB_PRIVATE void eb_timer_advance(struct eb_timer_wheel* wheel, uint32_t now);
+
+/* Microseconds from the last advance until the wheel next needs advancing; -1 if empty.
+ * This may be earlier than the next deadline, but never later.
+ */
+EB_PRIVATE long eb_timer_next(struct eb_timer_wheel* wheel);
+
+#endif
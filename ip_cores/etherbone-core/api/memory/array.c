@@ -59,8 +59,12 @@ static void eb_free_memory_item(EB_POINTER(eb_memory_item) item) {
 eb_operation_t        eb_new_operation       (void) { return (eb_operation_t)       eb_new_memory_item(); }
 eb_cycle_t            eb_new_cycle           (void) { return (eb_cycle_t)           eb_new_memory_item(); }
 eb_device_t           eb_new_device          (void) { return (eb_device_t)          eb_new_memory_item(); }
+eb_flow_t             eb_new_flow            (void) { return (eb_flow_t)            eb_new_memory_item(); }
+eb_device_aux_t       eb_new_device_aux      (void) { return (eb_device_aux_t)      eb_new_memory_item(); }
 eb_handler_callback_t eb_new_handler_callback(void) { return (eb_handler_callback_t)eb_new_memory_item(); }
+eb_handler_block_t    eb_new_handler_block   (void) { return (eb_handler_block_t)   eb_new_memory_item(); }
 eb_handler_address_t  eb_new_handler_address (void) { return (eb_handler_address_t) eb_new_memory_item(); }
+eb_handler_index_t    eb_new_handler_index   (void) { return (eb_handler_index_t)   eb_new_memory_item(); }
 eb_response_t         eb_new_response        (void) { return (eb_response_t)        eb_new_memory_item(); }
 eb_socket_t           eb_new_socket          (void) { return (eb_socket_t)          eb_new_memory_item(); }
 eb_socket_aux_t       eb_new_socket_aux      (void) { return (eb_socket_aux_t)      eb_new_memory_item(); }
@@ -72,8 +76,12 @@ eb_sdb_record_t       eb_new_sdb_record      (void) { return (eb_sdb_record_t)
 void eb_free_operation       (eb_operation_t        x) { eb_free_memory_item(x); }
 void eb_free_cycle           (eb_cycle_t            x) { eb_free_memory_item(x); }
 void eb_free_device          (eb_device_t           x) { eb_free_memory_item(x); }
+void eb_free_flow            (eb_flow_t             x) { eb_free_memory_item(x); }
+void eb_free_device_aux      (eb_device_aux_t       x) { eb_free_memory_item(x); }
 void eb_free_handler_callback(eb_handler_callback_t x) { eb_free_memory_item(x); }
+void eb_free_handler_block   (eb_handler_block_t    x) { eb_free_memory_item(x); }
 void eb_free_handler_address (eb_handler_address_t  x) { eb_free_memory_item(x); }
+void eb_free_handler_index   (eb_handler_index_t    x) { eb_free_memory_item(x); }
 void eb_free_response        (eb_response_t         x) { eb_free_memory_item(x); }
 void eb_free_socket          (eb_socket_t           x) { eb_free_memory_item(x); }
 void eb_free_socket_aux      (eb_socket_aux_t       x) { eb_free_memory_item(x); }
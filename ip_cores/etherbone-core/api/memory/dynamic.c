@@ -30,7 +30,7 @@
 
 #define ETHERBONE_IMPL
 
-#if !defined(EB_USE_STATIC) && !defined(EB_USE_MALLOC)
+#if !defined(EB_USE_STATIC) && !defined(EB_USE_MALLOC) && !defined(EB_USE_SLAB)
 
 #include <stdlib.h>
 #include "memory.h"
@@ -62,7 +62,9 @@ int eb_expand_array(void) {
   for (i = eb_memory_array_size; i != next_size; ++i)
     eb_memory_array[i].free_item.next = i+1; 
 
-  eb_memory_array[next_size-1].free_item.next = EB_END_OF_FREE;
+  /* Index 0xFFFF is EB_NULL and must never be handed out */
+  i = (next_size == 65536) ? next_size-2 : next_size-1;
+  eb_memory_array[i].free_item.next = EB_END_OF_FREE;
   eb_memory_free = eb_memory_array_size;
   eb_memory_array_size = next_size;
   
@@ -36,8 +36,12 @@
 eb_operation_t        eb_new_operation       (void) { return (eb_operation_t)       malloc(sizeof(struct eb_operation));        }
 eb_cycle_t            eb_new_cycle           (void) { return (eb_cycle_t)           malloc(sizeof(struct eb_cycle));            }
 eb_device_t           eb_new_device          (void) { return (eb_device_t)          malloc(sizeof(struct eb_device));           }
+eb_flow_t             eb_new_flow            (void) { return (eb_flow_t)            malloc(sizeof(struct eb_flow));             }
+eb_device_aux_t       eb_new_device_aux      (void) { return (eb_device_aux_t)      malloc(sizeof(struct eb_device_aux));       }
 eb_handler_callback_t eb_new_handler_callback(void) { return (eb_handler_callback_t)malloc(sizeof(struct eb_handler_callback)); }
+eb_handler_block_t    eb_new_handler_block   (void) { return (eb_handler_block_t)   malloc(sizeof(struct eb_handler_block));    }
 eb_handler_address_t  eb_new_handler_address (void) { return (eb_handler_address_t) malloc(sizeof(struct eb_handler_address));  }
+eb_handler_index_t    eb_new_handler_index   (void) { return (eb_handler_index_t)   malloc(sizeof(struct eb_handler_index));    }
 eb_response_t         eb_new_response        (void) { return (eb_response_t)        malloc(sizeof(struct eb_response));         }
 eb_socket_t           eb_new_socket          (void) { return (eb_socket_t)          malloc(sizeof(struct eb_socket));           }
 eb_socket_aux_t       eb_new_socket_aux      (void) { return (eb_socket_aux_t)      malloc(sizeof(struct eb_socket_aux));       }
@@ -49,8 +53,12 @@ eb_sdb_record_t       eb_new_sdb_record      (void) { return (eb_sdb_record_t)
 void eb_free_operation       (eb_operation_t        x) { free(x); }
 void eb_free_cycle           (eb_cycle_t            x) { free(x); }
 void eb_free_device          (eb_device_t           x) { free(x); }
+void eb_free_flow            (eb_flow_t             x) { free(x); }
+void eb_free_device_aux      (eb_device_aux_t       x) { free(x); }
 void eb_free_handler_callback(eb_handler_callback_t x) { free(x); }
+void eb_free_handler_block   (eb_handler_block_t    x) { free(x); }
 void eb_free_handler_address (eb_handler_address_t  x) { free(x); }
+void eb_free_handler_index   (eb_handler_index_t    x) { free(x); }
 void eb_free_response        (eb_response_t         x) { free(x); }
 void eb_free_socket          (eb_socket_t           x) { free(x); }
 void eb_free_socket_aux      (eb_socket_aux_t       x) { free(x); }
@@ -4,7 +4,8 @@
  *  Copyright (C) 2011-2012 GSI Helmholtz Centre for Heavy Ion Research GmbH 
  *
  *  To keep memory management simple, all dynamic objects occupy the same space.
- *  Pointer types can be compactly represented using 16-bit array indexes.
+ *  Pointer types can be compactly represented using 16-bit array indexes
+ *  (32-bit when the array is split into chunks by slab.c).
  *  Type-safety is maintained using a gigantic union.
  *
  *  @author Wesley W. Terpstra <w.terpstra@gsi.de>
@@ -39,10 +40,14 @@ union eb_memory_item {
   struct eb_operation operation;
   struct eb_cycle cycle;
   struct eb_device device;
+  struct eb_flow flow;
+  struct eb_device_aux device_aux;
   struct eb_socket socket;
   struct eb_socket_aux socket_aux;
   struct eb_handler_callback handler_callback;
+  struct eb_handler_block handler_block;
   struct eb_handler_address handler_address;
+  struct eb_handler_index handler_index;
   struct eb_response response;
   struct eb_transport transport;
   struct eb_link link;
@@ -53,28 +58,40 @@ union eb_memory_item {
 
 #define EB_END_OF_FREE EB_NULL
 
-#ifdef EB_USE_STATIC
+#if defined(EB_USE_STATIC)
 EB_PRIVATE extern union eb_memory_item eb_memory_array[];
+#define EB_MEMORY_ITEM(x) eb_memory_array[x]
+#elif defined(EB_USE_SLAB)
+#define EB_SLAB_SHIFT 10
+#define EB_SLAB_CHUNK (1U << EB_SLAB_SHIFT)
+#define EB_SLAB_MAX   (0U - EB_SLAB_CHUNK) /* all handles < EB_NULL */
+EB_PRIVATE extern union eb_memory_item** eb_memory_chunk;
+#define EB_MEMORY_ITEM(x) eb_memory_chunk[(x) >> EB_SLAB_SHIFT][(x) & (EB_SLAB_CHUNK-1)]
 #else
 EB_PRIVATE extern union eb_memory_item* eb_memory_array;
+#define EB_MEMORY_ITEM(x) eb_memory_array[x]
 #endif
 EB_PRIVATE extern EB_POINTER(eb_memory_item) eb_memory_free;
 
 EB_PRIVATE int eb_expand_array(void);
 
-#define EB_OPERATION(x) (&eb_memory_array[x].operation)
-#define EB_CYCLE(x) (&eb_memory_array[x].cycle)
-#define EB_DEVICE(x) (&eb_memory_array[x].device)
-#define EB_SOCKET(x) (&eb_memory_array[x].socket)
-#define EB_SOCKET_AUX(x) (&eb_memory_array[x].socket_aux)
-#define EB_HANDLER_CALLBACK(x) (&eb_memory_array[x].handler_callback)
-#define EB_HANDLER_ADDRESS(x) (&eb_memory_array[x].handler_address)
-#define EB_RESPONSE(x) (&eb_memory_array[x].response)
-#define EB_FREE_ITEM(x) (&eb_memory_array[x].free_item)
-#define EB_TRANSPORT(x) (&eb_memory_array[x].transport)
-#define EB_LINK(x) (&eb_memory_array[x].link)
-#define EB_SDB_SCAN(x) (&eb_memory_array[x].sdb_scan)
-#define EB_SDB_RECORD(x) (&eb_memory_array[x].sdb_record)
+#define EB_OPERATION(x) (&EB_MEMORY_ITEM(x).operation)
+#define EB_CYCLE(x) (&EB_MEMORY_ITEM(x).cycle)
+#define EB_DEVICE(x) (&EB_MEMORY_ITEM(x).device)
+#define EB_FLOW(x) (&EB_MEMORY_ITEM(x).flow)
+#define EB_DEVICE_AUX(x) (&EB_MEMORY_ITEM(x).device_aux)
+#define EB_SOCKET(x) (&EB_MEMORY_ITEM(x).socket)
+#define EB_SOCKET_AUX(x) (&EB_MEMORY_ITEM(x).socket_aux)
+#define EB_HANDLER_CALLBACK(x) (&EB_MEMORY_ITEM(x).handler_callback)
+#define EB_HANDLER_BLOCK(x) (&EB_MEMORY_ITEM(x).handler_block)
+#define EB_HANDLER_ADDRESS(x) (&EB_MEMORY_ITEM(x).handler_address)
+#define EB_HANDLER_INDEX(x) (&EB_MEMORY_ITEM(x).handler_index)
+#define EB_RESPONSE(x) (&EB_MEMORY_ITEM(x).response)
+#define EB_FREE_ITEM(x) (&EB_MEMORY_ITEM(x).free_item)
+#define EB_TRANSPORT(x) (&EB_MEMORY_ITEM(x).transport)
+#define EB_LINK(x) (&EB_MEMORY_ITEM(x).link)
+#define EB_SDB_SCAN(x) (&EB_MEMORY_ITEM(x).sdb_scan)
+#define EB_SDB_RECORD(x) (&EB_MEMORY_ITEM(x).sdb_record)
 
 #endif
 #endif
@@ -33,10 +33,14 @@
 #define EB_OPERATION(x) (x)
 #define EB_CYCLE(x) (x)
 #define EB_DEVICE(x) (x)
+#define EB_FLOW(x) (x)
+#define EB_DEVICE_AUX(x) (x)
 #define EB_SOCKET(x) (x)
 #define EB_SOCKET_AUX(x) (x)
 #define EB_HANDLER_CALLBACK(x) (x)
+#define EB_HANDLER_BLOCK(x) (x)
 #define EB_HANDLER_ADDRESS(x) (x)
+#define EB_HANDLER_INDEX(x) (x)
 #define EB_RESPONSE(x) (x)
 #define EB_TRANSPORT(x) (x)
 #define EB_LINK(x) (x)
@@ -44,8 +44,12 @@
 EB_PRIVATE eb_operation_t eb_new_operation(void);
 EB_PRIVATE eb_cycle_t eb_new_cycle(void);
 EB_PRIVATE eb_device_t eb_new_device(void);
+EB_PRIVATE eb_flow_t eb_new_flow(void);
+EB_PRIVATE eb_device_aux_t eb_new_device_aux(void);
 EB_PRIVATE eb_handler_callback_t eb_new_handler_callback(void);
+EB_PRIVATE eb_handler_block_t eb_new_handler_block(void);
 EB_PRIVATE eb_handler_address_t eb_new_handler_address(void);
+EB_PRIVATE eb_handler_index_t eb_new_handler_index(void);
 EB_PRIVATE eb_response_t eb_new_response(void);
 EB_PRIVATE eb_socket_t eb_new_socket(void);
 EB_PRIVATE eb_socket_aux_t eb_new_socket_aux(void);
@@ -57,8 +61,12 @@ EB_PRIVATE eb_sdb_record_t eb_new_sdb_record(void);
 EB_PRIVATE void eb_free_operation(eb_operation_t x);
 EB_PRIVATE void eb_free_cycle(eb_cycle_t x);
 EB_PRIVATE void eb_free_device(eb_device_t x);
+EB_PRIVATE void eb_free_flow(eb_flow_t x);
+EB_PRIVATE void eb_free_device_aux(eb_device_aux_t x);
 EB_PRIVATE void eb_free_handler_callback(eb_handler_callback_t x);
+EB_PRIVATE void eb_free_handler_block(eb_handler_block_t x);
 EB_PRIVATE void eb_free_handler_address(eb_handler_address_t x);
+EB_PRIVATE void eb_free_handler_index(eb_handler_index_t x);
 EB_PRIVATE void eb_free_response(eb_response_t x);
 EB_PRIVATE void eb_free_socket(eb_socket_t x);
 EB_PRIVATE void eb_free_socket_aux(eb_socket_aux_t x);
@@ -0,0 +1,74 @@
+/** @file slab.c
+ *  @brief Grow the memory array in fixed-size chunks that never move.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  Like dynamic.c, all dynamic objects occupy the same space and share one
+ *  free list. However, the array is split into chunks of EB_SLAB_CHUNK items.
+ *  Expanding adds a chunk instead of copying every live object with realloc,
+ *  and 32-bit handles lift the 64k object limit of the 16-bit index.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#ifdef EB_USE_SLAB
+
+#include <stdlib.h>
+#include "memory.h"
+
+union eb_memory_item** eb_memory_chunk = 0;
+EB_PRIVATE uint32_t eb_memory_array_size = 0;
+static uint32_t eb_memory_chunks = 0; /* capacity of eb_memory_chunk */
+
+int eb_expand_array(void) {
+  union eb_memory_item** new_table;
+  union eb_memory_item* chunk;
+  uint32_t next_chunks, i;
+  
+  /* Stop short of EB_NULL = 0xFFFFFFFF */
+  if (eb_memory_array_size == EB_SLAB_MAX) return -1;
+  
+  /* Only the (small) table of chunk pointers is ever reallocated */
+  if ((eb_memory_array_size >> EB_SLAB_SHIFT) == eb_memory_chunks) {
+    next_chunks = eb_memory_chunks ? eb_memory_chunks*2 : 16;
+    new_table = (union eb_memory_item**)realloc(eb_memory_chunk, sizeof(union eb_memory_item*) * next_chunks);
+    if (new_table == 0) return -1;
+    
+    eb_memory_chunk = new_table;
+    eb_memory_chunks = next_chunks;
+  }
+  
+  chunk = (union eb_memory_item*)malloc(sizeof(union eb_memory_item) * EB_SLAB_CHUNK);
+  if (chunk == 0) return -1;
+  
+  eb_memory_chunk[eb_memory_array_size >> EB_SLAB_SHIFT] = chunk;
+  
+  /* Link together the new chunk's free list */
+  for (i = 0; i != EB_SLAB_CHUNK; ++i)
+    chunk[i].free_item.next = eb_memory_array_size + i + 1;
+  
+  chunk[EB_SLAB_CHUNK-1].free_item.next = EB_END_OF_FREE;
+  eb_memory_free = eb_memory_array_size;
+  eb_memory_array_size += EB_SLAB_CHUNK;
+  
+  return 0;
+}
+
+#endif
@@ -0,0 +1,320 @@
+/** @file attach.c
+ *  @brief Serve records through the block handlers of eb_socket_attach_block.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  The socket talks to itself. Two memories sit back to back, each with
+ *  block and word handlers that count every call and every word touched.
+ *  Runs of full-width words must reach the block handlers, and a run which
+ *  crosses from one memory to the next must be cut at addr_last. A block
+ *  handler which fails mid-run must see exactly that operation fail, with
+ *  no word accessed twice. Fifo writes, repeated reads and narrow
+ *  operations must fall back to the word handlers.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../etherbone.h"
+#include "common.h"
+
+#define BASE  0x100000
+#define WORDS 0x400          /* in each memory */
+#define LOW   BASE
+#define HIGH  (BASE + 4*WORDS) /* starts right after the addr_last of LOW */
+#define OPS   64           /* in one cycle */
+#define RUN   32           /* operations in one record on a 32-bit bus */
+
+struct memory {
+  struct sdb_device device;
+  uint8_t bytes[4*WORDS];
+  int touched[WORDS];   /* accesses of each word */
+  int blocks, words;    /* calls of each kind */
+  int widest;           /* most words in one block call */
+  int overruns;         /* calls reaching past the device */
+  eb_address_t fail;    /* this word fails; 0 if none */
+};
+
+static struct memory low, high;
+
+/* What the cycle callback saw of each operation */
+static int finished, errors[OPS];
+static eb_data_t results[OPS];
+static eb_status_t cycle_status;
+
+/* The bus is big endian */
+static eb_data_t load(struct memory* m, eb_address_t address, int width) {
+  eb_data_t out;
+  int i;
+
+  out = 0;
+  for (i = 0; i < width; ++i)
+    out = (out << 8) | m->bytes[address - m->device.sdb_component.addr_first + i];
+  return out;
+}
+
+static void store(struct memory* m, eb_address_t address, int width, eb_data_t data) {
+  int i;
+
+  for (i = width-1; i >= 0; --i) {
+    m->bytes[address - m->device.sdb_component.addr_first + i] = data & 0xFF;
+    data >>= 8;
+  }
+}
+
+/* Count an access to the word holding address; 0 if it must fail */
+static int touch(struct memory* m, eb_address_t address, int width) {
+  if (address < m->device.sdb_component.addr_first ||
+      address + width-1 > m->device.sdb_component.addr_last) {
+    ++m->overruns;
+    return 0;
+  }
+  if (m->fail != 0 && (address & ~(eb_address_t)3) == m->fail) return 0;
+
+  ++m->touched[(address - m->device.sdb_component.addr_first) / 4];
+  return 1;
+}
+
+static eb_status_t word_read(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t* data) {
+  struct memory* m = (struct memory*)user;
+
+  ++m->words;
+  *data = 0;
+  if (!touch(m, address, width & EB_DATAX)) return EB_FAIL;
+  *data = load(m, address, width & EB_DATAX);
+  return EB_OK;
+}
+
+static eb_status_t word_write(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t data) {
+  struct memory* m = (struct memory*)user;
+
+  ++m->words;
+  if (!touch(m, address, width & EB_DATAX)) return EB_FAIL;
+  store(m, address, width & EB_DATAX, data);
+  return EB_OK;
+}
+
+static void block_call(struct memory* m, eb_address_t address, eb_width_t width, int count) {
+  ++m->blocks;
+  if (count > m->widest) m->widest = count;
+  if ((width & EB_DATAX) != EB_DATA32) die("narrow block call", EB_FAIL);
+  if (address + 4*(eb_address_t)count-1 > m->device.sdb_component.addr_last) ++m->overruns;
+}
+
+static int block_read(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t* data, int count) {
+  struct memory* m = (struct memory*)user;
+  int i;
+
+  block_call(m, address, width, count);
+  for (i = 0; i < count; ++i) {
+    if (!touch(m, address + 4*i, 4)) return i;
+    data[i] = load(m, address + 4*i, 4);
+  }
+  return count;
+}
+
+static int block_write(eb_user_data_t user, eb_address_t address, eb_width_t width, const eb_data_t* data, int count) {
+  struct memory* m = (struct memory*)user;
+  int i;
+
+  block_call(m, address, width, count);
+  for (i = 0; i < count; ++i) {
+    if (!touch(m, address + 4*i, 4)) return i;
+    store(m, address + 4*i, 4, data[i]);
+  }
+  return count;
+}
+
+static void attach_memory(eb_socket_t socket, struct memory* m, eb_address_t first, uint32_t device_id) {
+  struct eb_handler handler;
+  struct eb_block_handler block;
+  eb_status_t status;
+
+  describe(&m->device, first, first + 4*WORDS-1, device_id, "Block-Handler      ");
+
+  handler.device = &m->device;
+  handler.data = m;
+  handler.read = &word_read;
+  handler.write = &word_write;
+  block.read_block = &block_read;
+  block.write_block = &block_write;
+
+  if ((status = eb_socket_attach_block(socket, &handler, &block)) != EB_OK) die("eb_socket_attach_block", status);
+}
+
+static void reset(struct memory* m) {
+  memset(m->touched, 0, sizeof(m->touched));
+  m->blocks = m->words = m->widest = m->overruns = 0;
+  m->fail = 0;
+}
+
+static void my_callback(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  int i;
+
+  cycle_status = status;
+  for (i = 0; op != EB_NULL && i < OPS; op = eb_operation_next(op), ++i) {
+    errors[i] = eb_operation_had_error(op);
+    results[i] = eb_operation_is_read(op) ? eb_operation_data(op) : 0;
+  }
+  ++finished;
+}
+
+/* Run one cycle of count operations: writes of value(i) or reads, at address(i) */
+static void cycle(eb_socket_t socket, eb_device_t device, int write, eb_format_t format,
+                  eb_address_t first, eb_address_t step, int count) {
+  eb_cycle_t cycle;
+  eb_status_t status;
+  eb_data_t mask;
+  int i;
+
+  mask = ~(eb_data_t)0 >> (64 - 8*(format & EB_DATAX));
+  memset(errors, 0, sizeof(errors));
+  memset(results, 0, sizeof(results));
+  finished = 0;
+
+  if ((status = eb_cycle_open(device, 0, &my_callback, &cycle)) != EB_OK) die("eb_cycle_open", status);
+  for (i = 0; i < count; ++i) {
+    if (write)
+      eb_cycle_write(cycle, first + i*step, format, (0x5a000000 + first + i*step + i) & mask);
+    else
+      eb_cycle_read(cycle, first + i*step, format, 0);
+  }
+  eb_cycle_close(cycle);
+
+  while (!finished) eb_socket_run(socket, -1);
+}
+
+/* Every word in [first, first+4*count) was touched once, except the one which failed */
+static void once(struct memory* m, eb_address_t first, int count, const char* what) {
+  eb_address_t address, base;
+  int expect;
+
+  base = m->device.sdb_component.addr_first;
+  for (address = first; address < first + 4*(eb_address_t)count; address += 4) {
+    if (address < base || address > m->device.sdb_component.addr_last) continue;
+    expect = address == m->fail ? 0 : 1;
+    if (m->touched[(address - base)/4] != expect) {
+      fprintf(stderr, "%s: word 0x%"EB_ADDR_FMT" touched %d times, expected %d\n",
+              what, address, m->touched[(address - base)/4], expect);
+      exit(1);
+    }
+  }
+}
+
+/* A run of full-width words, possibly crossing from low into high */
+static void run(eb_socket_t socket, eb_device_t device, eb_address_t first, int count, eb_address_t fail) {
+  eb_address_t address;
+  int i;
+
+  reset(&low);
+  reset(&high);
+  low.fail = high.fail = fail;
+
+  cycle(socket, device, 1, EB_DATA32|EB_BIG_ENDIAN, first, 4, count);
+  for (i = 0; i < count; ++i) {
+    address = first + 4*i;
+    if (errors[i] != (address == fail)) die("write error bits", EB_FAIL);
+  }
+  if ((fail != 0) != (cycle_status == EB_SEGFAULT)) die("write status", cycle_status);
+  once(&low, first, count, "write");
+  once(&high, first, count, "write");
+
+  reset(&low);
+  reset(&high);
+  low.fail = high.fail = fail;
+
+  cycle(socket, device, 0, EB_DATA32|EB_BIG_ENDIAN, first, 4, count);
+  for (i = 0; i < count; ++i) {
+    address = first + 4*i;
+    if (errors[i] != (address == fail)) die("read error bits", EB_FAIL);
+    if (address != fail && results[i] != 0x5a000000 + address + i) die("read back", EB_FAIL);
+  }
+  if ((fail != 0) != (cycle_status == EB_SEGFAULT)) die("read status", cycle_status);
+  once(&low, first, count, "read");
+  once(&high, first, count, "read");
+
+  /* The failed word is skipped, not retried word by word */
+  if (low.words + high.words != 0) die("word handler in a block run", EB_FAIL);
+  if (low.overruns + high.overruns != 0) die("block run past addr_last", EB_FAIL);
+}
+
+int main(int argc, const char** argv) {
+  eb_socket_t socket;
+  eb_device_t device;
+  eb_status_t status;
+  char address[64];
+  const char* port;
+  int i;
+
+  port = argc > 1 ? argv[1] : "60385";
+
+  if ((status = eb_socket_open(EB_ABI_CODE, port, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+  attach_memory(socket, &low,  LOW,  0xb10c0001);
+  attach_memory(socket, &high, HIGH, 0xb10c0002);
+
+  snprintf(address, sizeof(address), "udp/localhost/%s", port);
+  if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &device)) != EB_OK) die("eb_device_open", status);
+
+  /* Consecutive full-width words go to the block handler, a record at a time */
+  run(socket, device, LOW + 0x100, OPS, 0);
+  if (low.blocks != OPS/RUN || low.widest != RUN) die("one block call per record", EB_FAIL);
+  printf("%d words in %d records: %d block calls\n", OPS, OPS/RUN, low.blocks);
+
+  /* A record over the end of low is cut there and continues in high */
+  run(socket, device, HIGH - 4*(RUN/2), OPS, 0);
+  if (low.blocks != 1 || low.widest != RUN/2 || high.blocks != 2 || high.widest != RUN)
+    die("run cut at addr_last", EB_FAIL);
+  printf("record across addr_last: cut into %d + %d words\n", RUN/2, RUN/2);
+
+  /* A failure mid-run fails that word only, then the rest are offered again */
+  run(socket, device, LOW + 0x200, OPS, LOW + 0x200 + 4*10);
+  if (low.blocks != OPS/RUN + 1) die("resumed block call", EB_FAIL);
+  run(socket, device, HIGH - 4*(RUN/2), OPS, HIGH + 4*3);
+  if (low.blocks != 1 || high.blocks != 3) die("resumed block call after a cut", EB_FAIL);
+  printf("block handler failing mid-run: one operation failed\n");
+
+  /* A fifo writes one address over and over; repeated reads are no run either */
+  reset(&low);
+  cycle(socket, device, 1, EB_DATA32|EB_BIG_ENDIAN, LOW + 0x300, 0, 16);
+  if (cycle_status != EB_OK || low.blocks != 0 || low.words != 16) die("fifo write", EB_FAIL);
+  if (load(&low, LOW + 0x300, 4) != 0x5a000000 + LOW + 0x300 + 15) die("fifo write order", EB_FAIL);
+  reset(&low);
+  cycle(socket, device, 0, EB_DATA32|EB_BIG_ENDIAN, LOW + 0x300, 0, 16);
+  if (cycle_status != EB_OK || low.blocks != 0 || low.words != 16) die("repeated read", EB_FAIL);
+  for (i = 0; i < 16; ++i)
+    if (results[i] != 0x5a000000 + LOW + 0x300 + 15) die("repeated read data", EB_FAIL);
+  printf("fifo: word handler\n");
+
+  /* Narrow operations one per word take the word handler */
+  reset(&low);
+  cycle(socket, device, 1, EB_DATA16|EB_BIG_ENDIAN, LOW + 0x400 + 2, 4, 16);
+  if (cycle_status != EB_OK || low.blocks != 0 || low.words != 16) die("narrow write", EB_FAIL);
+  reset(&low);
+  cycle(socket, device, 0, EB_DATA16|EB_BIG_ENDIAN, LOW + 0x400 + 2, 4, 16);
+  if (cycle_status != EB_OK || low.blocks != 0 || low.words != 16) die("narrow read", EB_FAIL);
+  for (i = 0; i < 16; ++i)
+    if (results[i] != ((0x5a000000 + LOW + 0x400 + 2 + 4*i + i) & 0xFFFF)) die("narrow read data", EB_FAIL);
+  printf("narrow: word handler\n");
+
+  if ((status = eb_device_close(device)) != EB_OK) die("eb_device_close", status);
+  if ((status = eb_socket_close(socket)) != EB_OK) die("eb_socket_close", status);
+  return 0;
+}
@@ -0,0 +1,177 @@
+/** @file block.c
+ *  @brief Stream buffers to and from a software memory.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  The socket talks to itself, once over UDP and once over TCP. Each case
+ *  writes a buffer with eb_device_write_block, checks the memory image and
+ *  the bytes around it, then reads it back with eb_device_read_block.
+ *  The cases start and end off the bus width, mix operation widths, use
+ *  both byte orders, and run for many more cycles than the window holds.
+ *  A cycle which packs more than a packet holds fails with EB_OVERFLOW.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../etherbone.h"
+#include "common.h"
+
+#define BASE   0x100000
+#define MEMORY 0x80000
+#define GUARD  0x5A
+#define WINDOW 2
+
+struct test {
+  eb_address_t offset, length;
+  eb_format_t format;
+};
+
+static const struct test tests[] = {
+  { 0x0000,  0x40000, EB_DATA32|EB_BIG_ENDIAN },              /* aligned, ~200 cycles */
+  { 0x0001,  0x3fffe, EB_DATA8|EB_DATA32|EB_BIG_ENDIAN },     /* byte head and tail */
+  { 0x0003,  0x00005, EB_DATA8|EB_DATA32|EB_LITTLE_ENDIAN },  /* never reaches a whole word */
+  { 0x0002,  0x20006, EB_DATA16|EB_DATA32|EB_LITTLE_ENDIAN }, /* half-word head and tail */
+  { 0x0001,  0x3ffff, EB_DATAX|EB_LITTLE_ENDIAN },            /* only the tail is aligned */
+  { 0x1236,  0x0fff2, EB_DATA16|EB_BIG_ENDIAN },              /* narrow operations throughout */
+  { 0x0005,  0x10001, EB_DATA8|EB_LITTLE_ENDIAN }
+};
+
+static uint8_t memory[MEMORY];
+
+static eb_status_t memory_read(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t* data) {
+  eb_data_t out;
+  int i;
+
+  /* The bus is big endian */
+  out = 0;
+  for (i = 0; i < (width & EB_DATAX); ++i)
+    out = (out << 8) | memory[address - BASE + i];
+
+  *data = out;
+  return EB_OK;
+}
+
+static eb_status_t memory_write(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t data) {
+  int i;
+
+  for (i = (width & EB_DATAX)-1; i >= 0; --i) {
+    memory[address - BASE + i] = data & 0xFF;
+    data >>= 8;
+  }
+
+  return EB_OK;
+}
+
+/* The memory image of buffer after the transfer of one case.
+ * Little endian operations mirror the byte lanes within each bus word,
+ * whatever their width, so the buffer does not depend on how it was cut.
+ */
+static void expect(const struct test* test, eb_format_t data, const uint8_t* buffer, uint8_t* image) {
+  eb_address_t address, lane;
+
+  lane = (test->format & EB_ENDIAN_MASK) == EB_BIG_ENDIAN ? 0 : data-1;
+
+  memset(image, GUARD, MEMORY);
+  for (address = test->offset; address < test->offset + test->length; ++address)
+    image[address ^ lane] = buffer[address - test->offset];
+}
+
+static void run(eb_device_t device, const char* name, eb_format_t data, const struct test* test) {
+  static uint8_t buffer[MEMORY], image[MEMORY], back[MEMORY];
+  eb_status_t status;
+  eb_address_t i;
+
+  for (i = 0; i < test->length; ++i)
+    buffer[i] = rand();
+  memset(memory, GUARD, sizeof(memory));
+
+  if ((status = eb_device_write_block(device, BASE + test->offset, test->format, buffer, test->length, WINDOW, 0, eb_block)) != EB_OK) {
+    fprintf(stderr, "%s: write 0x%"EB_ADDR_FMT"+0x%"EB_ADDR_FMT"\n", name, test->offset, test->length);
+    die("eb_device_write_block", status);
+  }
+
+  expect(test, data, buffer, image);
+  for (i = 0; i < MEMORY; ++i) {
+    if (memory[i] != image[i]) {
+      fprintf(stderr, "%s: write 0x%"EB_ADDR_FMT"+0x%"EB_ADDR_FMT": memory at 0x%"EB_ADDR_FMT" is %02x, expected %02x\n",
+              name, test->offset, test->length, i, memory[i], image[i]);
+      exit(1);
+    }
+  }
+
+  memset(back, GUARD, sizeof(back));
+  if ((status = eb_device_read_block(device, BASE + test->offset, test->format, back, test->length, WINDOW, 0, eb_block)) != EB_OK) {
+    fprintf(stderr, "%s: read 0x%"EB_ADDR_FMT"+0x%"EB_ADDR_FMT"\n", name, test->offset, test->length);
+    die("eb_device_read_block", status);
+  }
+
+  if (memcmp(back, buffer, test->length) != 0 || back[test->length] != GUARD) {
+    fprintf(stderr, "%s: read 0x%"EB_ADDR_FMT"+0x%"EB_ADDR_FMT": buffer differs\n", name, test->offset, test->length);
+    exit(1);
+  }
+}
+
+static void check(eb_socket_t socket, const char* name, const char* address) {
+  eb_device_t device;
+  eb_status_t status;
+  eb_address_t length;
+  uint8_t byte;
+  unsigned k;
+
+  if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &device)) != EB_OK) die("eb_device_open", status);
+
+  for (k = 0; k < sizeof(tests)/sizeof(tests[0]); ++k)
+    run(device, name, EB_DATA32, &tests[k]);
+
+  /* Misaligned requests are refused before anything is sent */
+  length = 1;
+  if ((status = eb_device_read_block(device, BASE+1, EB_DATA16|EB_BIG_ENDIAN, &byte, length, 0, 0, eb_block)) != EB_ADDRESS)
+    die("misaligned read", EB_FAIL);
+  if ((status = eb_device_write_block(device, BASE, EB_DATA64|EB_BIG_ENDIAN, &byte, length, 0, 0, eb_block)) != EB_WIDTH)
+    die("width wider than the device", EB_FAIL);
+
+  if ((status = eb_device_close(device)) != EB_OK) die("eb_device_close", status);
+  printf("%s: %u block transfers ok\n", name, k);
+}
+
+int main(int argc, const char** argv) {
+  struct sdb_device device;
+  eb_socket_t socket;
+  eb_status_t status;
+  char address[64];
+  const char* port;
+
+  port = argc > 1 ? argv[1] : "60382";
+
+  if ((status = eb_socket_open(EB_ABI_CODE, port, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+
+  describe(&device, BASE, BASE + MEMORY-1, 0xb10c0000, "Block-Memory       ");
+  attach(socket, &device, &memory_read, &memory_write);
+
+  snprintf(address, sizeof(address), "udp/localhost/%s", port);
+  check(socket, "udp", address);
+  snprintf(address, sizeof(address), "tcp/localhost/%s", port);
+  check(socket, "tcp", address);
+
+  if ((status = eb_socket_close(socket)) != EB_OK) die("eb_socket_close", status);
+  return 0;
+}
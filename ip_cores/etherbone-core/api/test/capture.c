@@ -0,0 +1,212 @@
+/** @file capture.c
+ *  @brief Check the pcapng files written by eb_socket_capture.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  A socket reads and writes its own memory through udp/ and tcp/ while
+ *  capturing. The file must consist of whole blocks, every packet must
+ *  belong to a described interface, datagrams must carry a valid IPv4
+ *  header, and each device must show its requests and their replies.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../etherbone.h"
+#include "common.h"
+
+#define BASE   0x10000
+#define ROUNDS 20
+#define IFS    16
+
+struct interface {
+  char name[64];
+  int master;
+  int linktype;
+  int out, in;
+};
+
+static eb_data_t memory[ROUNDS];
+
+static eb_status_t my_read(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t* data) {
+  *data = memory[((address - BASE) / 4) % ROUNDS];
+  return EB_OK;
+}
+
+static eb_status_t my_write(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t data) {
+  memory[((address - BASE) / 4) % ROUNDS] = data;
+  return EB_OK;
+}
+
+static void exchange(eb_socket_t socket, const char* address) {
+  eb_device_t device;
+  eb_status_t status;
+  eb_data_t data;
+  int i;
+
+  if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &device)) != EB_OK) die(address, status);
+
+  for (i = 0; i < ROUNDS; ++i) {
+    if ((status = eb_device_write(device, BASE + 4*i, EB_DATA32|EB_BIG_ENDIAN, 0x1000 + i, 0, eb_block)) != EB_OK) die("eb_device_write", status);
+    if ((status = eb_device_read(device, BASE + 4*i, EB_DATA32|EB_BIG_ENDIAN, &data, 0, eb_block)) != EB_OK) die("eb_device_read", status);
+    if (data != 0x1000 + i) die("verification", EB_FAIL);
+  }
+
+  if ((status = eb_device_close(device)) != EB_OK) die("eb_device_close", status);
+}
+
+static uint32_t word(const uint8_t* p) {
+  uint32_t x;
+
+  memcpy(&x, p, 4);
+  return x;
+}
+
+static uint16_t half(const uint8_t* p) {
+  uint16_t x;
+
+  memcpy(&x, p, 2);
+  return x;
+}
+
+static void verify(const char* filename, const char* udp, const char* tcp) {
+  struct interface ifs[IFS];
+  FILE* file;
+  uint8_t* data;
+  const uint8_t* block;
+  const uint8_t* opt;
+  const uint8_t* ip;
+  long size;
+  uint32_t length, caplen, sum, flags;
+  int i, count, datagram_in;
+
+  if ((file = fopen(filename, "rb")) == 0) die(filename, EB_FAIL);
+  fseek(file, 0, SEEK_END);
+  size = ftell(file);
+  rewind(file);
+  if ((data = malloc(size)) == 0 || fread(data, 1, size, file) != (size_t)size) die(filename, EB_FAIL);
+  fclose(file);
+
+  if (size < 28 || word(data) != 0x0A0D0D0AU || word(data+8) != 0x1A2B3C4DU) die("section header", EB_FAIL);
+
+  count = 0;
+  datagram_in = 0;
+  for (block = data; block < data + size; block += length) {
+    if (data + size - block < 12) die("truncated block", EB_FAIL);
+    length = word(block+4);
+    if (length < 12 || (length & 3) != 0 || length > data + size - block) die("block length", EB_FAIL);
+    if (word(block + length - 4) != length) die("trailing block length", EB_FAIL);
+
+    switch (word(block)) {
+    case 0x0A0D0D0AU: /* SHB */
+      break;
+
+    case 1: /* IDB */
+      if (count == IFS) die("too many interfaces", EB_FAIL);
+      memset(&ifs[count], 0, sizeof(ifs[count]));
+      ifs[count].linktype = half(block+8);
+      for (opt = block + 16; half(opt) != 0; opt += 4 + ((half(opt+2) + 3) & ~3)) {
+        if (half(opt) == 2) memcpy(ifs[count].name, opt+4, half(opt+2) < 63 ? half(opt+2) : 63);
+        if (half(opt) == 3) ifs[count].master = half(opt+2) == 6 && memcmp(opt+4, "master", 6) == 0;
+      }
+      ++count;
+      break;
+
+    case 6: /* EPB */
+      if (word(block+8) >= (uint32_t)count) die("packet before its interface", EB_FAIL);
+      caplen = word(block+20);
+      opt = block + 28 + ((caplen + 3) & ~3);
+      if (half(opt) != 2 || half(opt+2) != 4) die("packet direction", EB_FAIL);
+      flags = word(opt+4);
+      if (flags == 2) ++ifs[word(block+8)].out;
+      else if (flags == 1) ++ifs[word(block+8)].in;
+      else die("packet direction", EB_FAIL);
+
+      if (ifs[word(block+8)].linktype == 228) {
+        ip = block + 28;
+        if (caplen < 32 || ip[0] != 0x45 || ip[9] != 17) die("IPv4 header", EB_FAIL);
+        for (sum = 0, i = 0; i < 20; i += 2) sum += (ip[i] << 8) | ip[i+1];
+        while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+        if (sum != 0xFFFF) die("IPv4 checksum", EB_FAIL);
+        if (((ip[2] << 8) | ip[3]) != caplen || ip[28] != 0x4E || ip[29] != 0x6F) die("Etherbone datagram", EB_FAIL);
+        if (!ifs[word(block+8)].master && flags == 1) ++datagram_in;
+      } else if (ifs[word(block+8)].linktype != 147) {
+        die("link type", EB_FAIL);
+      }
+      break;
+
+    default:
+      die("unexpected block", EB_FAIL);
+    }
+  }
+
+  /* The masters: a probe plus a write and a read per round, each answered */
+  for (i = 0; i < count; ++i) {
+    if (!ifs[i].master) continue;
+    if (strcmp(ifs[i].name, udp) == 0) {
+      if (ifs[i].out < 2*ROUNDS + 1) die("udp requests missing", EB_FAIL);
+      udp = "";
+    }
+    if (strcmp(ifs[i].name, tcp) == 0) {
+      if (ifs[i].out < 2*ROUNDS + 1 || ifs[i].in < ROUNDS + 1) die("tcp requests missing", EB_FAIL);
+      tcp = "";
+    }
+  }
+  if (*udp || *tcp) die("device interface missing", EB_FAIL);
+
+  /* The socket served udp itself: its requests and replies both arrive there */
+  if (datagram_in < (2*ROUNDS + 1) + (ROUNDS + 1)) die("udp packets missing", EB_FAIL);
+
+  free(data);
+}
+
+int main(int argc, const char** argv) {
+  struct sdb_device device;
+  eb_socket_t socket;
+  eb_status_t status;
+  const char* port;
+  char udp[64], tcp[64], filename[64];
+
+  port = argc > 1 ? argv[1] : "60391";
+  snprintf(udp, sizeof(udp), "udp/localhost/%s", port);
+  snprintf(tcp, sizeof(tcp), "tcp/localhost/%s", port);
+  snprintf(filename, sizeof(filename), "/tmp/eb-capture-%d.pcapng", (int)getpid());
+
+  describe(&device, BASE, BASE + 4*ROUNDS - 1, 0xc3c5eefa, "Capture-Memory     ");
+
+  if ((status = eb_socket_open(EB_ABI_CODE, port, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+  attach(socket, &device, &my_read, &my_write);
+  if ((status = eb_socket_capture(socket, filename)) != EB_OK) die("eb_socket_capture", status);
+
+  exchange(socket, udp);
+  exchange(socket, tcp);
+
+  if ((status = eb_socket_capture(socket, 0)) != EB_OK) die("eb_socket_capture", status);
+  if ((status = eb_socket_close(socket)) != EB_OK) die("eb_socket_close", status);
+
+  verify(filename, udp, tcp);
+  unlink(filename);
+
+  return 0;
+}
@@ -0,0 +1,219 @@
+/** @file coalesce.c
+ *  @brief Test that coalesced cycles keep the bus-visible order of accesses.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  The same cycles run closed normally and with eb_cycle_close_coalesced.
+ *  The local handler logs every access it sees. The coalesced log must be
+ *  the plain log minus the merged accesses, in the same order; every read
+ *  must report the same value, and the memory must end up the same.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../etherbone.h"
+#include "common.h"
+
+#define BASE  0x10000
+#define WORDS 16
+#define LOG   256
+#define OPS   64
+
+struct access {
+  int write;
+  eb_address_t address;
+  eb_data_t data;
+};
+
+static eb_data_t memory[WORDS];
+static struct access log[LOG];
+static int logged;
+
+/* What the cycle callback saw: every operation in order */
+static struct access seen[OPS];
+static int seen_count, done;
+static eb_status_t seen_status;
+
+static eb_status_t my_read(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t* data) {
+  *data = memory[(address - BASE)/4 % WORDS];
+  if (logged < LOG) {
+    log[logged].write = 0;
+    log[logged].address = address;
+    log[logged].data = *data;
+    ++logged;
+  }
+  return EB_OK;
+}
+
+static eb_status_t my_write(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t data) {
+  memory[(address - BASE)/4 % WORDS] = data;
+  if (logged < LOG) {
+    log[logged].write = 1;
+    log[logged].address = address;
+    log[logged].data = data;
+    ++logged;
+  }
+  return EB_OK;
+}
+
+static void my_callback(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  seen_status = status;
+  for (seen_count = 0; op != EB_NULL && seen_count < OPS; op = eb_operation_next(op), ++seen_count) {
+    seen[seen_count].write = !eb_operation_is_read(op);
+    seen[seen_count].address = eb_operation_address(op);
+    seen[seen_count].data = eb_operation_data(op);
+  }
+  done = 1;
+}
+
+/* One cycle mixing what may and may not be merged */
+static void queue(eb_cycle_t cycle, eb_data_t* ptr) {
+  eb_cycle_write(cycle, BASE+0x00, EB_DATA32, 1);
+  eb_cycle_write(cycle, BASE+0x04, EB_DATA32, 2);
+  eb_cycle_write(cycle, BASE+0x00, EB_DATA32, 3);  /* drops the first write */
+  eb_cycle_read (cycle, BASE+0x00, EB_DATA32, &ptr[0]);
+  eb_cycle_read (cycle, BASE+0x00, EB_DATA32, &ptr[1]); /* merged */
+  eb_cycle_read (cycle, BASE+0x00, EB_DATA32, 0);       /* merged */
+  eb_cycle_read (cycle, BASE+0x04, EB_DATA32, &ptr[2]);
+  eb_cycle_read (cycle, BASE+0x00, EB_DATA32, &ptr[3]); /* not adjacent: kept */
+  eb_cycle_write(cycle, BASE+0x08, EB_DATA32, 4);
+  eb_cycle_read (cycle, BASE+0x08, EB_DATA32, &ptr[4]); /* a write came between: kept */
+  eb_cycle_write(cycle, BASE+0x08, EB_DATA32, 5);       /* a read came between: kept */
+  eb_cycle_write(cycle, BASE+0x0C, EB_DATA32, 6);
+  eb_cycle_write(cycle, BASE+0x0C, EB_DATA32, 7);       /* drops the one before */
+  eb_cycle_read_config(cycle, 0x04, EB_DATA32, &ptr[5]);
+  eb_cycle_read_config(cycle, 0x04, EB_DATA32, &ptr[6]); /* config space: kept */
+  eb_cycle_read (cycle, BASE+0x0C, EB_DATA32, &ptr[7]);
+  eb_cycle_read (cycle, BASE+0x0C, EB_DATA32, &ptr[8]); /* merged */
+}
+
+static int run(eb_socket_t socket, eb_device_t device, int coalesce, eb_data_t* ptr, struct access* bus, struct access* ops, eb_data_t* mem) {
+  eb_cycle_t cycle;
+  eb_status_t status;
+  int n;
+
+  memset(memory, 0, sizeof(memory));
+  logged = 0;
+  done = 0;
+
+  if ((status = eb_cycle_open(device, 0, &my_callback, &cycle)) != EB_OK) die("eb_cycle_open", status);
+  queue(cycle, ptr);
+  if (coalesce)
+    eb_cycle_close_coalesced(cycle, coalesce);
+  else
+    eb_cycle_close(cycle);
+
+  while (!done) eb_socket_run(socket, -1);
+  if (seen_status != EB_OK) die("cycle", seen_status);
+
+  n = logged;
+  memcpy(bus, log, sizeof(log));
+  memcpy(ops, seen, sizeof(seen));
+  memcpy(mem, memory, sizeof(memory));
+  return n;
+}
+
+int main(int argc, const char** argv) {
+  struct sdb_device sdb;
+  struct eb_device_stats stats;
+  struct access plain_bus[LOG], merged_bus[LOG];
+  struct access plain_ops[OPS], merged_ops[OPS];
+  eb_data_t plain_ptr[9], merged_ptr[9];
+  eb_data_t plain_mem[WORDS], merged_mem[WORDS];
+  eb_socket_t socket;
+  eb_device_t device;
+  eb_status_t status;
+  const char* port;
+  char address[64];
+  uint64_t plain_bytes;
+  int plain, merged, plain_count, i, j, k;
+
+  port = argc > 1 ? argv[1] : "60375";
+
+  describe(&sdb, BASE, BASE + 4*WORDS - 1, 0xc0a1e5ce, "Coalesce-Memory    ");
+
+  if ((status = eb_socket_open(EB_ABI_CODE, port, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+  attach(socket, &sdb, &my_read, &my_write);
+
+  snprintf(address, sizeof(address), "udp/localhost/%s", port);
+  if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &device)) != EB_OK) die("eb_device_open", status);
+  if ((status = eb_device_stats_enable(device)) != EB_OK) die("eb_device_stats_enable", status);
+
+  plain = run(socket, device, 0, plain_ptr, plain_bus, plain_ops, plain_mem);
+  plain_count = seen_count;
+  eb_device_stats(device, &stats);
+  plain_bytes = stats.bytes;
+
+  merged = run(socket, device, EB_COALESCE_READS|EB_COALESCE_WRITES, merged_ptr, merged_bus, merged_ops, merged_mem);
+  eb_device_stats(device, &stats);
+
+  /* 3 reads merged and 2 writes dropped */
+  if (plain != 15 || merged != 10) {
+    fprintf(stderr, "expected 15 then 10 bus accesses, saw %d then %d\n", plain, merged);
+    return 1;
+  }
+
+  /* The coalesced accesses appear in the plain log in the same order */
+  for (i = j = 0; i < merged; ++i, ++j) {
+    while (j < plain && memcmp(&plain_bus[j], &merged_bus[i], sizeof(struct access)) != 0) ++j;
+    if (j == plain) {
+      fprintf(stderr, "bus access %d (%s 0x%x) out of order\n", i, merged_bus[i].write?"write":"read", (unsigned)merged_bus[i].address);
+      return 1;
+    }
+  }
+
+  if (memcmp(plain_ptr, merged_ptr, sizeof(plain_ptr)) != 0 ||
+      memcmp(plain_mem, merged_mem, sizeof(plain_mem)) != 0) {
+    fprintf(stderr, "coalescing changed a result\n");
+    return 1;
+  }
+
+  /* Reads keep their place in the operation list with the same values; dropped writes are gone */
+  if (plain_count != 17 || seen_count != 15) {
+    fprintf(stderr, "expected 17 then 15 operations, saw %d then %d\n", plain_count, seen_count);
+    return 1;
+  }
+  for (i = k = 0; i < plain_count; ++i) {
+    if (plain_ops[i].write && (k == seen_count || memcmp(&plain_ops[i], &merged_ops[k], sizeof(struct access)) != 0)) continue;
+    if (memcmp(&plain_ops[i], &merged_ops[k], sizeof(struct access)) != 0) {
+      fprintf(stderr, "operation %d differs\n", i);
+      return 1;
+    }
+    ++k;
+  }
+
+  /* Five words were kept off the wire, and the request really shrank by at least as much */
+  if (stats.coalesced != 5*4 || stats.bytes - plain_bytes + stats.coalesced > plain_bytes) {
+    fprintf(stderr, "saved %d bytes; sent %d then %d\n", (int)stats.coalesced, (int)plain_bytes, (int)(stats.bytes - plain_bytes));
+    return 1;
+  }
+
+  printf("%d bus accesses instead of %d; %d of %d request bytes saved\n",
+    merged, plain, (int)(2*plain_bytes - stats.bytes), (int)plain_bytes);
+
+  if ((status = eb_device_close(device)) != EB_OK) die("eb_device_close", status);
+  if ((status = eb_socket_close(socket)) != EB_OK) die("eb_socket_close", status);
+
+  return 0;
+}
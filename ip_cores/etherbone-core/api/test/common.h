@@ -0,0 +1,81 @@
+/** @file common.h
+ *  @brief Fixture shared by the socket tests.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  A software slave that echoes the address on reads, and the helpers
+ *  that describe and attach it.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#ifndef EB_TEST_COMMON_H
+#define EB_TEST_COMMON_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../etherbone.h"
+
+/* Not every test uses every helper; inline keeps -Wall quiet about that */
+
+static inline void die(const char* why, eb_status_t status) {
+  fprintf(stderr, "%s: %s\n", why, eb_status(status));
+  exit(1);
+}
+
+/* Reads return the address, so every result can be checked */
+static inline eb_status_t echo_read(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t* data) {
+  *data = address;
+  return EB_OK;
+}
+
+static inline eb_status_t echo_write(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t data) {
+  return EB_OK;
+}
+
+/* A GSI device of all widths covering [first, last]; name is 19 characters */
+static inline void describe(struct sdb_device* device, eb_address_t first, eb_address_t last, uint32_t device_id, const char* name) {
+  memset(device, 0, sizeof(*device));
+  device->abi_class = 0x1;
+  device->bus_specific = EB_DATAX;
+  device->sdb_component.addr_first = first;
+  device->sdb_component.addr_last  = last;
+  device->sdb_component.product.vendor_id = 0x651; /* GSI */
+  device->sdb_component.product.device_id = device_id;
+  device->sdb_component.product.record_type = sdb_record_device;
+  memcpy(device->sdb_component.product.name, name, sizeof(device->sdb_component.product.name));
+}
+
+/* The device must outlive the attachment; the handler is copied */
+static inline void attach(eb_socket_t socket, const struct sdb_device* device,
+                          eb_status_t (*read) (eb_user_data_t, eb_address_t, eb_width_t, eb_data_t*),
+                          eb_status_t (*write)(eb_user_data_t, eb_address_t, eb_width_t, eb_data_t)) {
+  struct eb_handler handler;
+  eb_status_t status;
+
+  handler.device = device;
+  handler.data = 0;
+  handler.read = read;
+  handler.write = write;
+
+  if ((status = eb_socket_attach(socket, &handler)) != EB_OK) die("eb_socket_attach", status);
+}
+
+#endif
@@ -0,0 +1,180 @@
+/** @file discover.c
+ *  @brief Inventory a crowd of local slaves with eb-discover.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  Child processes stand in for a network of nodes: each serves a small SDB
+ *  with an ECA, a TLU or a White Rabbit core on its own port. eb-discover
+ *  probes them all, reads every SDB and must report each node exactly once
+ *  with the right core. Nodes answer late, like ones across a network, and
+ *  the inventory is timed one node at a time and all at once.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "../etherbone.h"
+#include "common.h"
+
+#define NODES 24
+#define DELAY 2000 /* us each node sits idle between polls, standing in for the network */
+
+struct kind {
+  const char* name;
+  uint64_t vendor_id;
+  uint32_t device_id;
+  const char* product;
+};
+
+static const struct kind kinds[3] = {
+  { "eca", 0x651,  0xb2afc251, "ECA_UNIT:CONTROL   " },
+  { "tlu", 0x651,  0x10051981, "GSI_TM_LATCH_V2    " },
+  { "wr",  0xce42, 0xff07fc47, "WR-Periph-Syscon   " }
+};
+
+static pid_t parent, child[NODES];
+static int children;
+
+/* However the test ends, no node may stay behind holding its port */
+static void reap(void) {
+  int i;
+
+  if (getpid() != parent) return;
+  for (i = 0; i < children; ++i)
+    kill(child[i], SIGKILL);
+  for (i = 0; i < children; ++i)
+    waitpid(child[i], 0, 0);
+  children = 0;
+}
+
+static double now(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+/* A child: one node with some memory and the core of its kind */
+static void serve(const char* port, const struct kind* kind, int ready) {
+  struct sdb_device memory, core;
+  struct timespec delay;
+  eb_socket_t socket;
+  eb_status_t status;
+
+  delay.tv_sec = 0;
+  delay.tv_nsec = DELAY*1000;
+
+  describe(&memory, 0x10000, 0x1FFFF, 0x5afe5a3e, "Node-Memory        ");
+  describe(&core,   0x20000, 0x2FFFF, kind->device_id, kind->product);
+  core.sdb_component.product.vendor_id = kind->vendor_id;
+
+  if ((status = eb_socket_open(EB_ABI_CODE, port, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+  attach(socket, &memory, &echo_read, &echo_write);
+  attach(socket, &core, &echo_read, &echo_write);
+
+  if (write(ready, "", 1) != 1) die("write", EB_FAIL);
+  close(ready);
+
+  while (1) {
+    eb_socket_run(socket, -1);
+    nanosleep(&delay, 0);
+  }
+}
+
+/* Run eb-discover over all nodes; check every node was found with its core */
+static double inventory(const char* tool, int base, int concurrency) {
+  FILE* out;
+  char command[4096], line[1024], expect[128];
+  int seen[NODES], i, port, lines;
+  double start, elapsed;
+  char* at;
+
+  snprintf(command, sizeof(command), "%s -s -j -N -t 0.5 -n %d", tool, concurrency);
+  for (i = 0; i < NODES; ++i)
+    snprintf(command + strlen(command), sizeof(command) - strlen(command), " udp/localhost/%d", base + i);
+
+  memset(seen, 0, sizeof(seen));
+  lines = 0;
+
+  start = now();
+  if ((out = popen(command, "r")) == 0) die("popen", EB_FAIL);
+  while (fgets(line, sizeof(line), out)) {
+    ++lines;
+    if ((at = strstr(line, "/127.0.0.1/")) == 0) die(line, EB_FAIL);
+    port = atoi(at + 11);
+    if (port < base || port >= base + NODES) die(line, EB_FAIL);
+    i = port - base;
+
+    snprintf(expect, sizeof(expect), "\"kind\":\"%s\",\"base\":\"0x20000\"", kinds[i%3].name);
+    if (!strstr(line, "\"status\":\"success\"") || !strstr(line, "\"devices\":2") || !strstr(line, expect))
+      die(line, EB_FAIL);
+    ++seen[i];
+  }
+  if (pclose(out) != 0) die("eb-discover", EB_FAIL);
+  elapsed = now() - start;
+
+  if (lines != NODES) die("responders", EB_FAIL);
+  for (i = 0; i < NODES; ++i)
+    if (seen[i] != 1) die("responder seen twice", EB_FAIL);
+
+  /* Less the collection window */
+  return elapsed - 0.5;
+}
+
+int main(int argc, const char** argv) {
+  const char* tool;
+  char port[16], byte;
+  int base, ready[2], i;
+
+  base = argc > 1 ? atoi(argv[1]) : 60381;
+  tool = argc > 2 ? argv[2] : "./tools/eb-discover";
+
+  parent = getpid();
+  atexit(&reap);
+
+  for (i = 0; i < NODES; ++i) {
+    snprintf(port, sizeof(port), "%d", base + i);
+    if (pipe(ready) != 0) die("pipe", EB_FAIL);
+    if ((child[i] = fork()) == 0) {
+      close(ready[0]);
+      serve(port, &kinds[i%3], ready[1]);
+    }
+    if (child[i] < 0) die("fork", EB_FAIL);
+    ++children;
+    close(ready[1]);
+    if (read(ready[0], &byte, 1) != 1) die("child", EB_FAIL);
+    close(ready[0]);
+  }
+
+  printf("%d nodes, one at a time: %6.1fms\n", NODES, inventory(tool, base, 1)*1e3);
+  printf("%d nodes, all at once:   %6.1fms\n", NODES, inventory(tool, base, NODES)*1e3);
+
+  reap();
+  return 0;
+}
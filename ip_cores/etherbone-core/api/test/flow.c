@@ -0,0 +1,475 @@
+/** @file flow.c
+ *  @brief Check that sender flow control recovers from lost packets.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  The socket talks to itself through a UDP relay which drops packets.
+ *  Every cycle must complete exactly once: either with verified data or
+ *  with EB_TIMEOUT, mostly well before its timeout expires. Replies which merely
+ *  arrive out of order must not fail their cycles. A flood of cycles which
+ *  expect no answer must still be held to the window. A cycle with a short
+ *  timeout must fail in about that time, not the default. Finally,
+ *  tools/eb-put and tools/eb-get stream an image through the lossy relay;
+ *  they must resume past every loss, and the image read back must match.
+ *  With -f, a word which faults on the bus is skipped, and only that word.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#define __STDC_FORMAT_MACROS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../etherbone.h"
+#include "common.h"
+
+#define CYCLES   4000
+#define INFLIGHT 512
+#define TIMEOUT  100000 /* us; bounds the wait when a loss takes the whole window */
+#define FLOOD    200    /* request bytes of a flood() cycle, and then some */
+#define BASE     0x10000
+#define IMAGE    0x10000000 /* eb-put and eb-get stream to and from here */
+#define LENGTH   0x80000
+#define FAULT    0x12344    /* the image word which faults under -f */
+
+/* The relay: requests arrive on 'front' and leave by 'back' */
+struct relay {
+  int front, back;
+  struct sockaddr_in client, server;
+  volatile int drop_request, drop_reply; /* drop every n-th packet; 0 = none */
+  volatile int swap_reply; /* deliver every n-th reply after the next; 0 = none */
+  volatile int dropped, swapped;
+};
+
+static int inflight, done, timeouts, failed;
+static uint8_t memory[LENGTH];
+static int faulty; /* does the word at IMAGE+FAULT fail on the bus? */
+static pid_t parent;
+static char put_file[64], get_file[64];
+
+static int udp_bind(int port) {
+  struct sockaddr_in sin;
+  int fd;
+
+  if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) die("socket", EB_FAIL);
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sin.sin_port = htons(port);
+  if (bind(fd, (struct sockaddr*)&sin, sizeof(sin)) < 0) die("bind", EB_BUSY);
+
+  return fd;
+}
+
+static void* forward(void* arg) {
+  struct relay* r = (struct relay*)arg;
+  struct sockaddr_in from;
+  socklen_t len;
+  unsigned char buf[2048], held[2048];
+  unsigned long requests, replies, swaps;
+  fd_set rfds;
+  int got, n, holding;
+
+  requests = replies = swaps = 0;
+  holding = 0;
+  while (1) {
+    FD_ZERO(&rfds);
+    FD_SET(r->front, &rfds);
+    FD_SET(r->back, &rfds);
+    if (select((r->front > r->back ? r->front : r->back)+1, &rfds, 0, 0, 0) < 0) continue;
+
+    if (FD_ISSET(r->front, &rfds)) {
+      len = sizeof(r->client);
+      if ((got = recvfrom(r->front, buf, sizeof(buf), 0, (struct sockaddr*)&r->client, &len)) > 0) {
+        /* Never drop the width negotiation */
+        n = r->drop_request;
+        if (got < 4 || (buf[2] & 3) != 0 || n == 0 || ++requests % n != 0)
+          sendto(r->back, buf, got, 0, (struct sockaddr*)&r->server, sizeof(r->server));
+        else
+          ++r->dropped;
+      }
+    }
+
+    if (FD_ISSET(r->back, &rfds)) {
+      len = sizeof(from);
+      if ((got = recvfrom(r->back, buf, sizeof(buf), 0, (struct sockaddr*)&from, &len)) > 0) {
+        n = r->drop_reply;
+        if (got >= 4 && (buf[2] & 3) == 0 && n != 0 && ++replies % n == 0) {
+          ++r->dropped;
+        } else if (got >= 4 && (buf[2] & 3) == 0 && holding == 0 &&
+                   (n = r->swap_reply) != 0 && ++swaps % n == 0) {
+          memcpy(held, buf, got);
+          holding = got;
+          ++r->swapped;
+        } else {
+          sendto(r->front, buf, got, 0, (struct sockaddr*)&r->client, sizeof(r->client));
+          if (holding != 0) {
+            sendto(r->front, held, holding, 0, (struct sockaddr*)&r->client, sizeof(r->client));
+            holding = 0;
+          }
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+static void complete(eb_user_data_t user, eb_device_t device, eb_operation_t op, eb_status_t status) {
+  --inflight;
+  ++done;
+
+  if (status == EB_TIMEOUT) {
+    ++timeouts;
+    return;
+  }
+
+  if (status != EB_OK) {
+    fprintf(stderr, "cycle failed: %s\n", eb_status(status));
+    ++failed;
+    return;
+  }
+
+  for (; op != EB_NULL; op = eb_operation_next(op)) {
+    if (!eb_operation_is_read(op)) continue;
+    if (eb_operation_data(op) != eb_operation_address(op)) {
+      fprintf(stderr, "bad data at %"EB_ADDR_FMT"\n", eb_operation_address(op));
+      ++failed;
+    }
+  }
+}
+
+static eb_status_t memory_read(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t* data) {
+  eb_data_t out;
+  int i;
+
+  if (faulty && (address & ~(eb_address_t)3) == IMAGE+FAULT) return EB_FAIL;
+
+  /* The bus is big endian */
+  out = 0;
+  for (i = 0; i < (width & EB_DATAX); ++i)
+    out = (out << 8) | memory[address - IMAGE + i];
+
+  *data = out;
+  return EB_OK;
+}
+
+static eb_status_t memory_write(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t data) {
+  int i;
+
+  if (faulty && (address & ~(eb_address_t)3) == IMAGE+FAULT) return EB_FAIL;
+
+  for (i = (width & EB_DATAX)-1; i >= 0; --i) {
+    memory[address - IMAGE + i] = data & 0xFF;
+    data >>= 8;
+  }
+
+  return EB_OK;
+}
+
+static void cleanup(void) {
+  if (getpid() != parent) return;
+  unlink(put_file);
+  unlink(get_file);
+}
+
+/* Run a tool against the relay, serving the socket until it exits */
+static void tool(eb_socket_t socket, char* const* argv) {
+  pid_t pid, got;
+  int wstatus;
+
+  fflush(stdout); /* or the child prints it again */
+  if ((pid = fork()) == 0) {
+    execv(argv[0], argv);
+    perror(argv[0]);
+    _exit(127);
+  }
+  if (pid < 0) die("fork", EB_FAIL);
+
+  while ((got = waitpid(pid, &wstatus, WNOHANG)) == 0)
+    eb_socket_run(socket, 10000);
+
+  if (got != pid) die("waitpid", EB_FAIL);
+  if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+    fprintf(stderr, "%s failed\n", argv[0]);
+    exit(1);
+  }
+}
+
+/* Is the file exactly these bytes? */
+static int same(const char* name, const uint8_t* buf, long len) {
+  uint8_t chunk[4096];
+  FILE* f;
+  long pos;
+  size_t got;
+
+  if ((f = fopen(name, "rb")) == 0) return 0;
+  for (pos = 0; (got = fread(chunk, 1, sizeof(chunk), f)) > 0; pos += got)
+    if (pos + (long)got > len || memcmp(chunk, buf + pos, got) != 0) break;
+  fclose(f);
+
+  return got == 0 && pos == len;
+}
+
+/* Stream an image out and back through the lossy relay */
+static void stream(eb_socket_t socket, struct relay* r, int port) {
+  static uint8_t image[LENGTH];
+  char target[64], address[64], range[64];
+  char* put[] = { "tools/eb-put", "-q", "-p", "-b", "-R", "1000", target, address, put_file, 0 };
+  char* get[] = { "tools/eb-get", "-q", "-p", "-b", "-R", "1000", target, range, get_file, 0 };
+  char* put_f[] = { "tools/eb-put", "-q", "-p", "-b", "-R", "1000", "-f", target, address, put_file, 0 };
+  char* get_f[] = { "tools/eb-get", "-q", "-p", "-b", "-R", "1000", "-f", target, range, get_file, 0 };
+  FILE* f;
+  int i;
+
+  snprintf(target,   sizeof(target),   "udp/127.0.0.1/%d", port+1);
+  snprintf(address,  sizeof(address),  "0x%x", IMAGE);
+  snprintf(range,    sizeof(range),    "0x%x/0x%x", IMAGE, LENGTH);
+  snprintf(put_file, sizeof(put_file), "/tmp/eb-flow-%d.put", (int)parent);
+  snprintf(get_file, sizeof(get_file), "/tmp/eb-flow-%d.get", (int)parent);
+  atexit(&cleanup);
+
+  for (i = 0; i < LENGTH; ++i)
+    image[i] = rand();
+  if ((f = fopen(put_file, "wb")) == 0 || fwrite(image, 1, LENGTH, f) != LENGTH || fclose(f) != 0)
+    die(put_file, EB_FAIL);
+
+  /* Each 64 KiB chunk spans about 45 packets, so most attempts lose one */
+  r->dropped = 0;
+  r->drop_request = 97;
+  r->drop_reply = 89;
+  tool(socket, put);
+  if (r->dropped == 0) die("eb-put lost nothing", EB_FAIL);
+  if (memcmp(memory, image, LENGTH) != 0) die("eb-put image", EB_FAIL);
+  printf("eb-put: %d bytes, resumed past %d dropped packets\n", LENGTH, r->dropped);
+
+  r->dropped = 0;
+  tool(socket, get);
+  if (r->dropped == 0) die("eb-get lost nothing", EB_FAIL);
+  if (!same(get_file, image, LENGTH)) die("eb-get image", EB_FAIL);
+  printf("eb-get: %d bytes, resumed past %d dropped packets\n", LENGTH, r->dropped);
+
+  /* Forced: only the faulting word is skipped, not the rest of its chunk */
+  for (i = 0; i < LENGTH; ++i)
+    image[i] = rand();
+  if ((f = fopen(put_file, "wb")) == 0 || fwrite(image, 1, LENGTH, f) != LENGTH || fclose(f) != 0)
+    die(put_file, EB_FAIL);
+  memset(&image[FAULT], 0, 4);
+  memset(memory, 0, LENGTH);
+  faulty = 1;
+
+  tool(socket, put_f);
+  if (memcmp(memory, image, LENGTH) != 0) die("eb-put -f image", EB_FAIL);
+  tool(socket, get_f);
+  if (!same(get_file, image, LENGTH)) die("eb-get -f image", EB_FAIL);
+  printf("forced: %d bytes out and back, skipping the word at 0x%x\n", LENGTH, IMAGE+FAULT);
+
+  faulty = 0;
+  r->drop_request = r->drop_reply = 0;
+}
+
+/* Write without read-backs; the window must still hold the requests back */
+static void flood(eb_socket_t socket, eb_device_t remote) {
+  struct eb_device_flow flow;
+  struct eb_device_stats before, after;
+  eb_cycle_t cycle;
+  eb_status_t status;
+  uint32_t excess, worst;
+  int i, j;
+
+  done = failed = 0;
+  worst = 0;
+  if ((status = eb_device_stats(remote, &before)) != EB_OK) die("eb_device_stats", status);
+
+  for (i = 0; i < CYCLES; ++i) {
+    while (inflight >= INFLIGHT) eb_socket_run(socket, -1);
+
+    if ((status = eb_cycle_open(remote, 0, &complete, &cycle)) != EB_OK) die("eb_cycle_open", status);
+    for (j = 0; j < 16; ++j)
+      eb_cycle_write(cycle, BASE + (i << 6) + 4*j, EB_DATA32|EB_BIG_ENDIAN, j);
+    eb_cycle_close_silently(cycle);
+    ++inflight;
+
+    if ((status = eb_device_flow(remote, &flow)) != EB_OK) die("eb_device_flow", status);
+    excess = flow.inflight > flow.window ? flow.inflight - flow.window : 0;
+    if (excess > worst) worst = excess;
+  }
+
+  while (inflight > 0) eb_socket_run(socket, -1);
+
+  if ((status = eb_device_stats(remote, &after)) != EB_OK) die("eb_device_stats", status);
+  if ((status = eb_device_flow(remote, &flow)) != EB_OK) die("eb_device_flow", status);
+  printf("flood: %lu read-backs paced %d silent cycles, window %6lu bytes, %lu bytes held\n",
+         (unsigned long)(after.responses - before.responses), CYCLES,
+         (unsigned long)flow.window, (unsigned long)flow.inflight);
+
+  /* Only the last cycle may overshoot the window, and some cycles were made to answer */
+  if (failed || done != CYCLES || worst > FLOOD) die("silent flood", EB_FAIL);
+  if (after.responses == before.responses || flow.inflight > flow.window) die("silent pacing", EB_FAIL);
+}
+
+/* Push CYCLES cycles through the relay, stop dropping near the end */
+static double run(eb_socket_t socket, eb_device_t remote, struct relay* r, int drop_request, int drop_reply) {
+  struct timeval start, stop;
+  eb_cycle_t cycle;
+  eb_status_t status;
+  eb_address_t address;
+  int i, j;
+
+  done = timeouts = failed = 0;
+  r->dropped = 0;
+  r->drop_request = drop_request;
+  r->drop_reply = drop_reply;
+  gettimeofday(&start, 0);
+
+  for (i = 0; i < CYCLES; ++i) {
+    /* Later cycles overtake most losses, so they are noticed before their timeout */
+    if (i == CYCLES - INFLIGHT/2) r->drop_request = r->drop_reply = r->swap_reply = 0;
+
+    while (inflight >= INFLIGHT) eb_socket_run(socket, -1);
+
+    if ((status = eb_cycle_open(remote, 0, &complete, &cycle)) != EB_OK) die("eb_cycle_open", status);
+    eb_cycle_timeout(cycle, TIMEOUT);
+    address = BASE + (i << 4);
+    eb_cycle_write(cycle, address, EB_DATA32|EB_BIG_ENDIAN, i);
+    for (j = 0; j < 3; ++j)
+      eb_cycle_read(cycle, address + 4*(j+1), EB_DATA32|EB_BIG_ENDIAN, 0);
+    eb_cycle_close(cycle);
+    ++inflight;
+  }
+
+  while (inflight > 0) eb_socket_run(socket, -1);
+
+  gettimeofday(&stop, 0);
+  return (stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec)*1e-6;
+}
+
+int main(int argc, const char** argv) {
+  struct sdb_device device, storage;
+  struct eb_device_flow flow;
+  struct eb_device_stats stats;
+  struct relay relay;
+  struct timeval start, stop;
+  pthread_t thread;
+  eb_cycle_t cycle;
+  eb_socket_t socket;
+  eb_device_t remote;
+  eb_status_t status;
+  double seconds;
+  char address[64];
+  int port, lost;
+
+  port = argc > 1 ? atoi(argv[1]) : 60370;
+  parent = getpid();
+
+  describe(&device, BASE, IMAGE-1, 0x7e57f10e, "Lossy-Memory       ");
+  describe(&storage, IMAGE, IMAGE+LENGTH-1, 0x7e57f10f, "Lossy-Image        ");
+
+  snprintf(address, sizeof(address), "%d", port);
+  if ((status = eb_socket_open(EB_ABI_CODE, address, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+  attach(socket, &device, &echo_read, &echo_write);
+  attach(socket, &storage, &memory_read, &memory_write);
+
+  memset(&relay, 0, sizeof(relay));
+  relay.front = udp_bind(port+1);
+  relay.back  = udp_bind(port+2);
+  relay.server.sin_family = AF_INET;
+  relay.server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  relay.server.sin_port = htons(port);
+  if (pthread_create(&thread, 0, &forward, &relay) != 0) die("pthread_create", EB_FAIL);
+
+  snprintf(address, sizeof(address), "udp/127.0.0.1/%d", port+1);
+  if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &remote)) != EB_OK) die("eb_device_open", status);
+  if ((status = eb_device_stats_enable(remote)) != EB_OK) die("eb_device_stats_enable", status);
+
+  /* Clean link: nothing may be lost */
+  seconds = run(socket, remote, &relay, 0, 0);
+  if ((status = eb_device_flow(remote, &flow)) != EB_OK) die("eb_device_flow", status);
+  printf("clean: %5.3fs, window %6lu bytes, rtt %5luus, lost %lu\n", seconds,
+         (unsigned long)flow.window, (unsigned long)flow.rtt_us, (unsigned long)flow.lost);
+  if (failed || timeouts || flow.lost != 0 || flow.inflight != 0) die("clean link", EB_FAIL);
+
+  /* Reordering link: a reply overtaken by one other is late, not lost */
+  relay.swapped = 0;
+  relay.swap_reply = 5;
+  seconds = run(socket, remote, &relay, 0, 0);
+  if ((status = eb_device_flow(remote, &flow)) != EB_OK) die("eb_device_flow", status);
+  printf("swaps: %5.3fs, window %6lu bytes, rtt %5luus, lost %lu (%d replies reordered)\n", seconds,
+         (unsigned long)flow.window, (unsigned long)flow.rtt_us, (unsigned long)flow.lost, relay.swapped);
+  if (failed || timeouts || relay.swapped == 0 || flow.lost != 0 || flow.inflight != 0) die("reordering link", EB_FAIL);
+
+  /* Lossy link: drop requests and replies; the losses must be reported quickly */
+  seconds = run(socket, remote, &relay, 7, 11);
+  if ((status = eb_device_flow(remote, &flow)) != EB_OK) die("eb_device_flow", status);
+  printf("lossy: %5.3fs, window %6lu bytes, rtt %5luus, lost %lu (%d packets dropped)\n", seconds,
+         (unsigned long)flow.window, (unsigned long)flow.rtt_us, (unsigned long)flow.lost, relay.dropped);
+  if (failed || relay.dropped == 0 || timeouts == 0) die("lossy link", EB_FAIL);
+  if (flow.lost != (uint32_t)timeouts || flow.inflight != 0) die("lossy accounting", EB_FAIL);
+  if (seconds > 20*TIMEOUT*1e-6) die("loss recovery waited for the timeouts", EB_TIMEOUT);
+  lost = flow.lost;
+
+  /* Clean again: everything gets through */
+  seconds = run(socket, remote, &relay, 0, 0);
+  if ((status = eb_device_flow(remote, &flow)) != EB_OK) die("eb_device_flow", status);
+  printf("clean: %5.3fs, window %6lu bytes, rtt %5luus, lost %lu\n", seconds,
+         (unsigned long)flow.window, (unsigned long)flow.rtt_us, (unsigned long)flow.lost);
+  if (failed || timeouts || flow.lost != (uint32_t)lost || flow.inflight != 0) die("recovery", EB_FAIL);
+  
+  /* Every cycle was sent and then either answered or lost */
+  if ((status = eb_device_stats(remote, &stats)) != EB_OK) die("eb_device_stats", status);
+  if (stats.cycles != 4*CYCLES || stats.responses + stats.timeouts != 4*CYCLES ||
+      stats.timeouts != (uint64_t)lost || stats.records < stats.cycles)
+    die("statistics", EB_FAIL);
+
+  /* Unanswered cycles hold credit until a read-back returns it */
+  flood(socket, remote);
+
+  /* Nothing gets through: a 20ms cycle fails long before the default timeout */
+  relay.drop_request = 1;
+  gettimeofday(&start, 0);
+  if ((status = eb_cycle_open(remote, 0, &complete, &cycle)) != EB_OK) die("eb_cycle_open", status);
+  eb_cycle_timeout(cycle, 20000);
+  eb_cycle_read(cycle, BASE, EB_DATA32|EB_BIG_ENDIAN, 0);
+  eb_cycle_close(cycle);
+  done = timeouts = 0;
+  ++inflight;
+  while (inflight > 0) eb_socket_run(socket, -1);
+  gettimeofday(&stop, 0);
+  seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec)*1e-6;
+  printf("short: %5.3fs to time out\n", seconds);
+  if (timeouts != 1 || seconds < 0.015 || seconds > 0.5) die("short timeout", EB_TIMEOUT);
+
+  stream(socket, &relay, port);
+  
+  if ((status = eb_device_close(remote)) != EB_OK) die("eb_device_close", status);
+  if ((status = eb_socket_close(socket)) != EB_OK) die("eb_socket_close", status);
+
+  return 0;
+}
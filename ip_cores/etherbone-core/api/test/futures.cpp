@@ -0,0 +1,195 @@
+/** @file futures.cpp
+ *  @brief Test cycles which report through futures and coroutines.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  One thread runs the socket, which talks to itself. Worker threads keep
+ *  several Batch round trips in flight at once and wait on their futures.
+ *  The socket's own thread uses Cycle futures, an aborted Cycle must break
+ *  its future, and with C++20 a coroutine awaits its cycles.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../etherbone.h"
+#include "common.h"
+
+using namespace etherbone;
+
+#define BASE     0x10000
+#define THREADS  8
+#define ROUNDS   200 /* per thread */
+#define INFLIGHT 4   /* batches each thread keeps outstanding */
+
+/* Reads return the address, so every result can be checked */
+class Echo : public Handler {
+  public:
+    status_t read (address_t address, width_t width, data_t* data) { *data = address; return EB_OK; }
+    status_t write(address_t address, width_t width, data_t  data) { return EB_OK; }
+};
+
+static Socket socket;
+static Device device;
+static std::atomic<bool> stop;
+
+static void loop() {
+  while (!stop) socket.run();
+}
+
+static void worker(int id) {
+  eb_queue_t queue = socket.queue();
+  future_t done[INFLIGHT];
+  data_t data[INFLIGHT];
+  address_t address[INFLIGHT];
+  status_t status;
+
+  for (int round = 0; round < ROUNDS; ++round) {
+    /* Put all round trips on the wire before waiting for any */
+    for (int i = 0; i < INFLIGHT; ++i) {
+      Batch batch;
+      address[i] = BASE + 4*((id*ROUNDS + round)*INFLIGHT + i);
+      if ((status = batch.open(queue, device, done[i])) != EB_OK) die("Batch::open", status);
+      batch.read(address[i], EB_DATA32|EB_BIG_ENDIAN, &data[i]);
+      batch.close();
+    }
+    for (int i = 0; i < INFLIGHT; ++i) {
+      if ((status = done[i].get()) != EB_OK) die("batch", status);
+      if (data[i] != address[i]) die("batch verification", EB_FAIL);
+    }
+  }
+}
+
+#ifdef __cpp_impl_coroutine
+/* Just enough of a coroutine type to start one and see it finish */
+struct Task {
+  struct promise_type {
+    Task get_return_object() { return Task(); }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() { }
+    void unhandled_exception() { abort(); }
+  };
+};
+
+static int awaited;
+
+static Task refresh(int reads) {
+  for (int i = 0; i < reads; ++i) {
+    Completion done;
+    Cycle cycle;
+    data_t data;
+    status_t status;
+
+    if ((status = cycle.open(device, done)) != EB_OK) die("Cycle::open", status);
+    cycle.read(BASE + 4*i, EB_DATA32|EB_BIG_ENDIAN, &data);
+    cycle.close();
+
+    if ((status = co_await done) != EB_OK) die("co_await", status);
+    if (data != (data_t)(BASE + 4*i)) die("coroutine verification", EB_FAIL);
+    ++awaited;
+  }
+}
+#endif
+
+int main(int argc, const char** argv) {
+  struct sdb_device sdb;
+  Echo echo;
+  future_t done;
+  data_t data;
+  status_t status;
+  const char* port;
+  char address[64];
+  struct timeval start, stop_time;
+
+  port = argc > 1 ? argv[1] : "60377";
+
+  describe(&sdb, BASE, 0xFFFFFFFFUL, 0xf07f07e5, "Futures-Echo       ");
+
+  if ((status = socket.open(port, EB_ADDR32|EB_DATA32)) != EB_OK) die("Socket::open", status);
+  if ((status = socket.attach(&sdb, &echo)) != EB_OK) die("Socket::attach", status);
+
+  snprintf(address, sizeof(address), "udp/localhost/%s", port);
+  if ((status = device.open(socket, address, EB_ADDR32|EB_DATA32)) != EB_OK) die("Device::open", status);
+
+  /* On the socket's thread: close() returns at once, the future completes inside run() */
+  Cycle cycle;
+  if ((status = cycle.open(device, done)) != EB_OK) die("Cycle::open", status);
+  cycle.read(BASE + 0x40, EB_DATA32|EB_BIG_ENDIAN, &data);
+  if ((status = cycle.close()) != EB_OK) die("Cycle::close", status);
+  while (done.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    socket.run();
+  if ((status = done.get()) != EB_OK) die("cycle", status);
+  if (data != BASE + 0x40) die("cycle verification", EB_FAIL);
+
+  /* An aborted cycle never runs; its future must not wait forever */
+  if ((status = cycle.open(device, done)) != EB_OK) die("Cycle::open", status);
+  cycle.read(BASE, EB_DATA32|EB_BIG_ENDIAN, &data);
+  cycle.abort();
+  try {
+    done.get();
+    die("aborted cycle completed", EB_FAIL);
+  } catch (const std::future_error& e) {
+    if (e.code() != std::future_errc::broken_promise) die("aborted cycle", EB_FAIL);
+  }
+
+#ifdef __cpp_impl_coroutine
+  refresh(16);
+  while (awaited < 16) socket.run();
+  printf("%d reads awaited in a coroutine\n", awaited);
+#endif
+
+  /* Workers overlap their round trips through the socket's thread */
+  std::thread socket_thread(loop);
+  std::vector<std::thread> workers;
+
+  gettimeofday(&start, 0);
+  for (int i = 0; i < THREADS; ++i)
+    workers.push_back(std::thread(worker, i));
+  for (int i = 0; i < THREADS; ++i)
+    workers[i].join();
+  gettimeofday(&stop_time, 0);
+
+  printf("%d reads from %d threads, %d in flight each: %.1fus per read\n",
+    THREADS*ROUNDS*INFLIGHT, THREADS, INFLIGHT,
+    ((stop_time.tv_sec - start.tv_sec)*1e6 + (stop_time.tv_usec - start.tv_usec)) / (THREADS*ROUNDS*INFLIGHT));
+
+  /* One more batch wakes the loop to see the flag; this thread finishes it */
+  stop = true;
+  Batch batch;
+  if ((status = batch.open(socket.queue(), device, done)) != EB_OK) die("Batch::open", status);
+  batch.close();
+  socket_thread.join();
+  while (done.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    socket.run();
+  if ((status = done.get()) != EB_OK) die("batch", status);
+
+  if ((status = device.close()) != EB_OK) die("Device::close", status);
+  if ((status = socket.close()) != EB_OK) die("Socket::close", status);
+
+  return 0;
+}
@@ -0,0 +1,217 @@
+/** @file handler.c
+ *  @brief Attach, find and detach software slaves.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  Attaches 400 devices in scrambled order and checks that every address
+ *  finds its own handler, that gaps find none, and that detach keeps the
+ *  index in step. An attach which leaves no room for the SDB window must
+ *  leave the list as it was. Finally, times a lookup among 400 handlers.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "../memory/memory.h"
+#include "../glue/socket.h"
+#include "../glue/handler.h"
+#include "common.h"
+
+#define DEVICES 400
+#define BASE    0x100000
+#define STRIDE  0x2000 /* each device covers the first half; the rest is a gap */
+#define LOOKUPS 10000000
+
+static struct sdb_device devices[DEVICES];
+
+static double now(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+static eb_handler_index_t index_of(eb_socket_t socket) {
+  return EB_SOCKET(socket)->handlers;
+}
+
+/* The device whose handler serves address, or 0 */
+static const struct sdb_device* find(eb_socket_t socket, eb_address_t address) {
+  eb_handler_address_t handler;
+
+  handler = eb_handler_find(index_of(socket), address);
+  return handler == EB_NULL ? 0 : EB_HANDLER_ADDRESS(handler)->device;
+}
+
+static void expect(eb_socket_t socket, eb_address_t address, const struct sdb_device* device) {
+  const struct sdb_device* got;
+
+  if ((got = find(socket, address)) != device) {
+    fprintf(stderr, "address %"EB_ADDR_FMT": found device %d, expected %d\n", address,
+            got    ? (int)(got    - &devices[0]) : -1,
+            device ? (int)(device - &devices[0]) : -1);
+    exit(1);
+  }
+}
+
+/* Every present device is found at both ends; gaps and detached devices are not */
+static void check(eb_socket_t socket, const int* present) {
+  eb_address_t first;
+  int k;
+
+  expect(socket, 0, 0);
+  expect(socket, BASE - 1, 0);
+
+  for (k = 0; k < DEVICES; ++k) {
+    first = BASE + (eb_address_t)k*STRIDE;
+    expect(socket, first,              present[k] ? &devices[k] : 0);
+    expect(socket, first + STRIDE/2-1, present[k] ? &devices[k] : 0);
+    expect(socket, first + STRIDE/2,   0);
+  }
+
+  expect(socket, BASE + (eb_address_t)DEVICES*STRIDE, 0);
+}
+
+static void scaling(eb_socket_t socket) {
+  eb_handler_index_t index;
+  eb_address_t address;
+  double start, seconds;
+  unsigned long hits;
+  int i, k;
+
+  index = index_of(socket);
+  hits = 0;
+  k = 0;
+
+  start = now();
+  for (i = 0; i < LOOKUPS; ++i) {
+    /* Hop between devices, so the last-hit shortcut rarely helps */
+    k = (k + 157) % DEVICES;
+    address = BASE + (eb_address_t)k*STRIDE + (i & 0xFFF);
+    hits += eb_handler_find(index, address) != EB_NULL;
+  }
+  seconds = now() - start;
+
+  if (hits != LOOKUPS) die("lookup", EB_FAIL);
+  printf("%d handlers: %.1f ns per lookup (%s)\n", DEVICES, seconds*1e9/LOOKUPS,
+         EB_HANDLER_INDEX(index)->span ? "binary search" : "list walk");
+}
+
+/* An attach with no room left for the SDB window must not stay linked */
+static void no_room(void) {
+  struct sdb_device low, high, fits;
+  struct eb_handler handler;
+  eb_socket_t socket;
+  eb_status_t status;
+
+  if ((status = eb_socket_open(EB_ABI_CODE, 0, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+
+  /* The gaps below and above are each smaller than SDB_REQUIRED_SIZE */
+  describe(&low,  0,      0xFFF,                      0x10000001, "Handler-Low        ");
+  describe(&high, 0x8000, ~(eb_address_t)0 - 0xFFFF, 0x10000002, "Handler-High       ");
+  describe(&fits, 0x8000, 0xFFFF,                     0x10000003, "Handler-Fits       ");
+
+  attach(socket, &low, &echo_read, &echo_write);
+
+  handler.device = &high;
+  handler.data = 0;
+  handler.read = &echo_read;
+  handler.write = &echo_write;
+  if ((status = eb_socket_attach(socket, &handler)) != EB_ADDRESS) die("attach without room for SDB", EB_FAIL);
+
+  if (EB_HANDLER_INDEX(index_of(socket))->count != 1) die("count after failed attach", EB_FAIL);
+  if (find(socket, 0x800) != &low) die("low after failed attach", EB_FAIL);
+  if (find(socket, 0x10000) != 0) die("high after failed attach", EB_FAIL);
+
+  attach(socket, &fits, &echo_read, &echo_write);
+  if (find(socket, 0x8000) != &fits) die("attach after failed attach", EB_FAIL);
+
+  if ((status = eb_socket_detach(socket, &high)) != EB_ADDRESS) die("detach of the failed device", EB_FAIL);
+  if ((status = eb_socket_detach(socket, &low))  != EB_OK) die("eb_socket_detach", status);
+  if ((status = eb_socket_detach(socket, &fits)) != EB_OK) die("eb_socket_detach", status);
+  if ((status = eb_socket_close(socket)) != EB_OK) die("eb_socket_close", status);
+}
+
+int main(int argc, const char** argv) {
+  struct eb_handler handler;
+  struct sdb_device overlap;
+  eb_socket_t socket;
+  eb_status_t status;
+  int present[DEVICES];
+  int i, k;
+
+  if ((status = eb_socket_open(EB_ABI_CODE, 0, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+
+  /* Nothing is found before the first attach */
+  expect(socket, BASE, 0);
+
+  for (k = 0; k < DEVICES; ++k) {
+    describe(&devices[k], BASE + (eb_address_t)k*STRIDE, BASE + (eb_address_t)k*STRIDE + STRIDE/2 - 1, 0x10000000 + k, "Handler-Test       ");
+    present[k] = 0;
+  }
+
+  /* Scrambled, so attach must insert in the middle of the list */
+  for (i = 0; i < DEVICES; ++i) {
+    k = (i * 263) % DEVICES;
+    attach(socket, &devices[k], &echo_read, &echo_write);
+    present[k] = 1;
+  }
+  check(socket, present);
+
+  /* Overlaps are refused and change nothing */
+  describe(&overlap, BASE + STRIDE/2 - 4, BASE + STRIDE/2 + 3, 0x1000ffff, "Handler-Overlap    ");
+  handler.device = &overlap;
+  handler.data = 0;
+  handler.read = &echo_read;
+  handler.write = &echo_write;
+  if ((status = eb_socket_attach(socket, &handler)) != EB_ADDRESS) die("overlapping attach", EB_FAIL);
+  check(socket, present);
+
+  scaling(socket);
+
+  /* Detach every third device, then put them back */
+  for (k = 0; k < DEVICES; k += 3) {
+    if ((status = eb_socket_detach(socket, &devices[k])) != EB_OK) die("eb_socket_detach", status);
+    present[k] = 0;
+  }
+  check(socket, present);
+  if ((status = eb_socket_detach(socket, &devices[0])) != EB_ADDRESS) die("second detach", EB_FAIL);
+
+  for (k = 0; k < DEVICES; k += 3) {
+    attach(socket, &devices[k], &echo_read, &echo_write);
+    present[k] = 1;
+  }
+  check(socket, present);
+
+  for (k = 0; k < DEVICES; ++k) {
+    if ((status = eb_socket_detach(socket, &devices[k])) != EB_OK) die("eb_socket_detach", status);
+    present[k] = 0;
+  }
+  check(socket, present);
+
+  if ((status = eb_socket_close(socket)) != EB_OK) die("eb_socket_close", status);
+
+  no_room();
+
+  printf("attach, find and detach: ok\n");
+  return 0;
+}
@@ -0,0 +1,147 @@
+/** @file idle.c
+ *  @brief Measure the cost of idle connections on a busy socket.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  One device runs blocking reads while more and more idle TCP devices
+ *  stay connected to the same socket. Round-trip latency, CPU time per
+ *  read and wakeups per second are measured with 1, 64 and 1024 idle
+ *  devices, for both eb_socket_run backends. With epoll they should not
+ *  depend on the number of idle devices. select() cannot watch
+ *  descriptors past FD_SETSIZE, so its largest step is skipped.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/resource.h>
+
+#include "../etherbone.h"
+#include "common.h"
+
+#define READS   2000 /* per measurement */
+#define DEVICES 1024 /* idle devices, at most */
+#define BASE    0x10000
+
+static const int steps[] = { 0, 1, 64, DEVICES };
+static eb_device_t idle[DEVICES];
+
+static double cpu_seconds(void) {
+  struct rusage usage;
+  
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + 
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec)*1e-6;
+}
+
+/* Measure one eb_socket_run backend with up to 'devices' idle devices */
+static void measure(const char* backend, const char* port, int devices) {
+  struct sdb_device device;
+  struct eb_socket_stats before, after;
+  struct timeval start, stop;
+  eb_socket_t socket;
+  eb_device_t busy;
+  eb_status_t status;
+  eb_data_t data;
+  char address[64];
+  double seconds, cpu;
+  int open, step, i, j;
+  
+  /* Read when the socket first runs */
+  setenv("EB_SOCKET_RUN", backend, 1);
+  
+  describe(&device, BASE, 0xFFFFFFFFUL, 0x7e5714e1, "Idle-Memory        ");
+  
+  
+  if ((status = eb_socket_open(EB_ABI_CODE, port, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+  attach(socket, &device, &echo_read, &echo_write);
+  if ((status = eb_socket_stats_enable(socket)) != EB_OK) die("eb_socket_stats_enable", status);
+  
+  snprintf(address, sizeof(address), "tcp/localhost/%s", port);
+  if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &busy)) != EB_OK) die("eb_device_open", status);
+  
+  open = 0;
+  for (j = 0; j < (int)(sizeof(steps)/sizeof(steps[0])); ++j) {
+    step = steps[j];
+    if (step > devices) {
+      printf("%-7s %12d   (descriptor limit)\n", backend, step);
+      continue;
+    }
+    
+    /* Each idle device holds two descriptors: its own and the accepted one */
+    if (strcmp(backend, "select") == 0 && 2*step + 64 > FD_SETSIZE) {
+      printf("%-7s %12d   (beyond FD_SETSIZE)\n", backend, step);
+      continue;
+    }
+    
+    for (; open < step; ++open)
+      if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &idle[open])) != EB_OK) die("eb_device_open", status);
+    
+    eb_socket_stats(socket, &before);
+    cpu = cpu_seconds();
+    gettimeofday(&start, 0);
+    for (i = 0; i < READS; ++i) {
+      if ((status = eb_device_read(busy, BASE + 4*i, EB_DATA32|EB_BIG_ENDIAN, &data, 0, eb_block)) != EB_OK) die("eb_device_read", status);
+      if (data != BASE + 4*i) die("verification", EB_FAIL);
+    }
+    gettimeofday(&stop, 0);
+    cpu = cpu_seconds() - cpu;
+    eb_socket_stats(socket, &after);
+    seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec)*1e-6;
+    
+    printf("%-7s %12d %7.1fus %8.1fus %10.0f\n", backend, open, seconds*1e6/READS, cpu*1e6/READS, 
+           (after.wakeups - before.wakeups) / seconds);
+  }
+  
+  for (i = 0; i < open; ++i)
+    if ((status = eb_device_close(idle[i])) != EB_OK) die("eb_device_close", status);
+  if ((status = eb_device_close(busy)) != EB_OK) die("eb_device_close", status);
+  if ((status = eb_socket_close(socket)) != EB_OK) die("eb_socket_close", status);
+}
+
+int main(int argc, const char** argv) {
+  struct rlimit limit;
+  const char* port;
+  char next[16];
+  int devices;
+  
+  port = argc > 1 ? argv[1] : "60371";
+  snprintf(next, sizeof(next), "%d", atoi(port)+1);
+  
+  /* Each idle device holds two descriptors: its own and the accepted one */
+  devices = DEVICES;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < 2*DEVICES + 64) devices = (limit.rlim_cur - 64) / 2;
+  }
+  
+  printf("backend idle devices   latency   cpu/read  wakeups/s\n");
+  measure("epoll", port, devices);
+  measure("select", next, devices);
+  
+  return 0;
+}
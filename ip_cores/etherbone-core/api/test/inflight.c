@@ -0,0 +1,163 @@
+/** @file inflight.c
+ *  @brief Measure the cost of many outstanding read-backs on a busy socket.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  Devices pointed at a port which never answers keep thousands of cycles
+ *  in flight, while one live device runs blocking reads on the same socket.
+ *  Round-trip latency and CPU time per read should not depend on the
+ *  number of outstanding cycles; closing the silent devices must fail
+ *  every one of their cycles with EB_TIMEOUT.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../etherbone.h"
+#include "common.h"
+
+#define READS       2000  /* per measurement */
+#define OUTSTANDING 10000 /* cycles, at most */
+#define SILENT      20    /* devices sharing the outstanding cycles */
+#define BASE        0x10000
+
+static eb_device_t silent[SILENT];
+static int queued, timeouts, failed;
+
+static void stalled(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  --queued;
+  if (status == EB_TIMEOUT)
+    ++timeouts;
+  else
+    ++failed;
+}
+
+static double cpu_seconds(void) {
+  struct rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec)*1e-6;
+}
+
+/* A UDP port which accepts requests and never answers them */
+static int sink_bind(int port) {
+  struct sockaddr_in sin;
+  int fd;
+
+  if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) die("socket", EB_FAIL);
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sin.sin_port = htons(port);
+  if (bind(fd, (struct sockaddr*)&sin, sizeof(sin)) < 0) die("bind", EB_BUSY);
+
+  return fd;
+}
+
+static void measure(eb_device_t busy, int outstanding) {
+  struct timeval start, stop;
+  eb_status_t status;
+  eb_data_t data;
+  double seconds, cpu;
+  int i;
+
+  cpu = cpu_seconds();
+  gettimeofday(&start, 0);
+  for (i = 0; i < READS; ++i) {
+    if ((status = eb_device_read(busy, BASE + 4*i, EB_DATA32|EB_BIG_ENDIAN, &data, 0, eb_block)) != EB_OK) die("eb_device_read", status);
+    if (data != BASE + 4*i) die("verification", EB_FAIL);
+  }
+  gettimeofday(&stop, 0);
+  cpu = cpu_seconds() - cpu;
+  seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec)*1e-6;
+
+  printf("%11d %7.1fus %8.1fus\n", outstanding, seconds*1e6/READS, cpu*1e6/READS);
+}
+
+int main(int argc, const char** argv) {
+  struct sdb_device device;
+  struct timeval start, stop;
+  eb_socket_t socket;
+  eb_device_t busy;
+  eb_cycle_t cycle;
+  eb_status_t status;
+  const char* port;
+  char address[64];
+  int sink, step, i;
+
+  port = argc > 1 ? argv[1] : "60373";
+  sink = sink_bind(atoi(port)+1);
+
+  describe(&device, BASE, 0xFFFFFFFFUL, 0x1f1e5714, "Inflight-Memory    ");
+
+  if ((status = eb_socket_open(EB_ABI_CODE, port, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+  attach(socket, &device, &echo_read, &echo_write);
+
+  snprintf(address, sizeof(address), "udp/localhost/%s", port);
+  if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &busy)) != EB_OK) die("eb_device_open", status);
+
+  /* Widths are given, so opening a silent device needs no answer */
+  snprintf(address, sizeof(address), "udp/localhost/%d", atoi(port)+1);
+  for (i = 0; i < SILENT; ++i)
+    if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 0, &silent[i])) != EB_OK) die("eb_device_open", status);
+
+  printf("outstanding   latency   cpu/read\n");
+  for (step = 0; ; step = step ? step*10 : 10) {
+    if (step > OUTSTANDING) step = OUTSTANDING;
+    for (; queued < step; ++queued) {
+      if ((status = eb_cycle_open(silent[queued % SILENT], 0, &stalled, &cycle)) != EB_OK) die("eb_cycle_open", status);
+      eb_cycle_timeout(cycle, EB_TIMEOUT_MAX);
+      eb_cycle_read(cycle, BASE, EB_DATA32|EB_BIG_ENDIAN, 0);
+      eb_cycle_close(cycle);
+    }
+    eb_socket_run(socket, 0); /* send them */
+
+    measure(busy, queued);
+    if (step == OUTSTANDING) break;
+  }
+
+  gettimeofday(&start, 0);
+  for (i = 0; i < SILENT; ++i)
+    if ((status = eb_device_close(silent[i])) != EB_OK) die("eb_device_close", status);
+  gettimeofday(&stop, 0);
+  printf("closed %d silent devices in %.1fms\n", SILENT,
+    ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec)*1e-6)*1e3);
+
+  if (queued != 0 || failed != 0 || timeouts != OUTSTANDING) {
+    fprintf(stderr, "%d cycles left, %d failed, %d timed out\n", queued, failed, timeouts);
+    return 1;
+  }
+
+  if ((status = eb_device_close(busy)) != EB_OK) die("eb_device_close", status);
+  if ((status = eb_socket_close(socket)) != EB_OK) die("eb_socket_close", status);
+  close(sink);
+
+  return 0;
+}
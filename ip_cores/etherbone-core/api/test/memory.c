@@ -0,0 +1,82 @@
+/** @file memory.c
+ *  @brief Compare the cost of the memory backends.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  Built once per backend by 'make memory-bench', against memory/ directly.
+ *  Reports alloc/free cost, how many objects fit, and the peak RSS.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "../memory/memory.h"
+
+#define LIVE   60000   /* fits every backend */
+#define ROUNDS 100
+#define LIMIT  1000000 /* how far we try to go */
+
+static double now(void) {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+int main(int argc, const char** argv) {
+  static eb_operation_t ops[LIMIT];
+  struct rusage usage;
+  double start, burst, churn;
+  long i, j, fit;
+  
+  /* Burst: fill and empty the pool, as a deep pipeline of cycles does */
+  start = now();
+  for (j = 0; j < ROUNDS; ++j) {
+    for (i = 0; i < LIVE; ++i)
+      if ((ops[i] = eb_new_operation()) == EB_NULL) {
+        fprintf(stderr, "out of memory at %ld objects\n", i);
+        return 1;
+      }
+    for (i = LIVE; i > 0; --i)
+      eb_free_operation(ops[i-1]);
+  }
+  burst = (now() - start) * 1e9 / ((double)ROUNDS * LIVE);
+  
+  /* Churn: a steady state of short-lived objects */
+  start = now();
+  for (i = 0; i < ROUNDS*LIVE; ++i)
+    eb_free_operation(eb_new_operation());
+  churn = (now() - start) * 1e9 / ((double)ROUNDS * LIVE);
+  
+  /* Memory needed to hold LIVE objects */
+  getrusage(RUSAGE_SELF, &usage);
+  
+  /* Capacity: how many live objects before EB_OOM */
+  for (fit = 0; fit < LIMIT; ++fit)
+    if ((ops[fit] = eb_new_operation()) == EB_NULL) break;
+  
+  printf("%-20s burst %6.1f ns  churn %6.1f ns  capacity %8ld%s  peak RSS %6ld kB\n",
+    argc > 1 ? argv[1] : "?", burst, churn, fit, fit == LIMIT ? "+" : " ", usage.ru_maxrss);
+  
+  return 0;
+}
@@ -0,0 +1,241 @@
+/** @file mux.c
+ *  @brief Share one link to a slave between processes through eb-mux.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  A child process serves memory on a port, and tools/eb-mux runs as a
+ *  second child. Several client processes then read through mux/ over UDP
+ *  and TCP at once, each with many cycles in flight, so their read-back
+ *  addresses collide and the daemon must renumber them. Other clients hang
+ *  up with cycles outstanding. Every value is checked, and the daemon must
+ *  still serve afterwards. Unreachable targets must fail the open.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "../etherbone.h"
+#include "common.h"
+
+#define BASE    0x10000
+#define CLIENTS 8    /* reading concurrently, half over UDP and half over TCP */
+#define QUITTERS 4   /* hanging up with cycles in flight */
+#define CYCLES  400  /* cycles per client */
+#define PER     16   /* reads per cycle */
+#define WAVE    32   /* cycles in flight per client */
+#define DAEMON  "tools/eb-mux"
+
+static eb_data_t results[CYCLES][PER];
+static int finished, failed;
+static pid_t parent, slave, daemon_pid;
+static char path[64];
+
+static void my_callback(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  ++finished;
+  if (status != EB_OK) ++failed;
+}
+
+/* Whatever way the test ends, leave no process holding the port */
+static void reap(void) {
+  if (getpid() != parent) return;
+  if (daemon_pid > 0) kill(daemon_pid, SIGKILL);
+  if (slave > 0) kill(slave, SIGKILL);
+  if (daemon_pid > 0) waitpid(daemon_pid, 0, 0);
+  if (slave > 0) waitpid(slave, 0, 0);
+  unlink(path);
+}
+
+/* The slave: serve memory until killed */
+static void serve(const char* port, int ready) {
+  struct sdb_device device;
+  eb_socket_t socket;
+  eb_status_t status;
+
+  describe(&device, BASE, 0xFFFFFFFFUL, 0x3c3c0000, "Mux-Memory         ");
+
+  if ((status = eb_socket_open(EB_ABI_CODE, port, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+  attach(socket, &device, &echo_read, &echo_write);
+
+  if (write(ready, "", 1) != 1) die("write", EB_FAIL);
+  close(ready);
+
+  while (1) eb_socket_run(socket, -1);
+}
+
+static void start_daemon(void) {
+  struct timespec tick;
+  struct stat st;
+  int i;
+
+  if ((daemon_pid = fork()) == 0) {
+    execl(DAEMON, DAEMON, path, (char*)0);
+    perror(DAEMON);
+    _exit(1);
+  }
+
+  /* eb-mux is ready once its socket exists */
+  tick.tv_sec = 0;
+  tick.tv_nsec = 10000000;
+  for (i = 0; i < 500; ++i) {
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) return;
+    nanosleep(&tick, 0);
+  }
+  die("eb-mux did not start", EB_FAIL);
+}
+
+/* Addresses are unique to each client and cycle, so misrouted replies show */
+static eb_address_t address_of(int client, int cycle, int op) {
+  return BASE + 4*(((eb_address_t)client*CYCLES + cycle)*PER + op);
+}
+
+/* A client: read CYCLES cycles with WAVE in flight, or quit half way */
+static void client(const char* target, int id, int quit) {
+  eb_socket_t socket;
+  eb_device_t device;
+  eb_cycle_t cycle;
+  eb_status_t status;
+  int i, j;
+
+  if ((status = eb_socket_open(EB_ABI_CODE, 0, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+  if ((status = eb_device_open(socket, target, EB_ADDR32|EB_DATA32, 3, &device)) != EB_OK) die(target, status);
+
+  memset(results, 0, sizeof(results));
+  finished = failed = 0;
+
+  for (i = 0; i < CYCLES; ++i) {
+    if ((status = eb_cycle_open(device, 0, &my_callback, &cycle)) != EB_OK) die("eb_cycle_open", status);
+    for (j = 0; j < PER; ++j)
+      eb_cycle_read(cycle, address_of(id, i, j), EB_DATA32|EB_BIG_ENDIAN, &results[i][j]);
+    eb_cycle_close(cycle);
+
+    /* Hang up with a full window of cycles still to be answered */
+    if (quit && i == CYCLES/2) {
+      eb_socket_run(socket, 0);
+      _exit(0);
+    }
+
+    while (i+1 - finished >= WAVE) eb_socket_run(socket, -1);
+  }
+  while (finished < CYCLES) eb_socket_run(socket, -1);
+
+  if (failed) die("cycle", EB_FAIL);
+  for (i = 0; i < CYCLES; ++i)
+    for (j = 0; j < PER; ++j)
+      if (results[i][j] != address_of(id, i, j)) die("verification", EB_FAIL);
+
+  if ((status = eb_device_close(device)) != EB_OK) die("eb_device_close", status);
+  if ((status = eb_socket_close(socket)) != EB_OK) die("eb_socket_close", status);
+  exit(0);
+}
+
+/* Run the clients at once and check that every one succeeded */
+static void clients(const char* udp, const char* tcp, int count, int quitters) {
+  pid_t pids[CLIENTS+QUITTERS];
+  int i, wstatus;
+
+  fflush(stdout); /* or every child prints it again */
+  for (i = 0; i < count+quitters; ++i) {
+    if ((pids[i] = fork()) == 0)
+      client(i%2 ? tcp : udp, i, i >= count);
+    if (pids[i] < 0) die("fork", EB_FAIL);
+  }
+
+  for (i = 0; i < count+quitters; ++i) {
+    if (waitpid(pids[i], &wstatus, 0) != pids[i]) die("waitpid", EB_FAIL);
+    if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+      fprintf(stderr, "client %d (%s) failed\n", i, i >= count ? "quitter" : "reader");
+      die("client", EB_FAIL);
+    }
+  }
+}
+
+/* Opening a target the daemon cannot reach must fail, not hang */
+static void unreachable(eb_socket_t socket, const char* target) {
+  eb_device_t device;
+  eb_status_t status;
+  struct timeval start, end;
+
+  gettimeofday(&start, 0);
+  if ((status = eb_device_open(socket, target, EB_ADDR32|EB_DATA32, 3, &device)) == EB_OK) die(target, EB_FAIL);
+  gettimeofday(&end, 0);
+
+  printf("%-28s %s after %.1fs\n", target, eb_status(status),
+         (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec)*1e-6);
+}
+
+int main(int argc, const char** argv) {
+  eb_socket_t socket;
+  const char* port;
+  char udp[64], tcp[64], address[64], byte;
+  int ready[2];
+
+  port = argc > 1 ? argv[1] : "60383";
+
+  parent = getpid();
+  snprintf(path, sizeof(path), "/tmp/eb-mux-test-%d", (int)parent);
+  setenv("EB_MUX_SOCKET", path, 1);
+  atexit(&reap);
+
+  if (pipe(ready) != 0) die("pipe", EB_FAIL);
+  if ((slave = fork()) == 0) {
+    close(ready[0]);
+    serve(port, ready[1]);
+  }
+  close(ready[1]);
+  if (read(ready[0], &byte, 1) != 1) die("slave", EB_FAIL);
+  close(ready[0]);
+
+  start_daemon();
+
+  snprintf(udp, sizeof(udp), "mux/udp/localhost/%s", port);
+  snprintf(tcp, sizeof(tcp), "mux/tcp/localhost/%s", port);
+
+  clients(udp, tcp, CLIENTS, 0);
+  printf("%d clients, %d reads each: ok\n", CLIENTS, CYCLES*PER);
+
+  clients(udp, tcp, CLIENTS, QUITTERS);
+  printf("%d clients beside %d which hung up: ok\n", CLIENTS, QUITTERS);
+
+  if (eb_socket_open(EB_ABI_CODE, 0, EB_ADDR32|EB_DATA32, &socket) != EB_OK) die("eb_socket_open", EB_FAIL);
+
+  /* Nothing listens one port above the slave */
+  snprintf(address, sizeof(address), "mux/tcp/localhost/%d", atoi(port)+1);
+  unreachable(socket, address);
+  snprintf(address, sizeof(address), "mux/udp/localhost/%d", atoi(port)+1);
+  unreachable(socket, address);
+  unreachable(socket, "mux/nowhere/at/all");
+
+  /* ... and the daemon lives on */
+  clients(udp, tcp, 2, 0);
+  printf("after the failures: ok\n");
+
+  eb_socket_close(socket);
+  return 0;
+}
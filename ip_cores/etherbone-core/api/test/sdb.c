@@ -0,0 +1,267 @@
+/** @file sdb.c
+ *  @brief Crawl SDB through a bridge, with and without the cache.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  The socket talks to itself. Its root table lists 64 memories and a
+ *  bridge, whose handler serves a nested table followed by a FIFO: any
+ *  read past the end of the nested table is a read with side effects, and
+ *  fails the test. Compares the time of a lookup without the cache, with a
+ *  cold cache, and with a warm one. Then changes the gateware below the
+ *  bridge and checks that the warm cache notices, and that cache files
+ *  with a bad record count are crawled over rather than trusted.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define EB_NEED_BIGENDIAN_64 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/time.h>
+
+#include "../etherbone.h"
+#include "../format/bigendian.h"
+#include "common.h"
+
+#define DEVICES 64
+#define CHILDREN 8
+#define BASE    0x100000
+#define BRIDGE  0x1000000 /* the nested bus, its table at the start */
+#define ROUNDS  20
+
+#define CHILD_ID 0xc41d0000 /* device_id of child k is CHILD_ID + k */
+
+static uint8_t table[64*(CHILDREN+1)];
+static unsigned long table_reads, fifo_reads;
+
+static double now(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+/* The nested table as the gateware of this date would describe it */
+static void build(uint32_t date, uint32_t id_offset) {
+  struct sdb_interconnect* header;
+  struct sdb_device* child;
+  int k;
+
+  memset(table, 0, sizeof(table));
+
+  header = (struct sdb_interconnect*)&table[0];
+  header->sdb_magic    = htobe32(0x5344422D);
+  header->sdb_records  = htobe16(CHILDREN+1);
+  header->sdb_version  = 1;
+  header->sdb_bus_type = sdb_wishbone;
+  header->sdb_component.addr_first = htobe64(0);
+  header->sdb_component.addr_last  = htobe64(0xFFFFFF);
+  header->sdb_component.product.vendor_id   = htobe64(0x651);
+  header->sdb_component.product.device_id   = htobe32(0xb41d6e00);
+  header->sdb_component.product.date        = htobe32(date);
+  header->sdb_component.product.record_type = sdb_record_interconnect;
+  memcpy(header->sdb_component.product.name, "Nested-Bus         ", sizeof(header->sdb_component.product.name));
+
+  for (k = 0; k < CHILDREN; ++k) {
+    child = (struct sdb_device*)&table[64*(k+1)];
+    child->abi_class = htobe16(1);
+    child->bus_specific = htobe32(EB_DATAX);
+    child->sdb_component.addr_first = htobe64(0x10000 + k*0x1000);
+    child->sdb_component.addr_last  = htobe64(0x10000 + k*0x1000 + 0xFFF);
+    child->sdb_component.product.vendor_id   = htobe64(0x651);
+    child->sdb_component.product.device_id   = htobe32(CHILD_ID + id_offset + k);
+    child->sdb_component.product.date        = htobe32(date);
+    child->sdb_component.product.record_type = sdb_record_device;
+    memcpy(child->sdb_component.product.name, "Nested-Device      ", sizeof(child->sdb_component.product.name));
+  }
+}
+
+static eb_status_t bridge_read(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t* data) {
+  eb_address_t offset;
+  eb_data_t out;
+  int i;
+
+  offset = address - BRIDGE;
+  width &= EB_DATAX;
+
+  /* Past the table sits a FIFO: reading it loses data */
+  if (offset + width > sizeof(table)) {
+    ++fifo_reads;
+    *data = 0;
+    return EB_OK;
+  }
+
+  out = 0;
+  for (i = 0; i < width; ++i)
+    out = (out << 8) | table[offset + i];
+
+  ++table_reads;
+  *data = out;
+  return EB_OK;
+}
+
+/* Remove the cache files, so the next lookup is cold */
+static void clear(const char* dir) {
+  struct dirent* entry;
+  char path[512];
+  DIR* d;
+
+  if ((d = opendir(dir)) == 0) die("opendir", EB_FAIL);
+  while ((entry = readdir(d)) != 0) {
+    if (entry->d_name[0] == '.') continue;
+    snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+    unlink(path);
+  }
+  closedir(d);
+}
+
+/* Change the record count of every cache file; it follows the magic and the 72-byte key */
+static void corrupt(const char* dir, uint32_t value, int add) {
+  struct dirent* entry;
+  char path[512];
+  uint32_t count;
+  FILE* f;
+  DIR* d;
+  int files;
+
+  files = 0;
+  if ((d = opendir(dir)) == 0) die("opendir", EB_FAIL);
+  while ((entry = readdir(d)) != 0) {
+    if (entry->d_name[0] == '.') continue;
+    snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+    if ((f = fopen(path, "r+b")) == 0) die("fopen", EB_FAIL);
+    if (fseek(f, 80, SEEK_SET) != 0 || fread(&count, sizeof(count), 1, f) != 1) die("cache file", EB_FAIL);
+    count = add ? count + value : value;
+    if (fseek(f, 80, SEEK_SET) != 0 || fwrite(&count, sizeof(count), 1, f) != 1) die("cache file", EB_FAIL);
+    fclose(f);
+    ++files;
+  }
+  closedir(d);
+
+  if (files == 0) die("no cache file", EB_FAIL);
+}
+
+/* How many devices match, failing the test on any error */
+static int lookup(eb_device_t device, uint32_t device_id) {
+  struct sdb_device found[4];
+  eb_status_t status;
+  int count;
+
+  count = 4;
+  if ((status = eb_sdb_find_by_identity(device, 0x651, device_id, found, &count)) != EB_OK) die("eb_sdb_find_by_identity", status);
+  if (count > 0 && found[0].sdb_component.addr_first < BRIDGE + 0x10000) die("bridge base not applied", EB_FAIL);
+  return count;
+}
+
+static double measure(eb_device_t device, const char* dir, int cold) {
+  double start, total;
+  int i;
+
+  total = 0;
+  for (i = 0; i < ROUNDS; ++i) {
+    if (cold) clear(dir);
+    start = now();
+    if (lookup(device, CHILD_ID + 3) != 1) die("lookup", EB_FAIL);
+    total += now() - start;
+  }
+
+  return total / ROUNDS * 1e3;
+}
+
+int main(int argc, const char** argv) {
+  struct sdb_device devices[DEVICES];
+  union sdb_record bridge;
+  eb_socket_t socket;
+  eb_device_t device;
+  eb_status_t status;
+  char dir[] = "/tmp/eb-sdb-XXXXXX";
+  char address[64];
+  const char* port;
+  double uncached, cold, warm;
+  unsigned long reads;
+  int k;
+
+  port = argc > 1 ? argv[1] : "60381";
+
+  if ((status = eb_socket_open(EB_ABI_CODE, port, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+
+  for (k = 0; k < DEVICES; ++k) {
+    describe(&devices[k], BASE + k*0x1000, BASE + k*0x1000 + 0xFFF, 0x5db00000 + k, "Root-Memory        ");
+    attach(socket, &devices[k], &echo_read, &echo_write);
+  }
+
+  /* A bridge is described through a union sdb_record */
+  describe(&bridge.device, BRIDGE, BRIDGE + 0xFFFFFF, 0xb41d6e00, "Nested-Bridge      ");
+  bridge.bridge.sdb_child = BRIDGE;
+  bridge.bridge.sdb_component.product.record_type = sdb_record_bridge;
+  attach(socket, &bridge.device, &bridge_read, &echo_write);
+  build(0x20260101, 0);
+
+  snprintf(address, sizeof(address), "udp/localhost/%s", port);
+  if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &device)) != EB_OK) die("eb_device_open", status);
+
+  if (mkdtemp(dir) == 0) die("mkdtemp", EB_FAIL);
+
+  unsetenv("EB_SDB_CACHE");
+  uncached = measure(device, dir, 0);
+  setenv("EB_SDB_CACHE", dir, 1);
+  cold = measure(device, dir, 1);
+  warm = measure(device, dir, 0);
+
+  printf("%d root devices, %d nested: uncached %.3f ms, cold cache %.3f ms, warm cache %.3f ms\n",
+         DEVICES+1, CHILDREN, uncached, cold, warm);
+
+  /* A warm lookup re-reads the nested header, and nothing else below the bridge */
+  reads = table_reads;
+  if (lookup(device, CHILD_ID + 3) != 1) die("warm lookup", EB_FAIL);
+  if (table_reads - reads != 64/4) {
+    fprintf(stderr, "warm lookup read %lu words of the nested table\n", table_reads - reads);
+    die("warm lookup", EB_FAIL);
+  }
+
+  /* New gateware below the bridge: same root, different nested table */
+  build(0x20261017, 0x100);
+  if (lookup(device, CHILD_ID + 3) != 0) die("stale cache after a nested change", EB_FAIL);
+  if (lookup(device, CHILD_ID + 0x100 + 3) != 1) die("lookup after a nested change", EB_FAIL);
+
+  /* A file whose count is absurd, or does not match its length, is crawled over */
+  corrupt(dir, 0xFFFFFFFFU, 0);
+  if (lookup(device, CHILD_ID + 0x100 + 3) != 1) die("lookup past a huge count", EB_FAIL);
+  corrupt(dir, 1, 1);
+  if (lookup(device, CHILD_ID + 0x100 + 3) != 1) die("lookup past a wrong count", EB_FAIL);
+  corrupt(dir, (uint32_t)-1, 1);
+  if (lookup(device, CHILD_ID + 0x100 + 3) != 1) die("lookup past a short count", EB_FAIL);
+
+  if (fifo_reads != 0) {
+    fprintf(stderr, "%lu reads past the nested table\n", fifo_reads);
+    die("speculative read", EB_FAIL);
+  }
+
+  clear(dir);
+  rmdir(dir);
+
+  if ((status = eb_device_close(device)) != EB_OK) die("eb_device_close", status);
+  if ((status = eb_socket_close(socket)) != EB_OK) die("eb_socket_close", status);
+
+  return 0;
+}
@@ -0,0 +1,261 @@
+/** @file serial.c
+ *  @brief Measure the dev/ transport against a slave behind a pseudo-terminal.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  Two ptys are joined by a null-modem relay. A child serves memory
+ *  passively on one of them; the parent opens the other with serial options
+ *  and measures the latency of blocking reads and the throughput of many
+ *  cycles in flight, checking every value. A pty ignores the line rate, so
+ *  this measures what the transport costs rather than the wire.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE /* cfmakeraw */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "../etherbone.h"
+#include "common.h"
+
+#define BASE    0x10000
+#define READS   1000  /* blocking reads per latency measurement */
+#define CYCLES  1000  /* cycles per throughput measurement */
+#define PER     64    /* reads per cycle */
+#define WAVE    16    /* cycles in flight at once */
+
+static eb_data_t results[CYCLES][PER];
+static int finished, failed;
+static pid_t parent, relayer, child;
+
+static void my_callback(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  ++finished;
+  if (status != EB_OK) ++failed;
+}
+
+/* Kill the relay and any server left running when the parent exits */
+static void reap(void) {
+  if (getpid() != parent) return;
+  if (child > 0) { kill(child, SIGKILL); waitpid(child, 0, 0); }
+  if (relayer > 0) { kill(relayer, SIGKILL); waitpid(relayer, 0, 0); }
+  child = relayer = 0;
+}
+
+static double now(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+/* Open a pty in raw mode; returns the master and the name of the slave */
+static int new_pty(const char** name, int* slave) {
+  struct termios ios;
+  int master;
+
+  if ((master = posix_openpt(O_RDWR | O_NOCTTY)) == -1) die("posix_openpt", EB_FAIL);
+  if (grantpt(master) != 0 || unlockpt(master) != 0) die("unlockpt", EB_FAIL);
+  if ((*name = ptsname(master)) == 0) die("ptsname", EB_FAIL);
+  *name = strdup(*name);
+
+  /* Hold the slave open so the master never reads EOF between users */
+  if ((*slave = open(*name, O_RDWR | O_NOCTTY)) == -1) die(*name, EB_FAIL);
+  if (tcgetattr(*slave, &ios) != 0) die("tcgetattr", EB_FAIL);
+  cfmakeraw(&ios);
+  if (tcsetattr(*slave, TCSANOW, &ios) != 0) die("tcsetattr", EB_FAIL);
+
+  return master;
+}
+
+/* Copy everything written on one side to the other, like a null-modem cable */
+static void relay(int a, int b) {
+  struct pollfd pfd[2];
+  char buf[4096];
+  int i, got, put, off;
+
+  pfd[0].fd = a;
+  pfd[1].fd = b;
+  pfd[0].events = pfd[1].events = POLLIN;
+
+  while (poll(pfd, 2, -1) >= 0) {
+    for (i = 0; i < 2; ++i) {
+      if (!(pfd[i].revents & POLLIN)) continue;
+      if ((got = read(pfd[i].fd, buf, sizeof(buf))) <= 0) exit(0);
+      for (off = 0; off < got; off += put)
+        if ((put = write(pfd[1-i].fd, buf+off, got-off)) <= 0) exit(0);
+    }
+  }
+  exit(0);
+}
+
+/* The child: serve memory on the pty until killed */
+static void serve(const char* address, int ready) {
+  struct sdb_device device;
+  eb_socket_t socket;
+  eb_status_t status;
+
+  describe(&device, BASE, 0xFFFFFFFFUL, 0x5e41a15e, "Serial-Memory      ");
+
+  if ((status = eb_socket_open(EB_ABI_CODE, 0, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+  attach(socket, &device, &echo_read, &echo_write);
+  if ((status = eb_socket_passive(socket, address)) != EB_OK) die(address, status);
+
+  if (write(ready, "", 1) != 1) die("write", EB_FAIL);
+  close(ready);
+
+  while (1) eb_socket_run(socket, -1);
+}
+
+static void measure(eb_socket_t socket, const char* address) {
+  eb_device_t device;
+  eb_cycle_t cycle;
+  eb_status_t status;
+  eb_data_t data;
+  double start, latency, rate;
+  int i, j;
+
+  if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &device)) != EB_OK) die(address, status);
+
+  start = now();
+  for (i = 0; i < READS; ++i) {
+    if ((status = eb_device_read(device, BASE + 4*i, EB_DATA32|EB_BIG_ENDIAN, &data, 0, eb_block)) != EB_OK) die("eb_device_read", status);
+    if (data != BASE + 4*i) die("verification", EB_FAIL);
+  }
+  latency = (now() - start)*1e6 / READS;
+
+  memset(results, 0, sizeof(results));
+  finished = failed = 0;
+
+  start = now();
+  for (i = 0; i < CYCLES; ++i) {
+    if ((status = eb_cycle_open(device, 0, &my_callback, &cycle)) != EB_OK) die("eb_cycle_open", status);
+    for (j = 0; j < PER; ++j)
+      eb_cycle_read(cycle, BASE + 4*(i*PER + j), EB_DATA32|EB_BIG_ENDIAN, &results[i][j]);
+    eb_cycle_close(cycle);
+
+    /* Stay within what the ptys buffer */
+    while (i+1 - finished >= WAVE) eb_socket_run(socket, -1);
+  }
+  while (finished < CYCLES) eb_socket_run(socket, -1);
+  rate = CYCLES*PER / (now() - start);
+
+  if (failed) die("cycle", EB_FAIL);
+  for (i = 0; i < CYCLES; ++i)
+    for (j = 0; j < PER; ++j)
+      if (results[i][j] != BASE + 4*(i*PER + j)) die("verification", EB_FAIL);
+
+  printf("%-40s %7.1fus %8.0f reads/s %6.2fMB/s\n", address, latency, rate, rate*4/1e6);
+
+  if ((status = eb_device_close(device)) != EB_OK) die("eb_device_close", status);
+}
+
+/* A passive stream is negotiated once, so each measurement gets a fresh slave */
+static void start(const char* address) {
+  char byte;
+  int ready[2];
+
+  if (pipe(ready) != 0) die("pipe", EB_FAIL);
+  fflush(stdout);
+  if ((child = fork()) == 0) {
+    close(ready[0]);
+    serve(address, ready[1]);
+  }
+  close(ready[1]);
+  if (read(ready[0], &byte, 1) != 1) die("child", EB_FAIL);
+  close(ready[0]);
+}
+
+static void stop(pid_t* pid) {
+  kill(*pid, SIGKILL);
+  waitpid(*pid, 0, 0);
+  *pid = 0;
+}
+
+int main(int argc, const char** argv) {
+  eb_socket_t socket;
+  eb_device_t device;
+  eb_status_t status;
+  const char* name_a;
+  const char* name_b;
+  const char* bad[3];
+  const char* good[3];
+  char slave[64], address[128];
+  int master_a, master_b, slave_a, slave_b, i;
+
+  parent = getpid();
+  atexit(&reap);
+
+  master_a = new_pty(&name_a, &slave_a);
+  master_b = new_pty(&name_b, &slave_b);
+
+  /* The relay must not hold the slaves, or it never sees EOF once we are gone */
+  if ((relayer = fork()) == 0) {
+    close(slave_a);
+    close(slave_b);
+    relay(master_a, master_b);
+  }
+  close(master_a);
+  close(master_b);
+
+  /* The names are /dev/pts/N; the transport wants dev/pts/N */
+  snprintf(slave, sizeof(slave), "dev/%s", name_a + 5);
+
+  if ((status = eb_socket_open(EB_ABI_CODE, 0, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+
+  /* Malformed options must be refused rather than ignored */
+  bad[0] = "?baud=12345";
+  bad[1] = "?frame=9N1";
+  bad[2] = "?speed=115200";
+  for (i = 0; i < 3; ++i) {
+    snprintf(address, sizeof(address), "dev/%s%s", name_b + 5, bad[i]);
+    status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 1, &device);
+    if (status != EB_ADDRESS) die(address, status);
+  }
+
+  good[0] = "";
+  good[1] = "?baud=3000000&frame=8N1";
+  good[2] = "?baud=4000000&flush=0";
+
+  printf("address                                   latency   throughput\n");
+  for (i = 0; i < 3; ++i) {
+    start(slave);
+    snprintf(address, sizeof(address), "dev/%s%s", name_b + 5, good[i]);
+    measure(socket, address);
+    stop(&child);
+  }
+
+  if ((status = eb_socket_close(socket)) != EB_OK) die("eb_socket_close", status);
+
+  stop(&relayer);
+  close(slave_a);
+  close(slave_b);
+
+  return 0;
+}
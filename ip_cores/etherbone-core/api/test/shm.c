@@ -0,0 +1,230 @@
+/** @file shm.c
+ *  @brief Compare the shm/ transport with udp/ between two local processes.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  A child process serves memory on a port; the parent reaches it through
+ *  udp/localhost/<port> and shm/<port>. For both it measures the latency of
+ *  blocking reads and the throughput of many cycles in flight, and checks
+ *  every value. Then it queues batches of cycles too big for one packet
+ *  until the ring has wrapped many times, so flushes carry records over
+ *  into a packet which starts back at the beginning of the ring. Once the
+ *  child is gone, reads through shm/ must fail.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "../etherbone.h"
+#include "../transport/shm.h"
+#include "common.h"
+
+#define BASE    0x10000
+#define READS   2000  /* blocking reads per latency measurement */
+#define CYCLES  2000  /* cycles per throughput measurement */
+#define PER     64    /* reads per cycle */
+#define WAVE    250   /* cycles in flight at once */
+#define BATCH   200   /* cycles in one flush, which spans several packets */
+#define WRAPS   8     /* times the ring wraps in each direction */
+
+static eb_data_t results[CYCLES][PER];
+static int finished, failed;
+static pid_t parent, child;
+
+static void my_callback(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  ++finished;
+  if (status != EB_OK) ++failed;
+}
+
+static double now(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+/* A failed test must not leave the child holding the port */
+static void reap(void) {
+  if (getpid() != parent || child <= 0) return;
+  kill(child, SIGKILL);
+  waitpid(child, 0, 0);
+}
+
+/* The child: serve memory until killed */
+static void serve(const char* port, int ready) {
+  struct sdb_device device;
+  eb_socket_t socket;
+  eb_status_t status;
+
+  describe(&device, BASE, 0xFFFFFFFFUL, 0x5afe5a3e, "Shm-Memory         ");
+
+  if ((status = eb_socket_open(EB_ABI_CODE, port, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+  attach(socket, &device, &echo_read, &echo_write);
+
+  if (write(ready, "", 1) != 1) die("write", EB_FAIL);
+  close(ready);
+
+  while (1) eb_socket_run(socket, -1);
+}
+
+static void measure(eb_socket_t socket, const char* address) {
+  eb_device_t device;
+  eb_cycle_t cycle;
+  eb_status_t status;
+  eb_data_t data;
+  double start, latency, rate;
+  int i, j;
+
+  if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &device)) != EB_OK) die(address, status);
+
+  start = now();
+  for (i = 0; i < READS; ++i) {
+    if ((status = eb_device_read(device, BASE + 4*i, EB_DATA32|EB_BIG_ENDIAN, &data, 0, eb_block)) != EB_OK) die("eb_device_read", status);
+    if (data != BASE + 4*i) die("verification", EB_FAIL);
+  }
+  latency = (now() - start)*1e6 / READS;
+
+  memset(results, 0, sizeof(results));
+  finished = failed = 0;
+
+  start = now();
+  for (i = 0; i < CYCLES; ++i) {
+    if ((status = eb_cycle_open(device, 0, &my_callback, &cycle)) != EB_OK) die("eb_cycle_open", status);
+    for (j = 0; j < PER; ++j)
+      eb_cycle_read(cycle, BASE + 4*(i*PER + j), EB_DATA32|EB_BIG_ENDIAN, &results[i][j]);
+    eb_cycle_close(cycle);
+    
+    /* Stay within the operation table */
+    while (i+1 - finished >= WAVE) eb_socket_run(socket, -1);
+  }
+  while (finished < CYCLES) eb_socket_run(socket, -1);
+  rate = CYCLES*PER / (now() - start);
+
+  if (failed) die("cycle", EB_FAIL);
+  for (i = 0; i < CYCLES; ++i)
+    for (j = 0; j < PER; ++j)
+      if (results[i][j] != BASE + 4*(i*PER + j)) die("verification", EB_FAIL);
+
+  printf("%-24s %7.1fus %8.0f reads/s\n", address, latency, rate);
+
+  if ((status = eb_device_close(device)) != EB_OK) die("eb_device_close", status);
+}
+
+/* Cycle sizes vary, so the wrap falls at a different point in each flush */
+static int reads_in(int batch, int cycle) {
+  return 1 + (cycle*37 + batch*11) % PER;
+}
+
+static void wrap(eb_socket_t socket, const char* address) {
+  eb_device_t device;
+  eb_cycle_t cycle;
+  eb_status_t status;
+  eb_address_t first;
+  unsigned long bytes;
+  double start;
+  int batch, i, j;
+
+  if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &device)) != EB_OK) die(address, status);
+
+  bytes = 0;
+  for (batch = 0; bytes < (unsigned long)WRAPS*EB_SHM_RING; ++batch) {
+    memset(results, 0, sizeof(results));
+    finished = failed = 0;
+
+    for (i = 0; i < BATCH; ++i) {
+      if ((status = eb_cycle_open(device, 0, &my_callback, &cycle)) != EB_OK) die("eb_cycle_open", status);
+      first = BASE + 4*(((eb_address_t)batch*BATCH + i)*PER);
+      for (j = 0; j < reads_in(batch, i); ++j)
+        eb_cycle_read(cycle, first + 4*j, EB_DATA32|EB_BIG_ENDIAN, &results[i][j]);
+      eb_cycle_close(cycle);
+      bytes += 4*(reads_in(batch, i) + 2); /* a record of reads each way, roughly */
+    }
+    /* A request lost at the wrap is never answered */
+    start = now();
+    while (finished < BATCH) {
+      eb_socket_run(socket, 100000);
+      if (now() - start > 10) die("cycles lost across the wrap", EB_TIMEOUT);
+    }
+
+    if (failed) die("cycle across the wrap", EB_FAIL);
+    for (i = 0; i < BATCH; ++i) {
+      first = BASE + 4*(((eb_address_t)batch*BATCH + i)*PER);
+      for (j = 0; j < reads_in(batch, i); ++j)
+        if (results[i][j] != first + 4*j) die("verification across the wrap", EB_FAIL);
+    }
+  }
+
+  printf("%-24s %d flushes of %d cycles: ok\n", address, batch, BATCH);
+
+  if ((status = eb_device_close(device)) != EB_OK) die("eb_device_close", status);
+}
+
+int main(int argc, const char** argv) {
+  eb_socket_t socket;
+  eb_device_t device;
+  eb_status_t status;
+  eb_data_t data;
+  const char* port;
+  char address[64], byte;
+  int ready[2];
+
+  port = argc > 1 ? argv[1] : "60379";
+
+  parent = getpid();
+  atexit(&reap);
+
+  if (pipe(ready) != 0) die("pipe", EB_FAIL);
+  if ((child = fork()) == 0) {
+    close(ready[0]);
+    serve(port, ready[1]);
+  }
+  close(ready[1]);
+  if (read(ready[0], &byte, 1) != 1) die("child", EB_FAIL);
+  close(ready[0]);
+
+  if ((status = eb_socket_open(EB_ABI_CODE, 0, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+
+  printf("address                   latency   throughput\n");
+  snprintf(address, sizeof(address), "udp/localhost/%s", port);
+  measure(socket, address);
+  snprintf(address, sizeof(address), "shm/%s", port);
+  measure(socket, address);
+  wrap(socket, address);
+
+  /* Sending to a process which is gone must neither block nor succeed */
+  if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &device)) != EB_OK) die(address, status);
+  reap();
+  child = 0;
+  status = eb_device_read(device, BASE, EB_DATA32|EB_BIG_ENDIAN, &data, 0, eb_block);
+  if (status == EB_OK) die("read from a dead peer", status);
+  eb_device_close(device);
+
+  if ((status = eb_socket_close(socket)) != EB_OK) die("eb_socket_close", status);
+
+  return 0;
+}
@@ -34,9 +34,13 @@ int main(void) {
   printf("operation        = %lu\n", (unsigned long)sizeof(struct eb_operation));
   printf("cycle            = %lu\n", (unsigned long)sizeof(struct eb_cycle));
   printf("device           = %lu\n", (unsigned long)sizeof(struct eb_device));
+  printf("flow             = %lu\n", (unsigned long)sizeof(struct eb_flow));
+  printf("device_aux       = %lu\n", (unsigned long)sizeof(struct eb_device_aux));
   printf("socket           = %lu\n", (unsigned long)sizeof(struct eb_socket));
   printf("handler_callback = %lu\n", (unsigned long)sizeof(struct eb_handler_callback));
+  printf("handler_block    = %lu\n", (unsigned long)sizeof(struct eb_handler_block));
   printf("handler_address  = %lu\n", (unsigned long)sizeof(struct eb_handler_address));
+  printf("handler_index    = %lu\n", (unsigned long)sizeof(struct eb_handler_index));
   printf("response         = %lu\n", (unsigned long)sizeof(struct eb_response));
   printf("free_item        = %lu\n", (unsigned long)sizeof(struct eb_free_item));
   printf("union            = %lu\n", (unsigned long)sizeof(union eb_memory_item));
@@ -0,0 +1,202 @@
+/** @file threads.c
+ *  @brief Stress cycle submission from many threads.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  1-16 threads hand cycles to one socket through eb_socket_queue.
+ *  The socket talks to itself, so every read and write can be checked.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#define __STDC_FORMAT_MACROS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+
+#include "../etherbone.h"
+#include "common.h"
+
+#define CYCLES   2000 /* per thread */
+#define INFLIGHT 16   /* per thread */
+#define BASE     0x10000
+
+struct worker {
+  pthread_t thread;
+  eb_queue_t queue;
+  eb_device_t device;
+  int id;
+  volatile int inflight;
+};
+
+static volatile int done;
+static volatile int failed;
+
+/* Every cycle writes its index to its own slot; the slave records them */
+static eb_data_t written[16*CYCLES];
+static int writes[16*CYCLES];
+
+static eb_status_t my_read(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t* data) {
+  *data = (address * 0x9E3779B1UL) & 0xFFFFFFFFUL;
+  return EB_OK;
+}
+
+static eb_status_t my_write(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t data) {
+  eb_address_t slot;
+  
+  slot = (address - BASE) >> 4;
+  if (address < BASE || (address & 0xF) != 0 || slot >= 16*CYCLES) {
+    fprintf(stderr, "stray write to %"EB_ADDR_FMT"\n", address);
+    ++failed;
+    return EB_FAIL;
+  }
+  
+  written[slot] = data;
+  ++writes[slot];
+  return EB_OK;
+}
+
+/* Each cycle's write must have reached the slave exactly once, intact */
+static void check_writes(int threads) {
+  int t, i, slot;
+  
+  for (t = 0; t < threads; ++t) {
+    for (i = 0; i < CYCLES; ++i) {
+      slot = t*CYCLES + i;
+      if (writes[slot] != 1 || written[slot] != (eb_data_t)i) {
+        fprintf(stderr, "thread %d: cycle %d wrote %d times, last %"EB_DATA_FMT"\n", t, i, writes[slot], written[slot]);
+        die("verification", EB_FAIL);
+      }
+    }
+  }
+}
+
+static void complete(eb_user_data_t user, eb_device_t device, eb_operation_t op, eb_status_t status) {
+  struct worker* w = (struct worker*)user;
+  
+  /* Runs on the socket's thread; only the counters are shared */
+  if (status != EB_OK) {
+    fprintf(stderr, "thread %d: cycle failed: %s\n", w->id, eb_status(status));
+    __sync_fetch_and_add(&failed, 1);
+  }
+  
+  for (; op != EB_NULL; op = eb_operation_next(op)) {
+    if (!eb_operation_is_read(op)) continue;
+    if (eb_operation_data(op) != ((eb_operation_address(op) * 0x9E3779B1UL) & 0xFFFFFFFFUL)) {
+      fprintf(stderr, "thread %d: bad data at %"EB_ADDR_FMT"\n", w->id, eb_operation_address(op));
+      __sync_fetch_and_add(&failed, 1);
+    }
+  }
+  
+  __sync_fetch_and_sub(&w->inflight, 1);
+  __sync_fetch_and_add(&done, 1);
+}
+
+static void* submit(void* arg) {
+  struct worker* w = (struct worker*)arg;
+  eb_batch_t batch;
+  eb_address_t address;
+  eb_status_t status;
+  int i, j;
+  
+  for (i = 0; i < CYCLES; ++i) {
+    while (__atomic_load_n(&w->inflight, __ATOMIC_ACQUIRE) >= INFLIGHT) sched_yield();
+    __sync_fetch_and_add(&w->inflight, 1);
+  
+    if ((status = eb_batch_open(w->queue, w->device, w, &complete, &batch)) != EB_OK)
+      die("eb_batch_open", status);
+  
+    address = BASE + ((w->id * CYCLES + i) << 4);
+    eb_batch_write(batch, address, EB_DATA32|EB_BIG_ENDIAN, i);
+    for (j = 0; j < 3; ++j)
+      eb_batch_read(batch, address + 4*(j+1), EB_DATA32|EB_BIG_ENDIAN, 0);
+  
+    eb_batch_close(batch);
+  }
+  
+  return 0;
+}
+
+int main(int argc, const char** argv) {
+  struct sdb_device device;
+  struct worker workers[16];
+  struct timeval start, stop;
+  eb_socket_t socket;
+  eb_device_t remote;
+  eb_queue_t queue;
+  eb_status_t status;
+  const char* port;
+  char address[64];
+  double seconds;
+  int threads, i;
+  
+  port = argc > 1 ? argv[1] : "60369";
+  
+  describe(&device, BASE, 0xFFFFFFFFUL, 0x7e57ba7c, "Threaded-Memory    ");
+  
+  
+  if ((status = eb_socket_open(EB_ABI_CODE, port, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+  attach(socket, &device, &my_read, &my_write);
+  
+  snprintf(address, sizeof(address), "udp/localhost/%s", port);
+  if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &remote)) != EB_OK) die("eb_device_open", status);
+  
+  if ((queue = eb_socket_queue(socket)) == 0) {
+    printf("no thread support; skipped\n");
+    return 0;
+  }
+  
+  for (threads = 1; threads <= 16; threads *= 2) {
+    done = 0;
+    memset(writes, 0, sizeof(writes));
+    gettimeofday(&start, 0);
+  
+    for (i = 0; i < threads; ++i) {
+      workers[i].queue = queue;
+      workers[i].device = remote;
+      workers[i].id = i;
+      workers[i].inflight = 0;
+      if (pthread_create(&workers[i].thread, 0, &submit, &workers[i]) != 0) die("pthread_create", EB_FAIL);
+    }
+  
+    while (done < threads*CYCLES && failed == 0)
+      eb_socket_run(socket, 100000);
+  
+    if (failed != 0) die("verification", EB_FAIL);
+  
+    for (i = 0; i < threads; ++i)
+      pthread_join(workers[i].thread, 0);
+  
+    check_writes(threads);
+  
+    gettimeofday(&stop, 0);
+    seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec)*1e-6;
+  
+    printf("%2d threads: %6d cycles in %.3fs = %8.0f cycles/s\n", threads, done, seconds, done/seconds);
+  }
+  
+  if ((status = eb_device_close(remote)) != EB_OK) die("eb_device_close", status);
+  if ((status = eb_socket_close(socket)) != EB_OK) die("eb_socket_close", status);
+  
+  return 0;
+}
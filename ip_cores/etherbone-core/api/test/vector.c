@@ -0,0 +1,175 @@
+/** @file vector.c
+ *  @brief Compare the record payload encoders.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  Built by 'make vector-bench', against format/vector.c directly.
+ *  Checks every implementation against a word-at-a-time loop like the one
+ *  slave.c used, then reports the cost of a full 255-value record.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "../format/bigendian.h"
+#include "../format/vector.h"
+
+#define COUNT  255     /* the most values in a record */
+#define ROUNDS 400000
+
+typedef void (*load_t)(eb_data_t* out, const uint8_t* in, int count);
+typedef void (*store_t)(uint8_t* out, const eb_data_t* in, int count);
+
+struct implementation {
+  const char* name;
+  load_t load;
+  store_t store;
+};
+
+static double now(void) {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+/* What slave.c did before: one switch per value, width known at run-time */
+static volatile int word_alignment = 4;
+
+static eb_data_t word_load(const uint8_t* rptr, int alignment) {
+  switch (alignment) {
+  case 2: return be16toh(*(const uint16_t*)rptr);
+  case 4: return be32toh(*(const uint32_t*)rptr);
+  }
+  return 0;
+}
+
+static void word_store(uint8_t* wptr, eb_data_t val, int alignment) {
+  switch (alignment) {
+  case 2: *(uint16_t*)wptr = htobe16(val); break;
+  case 4: *(uint32_t*)wptr = htobe32(val); break;
+  }
+}
+
+static void word_load32(eb_data_t* out, const uint8_t* in, int count) {
+  int i, alignment;
+  
+  alignment = word_alignment;
+  for (i = 0; i < count; ++i)
+    out[i] = word_load(in + i*alignment, alignment);
+}
+
+static void word_store32(uint8_t* out, const eb_data_t* in, int count) {
+  int i, alignment;
+  
+  alignment = word_alignment;
+  for (i = 0; i < count; ++i)
+    word_store(out + i*alignment, in[i], alignment);
+}
+
+static int check(struct implementation* impl) {
+  static uint8_t wire[COUNT*4+8], back[COUNT*4+8];
+  static eb_data_t values[COUNT+1];
+  int offset, count, i;
+  
+  for (i = 0; i < (int)sizeof(wire); ++i)
+    wire[i] = rand();
+  
+  /* Every length and every misalignment of the packet buffer */
+  for (offset = 0; offset < 4; ++offset) {
+    for (count = 0; count <= COUNT; ++count) {
+      values[count] = 0x5A5A;
+      (*impl->load)(values, wire + offset, count);
+      if (values[count] != 0x5A5A) return 0;
+      
+      for (i = 0; i < count; ++i)
+        if (values[i] != (eb_data_t)(((uint32_t)wire[offset+i*4] << 24) | ((uint32_t)wire[offset+i*4+1] << 16) |
+                                     ((uint32_t)wire[offset+i*4+2] << 8) | wire[offset+i*4+3]))
+          return 0;
+      
+      /* High bits must be dropped on the way out */
+      for (i = 0; i < count; ++i)
+        values[i] |= ~(eb_data_t)0 << 16 << 16;
+      
+      memset(back, 0xA5, sizeof(back));
+      (*impl->store)(back + offset, values, count);
+      if (memcmp(back + offset, wire + offset, count*4) != 0) return 0;
+      if (back[offset + count*4] != 0xA5) return 0;
+    }
+  }
+  
+  return 1;
+}
+
+static void measure(struct implementation* impl) {
+  static uint8_t wire[COUNT*4];
+  static eb_data_t values[COUNT];
+  double start, load, store;
+  int i;
+  
+  for (i = 0; i < (int)sizeof(wire); ++i)
+    wire[i] = i;
+  
+  start = now();
+  for (i = 0; i < ROUNDS; ++i)
+    (*impl->load)(values, wire, COUNT);
+  load = (now() - start) * 1e9 / ROUNDS;
+  
+  start = now();
+  for (i = 0; i < ROUNDS; ++i)
+    (*impl->store)(wire, values, COUNT);
+  store = (now() - start) * 1e9 / ROUNDS;
+  
+  printf("%-10s decode %7.1f ns  encode %7.1f ns  per %d-value record\n", impl->name, load, store, COUNT);
+}
+
+int main(int argc, const char** argv) {
+  struct implementation impls[] = {
+    { "per-word", &word_load32,             &word_store32 },
+    { "scalar",   &eb_vector_load32_scalar, &eb_vector_store32_scalar },
+#ifdef EB_VECTOR_X86
+    { "sse4.1",   &eb_vector_load32_sse4,   &eb_vector_store32_sse4 },
+    { "avx2",     &eb_vector_load32_avx2,   &eb_vector_store32_avx2 },
+#endif
+    { "dispatch", &eb_vector_load32,        &eb_vector_store32 },
+  };
+  int i, n;
+  
+  n = sizeof(impls)/sizeof(impls[0]);
+  printf("dispatch selects %s\n", eb_vector_isa());
+  
+  for (i = 0; i < n; ++i) {
+#ifdef EB_VECTOR_X86
+    if (impls[i].load == &eb_vector_load32_sse4 && !eb_vector_has_sse4()) continue;
+    if (impls[i].load == &eb_vector_load32_avx2 && !eb_vector_has_avx2()) continue;
+#endif
+    if (!check(&impls[i])) {
+      fprintf(stderr, "%s: wrong result\n", impls[i].name);
+      return 1;
+    }
+    if (argc <= 1 || strcmp(argv[1], "-c") != 0)
+      measure(&impls[i]);
+  }
+  
+  return 0;
+}
@@ -0,0 +1,532 @@
+/** @file eb-bench.c
+ *  @brief Measure the performance of the Etherbone stack.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  Unless told to use existing slaves, a child process serves memory on a
+ *  port, like eb-snoop, and the eb-mux beside this program runs as a second
+ *  child so that mux/ is measured too. For every address, the parent measures the latency
+ *  of single reads, the records/s of cycles of several sizes, the MB/s of
+ *  block reads and writes from 4 KiB to 16 MiB, and how records/s scales
+ *  with more devices.
+ *  Results are printed as a table, or as one JSON object per line.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L /* strtoull + getopt */
+#define _ISOC99_SOURCE /* strtoull on old systems */
+
+#include <unistd.h> /* getopt */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "../etherbone.h"
+#include "../glue/version.h"
+#include "../test/common.h"
+
+#define LATENCY_SAMPLES 2000
+#define MAX_DEVICES     64
+#define MAX_ADDRESSES   16
+#define BLOCK_MIN       4096             /* block transfers grow 4x from here */
+#define BLOCK_MAX       (16*1024*1024)   /* ... to here */
+
+struct bench_device {
+  eb_device_t device;
+  int inflight;
+};
+
+static const char* program;
+static const char* backend;
+static eb_address_t memory_size;
+static uint8_t* memory;
+static double duration;
+static int window, max_devices, json, quiet;
+static unsigned long records_done, cycles_failed;
+static double samples[LATENCY_SAMPLES];
+
+static void help(void) {
+  fprintf(stderr, "Usage: %s [OPTION] [proto/host/port ...]\n", program);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "With no addresses, a child serves memory on the port and the parent\n");
+  fprintf(stderr, "benchmarks it through every local transport; mux/ needs the eb-mux\n");
+  fprintf(stderr, "installed beside this program.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -p <port>      port of the built-in slave               (60393)\n");
+  fprintf(stderr, "  -x             the addresses are existing slaves (eb-snoop <port> 0-<size-1>)\n");
+  fprintf(stderr, "  -m <size>      bytes of memory at address 0         (16777216)\n");
+  fprintf(stderr, "  -t <seconds>   duration of each throughput measurement (0.5)\n");
+  fprintf(stderr, "  -w <cycles>    cycles kept in flight per device          (16)\n");
+  fprintf(stderr, "  -D <devices>   most devices in the scaling measurement    (8)\n");
+  fprintf(stderr, "  -b <name>      label the results with this backend name\n");
+  fprintf(stderr, "  -j             print one JSON object per result\n");
+  fprintf(stderr, "  -q             quiet: do not display warnings\n");
+  fprintf(stderr, "  -h             display this help and exit\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Report Etherbone bugs to <etherbone-core@ohwr.org>\n");
+  fprintf(stderr, "Version %"PRIx32" (%s). Licensed under the LGPL v3.\n", EB_VERSION_SHORT, EB_DATE_FULL);
+}
+
+static double now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static eb_status_t my_read(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t* data) {
+  eb_data_t out;
+  int i;
+
+  out = 0;
+  width &= EB_DATAX;
+  for (i = 0; i < width; ++i)
+    out = (out << 8) | memory[(address + i) % memory_size];
+
+  *data = out;
+  return EB_OK;
+}
+
+static eb_status_t my_write(eb_user_data_t user, eb_address_t address, eb_width_t width, eb_data_t data) {
+  int i;
+
+  width &= EB_DATAX;
+  for (i = width-1; i >= 0; --i) {
+    memory[(address + i) % memory_size] = data;
+    data >>= 8;
+  }
+
+  return EB_OK;
+}
+
+/* Run the eb-mux found beside this program on a private socket.
+ * Returns its pid, or 0 if it did not come up.
+ */
+static pid_t start_mux(const char* path) {
+  struct timespec tick;
+  struct stat st;
+  char daemon[512];
+  const char* slash;
+  pid_t pid;
+  int i;
+
+  slash = strrchr(program, '/');
+  if (slash)
+    snprintf(daemon, sizeof(daemon), "%.*seb-mux", (int)(slash - program + 1), program);
+  else
+    snprintf(daemon, sizeof(daemon), "eb-mux");
+
+  if ((pid = fork()) == 0) {
+    execlp(daemon, daemon, path, (char*)0);
+    _exit(1);
+  }
+  if (pid < 0) return 0;
+
+  /* eb-mux is ready once its socket exists */
+  tick.tv_sec = 0;
+  tick.tv_nsec = 10000000;
+  for (i = 0; i < 200; ++i) {
+    if (waitpid(pid, 0, WNOHANG) == pid) break;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) return pid;
+    nanosleep(&tick, 0);
+  }
+
+  kill(pid, SIGTERM);
+  waitpid(pid, 0, 0);
+  if (!quiet) fprintf(stderr, "%s: warning: cannot start %s; skipping mux/\n", program, daemon);
+  return 0;
+}
+
+/* The child: serve memory until killed */
+static void serve(const char* port, int ready) {
+  struct sdb_device device;
+  eb_socket_t socket;
+  eb_status_t status;
+
+  if ((memory = calloc(memory_size, 1)) == 0) die("memory", EB_OOM);
+
+  describe(&device, 0, memory_size - 1, 0xc3c5eefa, "Software-Memory    ");
+  device.abi_ver_major = 1;
+  device.sdb_component.product.version = EB_VERSION_SHORT;
+  device.sdb_component.product.date = EB_DATE_SHORT;
+
+  if ((status = eb_socket_open(EB_ABI_CODE, port, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+  attach(socket, &device, &my_read, &my_write);
+
+  if (write(ready, "", 1) != 1) die("write", EB_FAIL);
+  close(ready);
+
+  while (1) eb_socket_run(socket, -1);
+}
+
+static void report_begin(const char* test, const char* address) {
+  if (json)
+    fprintf(stdout, "{\"backend\":\"%s\",\"address\":\"%s\",\"test\":\"%s\"", backend, address, test);
+  else
+    fprintf(stdout, "%-24s %-8s", address, test);
+}
+
+static void report(const char* key, const char* unit, double value) {
+  if (json)
+    fprintf(stdout, ",\"%s\":%.3f", key, value);
+  else
+    fprintf(stdout, " %s=%.1f%s", key, value, unit);
+}
+
+static void report_end(void) {
+  fprintf(stdout, json ? "}\n" : "\n");
+  fflush(stdout);
+}
+
+static int compare(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+static void done(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  struct bench_device* device = (struct bench_device*)user;
+
+  --device->inflight;
+  if (status != EB_OK) {
+    ++cycles_failed;
+    return;
+  }
+
+  for (; op != EB_NULL; op = eb_operation_next(op))
+    ++records_done;
+}
+
+static void latency(eb_device_t device, const char* address) {
+  eb_status_t status;
+  eb_data_t data;
+  double start, sum;
+  int i;
+
+  sum = 0;
+  for (i = 0; i < LATENCY_SAMPLES; ++i) {
+    start = now();
+    if ((status = eb_device_read(device, (4*i) % memory_size, EB_DATA32|EB_BIG_ENDIAN, &data, 0, eb_block)) != EB_OK) die("eb_device_read", status);
+    samples[i] = (now() - start)*1e6;
+    sum += samples[i];
+  }
+
+  qsort(samples, LATENCY_SAMPLES, sizeof(double), &compare);
+
+  report_begin("latency", address);
+  report("mean_us", "us", sum / LATENCY_SAMPLES);
+  report("p50_us", "us", samples[LATENCY_SAMPLES/2]);
+  report("p99_us", "us", samples[LATENCY_SAMPLES*99/100]);
+  report_end();
+}
+
+/* Keep window cycles of size reads in flight on each device for the duration */
+static double records(eb_socket_t socket, struct bench_device* devices, int count, int size) {
+  eb_cycle_t cycle;
+  eb_status_t status;
+  eb_address_t address;
+  double start, stop, end;
+  unsigned long cycles;
+  int d, j;
+
+  records_done = 0;
+  cycles_failed = 0;
+  cycles = 0;
+  address = 0;
+
+  start = now();
+  end = start + duration;
+
+  while ((stop = now()) < end) {
+    for (d = 0; d < count; ++d) {
+      while (devices[d].inflight < window) {
+        if ((status = eb_cycle_open(devices[d].device, &devices[d], &done, &cycle)) != EB_OK) die("eb_cycle_open", status);
+        for (j = 0; j < size; ++j) {
+          eb_cycle_read(cycle, address, EB_DATA32|EB_BIG_ENDIAN, 0);
+          address = (address + 4) % memory_size;
+        }
+        eb_cycle_close(cycle);
+        ++devices[d].inflight;
+        ++cycles;
+      }
+    }
+    eb_socket_run(socket, -1);
+  }
+
+  /* Drain without counting the time */
+  for (d = 0; d < count; ++d)
+    while (devices[d].inflight > 0)
+      eb_socket_run(socket, -1);
+
+  if (cycles_failed && !quiet)
+    fprintf(stderr, "%s: %lu of %lu cycles failed\n", program, cycles_failed, cycles);
+
+  return records_done / (stop - start);
+}
+
+static void block_size(eb_device_t device, const char* address, uint8_t* buffer, eb_address_t length) {
+  eb_status_t status;
+  double start, elapsed, write_rate, read_rate;
+  unsigned long bytes;
+  char label[32];
+
+  bytes = 0;
+  start = now();
+  do {
+    if ((status = eb_device_write_block(device, 0, EB_DATA32|EB_BIG_ENDIAN, buffer, length, 0, 0, eb_block)) != EB_OK) die("eb_device_write_block", status);
+    bytes += length;
+  } while ((elapsed = now() - start) < duration);
+  write_rate = bytes / elapsed / 1e6;
+
+  bytes = 0;
+  start = now();
+  do {
+    if ((status = eb_device_read_block(device, 0, EB_DATA32|EB_BIG_ENDIAN, buffer, length, 0, 0, eb_block)) != EB_OK) die("eb_device_read_block", status);
+    bytes += length;
+  } while ((elapsed = now() - start) < duration);
+  read_rate = bytes / elapsed / 1e6;
+
+  snprintf(label, sizeof(label), "block%luk", (unsigned long)(length / 1024));
+  report_begin(label, address);
+  report("bytes", "B", length);
+  report("write_MBps", "MB/s", write_rate);
+  report("read_MBps", "MB/s", read_rate);
+  report_end();
+}
+
+static void block(eb_device_t device, const char* address) {
+  eb_address_t length, largest;
+  uint8_t* buffer;
+
+  /* Sizes beyond the slave's memory would leave the device */
+  largest = memory_size < BLOCK_MAX ? memory_size : BLOCK_MAX;
+  largest &= ~(eb_address_t)3;
+
+  if ((buffer = malloc(largest)) == 0) die("block buffer", EB_OOM);
+  memset(buffer, 0x5A, largest);
+
+  if (largest < BLOCK_MIN) {
+    block_size(device, address, buffer, largest);
+  } else {
+    for (length = BLOCK_MIN; length <= largest; length *= 4)
+      block_size(device, address, buffer, length);
+  }
+
+  free(buffer);
+}
+
+static void measure(eb_socket_t socket, const char* address) {
+  static const int sizes[] = { 1, 8, 64, 255 };
+  struct bench_device devices[MAX_DEVICES];
+  eb_status_t status;
+  char label[32];
+  int i, count;
+
+  for (i = 0; i < MAX_DEVICES; ++i) {
+    devices[i].device = EB_NULL;
+    devices[i].inflight = 0;
+  }
+
+  if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &devices[0].device)) != EB_OK) {
+    if (!quiet) fprintf(stderr, "%s: skipping %s: %s\n", program, address, eb_status(status));
+    return;
+  }
+  latency(devices[0].device, address);
+
+  for (i = 0; i < (int)(sizeof(sizes)/sizeof(sizes[0])); ++i) {
+    snprintf(label, sizeof(label), "cycle%d", sizes[i]);
+    report_begin(label, address);
+    report("records_per_s", "/s", records(socket, devices, 1, sizes[i]));
+    report_end();
+  }
+
+  block(devices[0].device, address);
+
+  /* Scaling: more devices on the same slave, each with its own window */
+  for (count = 1; count <= max_devices; count *= 2) {
+    for (i = 1; i < count; ++i) {
+      if (devices[i].device != EB_NULL) continue;
+      if ((status = eb_device_open(socket, address, EB_ADDR32|EB_DATA32, 3, &devices[i].device)) != EB_OK) die(address, status);
+    }
+
+    snprintf(label, sizeof(label), "devices%d", count);
+    report_begin(label, address);
+    report("records_per_s", "/s", records(socket, devices, count, 64));
+    report_end();
+  }
+
+  for (i = 0; i < MAX_DEVICES; ++i)
+    if (devices[i].device != EB_NULL)
+      eb_device_close(devices[i].device);
+}
+
+int main(int argc, char** argv) {
+  long value;
+  char* value_end;
+  int opt, error, external, with_mux, i, count;
+  const char* port;
+  const char* addresses[MAX_ADDRESSES];
+  char defaults[4][64], mux[64];
+  char byte;
+  int ready[2];
+  pid_t child, mux_child;
+  eb_socket_t socket;
+  eb_status_t status;
+
+  /* Default arguments */
+  program = argv[0];
+  backend = "default";
+  port = "60393";
+  memory_size = BLOCK_MAX;
+  duration = 0.5;
+  window = 16;
+  max_devices = 8;
+  external = 0;
+  json = 0;
+  quiet = 0;
+  error = 0;
+
+  /* Process the command-line arguments */
+  while ((opt = getopt(argc, argv, "p:xm:t:w:D:b:jqh")) != -1) {
+    switch (opt) {
+    case 'p':
+      port = optarg;
+      break;
+    case 'x':
+      external = 1;
+      break;
+    case 'm':
+      memory_size = strtoull(optarg, &value_end, 0);
+      if (*value_end != 0 || memory_size < 4) {
+        fprintf(stderr, "%s: invalid memory size -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 't':
+      duration = strtod(optarg, &value_end);
+      if (*value_end != 0 || duration <= 0) {
+        fprintf(stderr, "%s: invalid duration -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 'w':
+      value = strtol(optarg, &value_end, 0);
+      if (*value_end != 0 || value < 1) {
+        fprintf(stderr, "%s: invalid number of cycles in flight -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      window = value;
+      break;
+    case 'D':
+      value = strtol(optarg, &value_end, 0);
+      if (*value_end != 0 || value < 1 || value > MAX_DEVICES) {
+        fprintf(stderr, "%s: invalid number of devices (1-%d) -- '%s'\n", program, MAX_DEVICES, optarg);
+        error = 1;
+      }
+      max_devices = value;
+      break;
+    case 'b':
+      backend = optarg;
+      break;
+    case 'j':
+      json = 1;
+      break;
+    case 'q':
+      quiet = 1;
+      break;
+    case 'h':
+      help();
+      return 1;
+    case ':':
+    case '?':
+      error = 1;
+      break;
+    default:
+      fprintf(stderr, "%s: bad getopt result\n", program);
+      return 1;
+    }
+  }
+
+  if (error) return 1;
+
+  count = argc - optind;
+  if (count > MAX_ADDRESSES) {
+    fprintf(stderr, "%s: at most %d addresses\n", program, MAX_ADDRESSES);
+    return 1;
+  }
+  if (external && count == 0) {
+    fprintf(stderr, "%s: -x needs the addresses of the slaves\n", program);
+    return 1;
+  }
+
+  with_mux = count == 0;
+  if (count == 0) {
+    snprintf(defaults[0], sizeof(defaults[0]), "udp/localhost/%s", port);
+    snprintf(defaults[1], sizeof(defaults[1]), "tcp/localhost/%s", port);
+    snprintf(defaults[2], sizeof(defaults[2]), "shm/%s", port);
+    snprintf(defaults[3], sizeof(defaults[3]), "mux/udp/localhost/%s", port);
+    for (count = 0; count < 4; ++count)
+      addresses[count] = defaults[count];
+  } else {
+    for (i = 0; i < count; ++i)
+      addresses[i] = argv[optind+i];
+  }
+
+  child = 0;
+  if (!external) {
+    if (pipe(ready) != 0) die("pipe", EB_FAIL);
+    if ((child = fork()) == 0) {
+      close(ready[0]);
+      serve(port, ready[1]);
+    }
+    close(ready[1]);
+    if (read(ready[0], &byte, 1) != 1) die("slave", EB_FAIL);
+    close(ready[0]);
+  }
+
+  mux_child = 0;
+  if (with_mux) {
+    snprintf(mux, sizeof(mux), "/tmp/eb-bench-mux-%d", (int)getpid());
+    setenv("EB_MUX_SOCKET", mux, 1);
+    if ((mux_child = start_mux(mux)) == 0) --count;
+  }
+
+  if ((status = eb_socket_open(EB_ABI_CODE, 0, EB_ADDR32|EB_DATA32, &socket)) != EB_OK) die("eb_socket_open", status);
+
+  for (i = 0; i < count; ++i)
+    measure(socket, addresses[i]);
+
+  eb_socket_close(socket);
+
+  if (child > 0) {
+    kill(child, SIGTERM);
+    waitpid(child, 0, 0);
+  }
+  if (mux_child > 0) {
+    kill(mux_child, SIGTERM);
+    waitpid(mux_child, 0, 0);
+    unlink(mux);
+  }
+
+  return 0;
+}
@@ -1,9 +1,14 @@
 /** @file eb-discover.c
  *  @brief A tool for discovering Etherbone devices on a network.
  *
- *  Copyright (C) 2011-2012 GSI Helmholtz Centre for Heavy Ion Research GmbH 
+ *  Copyright (C) 2011-2012 GSI Helmholtz Centre for Heavy Ion Research GmbH
  *
- *  A complete skeleton of an application using the Etherbone library.
+ *  A probe goes to every address given (usually a broadcast address) and
+ *  the replies are collected for a fixed window. With -s, each responder is
+ *  then inventoried: its SDB tree is read and ECA, TLU and White Rabbit
+ *  cores are picked out. The probe reply already carries the responder's
+ *  bus widths, so no second negotiation is needed, and up to -n responders
+ *  are scanned at once over a single socket.
  *
  *  @author Wesley W. Terpstra <w.terpstra@gsi.de>
  *
@@ -19,23 +24,31 @@
  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
  *  Lesser General Public License for more details.
- *  
+ *
  *  You should have received a copy of the GNU Lesser General Public
  *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
  *******************************************************************************
  */
 
+#define _DEFAULT_SOURCE /* getnameinfo, NI_DGRAM */
+
 #include "../transport/posix-udp.h"
+#include "../glue/widths.h"
+#include "../glue/version.h"
 
 #include <unistd.h> /* getopt */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
 #ifdef __WIN32
 #include <winsock2.h>
 #endif
 
+#define MAX_CORES   16 /* identified cores reported per responder */
+#define MAX_BRIDGES 64 /* nested buses scanned per responder */
+
 static const char* width_str[16] = {
  /*  0 */ "<null>",
  /*  1 */ "8",
@@ -55,6 +68,72 @@ static const char* width_str[16] = {
  /* 15 */ "8/16/32/64"
 };
 
+/* One entry per core kind; the wr-cores SDB records which identify it */
+static const struct core_id {
+  uint64_t vendor_id;
+  uint32_t device_id;
+  const char* kind;
+} core_ids[] = {
+  { 0x651,  0xb2afc251, "eca" }, /* ECA_UNIT:CONTROL */
+  { 0x651,  0x10051981, "tlu" }, /* GSI_TM_LATCH_V2 */
+  { 0x651,  0x7c82afbc, "tlu" }, /* ECA_UNIT:TLU */
+  { 0xce42, 0xff07fc47, "wr"  }, /* WR-Periph-Syscon: one per WR core */
+  { 0, 0, 0 }
+};
+
+struct core {
+  const char* kind;
+  eb_address_t base;
+  char name[20];
+};
+
+struct responder {
+  char address[128]; /* numeric; what the inventory dials */
+  char label[300];   /* as printed */
+  int version;
+  eb_width_t widths;
+
+  /* Inventory */
+  eb_device_t device;
+  int pending;   /* SDB scans outstanding */
+  int bridges;
+  int attempts;
+  int devices;
+  int cores;
+  struct core core[MAX_CORES];
+  eb_status_t status;
+  double start, elapsed;
+};
+
+static const char* program;
+static struct responder* responders;
+static int nresponders, maxresponders;
+static int json, numeric, verbose, quiet;
+
+static void help(void) {
+  fprintf(stderr, "Usage: %s [OPTION] <broadcast-address> [more addresses ...]\n", program);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -t <seconds>   how long to collect replies to the probe     (1)\n");
+  fprintf(stderr, "  -s             read the SDB of every responder and identify cores\n");
+  fprintf(stderr, "  -n <targets>   responders inventoried at once              (64)\n");
+  fprintf(stderr, "  -r <retries>   times to retry an inventory which timed out  (1)\n");
+  fprintf(stderr, "  -N             do not resolve host names\n");
+  fprintf(stderr, "  -j             print one JSON object per responder\n");
+  fprintf(stderr, "  -v             verbose operation\n");
+  fprintf(stderr, "  -q             quiet: do not display warnings\n");
+  fprintf(stderr, "  -h             display this help and exit\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Report Etherbone bugs to <etherbone-core@ohwr.org>\n");
+  fprintf(stderr, "Version %"PRIx32" (%s). Licensed under the LGPL v3.\n", EB_VERSION_SHORT, EB_DATE_FULL);
+}
+
+static double now(void) {
+  struct timeval tv;
+  
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
 struct eb_block_sets {
   int nfd;
   fd_set rfds;
@@ -72,29 +151,260 @@ static int eb_update_sets(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode)
   return 0;
 }
 
-static void check(int sock) {
+/* Print s as a JSON string */
+static void json_string(const char* s, int len) {
+  int i;
+  
+  fputc('"', stdout);
+  for (i = 0; i < len && s[i]; ++i) {
+    if (s[i] == '"' || s[i] == '\\') {
+      fprintf(stdout, "\\%c", s[i]);
+    } else if ((unsigned char)s[i] < 0x20 || (unsigned char)s[i] >= 0x7f) {
+      fprintf(stdout, "\\u%04x", (unsigned char)s[i]);
+    } else {
+      fputc(s[i], stdout);
+    }
+  }
+  fputc('"', stdout);
+}
+
+static void print_responder(struct responder* r, int inventory) {
+  int width, i, len;
+  
+  if (json) {
+    fprintf(stdout, "{\"address\":");
+    json_string(r->label, sizeof(r->label));
+    fprintf(stdout, ",\"version\":%d,\"data\":\"%s\",\"addr\":\"%s\"",
+      r->version, width_str[r->widths & EB_DATAX], width_str[r->widths >> 4]);
+    if (inventory) {
+      fprintf(stdout, ",\"status\":\"%s\",\"ms\":%.1f", eb_status(r->status), r->elapsed*1e3);
+      if (r->status == EB_OK) {
+        fprintf(stdout, ",\"devices\":%d,\"cores\":[", r->devices);
+        for (i = 0; i < r->cores; ++i) {
+          for (len = sizeof(r->core[i].name); len > 0 && r->core[i].name[len-1] == ' '; --len) { }
+          fprintf(stdout, "%s{\"kind\":\"%s\",\"base\":\"0x%"EB_ADDR_FMT"\",\"name\":",
+            i?",":"", r->core[i].kind, r->core[i].base);
+          json_string(r->core[i].name, len);
+          fprintf(stdout, "}");
+        }
+        fprintf(stdout, "]");
+      }
+    }
+    fprintf(stdout, "}\n");
+  } else {
+    width = printf("%s", r->label);
+    if (width < 33)
+      fwrite("                                      ", 1, 33-width, stdout);
+  
+    printf(" V.%d; data=%s-bit addr=%s-bit",
+      r->version, width_str[r->widths & EB_DATAX], width_str[r->widths >> 4]);
+  
+    if (inventory) {
+      if (r->status != EB_OK) {
+        printf("; sdb: %s", eb_status(r->status));
+      } else {
+        printf("; %d devices", r->devices);
+        for (i = 0; i < r->cores; ++i)
+          printf(" %s@0x%"EB_ADDR_FMT, r->core[i].kind, r->core[i].base);
+      }
+    }
+    printf("\n");
+  }
+  
+  fflush(stdout);
+}
+
+static void check(int sock, int inventory) {
   struct sockaddr_storage ss;
+  struct responder* r;
   socklen_t sslen;
   uint8_t buf[8];
-  int width;
-  char host[256], port[256];
+  int family, i;
+  char host[256], port[256], name[256];
   
   sslen = sizeof(ss);
   eb_posix_ip_non_blocking(sock, 1);
   if (recvfrom(sock, (char*)&buf[0], 8, MSG_DONTWAIT, (struct sockaddr*)&ss, &sslen) != 8) return;
   if (buf[0] != 0x4E || buf[1] != 0x6F) return;
   
-  if (getnameinfo((struct sockaddr*)&ss, sslen, host, sizeof(host), port, sizeof(port), NI_DGRAM) != 0) {
+  family = (ss.ss_family==PF_INET6)?6:4;
+  if (getnameinfo((struct sockaddr*)&ss, sslen, host, sizeof(host), port, sizeof(port), NI_DGRAM | NI_NUMERICHOST | NI_NUMERICSERV) != 0) {
     strcpy(host, "unknown");
     strcpy(port, "0");
   }
   
-  width = printf("udp%d/%s/%s", (ss.ss_family==PF_INET6)?6:4, host, port);
-  if (width < 33) 
-    fwrite("                                      ", 1, 33-width, stdout);
+  if (nresponders == maxresponders) {
+    maxresponders = maxresponders ? maxresponders*2 : 64;
+    if ((responders = realloc(responders, maxresponders*sizeof(struct responder))) == 0) {
+      fprintf(stderr, "%s: out of memory\n", program);
+      exit(1);
+    }
+  }
+  
+  r = &responders[nresponders];
+  memset(r, 0, sizeof(*r));
+  snprintf(r->address, sizeof(r->address), "udp%d/%s/%s", family, host, port);
+  
+  /* Several probe addresses can reach the same device */
+  for (i = 0; i < nresponders; ++i)
+    if (!strcmp(responders[i].address, r->address)) return;
+  ++nresponders;
+  
+  if (numeric || getnameinfo((struct sockaddr*)&ss, sslen, name, sizeof(name), 0, 0, NI_DGRAM) != 0)
+    strcpy(name, host);
+  snprintf(r->label, sizeof(r->label), "udp%d/%s/%s", family, name, port);
+  
+  r->version = buf[2] >> 4;
+  r->widths = buf[3];
+  
+  if (!inventory) print_responder(r, 0);
+}
+
+static void identify(struct responder* r, const struct sdb_device* device) {
+  const struct core_id* id;
+  struct core* c;
+  
+  ++r->devices;
+  
+  for (id = &core_ids[0]; id->kind; ++id)
+    if (id->vendor_id == device->sdb_component.product.vendor_id &&
+        id->device_id == device->sdb_component.product.device_id) break;
+  
+  if (!id->kind || r->cores == MAX_CORES) return;
+  
+  c = &r->core[r->cores++];
+  c->kind = id->kind;
+  c->base = device->sdb_component.addr_first;
+  memcpy(c->name, device->sdb_component.product.name, sizeof(c->name)-1);
+  c->name[sizeof(c->name)-1] = 0;
+}
+
+static void found(eb_user_data_t user, eb_device_t dev, const struct sdb_table* sdb, eb_status_t status) {
+  struct responder* r;
+  const union sdb_record* des;
+  int i, records;
+  
+  r = (struct responder*)user;
+  --r->pending;
+  
+  if (status != EB_OK) {
+    r->status = status;
+    return;
+  }
+  
+  records = sdb->interconnect.sdb_records - 1;
+  for (i = 0; i < records; ++i) {
+    des = &sdb->record[i];
+  
+    switch (des->empty.record_type) {
+    case sdb_record_device:
+      identify(r, &des->device);
+      break;
   
-  printf(" V.%d; data=%s-bit addr=%s-bit\n", 
-    buf[2] >> 4, width_str[buf[3] & EB_DATAX], width_str[buf[3] >> 4]);
+    case sdb_record_bridge:
+      /* Nested buses are read at the same time as their siblings */
+      if (r->bridges == MAX_BRIDGES) break;
+      ++r->bridges;
+      ++r->pending;
+      if ((status = eb_sdb_scan_bus(dev, &des->bridge, r, &found)) != EB_OK) {
+        --r->pending;
+        r->status = status;
+      }
+      break;
+  
+    default:
+      break;
+    }
+  }
+}
+
+static void start(eb_socket_t socket, struct responder* r) {
+  eb_status_t status;
+  
+  ++r->attempts;
+  r->start = now();
+  r->status = EB_OK;
+  r->bridges = r->devices = r->cores = 0;
+  r->pending = 1;
+  
+  /* The probe reply was the negotiation; open without another round trip */
+  status = eb_device_open(socket, r->address, eb_width_refine(r->widths & (EB_ADDRX|EB_DATAX)), 0, &r->device);
+  if (status == EB_OK) {
+    status = eb_sdb_scan_root(r->device, r, &found);
+    if (status != EB_OK) {
+      eb_device_close(r->device);
+      r->device = EB_NULL;
+    }
+  }
+  
+  if (status != EB_OK) {
+    r->status = status;
+    r->pending = 0;
+  }
+}
+
+/* Scan every responder, at most concurrency at a time; returns those which failed */
+static int inventory(int concurrency, int retries) {
+  eb_socket_t socket;
+  eb_status_t status;
+  struct responder* r;
+  int next, busy, done, failed, i, j;
+  int* running;
+  
+  if ((status = eb_socket_open(EB_ABI_CODE, 0, EB_ADDRX|EB_DATAX, &socket)) != EB_OK) {
+    fprintf(stderr, "%s: failed to open Etherbone socket: %s\n", program, eb_status(status));
+    exit(1);
+  }
+  
+  if ((running = malloc(concurrency*sizeof(int))) == 0) {
+    fprintf(stderr, "%s: out of memory\n", program);
+    exit(1);
+  }
+  
+  next = busy = done = failed = 0;
+  while (done < nresponders) {
+    while (busy < concurrency && next < nresponders) {
+      running[busy++] = next;
+      start(socket, &responders[next++]);
+    }
+  
+    /* Only wait if a scan is still on the wire */
+    for (i = 0; i < busy; ++i)
+      if (responders[running[i]].pending != 0) break;
+    if (i != busy) eb_socket_run(socket, -1);
+  
+    for (i = 0; i < busy; ++i) {
+      r = &responders[running[i]];
+      if (r->pending != 0) continue;
+  
+      if (r->device != EB_NULL) {
+        eb_device_close(r->device);
+        r->device = EB_NULL;
+      }
+  
+      if (r->status == EB_TIMEOUT && r->attempts <= retries) {
+        if (verbose) fprintf(stderr, "%s: %s timed out; retrying\n", program, r->label);
+        start(socket, r);
+        continue;
+      }
+  
+      r->elapsed = now() - r->start;
+      if (r->status != EB_OK) ++failed;
+      print_responder(r, 1);
+  
+      for (j = i+1; j < busy; ++j) running[j-1] = running[j];
+      --busy;
+      --i;
+      ++done;
+    }
+  }
+  
+  free(running);
+  
+  if ((status = eb_socket_close(socket)) != EB_OK && !quiet)
+    fprintf(stderr, "%s: warning: failed to close Etherbone socket: %s\n", program, eb_status(status));
+  
+  return failed;
 }
 
 int main(int argc, char** argv) {
@@ -105,13 +415,85 @@ int main(int argc, char** argv) {
   struct eb_transport* transport;
   uint8_t discover[8];
   eb_status_t status;
+  double window, deadline, left, started;
+  long value;
+  char* value_end;
+  int opt, error, sdb, concurrency, retries, failed, i;
 #ifdef  __WIN32
   WORD wVersionRequested;
   WSADATA wsaData;
 #endif
   
-  if (argc != 2) {
-    fprintf(stderr, "%s: missing non-optional argument -- <broadcast-address>\n", argv[0]);
+  /* Default command-line arguments */
+  program = argv[0];
+  window = 1;
+  sdb = 0;
+  concurrency = 64;
+  retries = 1;
+  numeric = 0;
+  json = 0;
+  verbose = 0;
+  quiet = 0;
+  error = 0;
+  
+  /* Process the command-line arguments */
+  while ((opt = getopt(argc, argv, "t:sn:r:Njvqh")) != -1) {
+    switch (opt) {
+    case 't':
+      window = strtod(optarg, &value_end);
+      if (*value_end || window <= 0 || window > 3600) {
+        fprintf(stderr, "%s: invalid window -- '%s'\n", program, optarg);
+        return 1;
+      }
+      break;
+    case 's':
+      sdb = 1;
+      break;
+    case 'n':
+      value = strtol(optarg, &value_end, 0);
+      if (*value_end || value < 1 || value > 4096) {
+        fprintf(stderr, "%s: invalid number of targets -- '%s'\n", program, optarg);
+        return 1;
+      }
+      concurrency = value;
+      break;
+    case 'r':
+      value = strtol(optarg, &value_end, 0);
+      if (*value_end || value < 0 || value > 100) {
+        fprintf(stderr, "%s: invalid number of retries -- '%s'\n", program, optarg);
+        return 1;
+      }
+      retries = value;
+      break;
+    case 'N':
+      numeric = 1;
+      break;
+    case 'j':
+      json = 1;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    case 'q':
+      quiet = 1;
+      break;
+    case 'h':
+      help();
+      return 1;
+    case ':':
+    case '?':
+      error = 1;
+      break;
+    default:
+      fprintf(stderr, "%s: bad getopt result\n", program);
+      return 1;
+    }
+  }
+  
+  if (error) return 1;
+  
+  if (optind >= argc) {
+    fprintf(stderr, "%s: missing non-optional argument -- <broadcast-address>\n", program);
     return 1;
   }
   
@@ -130,33 +512,51 @@ int main(int argc, char** argv) {
     return 1;
   }
   
-  if ((status = eb_posix_udp_connect(transport, &udp_link, argv[1], 0)) != EB_OK) {
-    perror("Cannot resolve address");
-    return 1;
-  }
-  
   discover[0] = 0x4E;
   discover[1] = 0x6F;
   discover[2] = 0x11; /* V1 probe */
   discover[3] = 0xFF; /* Any device will do */
   memset(&discover[4], 0, 4);
   
-  /* Send the discovery packet */
-  eb_posix_udp_send(transport, &udp_link, &discover[0], 8);
+  /* Send the discovery packet to each address */
+  started = now();
+  for (i = optind; i < argc; ++i) {
+    if ((status = eb_posix_udp_connect(transport, &udp_link, argv[i], 0)) != EB_OK) {
+      fprintf(stderr, "%s: cannot resolve address -- '%s'\n", program, argv[i]);
+      return 1;
+    }
+    eb_posix_udp_send(transport, &udp_link, &discover[0], 8);
+  }
   
-  while (1) {
+  deadline = started + window;
+  while ((left = deadline - now()) > 0) {
     FD_ZERO(&sets.rfds);
     FD_ZERO(&sets.wfds);
     sets.nfd = 0;
     eb_posix_udp_fdes(transport, 0, &sets, &eb_update_sets);
   
-    tv.tv_sec = 1;
-    tv.tv_usec = 0;
-    
+    tv.tv_sec = (long)left;
+    tv.tv_usec = (long)((left - tv.tv_sec) * 1e6);
+  
     if (select(sets.nfd+1, &sets.rfds, &sets.wfds, 0, &tv) <= 0) break; /* timeout */
-    check(udp_transport.socket4);
-    check(udp_transport.socket6);
+    check(udp_transport.socket4, sdb);
+    check(udp_transport.socket6, sdb);
   }
   
-  return 0;
+  eb_posix_udp_close(transport);
+  
+  if (verbose)
+    fprintf(stderr, "%s: %d responders in %.2fs\n", program, nresponders, now() - started);
+  
+  failed = 0;
+  if (sdb && nresponders > 0) {
+    started = now();
+    failed = inventory(concurrency, retries);
+    if (verbose)
+      fprintf(stderr, "%s: inventoried %d responders (%d failed) in %.3fs, %d at once\n",
+        program, nresponders, failed, now() - started, concurrency);
+  }
+  
+  free(responders);
+  return failed != 0;
 }
@@ -1,9 +1,12 @@
-/** @file eb-download.c
- *  @brief A program which downloads a file from a device.
+/** @file eb-get.c
+ *  @brief A program which downloads a file from one or more devices.
  *
- *  Copyright (C) 2011-2012 GSI Helmholtz Centre for Heavy Ion Research GmbH 
+ *  Copyright (C) 2011-2012 GSI Helmholtz Centre for Heavy Ion Research GmbH
  *
- *  A complete skeleton of an application using the Etherbone library.
+ *  Each output file is mapped into memory and filled with the block transfer
+ *  API, from every target at once in a single event loop. Each target keeps
+ *  its own window of cycles in flight. A chunk which times out is read again
+ *  from the last acknowledged offset.
  *
  *  @author Wesley W. Terpstra <w.terpstra@gsi.de>
  *
@@ -19,7 +22,7 @@
  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
  *  Lesser General Public License for more details.
- *  
+ *
  *  You should have received a copy of the GNU Lesser General Public
  *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
  *******************************************************************************
@@ -33,11 +36,31 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 
 #include "../etherbone.h"
 #include "../glue/version.h"
 
-#define OPERATIONS_PER_CYCLE 32
+#define CHUNK 65536 /* bytes acknowledged at a time */
+
+enum state { QUEUED, READING, DONE, FAILED };
+
+struct target {
+  const char* netaddress;
+  eb_device_t device;
+  eb_format_t format;
+  eb_address_t acked;  /* everything before this offset is in the file */
+  eb_address_t chunk;  /* length of the chunk in flight */
+  eb_address_t limit;  /* of the chunk; shrinks around segfaults when forced */
+  int resumes;
+  enum state state;
+  eb_status_t status;
+  char* filename;
+  uint8_t* image;
+};
 
 static const char* program;
 static eb_width_t address_width, data_width;
@@ -46,143 +69,255 @@ static eb_format_t endian;
 static int verbose, quiet;
 
 static void help(void) {
-  fprintf(stderr, "Usage: %s [OPTION] <proto/host/port> <address>/<len> <firmware>\n", program);
+  fprintf(stderr, "Usage: %s [OPTION] <proto/host/port>... <address>/<len> <firmware>\n", program);
   fprintf(stderr, "\n");
   fprintf(stderr, "  -a <width>     acceptable address bus widths     (8/16/32/64)\n");
   fprintf(stderr, "  -d <width>     acceptable data bus widths        (8/16/32/64)\n");
-  fprintf(stderr, "  -c <cycles>    cycles to pack per packet               (auto)\n");
+  fprintf(stderr, "  -c <cycles>    cycles in flight per target             (auto)\n");
   fprintf(stderr, "  -b             big-endian operation                    (auto)\n");
   fprintf(stderr, "  -l             little-endian operation                 (auto)\n");
   fprintf(stderr, "  -r <retries>   number of times to attempt autonegotiation (3)\n");
-  fprintf(stderr, "  -f             force; ignore remote segfaults\n");
+  fprintf(stderr, "  -n <targets>   targets to read concurrently              (64)\n");
+  fprintf(stderr, "  -R <resumes>   times to resume a target after a timeout   (5)\n");
+  fprintf(stderr, "  -f             force; skip the words which segfault\n");
   fprintf(stderr, "  -p             disable self-describing wishbone device probe\n");
   fprintf(stderr, "  -v             verbose operation\n");
   fprintf(stderr, "  -q             quiet: do not display warnings\n");
   fprintf(stderr, "  -h             display this help and exit\n");
   fprintf(stderr, "\n");
+  fprintf(stderr, "With several targets, each is saved to <firmware>.<n>, counting from 0.\n");
+  fprintf(stderr, "\n");
   fprintf(stderr, "Report Etherbone bugs to <etherbone-core@ohwr.org>\n");
   fprintf(stderr, "Version %"PRIx32" (%s). Licensed under the LGPL v3.\n", EB_VERSION_SHORT, EB_DATE_FULL);
 }
 
-/* Counter for completion */
-static int todo;
-static FILE* firmware_f;
-static const char* firmware;
-
-static void dec_todo(eb_user_data_t data, eb_device_t dev, eb_operation_t op, eb_status_t status) {
-  static eb_address_t lastoff = 0;
-  uint8_t buffer[16];
-  int j;
-  
-  /* Check overall status */
-  if (status != EB_OK) {
-    fprintf(stderr, "\r%s: etherbone cycle error: %s\n", 
-                    program, eb_status(status));
-    exit(1);
+static eb_address_t firmware_length;
+static int window, resumes, force;
+static int active;
+
+static double now(void) {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+static void finish(struct target* target, eb_status_t status) {
+  target->status = status;
+  target->state = status == EB_OK ? DONE : FAILED;
+  --active;
+
+  if (status != EB_OK)
+    fprintf(stderr, "\r%s: %s: failed at offset 0x%"EB_ADDR_FMT": %s\n",
+                    program, target->netaddress, target->acked, eb_status(status));
+}
+
+static void received(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status);
+
+/* Fetch the chunk after the last acknowledged one */
+static void start(struct target* target) {
+  eb_status_t status;
+
+  if (target->acked == firmware_length) {
+    finish(target, EB_OK);
+    return;
   }
-  
-  /* Check operation error lines */
-  for (; op != EB_NULL; op = eb_operation_next(op)) {
-    eb_address_t off = eb_operation_address(op) - address;
-    eb_data_t data = eb_operation_data(op);
-    eb_format_t format = eb_operation_format(op);
-    eb_format_t size = format & EB_DATAX;
-    
-    if (eb_operation_had_error(op)) {
-      fprintf(stderr, "\r%s: wishbone segfault writing %s %s bits to address 0x%"EB_ADDR_FMT".\n",
-        program, 
-        eb_width_data(eb_operation_format(op)),
-        eb_format_endian(eb_operation_format(op)), 
-        eb_operation_address(op));
-      exit(1);
-    }
-    
-    format &= EB_ENDIAN_MASK;
-    if (!format) format = endian;
-    
-    if (format == EB_BIG_ENDIAN) {
-      for (j = size-1; j >= 0; --j) {
-        buffer[j] = data & 0xFF;
-        data >>= 8;
-      }
-    } else {
-      for (j = 0; j < size; ++j) {
-        buffer[j] = data & 0xFF;
-        data >>= 8;
-      }
-    }
-    
-    if (off != lastoff) {
-      fseeko(firmware_f, off, SEEK_SET);
-      lastoff = off;
-    }
-    
-    if (fwrite(&buffer[0], 1, size, firmware_f) != size) {
-      fprintf(stderr, "\r%s: short read from '%s'\n", 
-                      program, firmware);
-      exit(1);
+
+  target->chunk = firmware_length - target->acked;
+  if (target->chunk > target->limit) target->chunk = target->limit;
+  target->state = READING;
+
+  status = eb_device_read_block(target->device, address + target->acked, target->format,
+                                target->image + target->acked, target->chunk, window, target, &received);
+  if (status != EB_OK) finish(target, status);
+}
+
+/* The chunk is done; chunks narrowed around a segfault widen again */
+static void advance(struct target* target) {
+  target->acked += target->chunk;
+  target->limit = target->limit < CHUNK/2 ? 2*target->limit : CHUNK;
+  start(target);
+}
+
+/* Called when a chunk fails; decides whether to read it again */
+static void resume(struct target* target, eb_status_t status) {
+  eb_address_t unit;
+
+  if (status == EB_SEGFAULT && force) {
+    /* Halve the chunk until the faulting word is found; the rest may go in again */
+    unit = (target->format & EB_DATAX) & -(target->format & EB_DATAX);
+    if (target->chunk > unit) {
+      target->limit = (target->chunk / 2) & ~(unit - 1);
+      start(target);
+      return;
     }
-    
-    lastoff += size;
+
+    if (!quiet)
+      fprintf(stderr, "\r%s: warning: %s: skipping segfault at 0x%"EB_ADDR_FMT"\n",
+                      program, target->netaddress, address + target->acked);
+    target->acked += target->chunk;
+    start(target);
+    return;
+  }
+
+  if ((status != EB_TIMEOUT && status != EB_FAIL) || target->resumes == 0) {
+    finish(target, status);
+    return;
+  }
+
+  --target->resumes;
+  if (!quiet)
+    fprintf(stderr, "\r%s: warning: %s: %s, resuming at offset 0x%"EB_ADDR_FMT"\n",
+                    program, target->netaddress, eb_status(status), target->acked);
+  start(target);
+}
+
+static void received(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  struct target* target = (struct target*)user;
+
+  if (status != EB_OK) {
+    resume(target, status);
+    return;
   }
-  
-  --todo;
+
+  advance(target);
 }
 
-static int force;
-static void transfer(eb_device_t device, eb_address_t address, eb_format_t format, int count) {
-  eb_cycle_t cycle;
-  eb_format_t size;
+/* Connect to a target, work out how to read from it, and map its file */
+static int prepare(eb_socket_t socket, struct target* target, int attempts, int probe) {
+  int fd;
   eb_status_t status;
-  int i;
-  
-  size = format & EB_DATAX;
-  
+  eb_width_t line_width;
+  eb_format_t line_widths;
+  eb_format_t device_support;
+  eb_format_t write_sizes;
+  eb_format_t edge, use_endian;
+
   if (verbose)
-    fprintf(stdout, "\rReading 0x%"EB_ADDR_FMT"-", address);
-  
-  if ((status = eb_cycle_open(device, 0, &dec_todo, &cycle)) != EB_OK) {
-    fprintf(stderr, "\r%s: cannot create cycle: %s\n", program, eb_status(status));
-    exit(1);
+    fprintf(stdout, "Connecting to '%s' with %d retry attempts...\n", target->netaddress, attempts);
+
+  if ((status = eb_device_open(socket, target->netaddress, EB_ADDRX|EB_DATAX, attempts, &target->device)) != EB_OK) {
+    fprintf(stderr, "%s: %s: failed to open Etherbone device: %s\n", program, target->netaddress, eb_status(status));
+    return 1;
+  }
+
+  line_width = eb_device_width(target->device);
+  if (verbose)
+    fprintf(stdout, "  negotiated %s-bit address and %s-bit data session.\n",
+                    eb_width_address(line_width), eb_width_data(line_width));
+
+  if (probe) {
+    if (verbose)
+      fprintf(stdout, "Scanning remote bus for Wishbone devices...\n");
+
+    struct sdb_device info;
+    if ((status = eb_sdb_find_by_address(target->device, address, &info)) != EB_OK) {
+      fprintf(stderr, "%s: %s: failed to find SDB record: %s\n", program, target->netaddress, eb_status(status));
+      return 1;
+    }
+
+    if ((info.bus_specific & SDB_WISHBONE_LITTLE_ENDIAN) != 0)
+      device_support = EB_LITTLE_ENDIAN;
+    else
+      device_support = EB_BIG_ENDIAN;
+    device_support |= info.bus_specific & EB_DATAX;
+
+    if (info.sdb_component.addr_last - address < firmware_length-1) {
+      if (!quiet)
+        fprintf(stderr, "%s: warning: %s: firmware end address 0x%"EB_ADDR_FMT" is past device end 0x%"EB_ADDR_FMT".\n",
+                        program, target->netaddress, address+firmware_length-1, (eb_address_t)info.sdb_component.addr_last);
+    }
+  } else {
+    device_support = endian | EB_DATAX;
+  }
+
+  /* Did the user request a bad endian? We use it anyway, but issue warning. */
+  if (endian != 0 && (device_support & EB_ENDIAN_MASK) != endian) {
+    if (!quiet)
+      fprintf(stderr, "%s: warning: %s: target device is %s (reading as %s).\n",
+                      program, target->netaddress, eb_format_endian(device_support), eb_format_endian(endian));
+  }
+
+  /* Select the probed endian. May still be 0 if device not found. */
+  use_endian = endian != 0 ? endian : device_support & EB_ENDIAN_MASK;
+
+  /* We need to know endian if it's not aligned to the line size */
+  if (use_endian == 0) {
+    fprintf(stderr, "%s: error: must know endian to read firmware\n",
+                    program);
+    return 1;
+  }
+
+  /* We need to pick the operation width we use.
+   * It must be supported both by the device and the line.
+   */
+  line_widths = ((line_width & EB_DATAX) << 1) - 1; /* Link can support any access smaller than line_width */
+  write_sizes = line_widths & device_support;
+
+  /* We cannot work with a device that requires larger access than we support */
+  if (write_sizes == 0) {
+    fprintf(stderr, "%s: error: %s: device's %s-bit data port cannot be used via a %s-bit wire format\n",
+                    program, target->netaddress, eb_width_data(device_support), eb_width_data(line_width));
+    return 1;
+  }
+
+  /* The block transfer uses the widest size for the bulk and the smallest at the edges */
+  edge = write_sizes & -write_sizes;
+
+  /* Confirm we can read the requested size faithfully */
+  if ((firmware_length & (edge-1)) != 0) {
+    fprintf(stderr, "%s: error: firmware length 0x%"EB_ADDR_FMT" is not a multiple of the minimum device granularity, %s-bit.\n",
+                    program, firmware_length, eb_width_data(edge));
+    return 1;
+  }
+
+  /* Confirm we can read the requested address faithfully */
+  if ((address & (edge-1)) != 0) {
+    fprintf(stderr, "%s: error: base address 0x%"EB_ADDR_FMT" is not a multiple of the minimum device granularity, %s-bit.\n",
+                    program, address, eb_width_data(edge));
+    return 1;
   }
-  
-  for (i = 0; i < count; ++i) {
-    eb_cycle_read(cycle, address, format, 0);
-    address += size;
+
+  if ((fd = open(target->filename, O_RDWR|O_CREAT|O_TRUNC, 0666)) < 0) {
+    fprintf(stderr, "%s: open, %s -- '%s'\n",
+                    program, strerror(errno), target->filename);
+    return 1;
   }
-  
-  if (verbose) {
-    fprintf(stdout, "0x%"EB_ADDR_FMT"... ", address-1);
-    fflush(stdout);
+
+  if (ftruncate(fd, firmware_length) != 0) {
+    fprintf(stderr, "%s: ftruncate, %s -- '%s'\n",
+                    program, strerror(errno), target->filename);
+    close(fd);
+    return 1;
   }
-  
-  if (force)
-    eb_cycle_close_silently(cycle);
-  else
-    eb_cycle_close(cycle);
-  ++todo;
+
+  if (firmware_length > 0 &&
+      (target->image = mmap(0, firmware_length, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    fprintf(stderr, "%s: mmap, %s -- '%s'\n",
+                    program, strerror(errno), target->filename);
+    target->image = 0;
+    close(fd);
+    return 1;
+  }
+  close(fd);
+
+  target->format = use_endian | write_sizes;
+  return 0;
 }
-  
+
 int main(int argc, char** argv) {
   long value;
   char* value_end;
-  int opt, cycle, error;
-  
+  int opt, error, i, j, failed;
+  double begin, elapsed, last;
+
   eb_socket_t socket;
   eb_status_t status;
-  eb_device_t device;
-  eb_width_t line_width;
-  eb_format_t line_widths;
-  eb_format_t device_support;
-  eb_format_t write_sizes;
-  eb_format_t bulk;
-  eb_format_t edge;
-  eb_address_t end_address, end_bulk, step, pos;
-  
+  struct target* targets;
+  eb_address_t total;
+
   /* Specific command-line options */
-  int attempts, probe, cycles;
-  const char* netaddress;
-  eb_address_t firmware_length;
+  int attempts, probe, concurrent, ntargets;
+  const char* firmware;
 
   /* Default arguments */
   program = argv[0];
@@ -194,11 +329,13 @@ int main(int argc, char** argv) {
   quiet = 0;
   verbose = 0;
   error = 0;
-  cycles = 0;
+  window = 0;
   force = 0;
-  
+  concurrent = 64;
+  resumes = 5;
+
   /* Process the command-line arguments */
-  while ((opt = getopt(argc, argv, "a:d:c:blr:fpvqh")) != -1) {
+  while ((opt = getopt(argc, argv, "a:d:c:blr:n:R:fpvqh")) != -1) {
     switch (opt) {
     case 'a':
       value = eb_width_parse_address(optarg, &address_width);
@@ -220,7 +357,7 @@ int main(int argc, char** argv) {
         fprintf(stderr, "%s: invalid cycle count -- '%s'\n", program, optarg);
         return 1;
       }
-      cycles = value;
+      window = value;
       break;
     case 'b':
       endian = EB_BIG_ENDIAN;
@@ -236,6 +373,22 @@ int main(int argc, char** argv) {
       }
       attempts = value;
       break;
+    case 'n':
+      value = strtol(optarg, &value_end, 0);
+      if (*value_end || value < 1 || value > 10000) {
+        fprintf(stderr, "%s: invalid number of targets -- '%s'\n", program, optarg);
+        return 1;
+      }
+      concurrent = value;
+      break;
+    case 'R':
+      value = strtol(optarg, &value_end, 0);
+      if (*value_end || value < 0 || value > 1000) {
+        fprintf(stderr, "%s: invalid number of resumes -- '%s'\n", program, optarg);
+        return 1;
+      }
+      resumes = value;
+      break;
     case 'f':
       force = 1;
       break;
@@ -260,232 +413,121 @@ int main(int argc, char** argv) {
       return 1;
     }
   }
-  
+
   if (error) return 1;
-  
-  if (optind + 3 != argc) {
-    fprintf(stderr, "%s: expecting three non-optional arguments: <proto/host/port> <address>/<len> <firmware>\n", program);
+
+  if (optind + 3 > argc) {
+    fprintf(stderr, "%s: expecting at least three non-optional arguments: <proto/host/port>... <address>/<len> <firmware>\n", program);
     return 1;
   }
-  
-  netaddress = argv[optind];
-  
-  address = strtoull(argv[optind+1], &value_end, 0);
+
+  ntargets = argc - optind - 2;
+
+  address = strtoull(argv[argc-2], &value_end, 0);
   if (*value_end != '/') {
     fprintf(stderr, "%s: address is not an unsigned value -- '%s'\n",
-                    program, argv[optind+1]);
+                    program, argv[argc-2]);
     return 1;
   }
-  
+
   ++value_end;
   firmware_length = strtoull(value_end, &value_end, 0);
   if (*value_end != 0) {
     fprintf(stderr, "%s: length is not an unsigned value -- '%s'\n",
-                    program, argv[optind+1]);
+                    program, argv[argc-2]);
     return 1;
   }
-  
-  firmware = argv[optind+2];
-  if ((firmware_f = fopen(firmware, "w")) == 0) {
-    fprintf(stderr, "%s: fopen, %s -- '%s'\n",
-                    program, strerror(errno), firmware);
+
+  firmware = argv[argc-1];
+
+  if ((targets = calloc(ntargets, sizeof(struct target))) == 0) {
+    fprintf(stderr, "%s: error: out of memory\n", program);
     return 1;
   }
-  
+
   if (verbose)
-    fprintf(stdout, "Opening socket with %s-bit address and %s-bit data widths\n", 
+    fprintf(stdout, "Opening socket with %s-bit address and %s-bit data widths\n",
                     eb_width_address(address_width), eb_width_data(data_width));
-  
+
   if ((status = eb_socket_open(EB_ABI_CODE, 0, address_width|data_width, &socket)) != EB_OK) {
     fprintf(stderr, "%s: failed to open Etherbone socket: %s\n", program, eb_status(status));
     return 1;
   }
-  
-  if (verbose)
-    fprintf(stdout, "Connecting to '%s' with %d retry attempts...\n", netaddress, attempts);
-  
-  if ((status = eb_device_open(socket, netaddress, EB_ADDRX|EB_DATAX, attempts, &device)) != EB_OK) {
-    fprintf(stderr, "%s: failed to open Etherbone device: %s\n", program, eb_status(status));
-    return 1;
-  }
-  
-  line_width = eb_device_width(device);
-  if (verbose)
-    fprintf(stdout, "  negotiated %s-bit address and %s-bit data session.\n", 
-                    eb_width_address(line_width), eb_width_data(line_width));
-  
-  if (probe) {
-    if (verbose)
-      fprintf(stdout, "Scanning remote bus for Wishbone devices...\n");
-    
-    struct sdb_device info;
-    if ((status = eb_sdb_find_by_address(device, address, &info)) != EB_OK) {
-      fprintf(stderr, "%s: failed to find SDB record: %s\n", program, eb_status(status));
+
+  failed = 0;
+  for (i = 0; i < ntargets; ++i) {
+    targets[i].netaddress = argv[optind+i];
+    targets[i].resumes = resumes;
+    targets[i].limit = CHUNK;
+    targets[i].status = EB_OK;
+    targets[i].state = QUEUED;
+    if ((targets[i].filename = malloc(strlen(firmware) + 16)) == 0) {
+      fprintf(stderr, "%s: error: out of memory\n", program);
       return 1;
     }
-    
-    if ((info.bus_specific & SDB_WISHBONE_LITTLE_ENDIAN) != 0)
-      device_support = EB_LITTLE_ENDIAN;
+    if (ntargets == 1)
+      strcpy(targets[i].filename, firmware);
     else
-      device_support = EB_BIG_ENDIAN;
-    device_support |= info.bus_specific & EB_DATAX;
-    
-    if (info.sdb_component.addr_last - address < firmware_length-1) {
-      if (!quiet)
-        fprintf(stderr, "%s: warning: firmware end address 0x%"EB_ADDR_FMT" is past device end 0x%"EB_ADDR_FMT".\n", 
-                        program, address+firmware_length-1, (eb_address_t)info.sdb_component.addr_last);
-    }
-  } else {
-    device_support = endian | EB_DATAX;
-  }
-  
-  /* Did the user request a bad endian? We use it anyway, but issue warning. */
-  if (endian != 0 && (device_support & EB_ENDIAN_MASK) != endian) {
-    if (!quiet)
-      fprintf(stderr, "%s: warning: target device is %s (writing as %s).\n",
-                      program, eb_format_endian(device_support), eb_format_endian(endian));
-  }
-  
-  if (endian == 0) {
-    /* Select the probed endian. May still be 0 if device not found. */
-    endian = device_support & EB_ENDIAN_MASK;
-  }
-  
-  /* We need to know endian if it's not aligned to the line size */
-  if (endian == 0) {
-    fprintf(stderr, "%s: error: must know endian to program firmware\n",
-                    program);
-    return 1;
-  }
-  
-  /* We need to pick the operation width we use.
-   * It must be supported both by the device and the line.
-   */
-  line_widths = ((line_width & EB_DATAX) << 1) - 1; /* Link can support any access smaller than line_width */
-  write_sizes = line_widths & device_support;
-    
-  /* We cannot work with a device that requires larger access than we support */
-  if (write_sizes == 0) {
-    fprintf(stderr, "%s: error: device's %s-bit data port cannot be used via a %s-bit wire format\n",
-                    program, eb_format_data(device_support), eb_width_data(line_width));
-    return 1;
-  }
-  
-  /* Pick the largest possible write_size for bulk transfer */
-  bulk = write_sizes;
-  bulk |= bulk >> 1;
-  bulk |= bulk >> 2;
-  bulk ^= bulk >> 1;
-  
-  /* Pick the smallest possible write_size for edge transfer */
-  edge = write_sizes & -write_sizes;
-  
-  /* Calculate a reasonable number to pack in a packet */
-  if (cycles == 0) {
-    eb_width_t line_alignment;
-    int cost, status;
-    
-    status = OPERATIONS_PER_CYCLE / ((line_width & EB_DATAX) * 8);
-    if (status == 0) status = 1;
-    
-    /* How many bytes per line alignment? */
-    line_alignment = line_width >> 4 | (line_width & EB_DATAX);
-    line_alignment |= line_alignment >> 1;
-    line_alignment |= line_alignment >> 2;
-    line_alignment ^= line_alignment >> 1;
-    
-    /* Can the writes be compressed? */
-    if (bulk != (line_width & EB_DATAX)) {
-      /* Each needs its own header */
-      cost = OPERATIONS_PER_CYCLE;
-      cost *= 3 * line_alignment;
-      cost += status * 3 * line_alignment;
-    } else {
-      cost = OPERATIONS_PER_CYCLE;
-      cost *= line_alignment;
-      cost += status * 6 * line_alignment;
+      sprintf(targets[i].filename, "%s.%d", firmware, i);
+    if (prepare(socket, &targets[i], attempts, probe) != 0) {
+      targets[i].state = FAILED;
+      ++failed;
     }
-    
-    /* A decent MTU */
-    cycles = 1450 / cost;
-    if (cycles == 0) cycles = 1;
   }
-  
+
   if (verbose)
-    fprintf(stdout, "Reading using batches of %d %s %s-bit words and %s-bit alignment\n",
-                     OPERATIONS_PER_CYCLE*cycles, eb_format_endian(endian), eb_width_data(bulk), eb_width_data(edge));
-  
-  /* Confirm we can write the requested size faithfully */
-  if ((firmware_length & (edge-1)) != 0) {
-    fprintf(stderr, "%s: error: firmware length 0x%"EB_ADDR_FMT" is not a multiple of the minimum device granularity, %s-bit.\n",
-                    program, firmware_length, eb_width_data(edge));
-  }
-  
-  /* Confirm we can write the requested address faithfully */
-  if ((address & (edge-1)) != 0) {
-    fprintf(stderr, "%s: error: base address 0x%"EB_ADDR_FMT" is not a multiple of the minimum device granularity, %s-bit.\n",
-                    program, address, eb_width_data(edge));
-  }
-  
-  /* Start counting cycles */
-  todo = 0;
-  end_address = address + firmware_length;
-  
-  /* Write any edge chunks needed to reach bulk alignment */
-  for (pos = address; (pos & (bulk-1)) != 0; pos += edge)
-    transfer(device, pos, endian | edge, 1);
-  
-  /* Wait for head to be written */
-  while (todo > 0) {
-    eb_socket_run(socket, 0);
-  }
-  
-  /* Begin the bulk transfer */
-  end_bulk = end_address & ~(eb_address_t)(bulk-1);
-  for (cycle = 0; pos < end_bulk; pos += step*bulk) {
-    step = end_bulk - pos;
-    step /= bulk;
-    
-    /* Don't put too many in one cycle */
-    if (step > OPERATIONS_PER_CYCLE) step = OPERATIONS_PER_CYCLE;
-    transfer(device, pos, endian | bulk, step);
-    
-    /* Flush? */
-    if (++cycle == cycles) {
-      cycle = 0;
-      while (todo > 0) {
-        eb_socket_run(socket, 0);
-      }
+    fprintf(stdout, "Reading %lu bytes from %d targets, %d at a time\n",
+                    (unsigned long)firmware_length, ntargets - failed, concurrent);
+
+  /* One event loop drives every target; finished targets make room for queued ones */
+  begin = last = now();
+  active = 0;
+  for (i = j = 0; i < ntargets || active > 0; ) {
+    for (; i < ntargets && active < concurrent; ++i) {
+      if (targets[i].state != QUEUED) continue;
+      ++active;
+      start(&targets[i]);
+    }
+
+    if (active > 0) eb_socket_run(socket, verbose ? 200000 : -1);
+
+    if (verbose && now() - last >= 1.0) {
+      last = now();
+      for (total = 0, j = 0; j < ntargets; ++j) total += targets[j].acked;
+      fprintf(stdout, "\r%lu bytes acknowledged, %.2f MB/s", (unsigned long)total, total / (last - begin) / 1e6);
+      fflush(stdout);
     }
   }
-  
-  /* Write any edge chunks needed to reach bulk final address */
-  for (; pos < end_address; pos += edge)
-    transfer(device, pos, endian | edge, 1);
-  
-  if (verbose) {
-    fprintf(stdout, " done!\n");
-    fprintf(stdout, "Awaiting acknowledgement... ");
-    fflush(stdout);
+  elapsed = now() - begin;
+
+  total = 0;
+  failed = 0;
+  for (i = 0; i < ntargets; ++i) {
+    total += targets[i].acked;
+    if (targets[i].state != DONE) ++failed;
   }
-  
-  /* Wait for tail to be written */
-  while (todo > 0) {
-    eb_socket_run(socket, -1);
+
+  if (verbose || ntargets > 1)
+    fprintf(stdout, "\rRead %d of %d targets: %lu bytes in %.2f s, %.2f MB/s\n",
+                    ntargets - failed, ntargets, (unsigned long)total, elapsed, elapsed > 0 ? total / elapsed / 1e6 : 0.0);
+
+  for (i = 0; i < ntargets; ++i) {
+    if (targets[i].device == EB_NULL) continue;
+    if ((status = eb_device_close(targets[i].device)) != EB_OK) {
+      fprintf(stderr, "%s: failed to close Etherbone device: %s\n", program, eb_status(status));
+      return 1;
+    }
   }
-  
-  if (verbose)
-    fprintf(stdout, " done!\n");
-  
-  if ((status = eb_device_close(device)) != EB_OK) {
-    fprintf(stderr, "%s: failed to close Etherbone device: %s\n", program, eb_status(status));
-    return 1;
+
+  for (i = 0; i < ntargets; ++i) {
+    if (targets[i].image) munmap(targets[i].image, firmware_length);
+    free(targets[i].filename);
   }
-  
+
   if ((status = eb_socket_close(socket)) != EB_OK) {
     fprintf(stderr, "%s: failed to close Etherbone socket: %s\n", program, eb_status(status));
     return 1;
   }
-  
-  return 0;
+
+  return failed ? 1 : 0;
 }
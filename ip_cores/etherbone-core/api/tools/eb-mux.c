@@ -0,0 +1,624 @@
+/** @file eb-mux.c
+ *  @brief A daemon which shares one probed link per target among processes.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  Devices opened as mux/<target> connect to this daemon over a local socket.
+ *  The first client for a target makes the daemon connect and probe it; later
+ *  clients reuse that link, so they pay neither a TCP handshake nor a network
+ *  round-trip for their width probe. Packets are forwarded unchanged, except
+ *  that read-back addresses are renumbered so that replies find their client.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#include "../transport/posix-ip.h"
+#include "../transport/transport.h"
+#include "../transport/mux.h"
+#include "../format/format.h"
+#include "../glue/widths.h"
+#include "../glue/strncasecmp.h"
+
+#include <sys/un.h>
+#include <signal.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define MAX_MTU    4096
+#define MAX_RECORD (sizeof(eb_max_align_t)*(255+255+1+1)+8) /* as in format/slave.c */
+#define MAX_NAME   256
+
+/* Read-back addresses handed to the targets; the same space eb_response_rba uses */
+#define RBA_SLOTS   16384
+#define RBA_SLOT(a) (((a)&0x7FFF)>>1)
+
+struct eb_target {
+  char name[MAX_NAME];
+  struct eb_transport_ops* ops;
+  struct eb_transport transport;
+  struct eb_link link;
+  eb_width_t probed; /* as answered by the target; 0 while the probe is out */
+  eb_width_t widths; /* negotiated; streams carry no per-packet header */
+  int attempts;
+  int dead;
+  struct timeval deadline;
+  int fill; /* stream bytes waiting for the rest of their record */
+  uint8_t rx[MAX_MTU+MAX_RECORD];
+  struct eb_target* next;
+};
+
+struct eb_client {
+  int fdes; /* -1 once dead */
+  struct eb_target* target;
+  eb_address_t rba;    /* read-back address of the client's last cycle */
+  eb_address_t mapped; /* ... and the one which replaced it on the link */
+  struct eb_client* next;
+};
+
+struct eb_rba {
+  struct eb_client* client;
+  eb_address_t rba;
+};
+
+static struct eb_target* targets;
+static struct eb_client* clients;
+static struct eb_rba rbas[RBA_SLOTS];
+static int rba_next;
+
+struct eb_block_sets {
+  int nfd;
+  fd_set rfds;
+  fd_set wfds;
+};
+
+static int eb_update_sets(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode) {
+  struct eb_block_sets* set = (struct eb_block_sets*)data;
+  
+  if (fd > set->nfd) set->nfd = fd;
+  
+  if ((mode & EB_DESCRIPTOR_IN)  != 0) FD_SET(fd, &set->rfds);
+  if ((mode & EB_DESCRIPTOR_OUT) != 0) FD_SET(fd, &set->wfds);
+  
+  return 0;
+}
+
+static int eb_check_sets(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode) {
+  struct eb_block_sets* set = (struct eb_block_sets*)data;
+  
+  return 
+    (((mode & EB_DESCRIPTOR_IN)  != 0) && FD_ISSET(fd, &set->rfds)) ||
+    (((mode & EB_DESCRIPTOR_OUT) != 0) && FD_ISSET(fd, &set->wfds));
+}
+
+static eb_address_t eb_load(const uint8_t* ptr, int alignment) {
+  eb_address_t x;
+  int i;
+  
+  x = 0;
+  for (i = 0; i < alignment; ++i) x = (x << 8) | ptr[i];
+  return x;
+}
+
+static void eb_store(uint8_t* ptr, eb_address_t x, int alignment) {
+  int i;
+  
+  for (i = alignment; i--; x >>= 8) ptr[i] = x & 0xFF;
+}
+
+static void eb_alignments(eb_width_t widths, int* alignment, int* record_alignment) {
+  eb_width_t biggest;
+  
+  biggest = (widths >> 4) | (widths & EB_DATAX);
+  *alignment = 2;
+  *alignment += (biggest >= EB_DATA32)*2;
+  *alignment += (biggest >= EB_DATA64)*4;
+  *record_alignment = 4;
+  *record_alignment += (biggest >= EB_DATA64)*4;
+}
+
+static long eb_usec_until(const struct timeval* when, const struct timeval* now) {
+  return (long)(when->tv_sec - now->tv_sec)*1000000 + (when->tv_usec - now->tv_usec);
+}
+
+/* Clients waiting for a target are not read until it answers our probe */
+static void eb_target_probed(struct eb_target* target, eb_width_t widths) {
+  target->probed = widths;
+  target->widths = eb_width_refine(widths);
+  if (!eb_width_possible(target->widths)) target->dead = 1;
+}
+
+static void eb_target_probe(struct eb_target* target) {
+  uint8_t buf[8] = { 0x4E, 0x6F, 0x11, EB_ADDRX|EB_DATAX, 0x0, 0x0, 0x0, 0x0 };
+  
+  target->ops->send_buffer(&target->transport, &target->link, 1);
+  target->ops->send(&target->transport, &target->link, buf, sizeof(buf));
+  target->ops->send_buffer(&target->transport, &target->link, 0);
+  
+  gettimeofday(&target->deadline, 0);
+  target->deadline.tv_sec += 3; /* as eb_device_open */
+}
+
+static struct eb_target* eb_target_open(const char* name) {
+  struct eb_target* target;
+  eb_status_t status;
+  unsigned int i;
+  
+  /* Do not loop back into ourselves */
+  if (!eb_strncasecmp(name, "mux/", 4)) return 0;
+  
+  if ((target = (struct eb_target*)malloc(sizeof(struct eb_target))) == 0) return 0;
+  
+  status = EB_ADDRESS;
+  for (i = 0; i < eb_transport_size; ++i) {
+    target->ops = &eb_transports[i];
+    if (target->ops->open(&target->transport, 0) != EB_OK) continue;
+    
+    status = target->ops->connect(&target->transport, &target->link, name, 0);
+    if (status == EB_OK) break;
+    
+    target->ops->close(&target->transport);
+    if (status != EB_ADDRESS) break;
+  }
+  
+  if (status != EB_OK) {
+    free(target);
+    return 0;
+  }
+  
+  strcpy(target->name, name);
+  target->probed = 0;
+  target->widths = 0;
+  target->attempts = target->ops->mtu ? 3 : 1; /* a stream gets exactly one handshake */
+  target->dead = 0;
+  target->fill = 0;
+  target->next = targets;
+  targets = target;
+  
+  eb_target_probe(target);
+  return target;
+}
+
+static void eb_target_close(struct eb_target* target) {
+  struct eb_client* client;
+  
+  for (client = clients; client != 0; client = client->next) {
+    if (client->target == target && client->fdes != -1) {
+      close(client->fdes);
+      client->fdes = -1;
+    }
+  }
+  
+  target->ops->disconnect(&target->transport, &target->link);
+  target->ops->close(&target->transport);
+  free(target);
+}
+
+/* Renumber the read-back address of a cycle, keeping the status bit */
+static eb_address_t eb_client_rba(struct eb_client* client, eb_address_t rba) {
+  eb_address_t low;
+  
+  low = rba & 1;
+  rba -= low;
+  
+  /* A cycle split over packets keeps its address */
+  if (client->mapped == 0 || client->rba != rba) {
+    rbas[rba_next].client = client;
+    rbas[rba_next].rba = rba;
+    client->rba = rba;
+    client->mapped = 0x8000 | (rba_next << 1);
+    rba_next = (rba_next + 1) % RBA_SLOTS;
+  }
+  
+  return client->mapped | low;
+}
+
+/* Forward one packet of a client to its target. Returns 0 if the client broke protocol. */
+static int eb_client_packet(struct eb_client* client, uint8_t* buf, int len) {
+  struct eb_target* target;
+  uint8_t* rptr, * eos;
+  eb_width_t widths;
+  int alignment, record_alignment, total;
+  uint8_t flags, wcount, rcount;
+  
+  target = client->target;
+  
+  if (len < 4 || buf[0] != 0x4E || buf[1] != 0x6F) return 0;
+  
+  /* Answer the probe from what the target told us */
+  if ((buf[2] & EB_HEADER_PF) != 0) {
+    if (len != 8) return 0;
+    buf[2] = 0x10 | EB_HEADER_PR | EB_HEADER_NR;
+    buf[3] = target->ops->mtu ? target->probed : target->widths;
+    send(client->fdes, buf, 8, MSG_NOSIGNAL);
+    return 1;
+  }
+  
+  widths = buf[3];
+  if (!eb_width_refined(widths)) return 0;
+  if (target->ops->mtu == 0 && widths != target->widths) return 0;
+  
+  eb_alignments(widths, &alignment, &record_alignment);
+  eos = buf + len;
+  
+  for (rptr = buf + record_alignment; rptr + record_alignment <= eos; rptr += total*alignment) {
+    flags  = rptr[0];
+    wcount = rptr[2];
+    rcount = rptr[3];
+    rptr += record_alignment;
+    
+    total = wcount + rcount + (wcount>0) + (rcount>0);
+    if (total*alignment > eos - rptr) return 0;
+    
+    /* Read-backs into config space are how the library matches replies */
+    if (rcount > 0 && (flags & EB_RECORD_BCA) != 0) {
+      uint8_t* bra = rptr + (wcount ? (wcount+1)*alignment : 0);
+      eb_store(bra, eb_client_rba(client, eb_load(bra, alignment)), alignment);
+    }
+  }
+  
+  /* After the probe, a stream carries only records */
+  if (target->ops->mtu == 0) {
+    buf += record_alignment;
+    len -= record_alignment;
+  }
+  
+  target->ops->send_buffer(&target->transport, &target->link, 1);
+  target->ops->send(&target->transport, &target->link, buf, len);
+  target->ops->send_buffer(&target->transport, &target->link, 0);
+  return 1;
+}
+
+/* The live client which owns the read-back address a reply record writes, or 0.
+ * With restore set, the record gets back the address the client chose.
+ */
+static struct eb_client* eb_target_owner(struct eb_target* target, uint8_t* rptr, int alignment, int record_alignment, int restore) {
+  struct eb_rba* slot;
+  eb_address_t bwa;
+  uint8_t flags, wcount, rcount;
+  
+  flags  = rptr[0];
+  wcount = rptr[2];
+  rcount = rptr[3];
+  
+  /* The target reads from us; nobody here answers */
+  if (rcount > 0 || wcount == 0) return 0;
+  
+  bwa = eb_load(rptr + record_alignment, alignment);
+  slot = &rbas[RBA_SLOT(bwa)];
+  if ((flags & EB_RECORD_WCA) == 0 || (bwa & 0x8000) == 0 || bwa >= 0x10000 ||
+      slot->client == 0 || slot->client->target != target || slot->client->fdes == -1)
+    return 0;
+  
+  if (restore) eb_store(rptr + record_alignment, slot->rba | (bwa & 1), alignment);
+  return slot->client;
+}
+
+/* Hand each complete reply cycle to the client owning its read-back address.
+ * A client's link carries packets, which must end on a cycle boundary, so a
+ * cycle is only forwarded once its last record has arrived and never split.
+ * Returns the number of bytes consumed; the rest is left untouched.
+ */
+static int eb_target_records(struct eb_target* target, uint8_t* buf, int len, eb_width_t widths) {
+  static uint8_t out[MAX_MTU+MAX_RECORD];
+  struct eb_client* to;
+  struct eb_client* owner;
+  uint8_t* rptr, * next, * eos, * cycle, * copy;
+  int alignment, record_alignment, total, fill;
+  uint8_t flags, wcount, rcount;
+  
+  eb_alignments(widths, &alignment, &record_alignment);
+  eos = buf + len;
+  
+  to = 0;
+  owner = 0;
+  fill = 0;
+  cycle = buf;
+  for (rptr = buf; rptr + record_alignment <= eos; rptr = next) {
+    flags  = rptr[0];
+    wcount = rptr[2];
+    rcount = rptr[3];
+    
+    total = wcount + rcount + (wcount>0) + (rcount>0);
+    if (total*alignment > eos - rptr - record_alignment) break;
+    next = rptr + record_alignment + total*alignment;
+    
+    /* The first record of a cycle says whose it is */
+    if (rptr == cycle) owner = eb_target_owner(target, rptr, alignment, record_alignment, 0);
+    
+    if ((flags & EB_RECORD_CYC) == 0) continue;
+    
+    if (fill > 0 && (owner != to || fill + (next - cycle) > EB_MUX_MTU)) {
+      send(to->fdes, out, fill, MSG_NOSIGNAL);
+      fill = 0;
+    }
+    
+    to = owner;
+    if (to != 0) {
+      if (fill == 0) {
+        memset(out, 0, record_alignment);
+        out[0] = 0x4E;
+        out[1] = 0x6F;
+        out[2] = 0x10 | EB_HEADER_NR; /* V1, a reply */
+        out[3] = widths;
+        fill = record_alignment;
+      }
+      
+      /* Give each record back the read-back address its client chose */
+      for (copy = cycle; copy < next; copy += record_alignment + alignment*(copy[2] + copy[3] + (copy[2]>0) + (copy[3]>0)))
+        eb_target_owner(target, copy, alignment, record_alignment, 1);
+      
+      memcpy(out + fill, cycle, next - cycle);
+      fill += next - cycle;
+    }
+    
+    cycle = next;
+  }
+  
+  if (fill > 0)
+    send(to->fdes, out, fill, MSG_NOSIGNAL);
+  
+  return cycle - buf;
+}
+
+/* Returns >0 if the target had data, 0 if not, -1 if its link is gone */
+static int eb_target_poll(struct eb_target* target, struct eb_block_sets* sets) {
+  struct eb_transport_ops* ops;
+  uint8_t buf[MAX_MTU];
+  uint8_t* rx;
+  int len, used, alignment, record_alignment;
+  
+  ops = target->ops;
+  
+  if (ops->mtu != 0) {
+    len = ops->poll(&target->transport, 0, sets, &eb_check_sets, buf, sizeof(buf));
+    if (len == 0) len = ops->poll(&target->transport, &target->link, sets, &eb_check_sets, buf, sizeof(buf));
+    if (len <= 0) return len;
+    
+    if (len < 4 || buf[0] != 0x4E || buf[1] != 0x6F) return 1;
+    
+    if ((buf[2] & EB_HEADER_PR) != 0) {
+      if (len == 8 && target->probed == 0) eb_target_probed(target, buf[3]);
+      return 1;
+    }
+    
+    /* We are not a slave, and replies must fit the link */
+    if ((buf[2] & EB_HEADER_PF) != 0 || target->probed == 0 || !eb_width_refined(buf[3])) return 1;
+    
+    eb_alignments(buf[3], &alignment, &record_alignment);
+    eb_target_records(target, buf + record_alignment, len - record_alignment, buf[3]);
+    return 1;
+  } else {
+    rx = &target->rx[0];
+    
+    len = ops->poll(&target->transport, 0, sets, &eb_check_sets, rx + target->fill, sizeof(target->rx) - target->fill);
+    if (len == 0) len = ops->poll(&target->transport, &target->link, sets, &eb_check_sets, rx + target->fill, sizeof(target->rx) - target->fill);
+    if (len <= 0) return len;
+    target->fill += len;
+    
+    used = 0;
+    if (target->probed == 0) {
+      if (target->fill < 8) return 1;
+      if (rx[0] != 0x4E || rx[1] != 0x6F || (rx[2] & EB_HEADER_PR) == 0) return -1;
+      eb_target_probed(target, rx[3]);
+      used = 8;
+    }
+    
+    used += eb_target_records(target, rx + used, target->fill - used, target->widths);
+    target->fill -= used;
+    memmove(rx, rx + used, target->fill);
+    
+    /* No reply cycle is longer than the request packet which caused it */
+    if (target->fill == sizeof(target->rx)) return -1;
+    return 1;
+  }
+}
+
+static void eb_client_accept(int listener) {
+  struct eb_client* client;
+  struct eb_target* target;
+  char name[MAX_NAME];
+  int fdes, len;
+  
+  if ((fdes = accept(listener, 0, 0)) == -1) return;
+  
+  /* The first message names the target */
+  len = recv(fdes, name, sizeof(name), 0);
+  if (len <= 0 || name[len-1] != 0) {
+    close(fdes);
+    return;
+  }
+  
+  for (target = targets; target != 0; target = target->next)
+    if (!target->dead && !strcmp(target->name, name)) break;
+  
+  /* Hanging up is how the client learns the target is unreachable */
+  if (target == 0 && (target = eb_target_open(name)) == 0) {
+    close(fdes);
+    return;
+  }
+  
+  if ((client = (struct eb_client*)malloc(sizeof(struct eb_client))) == 0) {
+    close(fdes);
+    return;
+  }
+  
+  client->fdes = fdes;
+  client->target = target;
+  client->rba = 0;
+  client->mapped = 0;
+  client->next = clients;
+  clients = client;
+}
+
+static void eb_client_close(struct eb_client* client) {
+  int i;
+  
+  if (client->fdes != -1) close(client->fdes);
+  
+  /* Late replies for this client are dropped */
+  for (i = 0; i < RBA_SLOTS; ++i)
+    if (rbas[i].client == client) rbas[i].client = 0;
+  
+  free(client);
+}
+
+int main(int argc, const char** argv) {
+  struct eb_block_sets sets;
+  struct sockaddr_un sun;
+  struct timeval now, timeout, * wait;
+  struct eb_target* target;
+  struct eb_target** tnext;
+  struct eb_client* client;
+  struct eb_client** cnext;
+  const char* path;
+  uint8_t buffer[MAX_MTU];
+  long left;
+  int listener, len, busy;
+  
+  if (argc > 2) {
+    fprintf(stderr, "Syntax: %s [socket-path]\n", argv[0]);
+    return 1;
+  }
+  
+  if (argc == 2)
+    path = argv[1];
+  else if ((path = getenv("EB_MUX_SOCKET")) == 0)
+    path = EB_MUX_SOCKET;
+  
+  if (strlen(path) >= sizeof(sun.sun_path)) {
+    fprintf(stderr, "%s: socket path too long\n", argv[0]);
+    return 1;
+  }
+  
+  /* A client or target going away must not take us with it */
+  signal(SIGPIPE, SIG_IGN);
+  
+  memset(&sun, 0, sizeof(sun));
+  sun.sun_family = AF_UNIX;
+  strcpy(sun.sun_path, path);
+  
+  if ((listener = socket(AF_UNIX, SOCK_SEQPACKET, 0)) == -1) {
+    perror("Cannot create local socket");
+    return 1;
+  }
+  
+  unlink(path); /* left over from a previous run */
+  if (bind(listener, (struct sockaddr*)&sun, sizeof(sun)) != 0 || listen(listener, 64) != 0) {
+    perror("Cannot listen on local socket");
+    return 1;
+  }
+  
+  while (1) {
+    FD_ZERO(&sets.rfds);
+    FD_ZERO(&sets.wfds);
+    sets.nfd = 0;
+    
+    eb_update_sets(&sets, listener, EB_DESCRIPTOR_IN);
+    for (client = clients; client != 0; client = client->next)
+      if (client->target->probed != 0)
+        eb_update_sets(&sets, client->fdes, EB_DESCRIPTOR_IN);
+    
+    /* Wake up for the earliest probe to time out */
+    wait = 0;
+    gettimeofday(&now, 0);
+    for (target = targets; target != 0; target = target->next) {
+      target->ops->fdes(&target->transport, 0, &sets, &eb_update_sets);
+      target->ops->fdes(&target->transport, &target->link, &sets, &eb_update_sets);
+      
+      if (target->probed == 0) {
+        left = eb_usec_until(&target->deadline, &now);
+        if (left < 0) left = 0;
+        if (wait == 0 || left < (long)timeout.tv_sec*1000000 + timeout.tv_usec) {
+          timeout.tv_sec = left / 1000000;
+          timeout.tv_usec = left % 1000000;
+          wait = &timeout;
+        }
+      }
+    }
+    
+    if (select(sets.nfd+1, &sets.rfds, &sets.wfds, 0, wait) < 0) {
+      if (errno == EINTR) continue;
+      perror("select");
+      return 1;
+    }
+    
+    if (FD_ISSET(listener, &sets.rfds))
+      eb_client_accept(listener);
+    
+    /* Requests from the clients */
+    for (client = clients; client != 0; client = client->next) {
+      if (client->fdes == -1 || client->target->probed == 0 || !FD_ISSET(client->fdes, &sets.rfds)) continue;
+      
+      len = recv(client->fdes, buffer, sizeof(buffer), MSG_DONTWAIT);
+      if (len == -1 && eb_posix_ip_ewouldblock()) continue;
+      
+      if (len <= 0 || client->target->dead || !eb_client_packet(client, buffer, len)) {
+        close(client->fdes);
+        client->fdes = -1;
+      }
+    }
+    
+    /* Replies from the targets; UDP bursts are shared, so go until all are quiet */
+    do {
+      busy = 0;
+      for (target = targets; target != 0; target = target->next) {
+        if (target->dead) continue;
+        while ((len = eb_target_poll(target, &sets)) > 0)
+          busy = 1;
+        if (len < 0) target->dead = 1;
+      }
+    } while (busy);
+    
+    /* Probes which went unanswered */
+    gettimeofday(&now, 0);
+    for (target = targets; target != 0; target = target->next) {
+      if (target->dead || target->probed != 0 || eb_usec_until(&target->deadline, &now) > 0) continue;
+      
+      if (--target->attempts > 0) {
+        eb_target_probe(target);
+      } else {
+        target->dead = 1;
+      }
+    }
+    
+    /* Reap what died in this round */
+    for (tnext = &targets; (target = *tnext) != 0; ) {
+      if (target->dead) {
+        *tnext = target->next;
+        eb_target_close(target);
+      } else {
+        tnext = &target->next;
+      }
+    }
+    for (cnext = &clients; (client = *cnext) != 0; ) {
+      if (client->fdes == -1) {
+        *cnext = client->next;
+        eb_client_close(client);
+      } else {
+        cnext = &client->next;
+      }
+    }
+  }
+  
+  return 1;
+}
@@ -5,6 +5,9 @@
  *
  *  A complete skeleton of an application using the Etherbone library.
  *
+ *  With -r, the requests recorded in a pcapng capture (see eb_socket_capture)
+ *  are sent to the memory served here, at their original pace or faster.
+ *
  *  @author Wesley W. Terpstra <w.terpstra@gsi.de>
  *
  *  @bug None!
@@ -32,9 +35,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 #include "../etherbone.h"
 #include "../glue/version.h"
+#include "../format/bigendian.h"
 
 static uint8_t* my_memory;
 
@@ -44,6 +56,21 @@ static eb_address_t address;
 static eb_format_t endian;
 static int verbose, quiet;
 
+/* Replay of a capture */
+#define REPLAY_IFS      256
+#define REPLAY_IPV4_UDP 28 /* bytes of IPv4 and UDP header in front of a datagram */
+
+struct replay_if {
+  int datagram;
+  int master;   /* requests are outbound; else inbound */
+  int fd;       /* stream connection; -1 until the first request */
+  int replies;  /* reads which returned data on fd */
+};
+
+static struct replay_if replay_ifs[REPLAY_IFS];
+static int replay_count, replay_udp;
+static unsigned long replay_packets, replay_bytes, replay_replies, replay_lost;
+
 static void help(void) {
   fprintf(stderr, "Usage: %s [OPTION] <port> <address-range> [passive-open-address]\n", program);
   fprintf(stderr, "\n");
@@ -54,6 +81,8 @@ static void help(void) {
   fprintf(stderr, "  -l             little-endian operation                 (auto)\n");
   fprintf(stderr, "  -v             verbose operation\n");
   fprintf(stderr, "  -q             quiet: do not display warnings\n");
+  fprintf(stderr, "  -r <capture>   replay the requests of a pcapng capture\n");
+  fprintf(stderr, "  -x <speedup>   replay this many times faster; 0 = at once (1)\n");
   fprintf(stderr, "  -h             display this help and exit\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "Report Etherbone bugs to <etherbone-core@ohwr.org>\n");
@@ -114,14 +143,305 @@ static eb_status_t my_write(eb_user_data_t user, eb_address_t req_address, eb_wi
   return EB_OK;
 }
 
+/* eb-put and eb-get move whole 32-bit big-endian words; convert those directly */
+static int my_read_block(eb_user_data_t user, eb_address_t req_address, eb_width_t width, eb_data_t* data, int count) {
+  int i;
+  uint32_t word;
+  uint8_t* memory;
+  
+  if (verbose || endian != EB_BIG_ENDIAN || (width&EB_DATAX) != EB_DATA32) {
+    for (i = 0; i < count; ++i, req_address += width&EB_DATAX)
+      my_read(user, req_address, width, &data[i]);
+    return count;
+  }
+  
+  memory = my_memory + (req_address - address);
+  for (i = 0; i < count; ++i, memory += 4) {
+    memcpy(&word, memory, 4);
+    data[i] = be32toh(word);
+  }
+  
+  return count;
+}
+
+static int my_write_block(eb_user_data_t user, eb_address_t req_address, eb_width_t width, const eb_data_t* data, int count) {
+  int i;
+  uint32_t word;
+  uint8_t* memory;
+  
+  if (verbose || endian != EB_BIG_ENDIAN || (width&EB_DATAX) != EB_DATA32) {
+    for (i = 0; i < count; ++i, req_address += width&EB_DATAX)
+      my_write(user, req_address, width, data[i]);
+    return count;
+  }
+  
+  memory = my_memory + (req_address - address);
+  for (i = 0; i < count; ++i, memory += 4) {
+    word = htobe32(data[i]);
+    memcpy(memory, &word, 4);
+  }
+  
+  return count;
+}
+
+static double replay_now(void) {
+  struct timespec ts;
+  
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static int replay_connect(const char* port, int type) {
+  struct sockaddr_in addr;
+  int fd;
+  
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(atoi(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  
+  if ((fd = socket(PF_INET, type, 0)) == -1) return -1;
+  
+  /* The listener queues the connection until eb_socket_run accepts it */
+  if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
+
+/* Serve whatever has arrived and count the replies */
+static void replay_serve(eb_socket_t socket, int timeout_us) {
+  uint8_t buf[65536];
+  int i;
+  
+  eb_socket_run(socket, timeout_us);
+  
+  while (recv(replay_udp, buf, sizeof(buf), 0) > 0)
+    ++replay_replies;
+  
+  for (i = 0; i < replay_count; ++i)
+    if (replay_ifs[i].fd != -1)
+      while (recv(replay_ifs[i].fd, buf, sizeof(buf), 0) > 0) {
+        ++replay_replies;
+        ++replay_ifs[i].replies;
+      }
+}
+
+static void replay_send(eb_socket_t socket, const char* port, struct replay_if* iface, const uint8_t* buf, int len) {
+  double deadline;
+  int got, probe, replies;
+  
+  if (iface->datagram) {
+    if (len < REPLAY_IPV4_UDP) return;
+    replay_bytes += len - REPLAY_IPV4_UDP;
+    while (send(replay_udp, buf + REPLAY_IPV4_UDP, len - REPLAY_IPV4_UDP, 0) < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) {
+        ++replay_lost;
+        return;
+      }
+      replay_serve(socket, 0);
+    }
+  } else {
+    if (iface->fd == -1 && (iface->fd = replay_connect(port, SOCK_STREAM)) == -1) {
+      ++replay_lost;
+      return;
+    }
+    replay_bytes += len;
+    
+    /* A stream slave drops a link which sends before the probe is answered */
+    probe = len == 8 && buf[0] == 0x4E && buf[1] == 0x6F && (buf[2] & 0x01) != 0;
+    replies = iface->replies;
+    
+    while (len > 0) {
+      if ((got = send(iface->fd, buf, len, 0)) < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          ++replay_lost;
+          return;
+        }
+        got = 0;
+      }
+      buf += got;
+      len -= got;
+      if (len > 0) replay_serve(socket, 0);
+    }
+    
+    deadline = replay_now() + 1;
+    while (probe && iface->replies == replies && replay_now() < deadline)
+      replay_serve(socket, 1000);
+  }
+  
+  ++replay_packets;
+}
+
+/* A socket takes the replies to its own reads on the same UDP port as
+ * the requests it serves, so the capture shows them inbound next to each
+ * other. Replies are probe responses, or hold only writes to config space.
+ */
+static int replay_is_reply(const uint8_t* buf, int len) {
+  int header;
+  
+  if (len < 4) return 1;
+  if ((buf[2] & 0x02) != 0) return 1; /* probe response */
+  if ((buf[2] & 0x04) == 0) return 0; /* has reads */
+  
+  header = (buf[3] & 0x88) ? 8 : 4;
+  return len > header && (buf[header] & 0x04) != 0; /* writes to config space */
+}
+
+/* Find the option with this code in an IDB or EPB */
+static const uint8_t* replay_option(const uint8_t* opt, const uint8_t* end, uint16_t code, uint16_t* len) {
+  uint16_t c, l;
+  
+  while (end - opt >= 4) {
+    memcpy(&c, opt, 2);
+    memcpy(&l, opt+2, 2);
+    if (c == 0) break;
+    if (end - opt - 4 < l) break;
+    if (c == code) {
+      *len = l;
+      return opt + 4;
+    }
+    opt += 4 + ((l + 3) & ~3);
+  }
+  return 0;
+}
+
+static int replay(eb_socket_t socket, const char* port, const char* filename, double speedup) {
+  FILE* file;
+  uint8_t* block;
+  const uint8_t* opt;
+  uint32_t head[2], size, word, ifid, caplen, flags;
+  uint16_t linktype, len;
+  uint64_t stamp, first;
+  double start, due, now, elapsed;
+  struct replay_if* iface;
+  int i, outbound, started;
+  
+  if ((file = fopen(filename, "rb")) == 0) {
+    fprintf(stderr, "%s: cannot open %s: %s\n", program, filename, strerror(errno));
+    return 1;
+  }
+  
+  if ((replay_udp = replay_connect(port, SOCK_DGRAM)) == -1) {
+    fprintf(stderr, "%s: cannot reach udp port %s: %s\n", program, port, strerror(errno));
+    return 1;
+  }
+  
+  signal(SIGPIPE, SIG_IGN); /* a slave may close a stream it cannot parse */
+  
+  block = 0;
+  first = 0;
+  start = 0;
+  started = 0;
+  replay_count = 0;
+  
+  while (fread(head, 4, 2, file) == 2) {
+    size = head[1];
+    if (size < 12 || (size & 3) != 0 || (block = realloc(block, size)) == 0) {
+      fprintf(stderr, "%s: %s: corrupt block\n", program, filename);
+      return 1;
+    }
+    if (fread(block + 8, 1, size - 8, file) != size - 8) break;
+    
+    switch (head[0]) {
+    case 0x0A0D0D0AU: /* SHB: a new section starts with no interfaces */
+      memcpy(&word, block + 8, 4);
+      if (word != 0x1A2B3C4DU) {
+        fprintf(stderr, "%s: %s: not a capture of this byte order\n", program, filename);
+        return 1;
+      }
+      for (i = 0; i < replay_count; ++i)
+        if (replay_ifs[i].fd != -1) close(replay_ifs[i].fd);
+      replay_count = 0;
+      break;
+      
+    case 1: /* IDB */
+      if (replay_count == REPLAY_IFS) break;
+      iface = &replay_ifs[replay_count++];
+      memcpy(&linktype, block + 8, 2);
+      iface->datagram = linktype == 228; /* IPv4 */
+      iface->master = (opt = replay_option(block + 16, block + size - 4, 3, &len)) != 0 &&
+                      len == 6 && memcmp(opt, "master", 6) == 0;
+      iface->fd = -1;
+      iface->replies = 0;
+      break;
+      
+    case 6: /* EPB */
+      memcpy(&ifid, block + 8, 4);
+      if (ifid >= (uint32_t)replay_count) break;
+      iface = &replay_ifs[ifid];
+      
+      memcpy(&caplen, block + 20, 4);
+      if (caplen > size - 32) break;
+      
+      flags = 0;
+      if ((opt = replay_option(block + 28 + ((caplen + 3) & ~3), block + size - 4, 2, &len)) != 0 && len == 4)
+        memcpy(&flags, opt, 4);
+      outbound = (flags & 3) == 2;
+      
+      /* Only the requests; the slave makes up its own replies */
+      if (outbound != iface->master) break;
+      if (iface->datagram && !outbound && replay_is_reply(block + 28 + REPLAY_IPV4_UDP, caplen - REPLAY_IPV4_UDP)) break;
+      
+      memcpy(&word, block + 12, 4);
+      stamp = (uint64_t)word << 32;
+      memcpy(&word, block + 16, 4);
+      stamp |= word;
+      
+      if (!started) {
+        first = stamp;
+        start = replay_now();
+        started = 1;
+      }
+      
+      if (speedup > 0) {
+        due = start + (stamp - first) * 1e-6 / speedup;
+        while ((now = replay_now()) < due)
+          replay_serve(socket, (due - now) * 1e6);
+      }
+      
+      if (verbose) fprintf(stdout, "Replaying %"PRIu32" bytes to interface %"PRIu32"\n", caplen, ifid);
+      replay_send(socket, port, iface, block + 28, caplen);
+      replay_serve(socket, 0);
+      break;
+      
+    default:
+      break;
+    }
+  }
+  
+  fclose(file);
+  free(block);
+  
+  elapsed = started ? replay_now() - start : 0;
+  
+  /* Let the last replies come back */
+  for (i = 0; i < 10; ++i)
+    replay_serve(socket, 10000);
+  
+  fprintf(stdout, "Replayed %lu requests (%lu bytes) in %.3fs", replay_packets, replay_bytes, elapsed);
+  if (elapsed > 0) fprintf(stdout, " = %.0f requests/s", replay_packets / elapsed);
+  fprintf(stdout, "; %lu replies", replay_replies);
+  if (replay_lost) fprintf(stdout, ", %lu not delivered", replay_lost);
+  fprintf(stdout, "\n");
+  
+  return 0;
+}
+
 int main(int argc, char** argv) {
   long value;
   char* value_end;
   int opt, error;
   const char* passive_address;
+  const char* capture;
+  double speedup;
   
   struct sdb_device device;
   struct eb_handler handler;
+  struct eb_block_handler block;
   eb_status_t status;
   eb_socket_t socket;
   
@@ -138,9 +458,11 @@ int main(int argc, char** argv) {
   verbose = 0;
   quiet = 0;
   error = 0;
+  capture = 0;
+  speedup = 1;
   
   /* Process the command-line arguments */
-  while ((opt = getopt(argc, argv, "a:d:w:blvqh")) != -1) {
+  while ((opt = getopt(argc, argv, "a:d:w:blvqr:x:h")) != -1) {
     switch (opt) {
     case 'a':
       value = eb_width_parse_address(optarg, &address_width);
@@ -175,6 +497,16 @@ int main(int argc, char** argv) {
     case 'q':
       quiet = 1;
       break;
+    case 'r':
+      capture = optarg;
+      break;
+    case 'x':
+      speedup = strtod(optarg, &value_end);
+      if (*value_end != 0 || speedup < 0) {
+        fprintf(stderr, "%s: invalid speedup -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
     case 'h':
       help();
       return 1;
@@ -230,6 +562,9 @@ int main(int argc, char** argv) {
   handler.read = &my_read;
   handler.write = &my_write;
   
+  block.read_block = &my_read_block;
+  block.write_block = &my_write_block;
+  
   if ((my_memory = calloc((device.sdb_component.addr_last-device.sdb_component.addr_first)+1, 1)) == 0) {
     fprintf(stderr, "%s: insufficient memory for 0x%"EB_ADDR_FMT"-0x%"EB_ADDR_FMT"\n",
                     program, (eb_address_t)device.sdb_component.addr_first, (eb_address_t)device.sdb_component.addr_last);
@@ -241,7 +576,7 @@ int main(int argc, char** argv) {
     return 1;
   }
   
-  if ((status = eb_socket_attach(socket, &handler)) != EB_OK) {
+  if ((status = eb_socket_attach_block(socket, &handler, &block)) != EB_OK) {
     fprintf(stderr, "%s: failed to attach slave device: %s\n", program, eb_status(status));
     return 1;
   }
@@ -256,6 +591,9 @@ int main(int argc, char** argv) {
     }
   }
   
+  if (capture)
+    return replay(socket, port, capture, speedup);
+  
   while (1) {
     eb_socket_run(socket, -1);
   }
@@ -0,0 +1,341 @@
+/** @file eb-stat.c
+ *  @brief A tool for measuring Etherbone latency and throughput.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  Issues a stream of reads to one address and dumps the device and
+ *  socket statistics collected by the library while doing so.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L /* strtoull + getopt */
+#define _ISOC99_SOURCE /* strtoull on old systems */
+
+#include <unistd.h> /* getopt */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../etherbone.h"
+#include "../glue/version.h"
+
+static const char* program;
+static int inflight, failed, quiet;
+
+static void help(void) {
+  fprintf(stderr, "Usage: %s [OPTION] <proto/host/port> <address/size>\n", program);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -a <width>     acceptable address bus widths     (8/16/32/64)\n");
+  fprintf(stderr, "  -d <width>     acceptable data bus widths        (8/16/32/64)\n");
+  fprintf(stderr, "  -b             big-endian operation                    (auto)\n");
+  fprintf(stderr, "  -l             little-endian operation                 (auto)\n");
+  fprintf(stderr, "  -r <retries>   number of times to attempt autonegotiation (3)\n");
+  fprintf(stderr, "  -n <cycles>    number of read cycles to issue          (1000)\n");
+  fprintf(stderr, "  -w <cycles>    number of cycles kept in flight            (1)\n");
+  fprintf(stderr, "  -c             read the config space instead of the bus\n");
+  fprintf(stderr, "  -s             don't read error status from device\n");
+  fprintf(stderr, "  -v             verbose operation: list empty buckets too\n");
+  fprintf(stderr, "  -q             quiet: do not display warnings\n");
+  fprintf(stderr, "  -h             display this help and exit\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Report Etherbone bugs to <etherbone-core@ohwr.org>\n");
+  fprintf(stderr, "Version %"PRIx32" (%s). Licensed under the LGPL v3.\n", EB_VERSION_SHORT, EB_DATE_FULL);
+}
+
+static void done(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  --inflight;
+
+  if (status != EB_OK) {
+    if (!quiet)
+      fprintf(stderr, "%s: etherbone cycle error: %s\n", program, eb_status(status));
+    ++failed;
+  } else if (op != EB_NULL && eb_operation_had_error(op)) {
+    if (!quiet)
+      fprintf(stderr, "%s: wishbone segfault reading 0x%"EB_ADDR_FMT"\n", program, eb_operation_address(op));
+    ++failed;
+  }
+}
+
+/* Print the occupied buckets of a histogram with their cumulative share */
+static void histogram(const char* title, const uint64_t* bucket, int verbose) {
+  uint64_t total, sum;
+  int i, first, last;
+
+  total = 0;
+  first = EB_STATS_BUCKETS;
+  last = -1;
+  for (i = 0; i < EB_STATS_BUCKETS; ++i) {
+    if (bucket[i] == 0) continue;
+    total += bucket[i];
+    if (first > i) first = i;
+    last = i;
+  }
+
+  fprintf(stdout, "%s:\n", title);
+  if (total == 0) {
+    fprintf(stdout, "  (no samples)\n");
+    return;
+  }
+
+  sum = 0;
+  for (i = first; i <= last; ++i) {
+    if (bucket[i] == 0 && !verbose) continue;
+    sum += bucket[i];
+    fprintf(stdout, "  %10"PRIu32" - %10"PRIu32"us %12"PRIu64" %6.2f%%\n",
+                    eb_stats_bucket(i), eb_stats_bucket(i+1)-1, bucket[i], 100.0*sum/total);
+  }
+}
+
+/* The end of the bucket which holds the given fraction of samples */
+static uint32_t percentile(const uint64_t* bucket, double fraction) {
+  uint64_t total, sum;
+  int i;
+
+  total = 0;
+  for (i = 0; i < EB_STATS_BUCKETS; ++i)
+    total += bucket[i];
+
+  sum = 0;
+  for (i = 0; i < EB_STATS_BUCKETS; ++i) {
+    sum += bucket[i];
+    if (sum > 0 && sum >= fraction*total) break;
+  }
+
+  return eb_stats_bucket(i+1);
+}
+
+int main(int argc, char** argv) {
+  long value;
+  char* value_end;
+  int opt, error;
+
+  eb_socket_t socket;
+  eb_status_t status;
+  eb_device_t device;
+  eb_width_t address_width, data_width, line_width;
+  eb_format_t endian, size, format;
+  eb_address_t address;
+  eb_cycle_t cycle;
+  struct eb_device_stats dstats;
+  struct eb_socket_stats sstats;
+
+  /* Specific command-line options */
+  int attempts, cycles, window, config, silent, verbose, issued;
+  const char* netaddress;
+
+  /* Default arguments */
+  program = argv[0];
+  address_width = EB_ADDRX;
+  data_width = EB_DATAX;
+  endian = 0; /* auto-detect */
+  attempts = 3;
+  cycles = 1000;
+  window = 1;
+  config = 0;
+  silent = 0;
+  verbose = 0;
+  quiet = 0;
+  error = 0;
+
+  /* Process the command-line arguments */
+  while ((opt = getopt(argc, argv, "a:d:blr:n:w:csvqh")) != -1) {
+    switch (opt) {
+    case 'a':
+      value = eb_width_parse_address(optarg, &address_width);
+      if (value != EB_OK) {
+        fprintf(stderr, "%s: invalid address width -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 'd':
+      value = eb_width_parse_data(optarg, &data_width);
+      if (value != EB_OK) {
+        fprintf(stderr, "%s: invalid data width -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 'b':
+      endian = EB_BIG_ENDIAN;
+      break;
+    case 'l':
+      endian = EB_LITTLE_ENDIAN;
+      break;
+    case 'r':
+      value = strtol(optarg, &value_end, 0);
+      if (*value_end || value < 0 || value > 100) {
+        fprintf(stderr, "%s: invalid number of retries -- '%s'\n", program, optarg);
+        return 1;
+      }
+      attempts = value;
+      break;
+    case 'n':
+      value = strtol(optarg, &value_end, 0);
+      if (*value_end || value <= 0) {
+        fprintf(stderr, "%s: invalid number of cycles -- '%s'\n", program, optarg);
+        return 1;
+      }
+      cycles = value;
+      break;
+    case 'w':
+      value = strtol(optarg, &value_end, 0);
+      if (*value_end || value <= 0 || value > 65536) {
+        fprintf(stderr, "%s: invalid number of cycles in flight -- '%s'\n", program, optarg);
+        return 1;
+      }
+      window = value;
+      break;
+    case 'c':
+      config = 1;
+      break;
+    case 's':
+      silent = 1;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    case 'q':
+      quiet = 1;
+      break;
+    case 'h':
+      help();
+      return 1;
+    case ':':
+    case '?':
+      error = 1;
+      break;
+    default:
+      fprintf(stderr, "%s: bad getopt result\n", program);
+      return 1;
+    }
+  }
+
+  if (error) return 1;
+
+  if (optind + 2 != argc) {
+    fprintf(stderr, "%s: expecting two non-optional arguments: <proto/host/port> <address/size>\n", program);
+    return 1;
+  }
+
+  netaddress = argv[optind];
+
+  address = strtoull(argv[optind+1], &value_end, 0);
+  if (*value_end == '/')
+    size = strtoull(value_end+1, &value_end, 0);
+  else
+    size = 0;
+  if (*value_end != 0 || (size != 1 && size != 2 && size != 4 && size != 8)) {
+    fprintf(stderr, "%s: argument does not match format <address>/<1|2|4|8> -- '%s'\n",
+                    program, argv[optind+1]);
+    return 1;
+  }
+
+  if ((address & (size-1)) != 0) {
+    fprintf(stderr, "%s: 0x%"EB_ADDR_FMT" is not aligned to a %d byte boundary\n",
+                    program, address, size);
+    return 1;
+  }
+
+  if ((status = eb_socket_open(EB_ABI_CODE, 0, address_width|data_width, &socket)) != EB_OK) {
+    fprintf(stderr, "%s: failed to open Etherbone socket: %s\n", program, eb_status(status));
+    return 1;
+  }
+
+  if ((status = eb_device_open(socket, netaddress, EB_ADDRX|EB_DATAX, attempts, &device)) != EB_OK) {
+    fprintf(stderr, "%s: failed to open Etherbone device: %s\n", program, eb_status(status));
+    return 1;
+  }
+
+  line_width = eb_device_width(device);
+  if ((size & line_width & EB_DATAX) == 0 && size > (line_width & EB_DATAX)) {
+    fprintf(stderr, "%s: error: cannot perform a %s-bit read through a %s-bit connection\n",
+                    program, eb_width_data(size), eb_width_data(line_width));
+    return 1;
+  }
+
+  /* A partial-word read needs to know its byte lane */
+  if (endian == 0 && (size & line_width & EB_DATAX) == 0)
+    endian = EB_BIG_ENDIAN;
+  format = endian | size;
+
+  /* Count only the traffic of the measurement itself */
+  if ((status = eb_device_stats_enable(device)) != EB_OK ||
+      (status = eb_socket_stats_enable(socket)) != EB_OK) {
+    fprintf(stderr, "%s: failed to enable statistics: %s\n", program, eb_status(status));
+    return 1;
+  }
+
+  inflight = 0;
+  failed = 0;
+  for (issued = 0; issued < cycles; ++issued) {
+    while (inflight >= window)
+      eb_socket_run(socket, -1);
+
+    if ((status = eb_cycle_open(device, 0, &done, &cycle)) != EB_OK) {
+      fprintf(stderr, "%s: failed to create cycle: %s\n", program, eb_status(status));
+      return 1;
+    }
+
+    if (config)
+      eb_cycle_read_config(cycle, address, format, 0);
+    else
+      eb_cycle_read(cycle, address, format, 0);
+
+    if (silent)
+      eb_cycle_close_silently(cycle);
+    else
+      eb_cycle_close(cycle);
+    ++inflight;
+  }
+
+  while (inflight > 0)
+    eb_socket_run(socket, -1);
+
+  if ((status = eb_device_stats(device, &dstats)) != EB_OK ||
+      (status = eb_socket_stats(socket, &sstats)) != EB_OK) {
+    fprintf(stderr, "%s: failed to read statistics: %s\n", program, eb_status(status));
+    return 1;
+  }
+
+  fprintf(stdout, "device:  %"PRIu64" cycles, %"PRIu64" records, %"PRIu64" packets, %"PRIu64" bytes sent\n",
+                  dstats.cycles, dstats.records, dstats.packets, dstats.bytes);
+  fprintf(stdout, "         %"PRIu64" answered, %"PRIu64" timed out, %d failed\n",
+                  dstats.responses, dstats.timeouts, failed);
+  if (dstats.responses > 0)
+    fprintf(stdout, "latency: mean %"PRIu64"us, p50 <%"PRIu32"us, p90 <%"PRIu32"us, p99 <%"PRIu32"us, p99.9 <%"PRIu32"us\n",
+                    dstats.latency_us / dstats.responses,
+                    percentile(dstats.latency, 0.5), percentile(dstats.latency, 0.9),
+                    percentile(dstats.latency, 0.99), percentile(dstats.latency, 0.999));
+  fprintf(stdout, "socket:  %"PRIu64" runs, %"PRIu64" wakeups, %"PRIu64"us waiting, %"PRIu64"us working\n",
+                  sstats.runs, sstats.wakeups, sstats.wait_us, sstats.work_us);
+
+  histogram("cycle latency", dstats.latency, verbose);
+  histogram("poll duration", sstats.poll, verbose);
+
+  if ((status = eb_device_close(device)) != EB_OK) {
+    fprintf(stderr, "%s: failed to close Etherbone device: %s\n", program, eb_status(status));
+    return 1;
+  }
+
+  if ((status = eb_socket_close(socket)) != EB_OK) {
+    fprintf(stderr, "%s: failed to close Etherbone socket: %s\n", program, eb_status(status));
+    return 1;
+  }
+
+  return failed != 0;
+}
@@ -3,7 +3,10 @@
  *
  *  Copyright (C) 2011-2012 GSI Helmholtz Centre for Heavy Ion Research GmbH 
  *
- *  A complete skeleton of an application using the Etherbone library.
+ *  Each TCP client names a UDP target, then exchanges length-prefixed
+ *  datagrams with it. All frames which arrive together are forwarded in one
+ *  burst, and all datagrams which arrive together leave in one TCP write.
+ *  On Linux the clients are watched with epoll instead of select.
  *
  *  @author Wesley W. Terpstra <w.terpstra@gsi.de>
  *
@@ -28,6 +31,7 @@
 #include "../transport/posix-ip.h"
 #include "../transport/posix-udp.h"
 #include "../transport/posix-tcp.h"
+#include "../transport/tunnel.h"
 #include "../transport/transport.h"
 
 #include <string.h>
@@ -38,50 +42,51 @@
 #include <winsock2.h>
 #endif
 
+#if defined(__linux__) && !defined(EB_DISABLE_EPOLL)
+#define EB_TUNNEL_EPOLL 1
+#include <sys/epoll.h>
+#include <unistd.h>
+#define EB_EPOLL_EVENTS 64
+#endif
+
 #define MAX_MTU 4096
 
 struct eb_client {
   struct eb_transport udp_transport;
   struct eb_link udp_slave;
   struct eb_link tcp_master;
+  int named;  /* the target has been read and the UDP side opened */
+  int dead;   /* freed once the current wakeup is handled */
+  int head, tail;
+  uint8_t rx[EB_TUNNEL_RX];
   struct eb_client* next;
 };
 
-static struct eb_client* eb_new_client(struct eb_transport* tcp_transport, struct eb_client* next) {
-  struct eb_client* first;
-  char address[128];
-  int x;
-  
-  /* Allocate a new head pointer */
-  if ((first = (struct eb_client*)malloc(sizeof(struct eb_client))) == 0) goto fail_mem;
-  first->next = next;
-  
-  /* Extract the target hostname */
-  strcpy(address, "udp/"); /* We only tunnel udp */
-  for (x = strlen(address);
-       eb_posix_tcp_recv(tcp_transport, &next->tcp_master, (uint8_t*)&address[x], 1) == 1;
-       ++x) {
-    if (address[x] == 0) break;
-    if (x == sizeof(address)-1) break;
-  }
-  
-  if (address[x] != 0) goto fail_address;
-  
-  if (eb_posix_udp_open(&next->udp_transport, 0) != EB_OK) goto fail_transport;
-  if (eb_posix_udp_connect(&next->udp_transport, &next->udp_slave, address, 0) != EB_OK) goto fail_link;
-  
-  return first;
+/* Datagrams from a target are framed here before the TCP write */
+static uint8_t tx[EB_TUNNEL_RX];
 
-fail_link:
-  eb_posix_udp_close(&next->udp_transport);
-fail_transport:
-  free(first);
-fail_address:
-fail_mem:
-  eb_posix_tcp_disconnect(tcp_transport, &next->tcp_master);
-  return next;
-}  
+#ifdef EB_TUNNEL_EPOLL
+static int eb_always_ready(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode) {
+  return 1;
+}
 
+struct eb_watch {
+  int epfd;
+  struct eb_client* client; /* 0 for the listening sockets */
+};
+
+static int eb_watch_fd(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode) {
+  struct eb_watch* watch = (struct eb_watch*)data;
+  struct epoll_event event;
+  
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.ptr = watch->client;
+  epoll_ctl(watch->epfd, EPOLL_CTL_ADD, fd, &event);
+  
+  return 0;
+}
+#else
 struct eb_block_sets {
   int nfd;
   fd_set rfds;
@@ -106,18 +111,108 @@ static int eb_check_sets(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode)
     (((mode & EB_DESCRIPTOR_IN)  != 0) && FD_ISSET(fd, &set->rfds)) ||
     (((mode & EB_DESCRIPTOR_OUT) != 0) && FD_ISSET(fd, &set->wfds));
 }
+#endif
+
+/* The client's first bytes name the target: "host/port\0". Returns -1 on failure. */
+static int eb_client_name(struct eb_client* client, eb_user_data_t watch, eb_descriptor_callback_t watch_fd) {
+  char address[128];
+  uint8_t* end;
+  int len;
+  
+  if ((end = memchr(client->rx, 0, client->tail)) == 0)
+    return client->tail < (int)sizeof(address) - 4 ? 0 : -1;
+  
+  len = end - client->rx;
+  if (len + 5 > (int)sizeof(address)) return -1;
+  
+  strcpy(address, "udp/"); /* We only tunnel udp */
+  memcpy(address + 4, client->rx, len + 1);
+  client->head = len + 1;
+  
+  if (eb_posix_udp_open(&client->udp_transport, 0) != EB_OK) return -1;
+  if (eb_posix_udp_connect(&client->udp_transport, &client->udp_slave, address, 0) != EB_OK) {
+    eb_posix_udp_close(&client->udp_transport);
+    return -1;
+  }
+  
+  client->named = 1;
+  if (watch_fd) eb_posix_udp_fdes(&client->udp_transport, 0, watch, watch_fd);
+  return 0;
+}
+
+/* Move whatever is ready in either direction. Returns -1 if the client is gone. */
+static int eb_client_service(struct eb_transport* tcp_transport, struct eb_client* client, eb_user_data_t data, eb_descriptor_callback_t ready, eb_user_data_t watch, eb_descriptor_callback_t watch_fd) {
+  int len, fill;
+  
+  /* Stream to datagrams */
+  len = eb_posix_tcp_poll(tcp_transport, &client->tcp_master, data, ready, &client->rx[client->tail], sizeof(client->rx) - client->tail);
+  if (len < 0) return -1;
+  client->tail += len;
+  
+  if (!client->named) {
+    if (eb_client_name(client, watch, watch_fd) != 0) return -1;
+    if (!client->named) return 0;
+  }
+  
+  eb_posix_udp_send_buffer(&client->udp_transport, 0, 1);
+  while (client->tail - client->head >= EB_TUNNEL_HEADER) {
+    len = ((unsigned int)client->rx[client->head]) << 8 | client->rx[client->head+1];
+    if (len > MAX_MTU) return -1;
+    if (client->tail - client->head < EB_TUNNEL_HEADER + len) break;
+    
+    eb_posix_udp_send(&client->udp_transport, &client->udp_slave, &client->rx[client->head + EB_TUNNEL_HEADER], len);
+    client->head += EB_TUNNEL_HEADER + len;
+  }
+  eb_posix_udp_send_buffer(&client->udp_transport, 0, 0);
+  
+  /* Keep any partial frame at the front */
+  memmove(&client->rx[0], &client->rx[client->head], client->tail - client->head);
+  client->tail -= client->head;
+  client->head = 0;
+  
+  /* Datagrams to stream */
+  fill = 0;
+  while ((len = eb_posix_udp_poll(&client->udp_transport, 0, data, ready, &tx[fill + EB_TUNNEL_HEADER], MAX_MTU)) > 0) {
+    tx[fill]   = (len >> 8) & 0xFF;
+    tx[fill+1] = len & 0xFF;
+    fill += EB_TUNNEL_HEADER + len;
+    
+    if (fill + EB_TUNNEL_HEADER + MAX_MTU > (int)sizeof(tx)) {
+      eb_posix_tcp_send(tcp_transport, &client->tcp_master, &tx[0], fill);
+      fill = 0;
+    }
+  }
+  if (fill > 0) eb_posix_tcp_send(tcp_transport, &client->tcp_master, &tx[0], fill);
+  
+  return len < 0 ? -1 : 0;
+}
+
+static void eb_client_free(struct eb_transport* tcp_transport, struct eb_client* client) {
+  eb_posix_tcp_disconnect(tcp_transport, &client->tcp_master);
+  if (client->named) {
+    eb_posix_udp_disconnect(&client->udp_transport, &client->udp_slave);
+    eb_posix_udp_close(&client->udp_transport);
+  }
+  free(client);
+}
 
 int main(int argc, const char** argv) {
-  struct eb_block_sets sets;
   struct eb_transport tcp_transport;
+  struct eb_link link;
   struct eb_client* first;
   struct eb_client* client;
-  struct eb_client* next;
-  struct eb_client* prev;
-  int len, fail;
+  struct eb_client** prev;
+  eb_user_data_t data, watch;
+  eb_descriptor_callback_t ready, watch_fd;
+  int len;
   eb_status_t err;
-  uint8_t buffer[MAX_MTU+2];
-  uint8_t len_buf[2];
+#ifdef EB_TUNNEL_EPOLL
+  struct epoll_event events[EB_EPOLL_EVENTS];
+  struct eb_watch listen_watch, client_watch;
+  int i, n;
+#else
+  struct eb_block_sets sets;
+#endif
 #ifdef  __WIN32
   WORD wVersionRequested;
   WSADATA wsaData;
@@ -141,14 +236,33 @@ int main(int argc, const char** argv) {
     return 1;
   }
   
-  first = (struct eb_client*)malloc(sizeof(struct eb_client));
-  if (first == 0) {
-    perror("Allocating initial link");
+  first = 0;
+  
+#ifdef EB_TUNNEL_EPOLL
+  if ((listen_watch.epfd = epoll_create(EB_EPOLL_EVENTS)) < 0) {
+    perror("Cannot create epoll descriptor");
     return 1;
   }
-  first->next = 0;
+  listen_watch.client = 0;
+  client_watch.epfd = listen_watch.epfd;
+  eb_posix_tcp_fdes(&tcp_transport, 0, &listen_watch, &eb_watch_fd);
+  
+  /* Only descriptors epoll reported are polled, so all are ready */
+  data = 0;
+  ready = &eb_always_ready;
+  watch = &client_watch;
+  watch_fd = &eb_watch_fd;
+#else
+  data = &sets;
+  ready = &eb_check_sets;
+  watch = 0;
+  watch_fd = 0;
+#endif
   
   while (1) {
+#ifdef EB_TUNNEL_EPOLL
+    if ((n = epoll_wait(listen_watch.epfd, events, EB_EPOLL_EVENTS, -1)) < 0) continue; /* EINTR */
+#else
     /* Block for a link to go active: */
     FD_ZERO(&sets.rfds);
     FD_ZERO(&sets.wfds);
@@ -157,74 +271,63 @@ int main(int argc, const char** argv) {
     /* All all descriptors to blocking list */
     eb_posix_tcp_fdes(&tcp_transport, 0, &sets, &eb_update_sets);
     
-    for (client = first->next; client != 0; client = client->next) {
+    for (client = first; client != 0; client = client->next) {
       eb_posix_tcp_fdes(&tcp_transport, &client->tcp_master, &sets, &eb_update_sets);
-      eb_posix_udp_fdes(&client->udp_transport, 0, &sets, &eb_update_sets);
+      if (client->named) eb_posix_udp_fdes(&client->udp_transport, 0, &sets, &eb_update_sets);
     }
     
     /* Wait for one to go active: */
     select(sets.nfd+1, &sets.rfds, &sets.wfds, 0, 0);
-    
-    /* Now poll all links: */
+#endif
     
     /* TCP accept? */
-    len = 0;
-    while ((len = eb_posix_tcp_accept(&tcp_transport, &first->tcp_master, &sets, &eb_check_sets)) > 0) {
-      first = eb_new_client(&tcp_transport, first);
+    while ((len = eb_posix_tcp_accept(&tcp_transport, &link, data, ready)) > 0) {
+      if ((client = (struct eb_client*)malloc(sizeof(struct eb_client))) == 0) {
+        eb_posix_tcp_disconnect(&tcp_transport, &link);
+        continue;
+      }
+      
+      client->udp_slave = link; /* unused until named */
+      client->tcp_master = link;
+      client->named = 0;
+      client->dead = 0;
+      client->head = 0;
+      client->tail = 0;
+      client->next = first;
+      first = client;
+      
+#ifdef EB_TUNNEL_EPOLL
+      client_watch.client = client;
+      eb_posix_tcp_fdes(&tcp_transport, &client->tcp_master, &client_watch, &eb_watch_fd);
+#endif
     }
     if (len < 0) {
       perror("Failed to accept a connection");
       break;
     }
     
-    prev = first;
-    for (client = prev->next; client != 0; client = next) {
-      next = client->next;
-      
-      fail = 0;
-      
-      len = 0;
-      while ((len = eb_posix_udp_poll(&client->udp_transport, 0, &sets, &eb_check_sets, &buffer[2], MAX_MTU)) > 0) {
-        buffer[0] = (len >> 8) & 0xFF;
-        buffer[1] = len & 0xFF;
-      
-        eb_posix_tcp_send(&tcp_transport, &client->tcp_master, &buffer[0], len+2);
-      }
-      if (len < 0) fail = 1;
-      
-      len = 0;
-      while ((len = eb_posix_tcp_poll(&tcp_transport, &client->tcp_master, &sets, &eb_check_sets, &len_buf[0], 2)) > 0) {
-        if (len == 1)
-          len += eb_posix_tcp_recv(&tcp_transport, &client->tcp_master, &len_buf[1], 1);
-        
-        if (len != 2) {
-          fail = 1;
-          break;
-        }
-        
-        len = ((unsigned int)len_buf[0]) << 8 | len_buf[1];
-        if (len > MAX_MTU) {
-          fail = 1;
-          break;
-        } 
-        
-        if (eb_posix_tcp_recv(&tcp_transport, &client->tcp_master, &buffer[0], len) != len) {
-          fail = 1;
-          break;
-        }
-        
-        eb_posix_udp_send(&client->udp_transport, &client->udp_slave, &buffer[0], len);
-      }
-      if (len < 0) fail = 1;
-      
-      if (fail) {
-        eb_posix_tcp_disconnect(&tcp_transport, &client->tcp_master);
-        eb_posix_udp_disconnect(&client->udp_transport, &client->udp_slave);
-        eb_posix_udp_close(&client->udp_transport);
-        prev->next = client->next;
-        free(client);
+    /* Service the clients with work */
+#ifdef EB_TUNNEL_EPOLL
+    for (i = 0; i < n; ++i) {
+      client = (struct eb_client*)events[i].data.ptr;
+      if (client == 0 || client->dead) continue;
+      client_watch.client = client;
+      if (eb_client_service(&tcp_transport, client, data, ready, watch, watch_fd) != 0)
+        client->dead = 1;
+    }
+#else
+    for (client = first; client != 0; client = client->next)
+      if (eb_client_service(&tcp_transport, client, data, ready, watch, watch_fd) != 0)
+        client->dead = 1;
+#endif
+    
+    /* Closing the descriptors also removes them from epoll */
+    for (prev = &first; (client = *prev) != 0; ) {
+      if (client->dead) {
+        *prev = client->next;
+        eb_client_free(&tcp_transport, client);
       } else {
-        prev = client;
+        prev = &client->next;
       }
     }
   }
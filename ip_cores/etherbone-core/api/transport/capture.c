@@ -0,0 +1,512 @@
+/** @file capture.c
+ *  @brief Record the packets of a socket in a pcapng file.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  The thread running the socket formats each packet into a pcapng block
+ *  and copies it into a ring; a writer thread moves the ring to the file.
+ *  Neither side takes a lock. If the writer falls behind, packets are
+ *  dropped and their number is recorded when the capture stops.
+ *
+ *  Every device is an interface, named by the address it was opened with
+ *  and described as "master" or "slave". Datagrams are wrapped in IPv4/UDP
+ *  headers to port 0xEBD0, so Wireshark's Etherbone dissector decodes them;
+ *  streams are kept raw (LINKTYPE_USER0).
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L /* nanosleep */
+#define ETHERBONE_IMPL
+
+#include "transport.h"
+#include "../glue/socket.h"
+#include "../glue/device.h"
+#include "../memory/memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef __WIN32
+#define EB_CAPTURE_THREADS 1
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#endif
+
+#ifdef EB_CAPTURE_THREADS
+
+#define EB_CAPTURE_RING   (4*1024*1024) /* bytes of formatted blocks; a power of two */
+#define EB_CAPTURE_NAME   64            /* longest interface name kept */
+#define EB_CAPTURE_IDLE   2000000       /* nanoseconds the writer sleeps on an empty ring */
+
+#define EB_PCAPNG_SHB     0x0A0D0D0AU
+#define EB_PCAPNG_IDB     1
+#define EB_PCAPNG_ISB     5
+#define EB_PCAPNG_EPB     6
+#define EB_PCAPNG_MAGIC   0x1A2B3C4DU
+#define EB_LINKTYPE_USER0 147
+#define EB_LINKTYPE_IPV4  228
+#define EB_IPV4_UDP       28 /* bytes of IPv4 and UDP header in front of a datagram */
+
+struct eb_capture_if {
+  eb_device_t device;   /* EB_NULL for the transport itself or a closed device */
+  uint8_t link_type;
+  int id;               /* position among the IDBs written; -1 if not yet written */
+  char name[EB_CAPTURE_NAME];
+  const char* side;
+};
+
+struct eb_capture {
+  /* Written by the socket's thread, read by the writer */
+  uint8_t* ring;
+  volatile uint32_t head; /* advanced by the writer */
+  volatile uint32_t tail; /* advanced by the socket's thread */
+  volatile int stop;
+
+  FILE* file;
+  pthread_t writer;
+
+  /* Only touched by the socket's thread */
+  uint64_t dropped;
+  struct eb_capture_if* ifs;
+  int ifs_count;
+  int ifs_size;
+  int ifs_written;
+  int last; /* interface of the previous packet */
+};
+
+static struct eb_capture* eb_socket_capture_state(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_socket_aux* aux;
+
+  socket = EB_SOCKET(socketp);
+  aux = EB_SOCKET_AUX(socket->aux);
+  return aux->state->capture;
+}
+
+static void eb_capture_put(struct eb_capture* capture, uint32_t* pos, const void* data, uint32_t len) {
+  uint32_t offset, first;
+
+  offset = *pos & (EB_CAPTURE_RING-1);
+  first = EB_CAPTURE_RING - offset;
+  if (first > len) first = len;
+
+  memcpy(capture->ring + offset, data, first);
+  memcpy(capture->ring, (const uint8_t*)data + first, len - first);
+  *pos += len;
+}
+
+static void eb_capture_u32(struct eb_capture* capture, uint32_t* pos, uint32_t value) {
+  eb_capture_put(capture, pos, &value, 4);
+}
+
+static void eb_capture_option(struct eb_capture* capture, uint32_t* pos, uint16_t code, const void* value, uint16_t len) {
+  static const uint8_t zero[4] = { 0, 0, 0, 0 };
+
+  eb_capture_put(capture, pos, &code, 2);
+  eb_capture_put(capture, pos, &len, 2);
+  eb_capture_put(capture, pos, value, len);
+  eb_capture_put(capture, pos, zero, (4 - (len & 3)) & 3);
+}
+
+static uint32_t eb_capture_option_size(uint32_t len) {
+  return 4 + ((len + 3) & ~3U);
+}
+
+/* Room for a block of size bytes? */
+static int eb_capture_room(struct eb_capture* capture, uint32_t size) {
+  uint32_t head;
+
+  head = capture->head;
+  __sync_synchronize(); /* read head before reusing the space it frees */
+  return EB_CAPTURE_RING - (capture->tail - head) >= size;
+}
+
+static void eb_capture_publish(struct eb_capture* capture, uint32_t pos) {
+  __sync_synchronize(); /* the block is complete before the tail moves */
+  capture->tail = pos;
+}
+
+/* Queue the IDB of an interface; 0 if the ring is full */
+static int eb_capture_idb(struct eb_capture* capture, struct eb_capture_if* iface) {
+  uint32_t size, pos, name_len, side_len;
+  uint16_t linktype, reserved;
+
+  name_len = strlen(iface->name);
+  side_len = strlen(iface->side);
+  size = 20 + eb_capture_option_size(name_len) + eb_capture_option_size(side_len) + 4;
+  if (!eb_capture_room(capture, size)) return 0;
+
+  linktype = (eb_transports[iface->link_type].mtu != 0) ? EB_LINKTYPE_IPV4 : EB_LINKTYPE_USER0;
+  reserved = 0;
+
+  pos = capture->tail;
+  eb_capture_u32(capture, &pos, EB_PCAPNG_IDB);
+  eb_capture_u32(capture, &pos, size);
+  eb_capture_put(capture, &pos, &linktype, 2);
+  eb_capture_put(capture, &pos, &reserved, 2);
+  eb_capture_u32(capture, &pos, 0); /* no snap length */
+  eb_capture_option(capture, &pos, 2, iface->name, name_len); /* if_name */
+  eb_capture_option(capture, &pos, 3, iface->side, side_len); /* if_description */
+  eb_capture_u32(capture, &pos, 0); /* opt_endofopt */
+  eb_capture_u32(capture, &pos, size);
+  eb_capture_publish(capture, pos);
+
+  iface->id = capture->ifs_written++;
+  return 1;
+}
+
+static struct eb_capture_if* eb_capture_add(struct eb_capture* capture, eb_device_t devicep, uint8_t link_type, const char* name, const char* side) {
+  struct eb_capture_if* ifs;
+  struct eb_capture_if* iface;
+  int size;
+
+  if (capture->ifs_count == capture->ifs_size) {
+    size = capture->ifs_size ? capture->ifs_size*2 : 16;
+    if ((ifs = (struct eb_capture_if*)realloc(capture->ifs, sizeof(struct eb_capture_if)*size)) == 0)
+      return 0;
+    capture->ifs = ifs;
+    capture->ifs_size = size;
+  }
+
+  iface = &capture->ifs[capture->ifs_count++];
+  iface->device = devicep;
+  iface->link_type = link_type;
+  iface->id = -1;
+  strncpy(iface->name, name, sizeof(iface->name)-1);
+  iface->name[sizeof(iface->name)-1] = 0;
+  iface->side = side;
+
+  eb_capture_idb(capture, iface);
+  return iface;
+}
+
+static struct eb_capture_if* eb_capture_find(struct eb_capture* capture, eb_device_t devicep, uint8_t link_type) {
+  struct eb_capture_if* iface;
+  struct eb_device* device;
+  int i;
+
+  if (capture->last < capture->ifs_count) {
+    iface = &capture->ifs[capture->last];
+    if (iface->device == devicep && iface->link_type == link_type) return iface;
+  }
+
+  for (i = 0; i < capture->ifs_count; ++i) {
+    iface = &capture->ifs[i];
+    if (iface->device == devicep && iface->link_type == link_type) {
+      capture->last = i;
+      return iface;
+    }
+  }
+
+  /* A device opened before the capture started, or the transport itself */
+  if (devicep == EB_NULL)
+    return eb_capture_add(capture, devicep, link_type, "listening", "slave");
+
+  device = EB_DEVICE(devicep);
+  if (device->un_link.passive == devicep)
+    return eb_capture_add(capture, devicep, link_type, "accepted", "slave");
+  else
+    return eb_capture_add(capture, devicep, link_type, "device", "master");
+}
+
+static uint16_t eb_capture_checksum(const uint8_t* header, int len) {
+  uint32_t sum;
+  int i;
+
+  for (sum = 0, i = 0; i < len; i += 2)
+    sum += (header[i] << 8) | header[i+1];
+  while (sum >> 16)
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  return ~sum;
+}
+
+/* What the datagram would have looked like on the loopback interface */
+static void eb_capture_ipv4(uint8_t* header, int outbound, int len) {
+  uint16_t sum;
+
+  memset(header, 0, EB_IPV4_UDP);
+  header[0] = 0x45;
+  header[2] = (EB_IPV4_UDP + len) >> 8;
+  header[3] = (EB_IPV4_UDP + len);
+  header[8] = 64; /* TTL */
+  header[9] = 17; /* UDP */
+  header[12] = 127; header[15] = outbound ? 1 : 2; /* source */
+  header[16] = 127; header[19] = outbound ? 2 : 1; /* destination */
+  sum = eb_capture_checksum(header, 20);
+  header[10] = sum >> 8;
+  header[11] = sum;
+
+  header[20] = 0xEB; header[21] = 0xD0;
+  header[22] = 0xEB; header[23] = 0xD0;
+  header[24] = (8 + len) >> 8;
+  header[25] = (8 + len);
+}
+
+void eb_socket_capture_packet(eb_socket_t socketp, eb_transport_t transportp, eb_device_t devicep, int outbound, const uint8_t* buf, int len) {
+  struct eb_capture* capture;
+  struct eb_capture_if* iface;
+  struct eb_transport* transport;
+  struct timeval now;
+  uint8_t header[EB_IPV4_UDP];
+  uint64_t usec;
+  uint32_t size, pos, caplen, flags;
+  int datagram;
+
+  if ((capture = eb_socket_capture_state(socketp)) == 0 || len <= 0) return;
+
+  transport = EB_TRANSPORT(transportp);
+  if ((iface = eb_capture_find(capture, devicep, transport->link_type)) == 0 ||
+      (iface->id == -1 && !eb_capture_idb(capture, iface))) {
+    ++capture->dropped;
+    return;
+  }
+
+  datagram = eb_transports[iface->link_type].mtu != 0;
+  caplen = len + (datagram ? EB_IPV4_UDP : 0);
+  size = 28 + ((caplen + 3) & ~3U) + 12 + 4;
+
+  if (!eb_capture_room(capture, size)) {
+    ++capture->dropped;
+    return;
+  }
+
+  gettimeofday(&now, 0);
+  usec = (uint64_t)now.tv_sec*1000000 + now.tv_usec;
+  flags = outbound ? 2 : 1;
+
+  pos = capture->tail;
+  eb_capture_u32(capture, &pos, EB_PCAPNG_EPB);
+  eb_capture_u32(capture, &pos, size);
+  eb_capture_u32(capture, &pos, iface->id);
+  eb_capture_u32(capture, &pos, usec >> 32);
+  eb_capture_u32(capture, &pos, (uint32_t)usec);
+  eb_capture_u32(capture, &pos, caplen);
+  eb_capture_u32(capture, &pos, caplen);
+  if (datagram) {
+    eb_capture_ipv4(header, outbound, len);
+    eb_capture_put(capture, &pos, header, EB_IPV4_UDP);
+  }
+  eb_capture_put(capture, &pos, buf, len);
+  eb_capture_put(capture, &pos, "\0\0\0", (4 - (caplen & 3)) & 3);
+  eb_capture_option(capture, &pos, 2, &flags, 4); /* epb_flags: direction */
+  eb_capture_u32(capture, &pos, 0); /* opt_endofopt */
+  eb_capture_u32(capture, &pos, size);
+  eb_capture_publish(capture, pos);
+}
+
+void eb_socket_capture_device(eb_socket_t socketp, eb_transport_t transportp, eb_device_t devicep, const char* address) {
+  struct eb_capture* capture;
+  struct eb_transport* transport;
+  int i;
+
+  if ((capture = eb_socket_capture_state(socketp)) == 0) return;
+
+  /* A new device may reuse the handle of a closed one */
+  for (i = 0; i < capture->ifs_count; ++i)
+    if (capture->ifs[i].device == devicep)
+      capture->ifs[i].device = EB_NULL;
+
+  transport = EB_TRANSPORT(transportp);
+  if (address == 0)
+    eb_capture_add(capture, devicep, transport->link_type, "accepted", "slave");
+  else if (EB_DEVICE(devicep)->un_link.passive == devicep)
+    eb_capture_add(capture, devicep, transport->link_type, address, "slave");
+  else
+    eb_capture_add(capture, devicep, transport->link_type, address, "master");
+}
+
+static void eb_capture_drain(struct eb_capture* capture) {
+  uint32_t head, tail, offset, first;
+
+  head = capture->head;
+  tail = capture->tail;
+  __sync_synchronize(); /* read tail before the blocks it covers */
+
+  while (head != tail) {
+    offset = head & (EB_CAPTURE_RING-1);
+    first = EB_CAPTURE_RING - offset;
+    if (first > tail - head) first = tail - head;
+
+    if (fwrite(capture->ring + offset, 1, first, capture->file) != first) break; /* disk full: keep going */
+    head += first;
+  }
+  fflush(capture->file); /* readable while the capture runs */
+
+  __sync_synchronize(); /* finish copying before the space is reused */
+  capture->head = tail;
+}
+
+static void* eb_capture_writer(void* arg) {
+  struct eb_capture* capture;
+  struct timespec idle;
+  int stop;
+
+  capture = (struct eb_capture*)arg;
+  idle.tv_sec = 0;
+  idle.tv_nsec = EB_CAPTURE_IDLE;
+
+  do {
+    stop = capture->stop;
+    __sync_synchronize(); /* blocks queued before stop are drained below */
+
+    if (capture->head == capture->tail) {
+      if (!stop) nanosleep(&idle, 0);
+    } else {
+      eb_capture_drain(capture);
+    }
+  } while (!stop || capture->head != capture->tail);
+
+  return 0;
+}
+
+static void eb_capture_shb(FILE* file) {
+  static const char application[] = "etherbone";
+  uint32_t block[7], size;
+  uint16_t code, len;
+
+  size = 28 + eb_capture_option_size(sizeof(application)-1) + 4;
+
+  block[0] = EB_PCAPNG_SHB;
+  block[1] = size;
+  block[2] = EB_PCAPNG_MAGIC;
+  block[3] = 1; /* version 1.0 */
+  block[4] = 0xFFFFFFFFU; /* section length unknown */
+  block[5] = 0xFFFFFFFFU;
+  fwrite(block, 4, 6, file);
+
+  code = 4; /* shb_userappl */
+  len = sizeof(application)-1;
+  fwrite(&code, 2, 1, file);
+  fwrite(&len, 2, 1, file);
+  fwrite(application, 1, len, file);
+  fwrite("\0\0\0", 1, (4 - (len & 3)) & 3, file);
+
+  block[0] = 0; /* opt_endofopt */
+  block[1] = size;
+  fwrite(block, 4, 2, file);
+}
+
+/* Record how many packets never made it into the ring */
+static void eb_capture_isb(struct eb_capture* capture) {
+  uint32_t block[5], size;
+  uint16_t code, len;
+
+  if (capture->dropped == 0 || capture->ifs_written == 0) return;
+
+  size = 20 + eb_capture_option_size(8) + 4;
+  block[0] = EB_PCAPNG_ISB;
+  block[1] = size;
+  block[2] = 0; /* interface */
+  block[3] = 0; /* no timestamp */
+  block[4] = 0;
+  fwrite(block, 4, 5, capture->file);
+
+  code = 5; /* isb_ifdrop */
+  len = 8;
+  fwrite(&code, 2, 1, capture->file);
+  fwrite(&len, 2, 1, capture->file);
+  fwrite(&capture->dropped, 8, 1, capture->file);
+
+  block[0] = 0; /* opt_endofopt */
+  block[1] = size;
+  fwrite(block, 4, 2, capture->file);
+}
+
+void eb_socket_capture_free(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_socket_aux* aux;
+  struct eb_capture* capture;
+
+  socket = EB_SOCKET(socketp);
+  aux = EB_SOCKET_AUX(socket->aux);
+
+  if (aux->state == 0 || (capture = aux->state->capture) == 0) return;
+  aux->state->capture = 0;
+
+  capture->stop = 1;
+  pthread_join(capture->writer, 0);
+
+  eb_capture_isb(capture);
+  fclose(capture->file);
+  free(capture->ifs);
+  free(capture->ring);
+  free(capture);
+}
+
+eb_status_t eb_socket_capture(eb_socket_t socketp, const char* filename) {
+  struct eb_socket* socket;
+  struct eb_socket_aux* aux;
+  struct eb_capture* capture;
+
+  eb_socket_capture_free(socketp);
+  if (filename == 0) return EB_OK;
+
+  if ((capture = (struct eb_capture*)malloc(sizeof(struct eb_capture))) == 0)
+    return EB_OOM;
+
+  if ((capture->ring = (uint8_t*)malloc(EB_CAPTURE_RING)) == 0) {
+    free(capture);
+    return EB_OOM;
+  }
+
+  if ((capture->file = fopen(filename, "wb")) == 0) {
+    free(capture->ring);
+    free(capture);
+    return EB_FAIL;
+  }
+
+  capture->head = 0;
+  capture->tail = 0;
+  capture->stop = 0;
+  capture->dropped = 0;
+  capture->ifs = 0;
+  capture->ifs_count = 0;
+  capture->ifs_size = 0;
+  capture->ifs_written = 0;
+  capture->last = 0;
+
+  eb_capture_shb(capture->file);
+
+  if (pthread_create(&capture->writer, 0, &eb_capture_writer, capture) != 0) {
+    fclose(capture->file);
+    free(capture->ring);
+    free(capture);
+    return EB_FAIL;
+  }
+
+  socket = EB_SOCKET(socketp);
+  aux = EB_SOCKET_AUX(socket->aux);
+  aux->state->capture = capture;
+
+  return EB_OK;
+}
+
+#else
+
+void eb_socket_capture_packet(eb_socket_t socketp, eb_transport_t transportp, eb_device_t devicep, int outbound, const uint8_t* buf, int len) { }
+void eb_socket_capture_device(eb_socket_t socketp, eb_transport_t transportp, eb_device_t devicep, const char* address) { }
+void eb_socket_capture_free(eb_socket_t socketp) { }
+
+eb_status_t eb_socket_capture(eb_socket_t socketp, const char* filename) {
+  return filename ? EB_FAIL : EB_OK;
+}
+
+#endif
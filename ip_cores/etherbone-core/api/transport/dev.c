@@ -6,6 +6,14 @@
  *  The transport carries a port for accepting inbound connections.
  *  Passive devices are created for inbound connections.
  *
+ *  Serial options may follow the device name after a '?', separated by '&':
+ *    baud=<rate>        line rate (default 115200; up to 4000000 on Linux)
+ *    frame=<8N1>        data bits, parity (N/E/O) and stop bits
+ *    flow=<none|rtscts> hardware flow control
+ *    lowlatency=<0|1>   ask the driver not to hold back input (default 1)
+ *    flush=<0|1>        discard stale input when connecting (default 1)
+ *  eg: dev/ttyUSB0?baud=3000000&lowlatency=1
+ *
  *  @author Wesley W. Terpstra <w.terpstra@gsi.de>
  *
  *  @bug None!
@@ -37,24 +45,209 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
 #include <string.h>
 #include <termios.h>
 
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#endif
+
 #ifndef O_BINARY
 #define O_BINARY 0
 #endif
 
-static void eb_dev_set_blocking(struct eb_dev_link* link, int block) {
-  int flags;
+#ifndef CRTSCTS
+#define CRTSCTS 0
+#endif
+
+struct eb_dev_speed {
+  long baud;
+  speed_t speed;
+};
+
+static const struct eb_dev_speed eb_dev_speeds[] = {
+  { 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 },
+#ifdef B57600
+  { 57600, B57600 },
+#endif
+#ifdef B115200
+  { 115200, B115200 },
+#endif
+#ifdef B230400
+  { 230400, B230400 },
+#endif
+#ifdef B460800
+  { 460800, B460800 },
+#endif
+#ifdef B500000
+  { 500000, B500000 },
+#endif
+#ifdef B921600
+  { 921600, B921600 },
+#endif
+#ifdef B1000000
+  { 1000000, B1000000 },
+#endif
+#ifdef B1500000
+  { 1500000, B1500000 },
+#endif
+#ifdef B2000000
+  { 2000000, B2000000 },
+#endif
+#ifdef B3000000
+  { 3000000, B3000000 },
+#endif
+#ifdef B4000000
+  { 4000000, B4000000 },
+#endif
+  { 0, 0 }
+};
+
+/* Options which follow the device name, eg: dev/ttyUSB0?baud=3000000&frame=8E1 */
+struct eb_dev_options {
+  long baud;
+  speed_t speed;
+  tcflag_t cflag;   /* CSIZE, PARENB, PARODD, CSTOPB and CRTSCTS */
+  int low_latency;
+  int flush;        /* discard what the last user left unread */
+};
+
+static int eb_dev_flag(const char* value, int* out) {
+  if (!strcmp(value, "0") || !strcmp(value, "off")) { *out = 0; return 0; }
+  if (!strcmp(value, "1") || !strcmp(value, "on"))  { *out = 1; return 0; }
+  return -1;
+}
+
+static int eb_dev_frame(const char* value, tcflag_t* cflag) {
+  tcflag_t out;
+  
+  if (strlen(value) != 3) return -1;
+  
+  switch (value[0]) {
+  case '5': out = CS5; break;
+  case '6': out = CS6; break;
+  case '7': out = CS7; break;
+  case '8': out = CS8; break;
+  default: return -1;
+  }
+  
+  switch (value[1]) {
+  case 'N': case 'n': break;
+  case 'E': case 'e': out |= PARENB; break;
+  case 'O': case 'o': out |= PARENB | PARODD; break;
+  default: return -1;
+  }
+  
+  switch (value[2]) {
+  case '1': break;
+  case '2': out |= CSTOPB; break;
+  default: return -1;
+  }
+  
+  *cflag = (*cflag & CRTSCTS) | out;
+  return 0;
+}
+
+static int eb_dev_option(struct eb_dev_options* options, char* option) {
+  const struct eb_dev_speed* s;
+  char* value;
+  char* end;
+  int on;
+  
+  if ((value = strchr(option, '=')) == 0) return -1;
+  *value++ = 0;
+  
+  if (!strcmp(option, "baud")) {
+    options->baud = strtol(value, &end, 10);
+    if (*end != 0) return -1;
+    for (s = &eb_dev_speeds[0]; s->baud != 0; ++s)
+      if (s->baud == options->baud) break;
+    if (s->baud == 0) return -1;
+    options->speed = s->speed;
+    return 0;
+  }
+  
+  if (!strcmp(option, "frame"))
+    return eb_dev_frame(value, &options->cflag);
+  
+  if (!strcmp(option, "flow")) {
+    if (!strcmp(value, "none")) {
+      options->cflag &= ~CRTSCTS;
+    } else if (!strcmp(value, "rtscts") && CRTSCTS != 0) {
+      options->cflag |= CRTSCTS;
+    } else {
+      return -1;
+    }
+    return 0;
+  }
+  
+  if (!strcmp(option, "lowlatency")) {
+    if (eb_dev_flag(value, &on) != 0) return -1;
+    options->low_latency = on;
+    return 0;
+  }
+  
+  if (!strcmp(option, "flush")) {
+    if (eb_dev_flag(value, &on) != 0) return -1;
+    options->flush = on;
+    return 0;
+  }
+  
+  return -1;
+}
+
+/* Split "name?opt=val&opt=val" into devpath and options */
+static int eb_dev_parse(const char* devname, char* devpath, struct eb_dev_options* options) {
+  char* query;
+  char* option;
+  char* next;
+  
+  options->baud = 115200;
+  options->speed = B115200;
+  options->cflag = CS8;
+  options->low_latency = 1;
+  options->flush = 1;
+  
+  strcpy(devpath, "/dev/");
+  strcat(devpath, devname);
   
-  flags = (link->flags & ~O_NONBLOCK) | (block?0:O_NONBLOCK);
-  if (flags != link->flags) {
-    fcntl(link->fdes, F_SETFL, flags);
-    link->flags = flags;
+  if ((query = strchr(devpath, '?')) == 0) return 0;
+  *query++ = 0;
+  
+  for (option = query; option != 0; option = next) {
+    if ((next = strchr(option, '&')) != 0) *next++ = 0;
+    if (eb_dev_option(options, option) != 0) return -1;
   }
+  
+  return 0;
 }
 
-static int eb_dev_ewouldblock() {
+static void eb_dev_low_latency(int fdes) {
+#if defined(__linux__) && defined(ASYNC_LOW_LATENCY)
+  struct serial_struct serial;
+  
+  /* Not every driver has this (ptys, some CDC-ACM); it is only a hint */
+  if (ioctl(fdes, TIOCGSERIAL, &serial) == 0) {
+    serial.flags |= ASYNC_LOW_LATENCY;
+    ioctl(fdes, TIOCSSERIAL, &serial);
+  }
+#endif
+}
+
+/* The descriptor stays non-blocking; calls which must block wait here */
+static void eb_dev_wait(int fdes, short events) {
+  struct pollfd pfd;
+  
+  pfd.fd = fdes;
+  pfd.events = events;
+  pfd.revents = 0;
+  poll(&pfd, 1, -1);
+}
+
+static int eb_dev_ewouldblock(void) {
   return (errno == EAGAIN || errno == EWOULDBLOCK);
 }
 
@@ -69,10 +262,12 @@ void eb_dev_close(struct eb_transport* transportp) {
 
 eb_status_t eb_dev_connect(struct eb_transport* transportp, struct eb_link* linkp, const char* address, int passive) {
   struct eb_dev_link* link;
+  struct eb_dev_options options;
   struct termios ios;
   const char* devname;
   char devpath[256];
   char junk[256];
+  long wait;
   int fdes;
   
   link = (struct eb_dev_link*)linkp;
@@ -84,28 +279,36 @@ eb_status_t eb_dev_connect(struct eb_transport* transportp, struct eb_link* link
   if (strlen(devname) > 200)
     return EB_ADDRESS;
   
-  strcpy(devpath, "/dev/");
-  strncat(devpath, devname, sizeof(devpath)-8);
+  if (eb_dev_parse(devname, devpath, &options) != 0)
+    return EB_ADDRESS;
   
-  if ((fdes = open(devpath, O_BINARY | O_RDWR)) == -1) {
+  /* Non-blocking for good: a missing carrier must not hang open either */
+  if ((fdes = open(devpath, O_BINARY | O_RDWR | O_NOCTTY | O_NONBLOCK)) == -1) {
     return EB_FAIL;
   }
   
   link->fdes = fdes;
-  link->flags = fcntl(fdes, F_GETFL, 0);
-
+  
   // If this is a serial device, enter raw mode
   if (tcgetattr(fdes, &ios) == 0) {
     cfmakeraw(&ios);
-    cfsetispeed(&ios, B115200);
-    cfsetospeed(&ios, B115200);
+    ios.c_cflag &= ~(CSIZE | PARENB | PARODD | CSTOPB | CRTSCTS);
+    ios.c_cflag |= options.cflag | CLOCAL | CREAD;
+    ios.c_cc[VMIN] = 1;
+    ios.c_cc[VTIME] = 0;
+    cfsetispeed(&ios, options.speed);
+    cfsetospeed(&ios, options.speed);
     tcsetattr(fdes, TCSANOW, &ios);
+    
+    if (options.low_latency) eb_dev_low_latency(fdes);
   }
   
-  eb_dev_set_blocking(link, 0);
   /* Discard any data unread by last user */
-  if (!passive) {
-    usleep(10000); /* 10 ms */
+  if (!passive && options.flush) {
+    /* Let ~256 characters still on the wire arrive, at most 10 ms */
+    wait = 2560000000L / options.baud;
+    usleep(wait < 10000 ? wait : 10000);
+    tcflush(fdes, TCIFLUSH);
     while (read(fdes, junk, sizeof(junk)) > 0) { }
   }
   
@@ -145,8 +348,6 @@ int eb_dev_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_
   if (!(*ready)(data, link->fdes, EB_DESCRIPTOR_IN))
     return 0;
   
-  /* Set non-blocking */
-  eb_dev_set_blocking(link, 0);
   result = read(link->fdes, (char*)buf, len);
   
   if (result == -1 && eb_dev_ewouldblock()) return 0;
@@ -161,28 +362,39 @@ int eb_dev_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t*
   if (linkp == 0) return 0;
   
   link = (struct eb_dev_link*)linkp;
-
-  /* Set blocking */
-  eb_dev_set_blocking(link, 1);
-
-  result = read(link->fdes, buf, len);
   
-  /* EAGAIN impossible on blocking read */
+  /* The rest of a record is due; wait for it */
+  while ((result = read(link->fdes, buf, len)) == -1) {
+    if (eb_dev_ewouldblock()) {
+      eb_dev_wait(link->fdes, POLLIN);
+    } else if (errno != EINTR) {
+      return -1;
+    }
+  }
+  
   if (result == 0) return -1;
   return result;
 }
 
 void eb_dev_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len) {
   struct eb_dev_link* link;
+  int result;
   
   /* linkp == 0 impossible if poll == 0 returns 0 */
   
   link = (struct eb_dev_link*)linkp;
   
-  /* Set blocking */
-  eb_dev_set_blocking(link, 1);
-
-  write(link->fdes, buf, len);
+  /* A fast line fills the output queue; keep writing as it drains */
+  while (len > 0) {
+    if ((result = write(link->fdes, buf, len)) > 0) {
+      buf += result;
+      len -= result;
+    } else if (result == -1 && eb_dev_ewouldblock()) {
+      eb_dev_wait(link->fdes, POLLOUT);
+    } else if (result == 0 || errno != EINTR) {
+      return; /* the device is gone; recv will notice */
+    }
+  }
 }
 
 void eb_dev_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on) {
@@ -45,13 +45,12 @@ EB_PRIVATE void eb_dev_send(struct eb_transport* transportp, struct eb_link* lin
 EB_PRIVATE void eb_dev_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on);
 
 struct eb_dev_transport {
-  /* Contents must fit in 9 bytes */
+  /* Contents must fit in 16 bytes */
 };
 
 struct eb_dev_link {
   /* Contents must fit in 12 bytes */
-  int fdes;
-  int flags;
+  int fdes; /* always O_NONBLOCK */
 };
 
 #endif
@@ -74,7 +74,9 @@ struct eb_transport_ops eb_transports[] = {
     eb_lm32_udp_poll,
     eb_lm32_udp_recv,
     eb_lm32_udp_send,
-    eb_lm32_udp_send_buffer
+    eb_lm32_udp_send_buffer,
+    0,
+    0
 }
 };
 
@@ -281,6 +283,20 @@ EB_PRIVATE void eb_lm32_udp_send(struct eb_transport* transportp, struct eb_link
 
 
 int eb_socket_run(eb_socket_t socket, int timeout_us) {return 0;}
+void eb_socket_run_add(eb_socket_t socket, eb_transport_t transport, eb_link_t link, eb_device_t device) {}
+void eb_socket_run_del(eb_socket_t socket, eb_transport_t transport, eb_link_t link) {}
+void eb_socket_run_free(eb_socket_t socket) {}
+void eb_socket_run_descriptor(eb_socket_t socket, eb_descriptor_t fd, uint8_t mode) {}
+uint32_t eb_socket_run_clock(void) {return 0;}
+eb_status_t eb_socket_stats_enable(eb_socket_t socket) {return EB_FAIL;}
+eb_status_t eb_socket_stats(eb_socket_t socket, struct eb_socket_stats* stats) {return EB_FAIL;}
+void eb_socket_queue_drain(eb_socket_t socket) {}
+void eb_socket_queue_free(eb_socket_t socket) {}
+void eb_socket_queue_fdes(eb_socket_t socket, eb_user_data_t user, eb_descriptor_callback_t cb) {}
+void eb_socket_capture_packet(eb_socket_t socket, eb_transport_t transport, eb_device_t device, int outbound, const uint8_t* buf, int len) {}
+void eb_socket_capture_device(eb_socket_t socket, eb_transport_t transport, eb_device_t device, const char* address) {}
+void eb_socket_capture_free(eb_socket_t socket) {}
+eb_status_t eb_socket_capture(eb_socket_t socket, const char* filename) {return filename ? EB_FAIL : EB_OK;}
 EB_PRIVATE void eb_lm32_udp_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on) {};
 EB_PRIVATE void eb_lm32_udp_fdes(struct eb_transport* transportp, struct eb_link* link, eb_user_data_t data, eb_descriptor_callback_t cb) {};
 EB_PRIVATE int eb_lm32_udp_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len) {return 0;}
@@ -79,6 +79,14 @@ struct eb_transport_ops {
    /* This allows for a clear demarkation of where the socket should enable/disable buffering */
    void (*send)(struct eb_transport*, struct eb_link* link, const uint8_t* buf, int len);
    void (*send_buffer)(struct eb_transport*, struct eb_link* link, int start); /* upon creation, should be 0 */
+   
+   /* Optional (0 if unsupported): let the flush format directly into a transport-owned buffer.
+    * claim returns a buffer of *len (>= mtu) bytes, or 0 if one is already claimed.
+    * commit sends the first len bytes of the claimed buffer (0 just releases it).
+    * The next claim never returns the buffer just committed.
+    */
+   uint8_t* (*claim) (struct eb_transport*, struct eb_link* link, int* len);
+   void     (*commit)(struct eb_transport*, struct eb_link* link, int len);
 };
 
 EB_PRIVATE eb_status_t eb_lm32_udp_open(struct eb_transport* transport, const char* port);
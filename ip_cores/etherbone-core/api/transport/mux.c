@@ -0,0 +1,161 @@
+/** @file mux.c
+ *  @brief This implements devices shared through the eb-mux daemon.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  A mux/<target> device is a local socket to eb-mux, which keeps one
+ *  already-probed link per target and forwards the cycles of every client.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#ifndef __WIN32
+
+#include "mux.h"
+#include "transport.h"
+#include "../glue/strncasecmp.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+eb_status_t eb_mux_open(struct eb_transport* transportp, const char* port) {
+  /* noop */
+  return EB_OK;
+}
+
+void eb_mux_close(struct eb_transport* transportp) {
+  /* noop */
+}
+
+eb_status_t eb_mux_connect(struct eb_transport* transportp, struct eb_link* linkp, const char* address, int passive) {
+  struct eb_mux_link* link;
+  struct sockaddr_un sun;
+  const char* path;
+  const char* target;
+  int fdes;
+  
+  link = (struct eb_mux_link*)linkp;
+  
+  if (eb_strncasecmp(address, "mux/", 4))
+    return EB_ADDRESS;
+  
+  target = address + 4;
+  if (strlen(target) == 0 || strlen(target) > 200)
+    return EB_ADDRESS;
+  
+  if ((path = getenv("EB_MUX_SOCKET")) == 0)
+    path = EB_MUX_SOCKET;
+  if (strlen(path) >= sizeof(sun.sun_path))
+    return EB_ADDRESS;
+  
+  memset(&sun, 0, sizeof(sun));
+  sun.sun_family = AF_UNIX;
+  strcpy(sun.sun_path, path);
+  
+  if ((fdes = socket(AF_UNIX, SOCK_SEQPACKET, 0)) == -1)
+    return EB_FAIL;
+  
+  if (connect(fdes, (struct sockaddr*)&sun, sizeof(sun)) != 0) {
+    close(fdes);
+    return EB_FAIL;
+  }
+  
+  /* Do not wait for the daemon to reach the target: it might be us.
+   * If it cannot, it hangs up and the next poll reports the link gone.
+   */
+  if (send(fdes, target, strlen(target)+1, MSG_NOSIGNAL) == -1) {
+    close(fdes);
+    return EB_FAIL;
+  }
+  
+  link->fdes = fdes;
+  return EB_OK;
+}
+
+void eb_mux_disconnect(struct eb_transport* transport, struct eb_link* linkp) {
+  struct eb_mux_link* link;
+  
+  link = (struct eb_mux_link*)linkp;
+  close(link->fdes);
+}
+
+void eb_mux_fdes(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t cb) {
+  struct eb_mux_link* link;
+  
+  if (linkp) {
+    link = (struct eb_mux_link*)linkp;
+    (*cb)(data, link->fdes, EB_DESCRIPTOR_IN);
+  }
+}
+
+int eb_mux_accept(struct eb_transport* transportp, struct eb_link* result_linkp, eb_user_data_t data, eb_descriptor_callback_t ready) {
+  /* Mux does not make child connections */
+  return 0;
+}
+
+int eb_mux_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int len) {
+  struct eb_mux_link* link;
+  int result;
+  
+  if (linkp == 0) return 0;
+  
+  link = (struct eb_mux_link*)linkp;
+  
+  /* Should we check? */
+  if (!(*ready)(data, link->fdes, EB_DESCRIPTOR_IN))
+    return 0;
+  
+  result = recv(link->fdes, (char*)buf, len, MSG_DONTWAIT);
+  
+  if (result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+  if (result == 0) return -1; /* the daemon went away */
+  return result;
+}
+
+int eb_mux_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len) {
+  /* Should never happen on a non-stream socket */
+  return -1;
+}
+
+void eb_mux_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len) {
+  struct eb_mux_link* link;
+  
+  /* linkp == 0 impossible if poll == 0 returns 0 */
+  
+  link = (struct eb_mux_link*)linkp;
+  
+  /* If the daemon is gone, the next poll reports it */
+  send(link->fdes, (const char*)buf, len, MSG_NOSIGNAL);
+}
+
+void eb_mux_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on) {
+  /* noop */
+}
+
+#endif
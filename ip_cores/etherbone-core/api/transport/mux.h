@@ -0,0 +1,62 @@
+/** @file mux.h
+ *  @brief This implements devices shared through the eb-mux daemon.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  A mux/<target> device is a local socket to eb-mux, which keeps one
+ *  already-probed link per target and forwards the cycles of every client.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+
+#ifndef EB_MUX_H
+#define EB_MUX_H
+
+#include "posix-udp.h"
+#include "transport.h"
+
+/* Packets to the daemon keep their boundaries, so it can relay them to UDP targets.
+ * As with udp/, a cycle must fit in one packet, whatever the target.
+ */
+#define EB_MUX_MTU EB_POSIX_UDP_MTU
+
+/* Where eb-mux listens, unless EB_MUX_SOCKET is set in the environment */
+#define EB_MUX_SOCKET "/tmp/eb-mux"
+
+EB_PRIVATE eb_status_t eb_mux_open(struct eb_transport* transport, const char* port);
+EB_PRIVATE void eb_mux_close(struct eb_transport* transport);
+EB_PRIVATE eb_status_t eb_mux_connect(struct eb_transport* transport, struct eb_link* link, const char* address, int passive);
+EB_PRIVATE void eb_mux_disconnect(struct eb_transport* transport, struct eb_link* link);
+EB_PRIVATE void eb_mux_fdes(struct eb_transport*, struct eb_link* link, eb_user_data_t data, eb_descriptor_callback_t cb);
+EB_PRIVATE int eb_mux_accept(struct eb_transport*, struct eb_link* result_link, eb_user_data_t data, eb_descriptor_callback_t ready);
+EB_PRIVATE int eb_mux_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int len);
+EB_PRIVATE int eb_mux_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len);
+EB_PRIVATE void eb_mux_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len);
+EB_PRIVATE void eb_mux_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on);
+
+struct eb_mux_transport {
+  /* Contents must fit in 16 bytes */
+};
+
+struct eb_mux_link {
+  /* Contents must fit in 12 bytes */
+  int fdes;
+};
+
+#endif
@@ -32,6 +32,58 @@
 #include "posix-tcp.h"
 #include "transport.h"
 
+#ifdef EB_POSIX_TCP_WRITEV
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+/* A flush formats its records straight into these chunks.
+ * They leave in a single writev when the flush ends or all are full.
+ */
+#define EB_POSIX_TCP_CHUNKS 8
+#define EB_POSIX_TCP_CHUNK  16384
+
+/* The chunks of one transport; allocated on the first claim */
+struct eb_posix_tcp_queue {
+  uint8_t chunk[EB_POSIX_TCP_CHUNKS][EB_POSIX_TCP_CHUNK];
+  struct iovec iov[EB_POSIX_TCP_CHUNKS];
+  eb_posix_sock_t sock;
+  int fill;  /* committed chunks */
+  int claim; /* chunk fill is handed out */
+};
+
+static void eb_posix_tcp_writev(struct eb_posix_tcp_queue* queue) {
+  struct iovec* iov;
+  int cnt;
+  ssize_t got;
+  
+  if (queue == 0) return;
+  
+  iov = &queue->iov[0];
+  cnt = queue->fill;
+  queue->fill = 0;
+  
+  if (cnt == 0) return;
+  eb_posix_ip_non_blocking(queue->sock, 0);
+  
+  while (cnt > 0) {
+    got = writev(queue->sock, iov, cnt);
+    if (got <= 0) {
+      if (got == -1 && errno == EINTR) continue;
+      return; /* the peer is gone; recv will notice */
+    }
+    
+    /* A blocking writev can still be cut short by a signal */
+    for (; cnt > 0 && (size_t)got >= iov->iov_len; ++iov, --cnt)
+      got -= iov->iov_len;
+    if (cnt > 0) {
+      iov->iov_base = (uint8_t*)iov->iov_base + got;
+      iov->iov_len -= got;
+    }
+  }
+}
+#endif
+
 eb_status_t eb_posix_tcp_open(struct eb_transport* transportp, const char* port) {
   struct eb_posix_tcp_transport* transport;
   eb_posix_sock_t sock4, sock6;
@@ -63,6 +115,9 @@ eb_status_t eb_posix_tcp_open(struct eb_transport* transportp, const char* port)
   transport = (struct eb_posix_tcp_transport*)transportp;
   transport->port4 = sock4;
   transport->port6 = sock6;
+#ifdef EB_POSIX_TCP_WRITEV
+  transport->queue = 0;
+#endif
 
   return EB_OK;
 }
@@ -73,6 +128,10 @@ void eb_posix_tcp_close(struct eb_transport* transportp) {
   transport = (struct eb_posix_tcp_transport*)transportp;
   eb_posix_ip_close(transport->port4);
   eb_posix_ip_close(transport->port6);
+#ifdef EB_POSIX_TCP_WRITEV
+  eb_posix_tcp_writev(transport->queue);
+  free(transport->queue);
+#endif
 }
 
 eb_status_t eb_posix_tcp_connect(struct eb_transport* transportp, struct eb_link* linkp, const char* address, int passive) {
@@ -198,11 +257,20 @@ int eb_posix_tcp_recv(struct eb_transport* transportp, struct eb_link* linkp, ui
 
 void eb_posix_tcp_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len) {
   struct eb_posix_tcp_link* link;
+#ifdef EB_POSIX_TCP_WRITEV
+  struct eb_posix_tcp_transport* transport;
+#endif
   
   /* linkp == 0 impossible if poll == 0 returns 0 */
   
   link = (struct eb_posix_tcp_link*)linkp;
   
+#ifdef EB_POSIX_TCP_WRITEV
+  /* Keep the stream in order behind any committed chunks */
+  transport = (struct eb_posix_tcp_transport*)transportp;
+  eb_posix_tcp_writev(transport->queue);
+#endif
+  
   /* Set blocking */
   eb_posix_ip_non_blocking(link->socket, 0);
 
@@ -211,7 +279,68 @@ void eb_posix_tcp_send(struct eb_transport* transportp, struct eb_link* linkp, c
 
 void eb_posix_tcp_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on) {
   struct eb_posix_tcp_link* link;
+#ifdef EB_POSIX_TCP_WRITEV
+  struct eb_posix_tcp_transport* transport;
+  
+  transport = (struct eb_posix_tcp_transport*)transportp;
+  if (!on) eb_posix_tcp_writev(transport->queue);
+#endif
   
   link = (struct eb_posix_tcp_link*)linkp;
   eb_posix_ip_set_buffer(link->socket, on);
 }
+
+#ifdef EB_POSIX_TCP_WRITEV
+uint8_t* eb_posix_tcp_claim(struct eb_transport* transportp, struct eb_link* linkp, int* len) {
+  struct eb_posix_tcp_transport* transport;
+  struct eb_posix_tcp_queue* queue;
+  
+  transport = (struct eb_posix_tcp_transport*)transportp;
+  
+  /* Without the chunks, the caller falls back to send */
+  if ((queue = transport->queue) == 0) {
+    if ((queue = (struct eb_posix_tcp_queue*)malloc(sizeof(struct eb_posix_tcp_queue))) == 0) return 0;
+    queue->fill = 0;
+    queue->claim = 0;
+    transport->queue = queue;
+  }
+  
+  if (queue->claim != 0) return 0;
+  
+  if (queue->fill == EB_POSIX_TCP_CHUNKS)
+    eb_posix_tcp_writev(queue);
+  
+  queue->claim = queue->fill + 1;
+  *len = EB_POSIX_TCP_CHUNK;
+  return &queue->chunk[queue->fill][0];
+}
+
+void eb_posix_tcp_commit(struct eb_transport* transportp, struct eb_link* linkp, int len) {
+  struct eb_posix_tcp_transport* transport;
+  struct eb_posix_tcp_queue* queue;
+  struct eb_posix_tcp_link* link;
+  int slot;
+  
+  transport = (struct eb_posix_tcp_transport*)transportp;
+  link = (struct eb_posix_tcp_link*)linkp;
+  queue = transport->queue;
+  
+  slot = queue->claim - 1;
+  queue->claim = 0;
+  
+  if (len == 0) return;
+  
+  /* Chunks queued for another connection must go first */
+  if (queue->fill > 0 && queue->sock != link->socket)
+    eb_posix_tcp_writev(queue);
+  
+  /* Only a nested send could have emptied the list under the claim */
+  if (slot != queue->fill)
+    memcpy(&queue->chunk[queue->fill][0], &queue->chunk[slot][0], len);
+  
+  queue->sock = link->socket;
+  queue->iov[queue->fill].iov_base = &queue->chunk[queue->fill][0];
+  queue->iov[queue->fill].iov_len = len;
+  ++queue->fill;
+}
+#endif
@@ -34,6 +34,10 @@
 
 #define EB_POSIX_TCP_MTU 0
 
+#ifndef __WIN32
+#define EB_POSIX_TCP_WRITEV 1
+#endif
+
 EB_PRIVATE eb_status_t eb_posix_tcp_open(struct eb_transport* transport, const char* port);
 EB_PRIVATE void eb_posix_tcp_close(struct eb_transport* transport);
 EB_PRIVATE eb_status_t eb_posix_tcp_connect(struct eb_transport* transport, struct eb_link* link, const char* address, int passive);
@@ -44,13 +48,21 @@ EB_PRIVATE int eb_posix_tcp_poll(struct eb_transport* transportp, struct eb_link
 EB_PRIVATE int eb_posix_tcp_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len);
 EB_PRIVATE void eb_posix_tcp_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len);
 EB_PRIVATE void eb_posix_tcp_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on);
+#ifdef EB_POSIX_TCP_WRITEV
+EB_PRIVATE uint8_t* eb_posix_tcp_claim(struct eb_transport* transportp, struct eb_link* linkp, int* len);
+EB_PRIVATE void eb_posix_tcp_commit(struct eb_transport* transportp, struct eb_link* linkp, int len);
+#endif
 
+struct eb_posix_tcp_queue;
 struct eb_posix_tcp_transport {
-  /* Contents must fit in 9 bytes */
+  /* Contents must fit in 16 bytes */
   eb_posix_sock_t port4; /* IPv4 */
 #ifndef EB_DISABLE_IPV6
   eb_posix_sock_t port6; /* IPv6 */
 #endif
+#ifdef EB_POSIX_TCP_WRITEV
+  struct eb_posix_tcp_queue* queue; /* writev chunks of a flush */
+#endif
 };
 
 struct eb_posix_tcp_link {
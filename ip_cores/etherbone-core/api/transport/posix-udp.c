@@ -28,6 +28,10 @@
 
 #define ETHERBONE_IMPL
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* sendmmsg, recvmmsg, struct mmsghdr */
+#endif
+
 /* #define PACKET_DEBUG 1 */
 
 #include "posix-ip.h"
@@ -42,8 +46,39 @@
 #include <stdio.h>
 #endif
 
+/* Datagrams are queued so that a burst costs one sendmmsg/recvmmsg */
+#define EB_POSIX_UDP_BATCH 16
+
+struct eb_posix_udp_packet {
+  struct sockaddr_storage sa;
+  socklen_t sa_len;
+  eb_posix_sock_t sock;
+  int len;
+  uint8_t buf[EB_POSIX_UDP_MTU];
+};
+
+/* The queues of one transport */
+struct eb_posix_udp_queue {
+  struct eb_posix_udp_packet tx[EB_POSIX_UDP_BATCH];
+  struct eb_posix_udp_packet rx[EB_POSIX_UDP_BATCH];
+  int tx_fill;  /* queued for send */
+  int tx_hold;  /* send_buffer(1) is active */
+  int rx_head;  /* next to hand to eb_device_slave */
+  int rx_fill;  /* received */
+  int tx_claim; /* 1+slot handed out by eb_posix_udp_claim, else 0 */
+  
+  /* Sender of the datagram being processed */
+  struct sockaddr_storage sa;
+  socklen_t sa_len;
+};
+
+static struct eb_udp_counters eb_posix_udp_counters;
+
+static void eb_posix_udp_flush(struct eb_posix_udp_queue* queue);
+
 eb_status_t eb_posix_udp_open(struct eb_transport* transportp, const char* port) {
   struct eb_posix_udp_transport* transport;
+  struct eb_posix_udp_queue* queue;
   eb_posix_sock_t sock4, sock6;
   
   sock4 = eb_posix_ip_open(PF_INET, SOCK_DGRAM, port);
@@ -57,9 +92,23 @@ eb_status_t eb_posix_udp_open(struct eb_transport* transportp, const char* port)
   if (sock4 == -1 && sock6 == -1) 
     return EB_BUSY;
   
+  if ((queue = (struct eb_posix_udp_queue*)malloc(sizeof(struct eb_posix_udp_queue))) == 0) {
+    eb_posix_ip_close(sock4);
+    eb_posix_ip_close(sock6);
+    return EB_OOM;
+  }
+  
+  queue->tx_fill = 0;
+  queue->tx_hold = 0;
+  queue->rx_head = 0;
+  queue->rx_fill = 0;
+  queue->tx_claim = 0;
+  queue->sa_len = 0;
+  
   transport = (struct eb_posix_udp_transport*)transportp;
   transport->socket4 = sock4;
   transport->socket6 = sock6;
+  transport->queue = queue;
   
   return EB_OK;
 }
@@ -68,8 +117,10 @@ void eb_posix_udp_close(struct eb_transport* transportp) {
   struct eb_posix_udp_transport* transport;
   
   transport = (struct eb_posix_udp_transport*)transportp;
+  eb_posix_udp_flush(transport->queue);
   eb_posix_ip_close(transport->socket4);
   eb_posix_ip_close(transport->socket6);
+  free(transport->queue);
 }
 
 eb_status_t eb_posix_udp_connect(struct eb_transport* transportp, struct eb_link* linkp, const char* address, int passive) {
@@ -130,37 +181,135 @@ int eb_posix_udp_accept(struct eb_transport* transportp, struct eb_link* result_
   return 0;
 }
 
-/* !!! global is not the best approach. break multi-threading. */
-static struct sockaddr_storage eb_posix_udp_sa;
-static socklen_t eb_posix_udp_sa_len;
+#if defined(__linux__) && !defined(EB_DISABLE_MMSG)
+#define EB_POSIX_UDP_MMSG 1
+#endif
+
+static void eb_posix_udp_flush(struct eb_posix_udp_queue* queue) {
+  struct eb_posix_udp_packet* packet;
+  int i, j, sent;
+#ifdef EB_POSIX_UDP_MMSG
+  struct mmsghdr msgs[EB_POSIX_UDP_BATCH];
+  struct iovec iov[EB_POSIX_UDP_BATCH];
+#endif
+
+  for (i = 0; i < queue->tx_fill; i = j) {
+    /* Group consecutive datagrams leaving by the same socket */
+    packet = &queue->tx[i];
+    for (j = i+1; j < queue->tx_fill && queue->tx[j].sock == packet->sock; ++j) { }
+    
+    eb_posix_ip_non_blocking(packet->sock, 0);
+    
+#ifdef EB_POSIX_UDP_MMSG
+    memset(&msgs[0], 0, sizeof(msgs[0])*(j-i));
+    for (sent = i; sent < j; ++sent) {
+      iov[sent-i].iov_base = queue->tx[sent].buf;
+      iov[sent-i].iov_len  = queue->tx[sent].len;
+      msgs[sent-i].msg_hdr.msg_name    = &queue->tx[sent].sa;
+      msgs[sent-i].msg_hdr.msg_namelen = queue->tx[sent].sa_len;
+      msgs[sent-i].msg_hdr.msg_iov     = &iov[sent-i];
+      msgs[sent-i].msg_hdr.msg_iovlen  = 1;
+    }
+    
+    /* A blocking sendmmsg may stop early; resume from there */
+    for (sent = i; sent < j; ) {
+      int got = sendmmsg(packet->sock, &msgs[sent-i], j-sent, 0);
+      ++eb_posix_udp_counters.tx_calls;
+      if (got <= 0) break; /* datagrams are unreliable anyway */
+      sent += got;
+    }
+#else
+    for (sent = i; sent < j; ++sent) {
+      struct eb_posix_udp_packet* p = &queue->tx[sent];
+      sendto(p->sock, (const char*)p->buf, p->len, 0, (struct sockaddr*)&p->sa, p->sa_len);
+      ++eb_posix_udp_counters.tx_calls;
+    }
+#endif
+    eb_posix_udp_counters.tx_packets += j-i;
+  }
+  
+  queue->tx_fill = 0;
+}
+
+static int eb_posix_udp_fill(struct eb_posix_udp_queue* queue, eb_posix_sock_t sock) {
+  int got;
+#ifdef EB_POSIX_UDP_MMSG
+  struct mmsghdr msgs[EB_POSIX_UDP_BATCH];
+  struct iovec iov[EB_POSIX_UDP_BATCH];
+  int i;
+  
+  memset(&msgs[0], 0, sizeof(msgs));
+  for (i = 0; i < EB_POSIX_UDP_BATCH; ++i) {
+    iov[i].iov_base = queue->rx[i].buf;
+    iov[i].iov_len  = sizeof(queue->rx[i].buf);
+    msgs[i].msg_hdr.msg_name    = &queue->rx[i].sa;
+    msgs[i].msg_hdr.msg_namelen = sizeof(queue->rx[i].sa);
+    msgs[i].msg_hdr.msg_iov     = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen  = 1;
+  }
+  
+  got = recvmmsg(sock, &msgs[0], EB_POSIX_UDP_BATCH, MSG_DONTWAIT, 0);
+  ++eb_posix_udp_counters.rx_calls;
+  if (got == -1) return eb_posix_ip_ewouldblock() ? 0 : -1;
+  
+  for (i = 0; i < got; ++i) {
+    queue->rx[i].sa_len = msgs[i].msg_hdr.msg_namelen;
+    queue->rx[i].len = msgs[i].msg_len;
+    queue->rx[i].sock = sock;
+  }
+#else
+  queue->rx[0].sa_len = sizeof(queue->rx[0].sa);
+  got = recvfrom(sock, (char*)queue->rx[0].buf, sizeof(queue->rx[0].buf), MSG_DONTWAIT, (struct sockaddr*)&queue->rx[0].sa, &queue->rx[0].sa_len);
+  ++eb_posix_udp_counters.rx_calls;
+  if (got == -1) return eb_posix_ip_ewouldblock() ? 0 : -1;
+  
+  queue->rx[0].len = got;
+  queue->rx[0].sock = sock;
+  got = 1;
+#endif
+  
+  eb_posix_udp_counters.rx_packets += got;
+  queue->rx_head = 0;
+  queue->rx_fill = got;
+  return got;
+}
 
 int eb_posix_udp_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int len) {
   struct eb_posix_udp_transport* transport;
+  struct eb_posix_udp_queue* queue;
+  struct eb_posix_udp_packet* packet;
   int result;
   
   if (linkp != 0) return 0; /* Only recv top-level */
   
   transport = (struct eb_posix_udp_transport*)transportp;
+  queue = transport->queue;
   
-  /* Set non-blocking */
-  eb_posix_ip_non_blocking(transport->socket4, 1);
-  eb_posix_ip_non_blocking(transport->socket6, 1);
-  
-  if (transport->socket4 != -1 && (*ready)(data, transport->socket4, EB_DESCRIPTOR_IN)) {
-    eb_posix_udp_sa_len = sizeof(eb_posix_udp_sa);
-    result = recvfrom(transport->socket4, (char*)buf, len, MSG_DONTWAIT, (struct sockaddr*)&eb_posix_udp_sa, &eb_posix_udp_sa_len);
-    if (result == -1 && !eb_posix_ip_ewouldblock()) return -1;
-    if (result != -1) return result;
+  /* Refill from the kernel once the previous burst is consumed */
+  if (queue->rx_head == queue->rx_fill) {
+    eb_posix_udp_flush(queue);
+    
+    /* Set non-blocking */
+    eb_posix_ip_non_blocking(transport->socket4, 1);
+    eb_posix_ip_non_blocking(transport->socket6, 1);
+    
+    result = 0;
+    if (result == 0 && transport->socket4 != -1 && (*ready)(data, transport->socket4, EB_DESCRIPTOR_IN))
+      result = eb_posix_udp_fill(queue, transport->socket4);
+    if (result == 0 && transport->socket6 != -1 && (*ready)(data, transport->socket6, EB_DESCRIPTOR_IN))
+      result = eb_posix_udp_fill(queue, transport->socket6);
+    
+    if (result <= 0) return result;
   }
   
-  if (transport->socket6 != -1 && (*ready)(data, transport->socket6, EB_DESCRIPTOR_IN)) {
-    eb_posix_udp_sa_len = sizeof(eb_posix_udp_sa);
-    result = recvfrom(transport->socket6, (char*)buf, len, MSG_DONTWAIT, (struct sockaddr*)&eb_posix_udp_sa, &eb_posix_udp_sa_len);
-    if (result == -1 && !eb_posix_ip_ewouldblock()) return -1;
-    if (result != -1) return result;
-  }
+  packet = &queue->rx[queue->rx_head++];
   
-  return 0;
+  memcpy(&queue->sa, &packet->sa, packet->sa_len);
+  queue->sa_len = packet->sa_len;
+  
+  if (packet->len < len) len = packet->len;
+  memcpy(buf, packet->buf, len);
+  return len;
 }
 
 int eb_posix_udp_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len) {
@@ -168,10 +317,41 @@ int eb_posix_udp_recv(struct eb_transport* transportp, struct eb_link* linkp, ui
   return -1;
 }
 
-void eb_posix_udp_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len) {
+static void eb_posix_udp_address(struct eb_transport* transportp, struct eb_link* linkp, struct eb_posix_udp_packet* packet) {
   struct eb_posix_udp_transport* transport;
   struct eb_posix_udp_link* link;
   
+  transport = (struct eb_posix_udp_transport*)transportp;
+  link = (struct eb_posix_udp_link*)linkp;
+  
+  if (link == 0) {
+    /* Reply to whoever sent the datagram being processed */
+    memcpy(&packet->sa, &transport->queue->sa, transport->queue->sa_len);
+    packet->sa_len = transport->queue->sa_len;
+  } else {
+    memcpy(&packet->sa, link->sa, link->sa_len);
+    packet->sa_len = link->sa_len;
+  }
+  
+  if (packet->sa.ss_family == PF_INET6)
+    packet->sock = transport->socket6;
+  else
+    packet->sock = transport->socket4;
+}
+
+static void eb_posix_udp_queued(struct eb_posix_udp_queue* queue, struct eb_link* linkp) {
+  /* Replies wait for the rest of their burst; everything else goes now */
+  if (queue->tx_fill == EB_POSIX_UDP_BATCH ||
+      (queue->tx_hold == 0 && 
+       (linkp != 0 || queue->rx_head == queue->rx_fill)))
+    eb_posix_udp_flush(queue);
+}
+
+void eb_posix_udp_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len) {
+  struct eb_posix_udp_queue* queue;
+  struct eb_posix_udp_packet* packet;
+  struct eb_posix_udp_packet direct;
+  
 #ifdef PACKET_DEBUG
   int i;
   fprintf(stderr, "<---- ");
@@ -179,29 +359,80 @@ void eb_posix_udp_send(struct eb_transport* transportp, struct eb_link* linkp, c
   fprintf(stderr, "\n");
 #endif
 
-  transport = (struct eb_posix_udp_transport*)transportp;
-  link = (struct eb_posix_udp_link*)linkp;
+  if (len > EB_POSIX_UDP_MTU) len = EB_POSIX_UDP_MTU;
   
+  queue = ((struct eb_posix_udp_transport*)transportp)->queue;
+  if (queue->tx_claim != 0) {
+    /* The next slot is being formatted in place; do not queue behind it */
+    eb_posix_udp_address(transportp, linkp, &direct);
+    eb_posix_ip_non_blocking(direct.sock, 0);
+    sendto(direct.sock, (const char*)buf, len, 0, (struct sockaddr*)&direct.sa, direct.sa_len);
+    ++eb_posix_udp_counters.tx_calls;
+    ++eb_posix_udp_counters.tx_packets;
+    return;
+  }
   
-  if (link == 0) {
-    if (eb_posix_udp_sa.ss_family == PF_INET6) {
-      eb_posix_ip_non_blocking(transport->socket6, 0);
-      sendto(transport->socket6, (const char*)buf, len, 0, (struct sockaddr*)&eb_posix_udp_sa, eb_posix_udp_sa_len);
-    } else {
-      eb_posix_ip_non_blocking(transport->socket4, 0);
-      sendto(transport->socket4, (const char*)buf, len, 0, (struct sockaddr*)&eb_posix_udp_sa, eb_posix_udp_sa_len);
-    }
-  } else {
-    if (link->sa->ss_family == PF_INET6) {
-      eb_posix_ip_non_blocking(transport->socket6, 0);
-      sendto(transport->socket6, (const char*)buf, len, 0, (struct sockaddr*)link->sa, link->sa_len);
-    } else {
-      eb_posix_ip_non_blocking(transport->socket4, 0);
-      sendto(transport->socket4, (const char*)buf, len, 0, (struct sockaddr*)link->sa, link->sa_len);
-    }
+  packet = &queue->tx[queue->tx_fill++];
+  packet->len = len;
+  memcpy(packet->buf, buf, len);
+  eb_posix_udp_address(transportp, linkp, packet);
+  eb_posix_udp_queued(queue, linkp);
+}
+
+uint8_t* eb_posix_udp_claim(struct eb_transport* transportp, struct eb_link* linkp, int* len) {
+  struct eb_posix_udp_queue* queue;
+  
+  queue = ((struct eb_posix_udp_transport*)transportp)->queue;
+  if (queue->tx_claim != 0) return 0;
+  
+  /* Commit leaves the filled slot behind, so the next claim is always a different slot */
+  if (queue->tx_fill == EB_POSIX_UDP_BATCH)
+    eb_posix_udp_flush(queue);
+  
+  queue->tx_claim = queue->tx_fill + 1;
+  *len = EB_POSIX_UDP_MTU;
+  return queue->tx[queue->tx_fill].buf;
+}
+
+void eb_posix_udp_commit(struct eb_transport* transportp, struct eb_link* linkp, int len) {
+  struct eb_posix_udp_queue* queue;
+  struct eb_posix_udp_packet* packet;
+  int slot;
+  
+  queue = ((struct eb_posix_udp_transport*)transportp)->queue;
+  slot = queue->tx_claim - 1;
+  queue->tx_claim = 0;
+  
+  if (len == 0) return;
+  if (len > EB_POSIX_UDP_MTU) len = EB_POSIX_UDP_MTU;
+  
+  /* Only a flush from a nested poll could have moved the queue under us */
+  packet = &queue->tx[queue->tx_fill++];
+  if (packet != &queue->tx[slot])
+    memcpy(packet->buf, queue->tx[slot].buf, len);
+  
+#ifdef PACKET_DEBUG
+  {
+    int i;
+    fprintf(stderr, "<---- ");
+    for (i = 0; i < len; ++i) fprintf(stderr, "%02x", packet->buf[i]);
+    fprintf(stderr, "\n");
   }
+#endif
+  
+  packet->len = len;
+  eb_posix_udp_address(transportp, linkp, packet);
+  eb_posix_udp_queued(queue, linkp);
 }
 
 void eb_posix_udp_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on) {
-  /* no-op */
+  struct eb_posix_udp_queue* queue;
+  
+  queue = ((struct eb_posix_udp_transport*)transportp)->queue;
+  queue->tx_hold = on;
+  if (!on) eb_posix_udp_flush(queue);
+}
+
+void eb_udp_counters_read(struct eb_udp_counters* counters) {
+  *counters = eb_posix_udp_counters;
 }
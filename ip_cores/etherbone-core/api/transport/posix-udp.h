@@ -44,11 +44,14 @@ EB_PRIVATE int eb_posix_udp_poll(struct eb_transport* transportp, struct eb_link
 EB_PRIVATE int eb_posix_udp_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len);
 EB_PRIVATE void eb_posix_udp_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len);
 EB_PRIVATE void eb_posix_udp_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on);
+EB_PRIVATE uint8_t* eb_posix_udp_claim(struct eb_transport* transportp, struct eb_link* linkp, int* len);
+EB_PRIVATE void eb_posix_udp_commit(struct eb_transport* transportp, struct eb_link* linkp, int len);
 
 struct eb_posix_udp_transport {
-  /* Contents must fit in 9 bytes */
+  /* Contents must fit in 16 bytes */
   eb_posix_sock_t socket4; /* IPv4 */
   eb_posix_sock_t socket6; /* IPv6 */
+  struct eb_posix_udp_queue* queue;
 };
 
 struct eb_posix_udp_link {
@@ -0,0 +1,409 @@
+/** @file queue.c
+ *  @brief Submit cycles to a socket from other threads.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  The socket itself remains single-threaded. Other threads stage cycles
+ *  in memory of their own (never the shared eb_memory_array) and push the
+ *  finished batch onto a lock-free multi-producer/single-consumer stack.
+ *  The thread running the socket drains it in eb_socket_check.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#include "posix-ip.h"
+#include "transport.h"
+#include "../glue/socket.h"
+#include "../glue/operation.h"
+#include "../memory/memory.h"
+
+#include <stdlib.h>
+
+#ifndef __WIN32
+#define EB_QUEUE_THREADS 1
+#include <pthread.h>
+#include <fcntl.h>
+#endif
+
+#ifdef EB_QUEUE_THREADS
+
+#define EB_ATOMIC_LOAD(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+
+/* Each submitting thread owns an arena of batches.
+ * Batches come back to it from the socket thread through 'returned'.
+ * refs counts the owning thread plus every batch currently handed out,
+ * so the arena outlives its thread until all its batches are home.
+ */
+struct eb_arena {
+  struct eb_batch* free;              /* owner thread only */
+  struct eb_batch* volatile returned; /* pushed by the socket thread */
+  volatile int refs;
+};
+
+struct eb_batch {
+  struct eb_batch* next;
+  struct eb_arena* arena;
+  struct eb_queue* queue;
+  
+  eb_device_t device;
+  eb_user_data_t user_data;
+  eb_callback_t callback;
+  uint32_t timeout;
+  
+  int ops;  /* -1 on out-of-memory */
+  int size;
+  struct eb_operation* op;
+};
+
+struct eb_queue {
+  struct eb_batch* volatile head; /* LIFO of closed batches */
+  volatile int signalled;
+  int wake[2]; /* self-pipe; wake[0] is watched by the socket's event loop */
+};
+
+static pthread_key_t eb_arena_key;
+static pthread_once_t eb_arena_once = PTHREAD_ONCE_INIT;
+
+static void eb_arena_release(struct eb_arena* arena) {
+  struct eb_batch* batch, * next;
+  
+  if (__sync_sub_and_fetch(&arena->refs, 1) != 0) return;
+  
+  /* Last reference; the owner is gone and nothing is in flight */
+  for (batch = arena->returned; batch != 0; batch = next) {
+    next = batch->next;
+    free(batch->op);
+    free(batch);
+  }
+  free(arena);
+}
+
+static void eb_arena_exit(void* data) {
+  struct eb_arena* arena = (struct eb_arena*)data;
+  struct eb_batch* batch, * next;
+  
+  for (batch = arena->free; batch != 0; batch = next) {
+    next = batch->next;
+    free(batch->op);
+    free(batch);
+  }
+  arena->free = 0;
+  
+  eb_arena_release(arena);
+}
+
+static void eb_arena_init(void) {
+  pthread_key_create(&eb_arena_key, &eb_arena_exit);
+}
+
+static struct eb_arena* eb_arena_self(void) {
+  struct eb_arena* arena;
+  
+  pthread_once(&eb_arena_once, &eb_arena_init);
+  if ((arena = (struct eb_arena*)pthread_getspecific(eb_arena_key)) != 0)
+    return arena;
+  
+  if ((arena = (struct eb_arena*)malloc(sizeof(struct eb_arena))) == 0)
+    return 0;
+  
+  arena->free = 0;
+  arena->returned = 0;
+  arena->refs = 1;
+  
+  if (pthread_setspecific(eb_arena_key, arena) != 0) {
+    free(arena);
+    return 0;
+  }
+  
+  return arena;
+}
+
+/* Called from the socket thread once a batch has been replayed */
+static void eb_batch_return(struct eb_batch* batch) {
+  struct eb_arena* arena;
+  struct eb_batch* head;
+  
+  arena = batch->arena;
+  do {
+    head = EB_ATOMIC_LOAD(arena->returned);
+    batch->next = head;
+  } while (!__sync_bool_compare_and_swap(&arena->returned, head, batch));
+  
+  eb_arena_release(arena);
+}
+
+static void eb_batch_ignore(eb_user_data_t user, eb_device_t device, eb_operation_t op, eb_status_t status) {
+  /* nothing to report to */
+}
+
+eb_queue_t eb_socket_queue(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_queue* queue;
+  
+  socket = EB_SOCKET(socketp);
+  if (socket->queue != 0) return socket->queue;
+  
+  if ((queue = (struct eb_queue*)malloc(sizeof(struct eb_queue))) == 0)
+    return 0;
+  
+  if (pipe(queue->wake) != 0) {
+    free(queue);
+    return 0;
+  }
+  
+  fcntl(queue->wake[0], F_SETFL, O_NONBLOCK);
+  fcntl(queue->wake[1], F_SETFL, O_NONBLOCK);
+  
+  queue->head = 0;
+  queue->signalled = 0;
+  
+  socket->queue = queue;
+  eb_socket_run_descriptor(socketp, queue->wake[0], EB_DESCRIPTOR_IN);
+  
+  return queue;
+}
+
+eb_status_t eb_batch_open(eb_queue_t queue, eb_device_t device, eb_user_data_t user, eb_callback_t cb, eb_batch_t* result) {
+  struct eb_arena* arena;
+  struct eb_batch* batch;
+  
+  if ((arena = eb_arena_self()) == 0) {
+    *result = 0;
+    return EB_OOM;
+  }
+  
+  /* Reclaim whatever the socket thread has finished with */
+  if (arena->free == 0)
+    arena->free = __sync_lock_test_and_set(&arena->returned, 0);
+  
+  if ((batch = arena->free) != 0) {
+    arena->free = batch->next;
+  } else {
+    if ((batch = (struct eb_batch*)malloc(sizeof(struct eb_batch))) == 0) {
+      *result = 0;
+      return EB_OOM;
+    }
+    batch->size = 0;
+    batch->op = 0;
+  }
+  
+  __sync_fetch_and_add(&arena->refs, 1);
+  
+  batch->arena = arena;
+  batch->queue = queue;
+  batch->device = device;
+  batch->user_data = user;
+  batch->callback = cb ? cb : &eb_batch_ignore;
+  batch->timeout = 0;
+  batch->ops = 0;
+  
+  *result = batch;
+  return EB_OK;
+}
+
+void eb_batch_abort(eb_batch_t batch) {
+  struct eb_arena* arena;
+  
+  /* Still owned by this thread; no need to go through 'returned' */
+  arena = batch->arena;
+  batch->next = arena->free;
+  arena->free = batch;
+  __sync_sub_and_fetch(&arena->refs, 1);
+}
+
+void eb_batch_timeout(eb_batch_t batch, uint32_t timeout_us) {
+  batch->timeout = timeout_us;
+}
+
+void eb_batch_close(eb_batch_t batch) {
+  struct eb_queue* queue;
+  struct eb_batch* head;
+  char wake;
+  
+  queue = batch->queue;
+  do {
+    head = EB_ATOMIC_LOAD(queue->head);
+    batch->next = head;
+  } while (!__sync_bool_compare_and_swap(&queue->head, head, batch));
+  
+  /* Only the first producer since the last drain needs to wake the socket */
+  if (__sync_lock_test_and_set(&queue->signalled, 1) == 0) {
+    wake = 0;
+    if (write(queue->wake[1], &wake, 1) < 0) {
+      /* pipe already full => socket is awake anyway */
+    }
+  }
+}
+
+static void eb_batch_doop(eb_batch_t batch, eb_address_t address, eb_format_t format, eb_data_t value, eb_data_t* data, eb_operation_flags_t flags) {
+  struct eb_operation* op;
+  int size;
+  
+  if (batch->ops == -1) return;
+  
+  if (batch->ops == batch->size) {
+    size = batch->size ? batch->size*2 : 32;
+    if ((op = (struct eb_operation*)realloc(batch->op, sizeof(struct eb_operation)*size)) == 0) {
+      /* Record out-of-memory; reported to the callback on replay */
+      batch->ops = -1;
+      return;
+    }
+    batch->op = op;
+    batch->size = size;
+  }
+  
+  op = &batch->op[batch->ops++];
+  op->address = address;
+  op->format = format;
+  op->flags = flags;
+  if (data) op->un_value.read_destination = data;
+  else      op->un_value.write_value = value;
+}
+
+void eb_batch_read(eb_batch_t batch, eb_address_t address, eb_format_t format, eb_data_t* data) {
+  eb_batch_doop(batch, address, format, 0, data, data ? EB_OP_READ_PTR : EB_OP_READ_VAL);
+}
+
+void eb_batch_read_config(eb_batch_t batch, eb_address_t address, eb_format_t format, eb_data_t* data) {
+  eb_batch_doop(batch, address, format, 0, data, (data ? EB_OP_READ_PTR : EB_OP_READ_VAL) | EB_OP_CFG_SPACE);
+}
+
+void eb_batch_write(eb_batch_t batch, eb_address_t address, eb_format_t format, eb_data_t data) {
+  eb_batch_doop(batch, address, format, data, 0, EB_OP_WRITE);
+}
+
+void eb_batch_write_config(eb_batch_t batch, eb_address_t address, eb_format_t format, eb_data_t data) {
+  eb_batch_doop(batch, address, format, data, 0, EB_OP_WRITE | EB_OP_CFG_SPACE);
+}
+
+/* Take every closed batch, oldest first */
+static struct eb_batch* eb_queue_take(struct eb_queue* queue) {
+  struct eb_batch* batch, * next, * prev;
+  char buf[64];
+  
+  __sync_lock_release(&queue->signalled);
+  while (read(queue->wake[0], &buf[0], sizeof(buf)) > 0) { }
+  
+  prev = 0;
+  for (batch = __sync_lock_test_and_set(&queue->head, 0); batch != 0; batch = next) {
+    next = batch->next;
+    batch->next = prev;
+    prev = batch;
+  }
+  
+  return prev;
+}
+
+/* Invalidates pointers: opens cycles and may run user callbacks */
+void eb_socket_queue_drain(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_batch* batch, * next;
+  struct eb_operation* op;
+  eb_cycle_t cycle;
+  eb_status_t status;
+  int i;
+  
+  socket = EB_SOCKET(socketp);
+  if (socket->queue == 0) return;
+  
+  /* A pending wakeup byte implies signalled is set */
+  if (EB_ATOMIC_LOAD(socket->queue->signalled) == 0 && EB_ATOMIC_LOAD(socket->queue->head) == 0) return;
+  
+  for (batch = eb_queue_take(socket->queue); batch != 0; batch = next) {
+    next = batch->next;
+  
+    if (batch->ops == -1) {
+      (*batch->callback)(batch->user_data, batch->device, EB_NULL, EB_OOM);
+    } else if ((status = eb_cycle_open(batch->device, batch->user_data, batch->callback, &cycle)) != EB_OK) {
+      (*batch->callback)(batch->user_data, batch->device, EB_NULL, status);
+    } else {
+      eb_cycle_timeout(cycle, batch->timeout);
+      for (i = 0; i < batch->ops; ++i) {
+        op = &batch->op[i];
+        switch (op->flags) {
+        case EB_OP_READ_PTR:                   eb_cycle_read        (cycle, op->address, op->format, op->un_value.read_destination); break;
+        case EB_OP_READ_VAL:                   eb_cycle_read        (cycle, op->address, op->format, 0); break;
+        case EB_OP_READ_PTR | EB_OP_CFG_SPACE: eb_cycle_read_config (cycle, op->address, op->format, op->un_value.read_destination); break;
+        case EB_OP_READ_VAL | EB_OP_CFG_SPACE: eb_cycle_read_config (cycle, op->address, op->format, 0); break;
+        case EB_OP_WRITE:                      eb_cycle_write       (cycle, op->address, op->format, op->un_value.write_value); break;
+        case EB_OP_WRITE | EB_OP_CFG_SPACE:    eb_cycle_write_config(cycle, op->address, op->format, op->un_value.write_value); break;
+        }
+      }
+      eb_cycle_close(cycle);
+    }
+  
+    eb_batch_return(batch);
+  }
+}
+
+void eb_socket_queue_free(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_queue* queue;
+  struct eb_batch* batch, * next;
+  
+  socket = EB_SOCKET(socketp);
+  if ((queue = socket->queue) == 0) return;
+  socket->queue = 0;
+  
+  /* All devices are closed; whatever is left can never be sent */
+  for (batch = eb_queue_take(queue); batch != 0; batch = next) {
+    next = batch->next;
+    (*batch->callback)(batch->user_data, batch->device, EB_NULL, EB_FAIL);
+    eb_batch_return(batch);
+  }
+  
+  eb_socket_run_descriptor(socketp, queue->wake[0], 0);
+  close(queue->wake[0]);
+  close(queue->wake[1]);
+  free(queue);
+}
+
+void eb_socket_queue_fdes(eb_socket_t socketp, eb_user_data_t user, eb_descriptor_callback_t cb) {
+  struct eb_socket* socket;
+  
+  socket = EB_SOCKET(socketp);
+  if (socket->queue != 0)
+    (*cb)(user, socket->queue->wake[0], EB_DESCRIPTOR_IN);
+}
+
+#else
+
+eb_queue_t eb_socket_queue(eb_socket_t socketp) {
+  return 0; /* no thread support */
+}
+
+eb_status_t eb_batch_open(eb_queue_t queue, eb_device_t device, eb_user_data_t user, eb_callback_t cb, eb_batch_t* result) {
+  *result = 0;
+  return EB_FAIL;
+}
+
+void eb_batch_abort(eb_batch_t batch) { }
+void eb_batch_close(eb_batch_t batch) { }
+void eb_batch_timeout(eb_batch_t batch, uint32_t timeout_us) { }
+void eb_batch_read(eb_batch_t batch, eb_address_t address, eb_format_t format, eb_data_t* data) { }
+void eb_batch_read_config(eb_batch_t batch, eb_address_t address, eb_format_t format, eb_data_t* data) { }
+void eb_batch_write(eb_batch_t batch, eb_address_t address, eb_format_t format, eb_data_t data) { }
+void eb_batch_write_config(eb_batch_t batch, eb_address_t address, eb_format_t format, eb_data_t data) { }
+
+void eb_socket_queue_drain(eb_socket_t socketp) { }
+void eb_socket_queue_free(eb_socket_t socketp) { }
+void eb_socket_queue_fdes(eb_socket_t socketp, eb_user_data_t user, eb_descriptor_callback_t cb) { }
+
+#endif
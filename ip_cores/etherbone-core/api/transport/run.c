@@ -5,6 +5,10 @@
  *
  *  Implement eb_socket_block using select().
  *  This should work on any POSIX operating system.
+ *  On Linux, a persistent epoll set is used instead, so a wakeup
+ *  costs O(ready descriptors) rather than O(all descriptors).
+ *  The environment variable EB_SOCKET_RUN=select picks select() at run
+ *  time; EB_DISABLE_EPOLL removes epoll from the build.
  *
  *  @author Wesley W. Terpstra <w.terpstra@gsi.de>
  *
@@ -32,8 +36,17 @@
 #include "transport.h"
 #include "../glue/socket.h"
 #include "../glue/device.h"
+#include "../glue/stats.h"
 #include "../memory/memory.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__) && !defined(EB_DISABLE_EPOLL)
+#define EB_USE_EPOLL 1
+#include <sys/epoll.h>
+#endif
+
 struct eb_block_sets {
   int nfd;
   fd_set rfds;
@@ -59,12 +72,31 @@ static int eb_check_sets(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode)
     (((mode & EB_DESCRIPTOR_OUT) != 0) && FD_ISSET(fd, &set->wfds));
 }
 
-long eb_socket_run(eb_socket_t socketp, long timeout_us) {
+/* Account for one eb_socket_run; 'busy' is the time spent outside the poll */
+static void eb_socket_run_count(struct eb_socket_stats* stats, struct timeval* start, struct timeval* poll, struct timeval* stop, int wakeup) {
+  struct timeval end;
+  long wait, busy;
+  
+  gettimeofday(&end, 0);
+  busy = (end.tv_sec - start->tv_sec)*1000000 + (end.tv_usec - start->tv_usec);
+  
+  ++stats->runs;
+  if (poll != 0) {
+    wait = (stop->tv_sec - poll->tv_sec)*1000000 + (stop->tv_usec - poll->tv_usec);
+    if (wait < 0) wait = 0;
+    busy -= wait;
+    stats->wakeups += wakeup;
+    stats->wait_us += wait;
+    eb_stats_record(&stats->poll[0], wait);
+  }
+  if (busy > 0) stats->work_us += busy;
+}
+
+static long eb_socket_run_select(eb_socket_t socketp, struct eb_socket_stats* stats, long timeout_us) {
   struct eb_block_sets sets;
-  struct timeval timeout, start, stop;
-  long eb_deadline;
+  struct timeval timeout, start, poll, stop;
   long eb_timeout_us;
-  int done;
+  int done, nfd;
   
   /* Find all descriptors */
   FD_ZERO(&sets.rfds);
@@ -74,21 +106,22 @@ long eb_socket_run(eb_socket_t socketp, long timeout_us) {
   /* Determine the deadline */
   gettimeofday(&start, 0);
   
-  /* !!! hack starts: until we fix sender flow control */
+  /* Send what the flow control window admits and drain input the transports
+   * already buffered; neither wakes up select, so do it before sleeping.
+   */
   done = eb_socket_check(socketp, start.tv_sec, &sets, &eb_check_sets);
-  if (done > 0) return 0;
-  /* !!! hack ends */
+  if (done > 0) {
+    if (stats) eb_socket_run_count(stats, &start, 0, 0, 0);
+    return 0;
+  }
   
-  eb_deadline = eb_socket_timeout(socketp);
+  eb_timeout_us = eb_socket_timeout_us(socketp);
   
   if (timeout_us == -1)
     timeout_us = 600*1000000; /* 10 minutes */
   
-  if (eb_deadline != 0) {
-    eb_timeout_us = (eb_deadline - start.tv_sec)*1000000;
-    if (timeout_us > eb_timeout_us)
-      timeout_us = eb_timeout_us;
-  }
+  if (eb_timeout_us != -1 && timeout_us > eb_timeout_us)
+    timeout_us = eb_timeout_us;
   
   if (timeout_us < 0) timeout_us = 0;
   
@@ -98,11 +131,364 @@ long eb_socket_run(eb_socket_t socketp, long timeout_us) {
   
   eb_socket_descriptors(socketp, &sets, &eb_update_sets);
   
-  select(sets.nfd+1, &sets.rfds, &sets.wfds, 0, &timeout);
+  if (stats) gettimeofday(&poll, 0);
+  nfd = select(sets.nfd+1, &sets.rfds, &sets.wfds, 0, &timeout);
   gettimeofday(&stop, 0);
   
   /* Update the timestamp cache */
   eb_socket_check(socketp, stop.tv_sec, &sets, &eb_check_sets);
   
+  if (stats) eb_socket_run_count(stats, &start, &poll, &stop, nfd > 0);
+  
   return (stop.tv_sec - start.tv_sec)*1000000 + (stop.tv_usec - start.tv_usec);
 }
+
+uint32_t eb_socket_run_clock(void) {
+  struct timeval now;
+  
+  gettimeofday(&now, 0);
+  return (uint32_t)now.tv_sec*1000000U + (uint32_t)now.tv_usec;
+}
+
+#ifdef EB_USE_EPOLL
+
+#define EB_EPOLL_EVENTS 64
+
+/* Persistent interest set of one socket.
+ * Descriptors are registered as links come and go, not on every wakeup.
+ * ready[] is indexed by descriptor and holds the modes reported by epoll.
+ * owner[] is the device whose link uses the descriptor, so a wakeup only
+ * visits the devices that have input.
+ */
+struct eb_socket_run {
+  struct eb_socket_stats* stats; /* 0 unless enabled */
+  int epfd; /* -1 if epoll is unavailable: use select() */
+  int size;
+  uint8_t* ready;
+  eb_device_t* owner;
+  eb_device_t adding; /* owner of the descriptors eb_epoll_add is given */
+};
+
+static int eb_epoll_ready(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode) {
+  struct eb_socket_run* run = (struct eb_socket_run*)data;
+  
+  if (fd < 0 || fd >= run->size) return 0;
+  return (run->ready[fd] & mode) != 0;
+}
+
+static int eb_epoll_add(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode) {
+  struct eb_socket_run* run = (struct eb_socket_run*)data;
+  struct epoll_event ev;
+  eb_device_t* owner;
+  uint8_t* ready;
+  int size, i;
+  
+  /* Grow the tables to cover the new descriptor */
+  if (fd >= run->size) {
+    for (size = run->size?run->size:64; size <= fd; size += size) { }
+    if ((ready = (uint8_t*)realloc(run->ready, size)) == 0) return 0;
+    run->ready = ready;
+    if ((owner = (eb_device_t*)realloc(run->owner, sizeof(eb_device_t)*size)) == 0) return 0;
+    run->owner = owner;
+    
+    memset(ready + run->size, 0, size - run->size);
+    for (i = run->size; i < size; ++i) owner[i] = EB_NULL;
+    run->size = size;
+  }
+  
+  run->owner[fd] = run->adding;
+  
+  memset(&ev, 0, sizeof(ev));
+  ev.events = 
+    (((mode & EB_DESCRIPTOR_IN)  != 0) ? EPOLLIN  : 0) |
+    (((mode & EB_DESCRIPTOR_OUT) != 0) ? EPOLLOUT : 0);
+  ev.data.fd = fd;
+  
+  /* A descriptor may be listed more than once (eg: by socket_open and run) */
+  if (epoll_ctl(run->epfd, EPOLL_CTL_ADD, fd, &ev) != 0 && errno == EEXIST)
+    epoll_ctl(run->epfd, EPOLL_CTL_MOD, fd, &ev);
+  
+  return 0;
+}
+
+static int eb_epoll_del(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode) {
+  struct eb_socket_run* run = (struct eb_socket_run*)data;
+  struct epoll_event ev; /* non-NULL for kernels before 2.6.9 */
+  
+  epoll_ctl(run->epfd, EPOLL_CTL_DEL, fd, &ev);
+  if (fd >= 0 && fd < run->size) {
+    run->ready[fd] = 0;
+    run->owner[fd] = EB_NULL;
+  }
+  
+  return 0;
+}
+
+static struct eb_socket_run* eb_socket_run_state(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_socket_aux* aux;
+  
+  socket = EB_SOCKET(socketp);
+  aux = EB_SOCKET_AUX(socket->aux);
+  return aux->state->run;
+}
+
+/* Invalidates pointers: calls eb_socket_descriptors */
+static struct eb_socket_run* eb_socket_run_setup(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_socket_aux* aux;
+  struct eb_socket_run* run;
+  struct eb_device* device;
+  eb_device_t devicep;
+  const char* backend;
+  
+  if ((run = (struct eb_socket_run*)malloc(sizeof(struct eb_socket_run))) == 0)
+    return 0;
+  
+  /* EB_SOCKET_RUN=select keeps the portable loop, eg: to compare the two */
+  backend = getenv("EB_SOCKET_RUN");
+  
+  run->stats = 0;
+  run->epfd = (backend != 0 && strcmp(backend, "select") == 0) ? -1 : epoll_create(EB_EPOLL_EVENTS);
+  run->size = 0;
+  run->ready = 0;
+  run->owner = 0;
+  run->adding = EB_NULL;
+  
+  socket = EB_SOCKET(socketp);
+  aux = EB_SOCKET_AUX(socket->aux);
+  aux->state->run = run;
+  
+  /* Seed the interest set; afterwards it is maintained incrementally */
+  if (run->epfd != -1) {
+    eb_socket_descriptors(socketp, run, &eb_epoll_add);
+    
+    /* Links which are already open: claim their descriptors */
+    socket = EB_SOCKET(socketp);
+    for (devicep = socket->first_device; devicep != EB_NULL; devicep = device->next) {
+      device = EB_DEVICE(devicep);
+      if (device->link != EB_NULL)
+        eb_socket_run_add(socketp, device->transport, device->link, devicep);
+    }
+  }
+  
+  return run;
+}
+
+static long eb_socket_run_epoll(eb_socket_t socketp, struct eb_socket_run* run, long timeout_us) {
+  struct epoll_event events[EB_EPOLL_EVENTS];
+  struct timeval start, poll, stop;
+  long eb_timeout_us;
+  int done, nev, i, fd;
+  
+  /* Determine the deadline */
+  gettimeofday(&start, 0);
+  
+  /* Send what the flow control window admits and drain buffered input first */
+  done = eb_socket_check_woken(socketp, start.tv_sec, run, &eb_epoll_ready);
+  if (done > 0) {
+    if (run->stats) eb_socket_run_count(run->stats, &start, 0, 0, 0);
+    return 0;
+  }
+  
+  eb_timeout_us = eb_socket_timeout_us(socketp);
+  
+  if (timeout_us == -1)
+    timeout_us = 600*1000000; /* 10 minutes */
+  
+  if (eb_timeout_us != -1 && timeout_us > eb_timeout_us)
+    timeout_us = eb_timeout_us;
+  
+  if (timeout_us < 0) timeout_us = 0;
+  
+  /* Round up so that we never spin on a sub-millisecond timeout */
+  if (run->stats) gettimeofday(&poll, 0);
+  nev = epoll_wait(run->epfd, &events[0], EB_EPOLL_EVENTS, (timeout_us+999)/1000);
+  gettimeofday(&stop, 0);
+  
+  for (i = 0; i < nev; ++i) {
+    fd = events[i].data.fd;
+    if (fd < run->size) {
+      run->ready[fd] = 
+        (((events[i].events & (EPOLLIN|EPOLLERR|EPOLLHUP)) != 0) ? EB_DESCRIPTOR_IN  : 0) |
+        (((events[i].events & EPOLLOUT) != 0)                     ? EB_DESCRIPTOR_OUT : 0);
+      if (run->owner[fd] != EB_NULL)
+        eb_socket_wake(socketp, run->owner[fd], EB_DEVICE_READABLE);
+    }
+  }
+  
+  /* Update the timestamp cache */
+  eb_socket_check_woken(socketp, stop.tv_sec, run, &eb_epoll_ready);
+  
+  /* Only the reported descriptors need clearing; level-triggered epoll re-reports the rest */
+  for (i = 0; i < nev; ++i) {
+    fd = events[i].data.fd;
+    if (fd < run->size) run->ready[fd] = 0;
+  }
+  
+  if (run->stats) eb_socket_run_count(run->stats, &start, &poll, &stop, nev > 0);
+  
+  return (stop.tv_sec - start.tv_sec)*1000000 + (stop.tv_usec - start.tv_usec);
+}
+
+long eb_socket_run(eb_socket_t socketp, long timeout_us) {
+  struct eb_socket_run* run;
+  
+  if ((run = eb_socket_run_state(socketp)) == 0 &&
+      (run = eb_socket_run_setup(socketp)) == 0)
+    return eb_socket_run_select(socketp, 0, timeout_us);
+  
+  if (run->epfd == -1)
+    return eb_socket_run_select(socketp, run->stats, timeout_us);
+  
+  return eb_socket_run_epoll(socketp, run, timeout_us);
+}
+
+void eb_socket_run_add(eb_socket_t socketp, eb_transport_t transportp, eb_link_t linkp, eb_device_t devicep) {
+  struct eb_socket_run* run;
+  struct eb_transport* transport;
+  
+  if ((run = eb_socket_run_state(socketp)) == 0 || run->epfd == -1) return;
+  
+  transport = EB_TRANSPORT(transportp);
+  run->adding = devicep;
+  eb_transports[transport->link_type].fdes(transport, EB_LINK(linkp), run, &eb_epoll_add);
+  run->adding = EB_NULL;
+}
+
+void eb_socket_run_del(eb_socket_t socketp, eb_transport_t transportp, eb_link_t linkp) {
+  struct eb_socket_run* run;
+  struct eb_transport* transport;
+  
+  if ((run = eb_socket_run_state(socketp)) == 0 || run->epfd == -1) return;
+  
+  transport = EB_TRANSPORT(transportp);
+  eb_transports[transport->link_type].fdes(transport, EB_LINK(linkp), run, &eb_epoll_del);
+}
+
+void eb_socket_run_descriptor(eb_socket_t socketp, eb_descriptor_t fd, uint8_t mode) {
+  struct eb_socket_run* run;
+  
+  if ((run = eb_socket_run_state(socketp)) == 0 || run->epfd == -1) return;
+  
+  if (mode != 0)
+    eb_epoll_add(run, fd, mode);
+  else
+    eb_epoll_del(run, fd, mode);
+}
+
+void eb_socket_run_free(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_socket_aux* aux;
+  struct eb_socket_run* run;
+  
+  socket = EB_SOCKET(socketp);
+  aux = EB_SOCKET_AUX(socket->aux);
+  
+  if (aux->state == 0 || (run = aux->state->run) == 0) return;
+  aux->state->run = 0;
+  
+  if (run->epfd != -1) close(run->epfd);
+  free(run->stats);
+  free(run->ready);
+  free(run->owner);
+  free(run);
+}
+
+#else
+
+/* select() rebuilds its sets on every call; only statistics persist */
+struct eb_socket_run {
+  struct eb_socket_stats* stats;
+};
+
+static struct eb_socket_run* eb_socket_run_state(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_socket_aux* aux;
+  
+  socket = EB_SOCKET(socketp);
+  aux = EB_SOCKET_AUX(socket->aux);
+  return aux->state->run;
+}
+
+static struct eb_socket_run* eb_socket_run_setup(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_socket_aux* aux;
+  struct eb_socket_run* run;
+  
+  if ((run = (struct eb_socket_run*)malloc(sizeof(struct eb_socket_run))) == 0)
+    return 0;
+  
+  run->stats = 0;
+  
+  socket = EB_SOCKET(socketp);
+  aux = EB_SOCKET_AUX(socket->aux);
+  aux->state->run = run;
+  
+  return run;
+}
+
+long eb_socket_run(eb_socket_t socketp, long timeout_us) {
+  struct eb_socket_run* run;
+  
+  run = eb_socket_run_state(socketp);
+  return eb_socket_run_select(socketp, run ? run->stats : 0, timeout_us);
+}
+
+void eb_socket_run_add(eb_socket_t socketp, eb_transport_t transportp, eb_link_t linkp, eb_device_t devicep) {
+  /* select() rebuilds its sets on every call */
+}
+
+void eb_socket_run_del(eb_socket_t socketp, eb_transport_t transportp, eb_link_t linkp) {
+  /* select() rebuilds its sets on every call */
+}
+
+void eb_socket_run_descriptor(eb_socket_t socketp, eb_descriptor_t fd, uint8_t mode) {
+  /* select() rebuilds its sets on every call */
+}
+
+void eb_socket_run_free(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_socket_aux* aux;
+  struct eb_socket_run* run;
+  
+  socket = EB_SOCKET(socketp);
+  aux = EB_SOCKET_AUX(socket->aux);
+  
+  if (aux->state == 0 || (run = aux->state->run) == 0) return;
+  aux->state->run = 0;
+  
+  free(run->stats);
+  free(run);
+}
+
+#endif
+
+eb_status_t eb_socket_stats_enable(eb_socket_t socketp) {
+  struct eb_socket_run* run;
+  struct eb_socket_stats* stats;
+  
+  if ((run = eb_socket_run_state(socketp)) == 0 &&
+      (run = eb_socket_run_setup(socketp)) == 0)
+    return EB_OOM;
+  
+  if (run->stats != 0) return EB_OK;
+  
+  if ((stats = (struct eb_socket_stats*)malloc(sizeof(struct eb_socket_stats))) == 0)
+    return EB_OOM;
+  
+  memset(stats, 0, sizeof(struct eb_socket_stats));
+  run->stats = stats;
+  
+  return EB_OK;
+}
+
+eb_status_t eb_socket_stats(eb_socket_t socketp, struct eb_socket_stats* out) {
+  struct eb_socket_run* run;
+  
+  if ((run = eb_socket_run_state(socketp)) == 0 || run->stats == 0)
+    return EB_FAIL;
+  
+  memcpy(out, run->stats, sizeof(struct eb_socket_stats));
+  return EB_OK;
+}
@@ -0,0 +1,558 @@
+/** @file shm.c
+ *  @brief This implements devices in another process on the same host.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  A socket opened on port <name> listens on the local socket eb-shm/<name>
+ *  in the abstract namespace. Connecting to shm/<name> creates the shared
+ *  memory and two eventfds and hands them over that socket, which is then
+ *  only watched to learn when the peer goes away.
+ *
+ *  Each direction is a ring of length-prefixed packets. The writer signals
+ *  the eventfd only if the reader has not been signalled since it last ran
+ *  dry, so a stream of packets to a busy peer needs no system calls.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#ifdef __linux__
+
+#include "shm.h"
+#include "transport.h"
+#include "../glue/strncasecmp.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define EB_SHM_PREFIX "eb-shm/"
+#define EB_SHM_NAME   100  /* longest <name> */
+#define EB_SHM_WRAP   0xFFFFFFFFU /* the next packet starts at the beginning */
+
+/* Indices run freely; head == tail means empty.
+ * Each packet is an 8-byte header holding its length, then the payload
+ * padded to 8 bytes. A packet never wraps; EB_SHM_WRAP skips the rest.
+ * head, tail and signalled live on separate cache lines.
+ */
+struct eb_shm_ring {
+  volatile uint32_t head; /* advanced by the reader */
+  uint8_t pad0[60];
+  volatile uint32_t tail; /* advanced by the writer */
+  uint8_t pad1[60];
+  volatile uint32_t signalled; /* the reader's eventfd was written and not yet read */
+  uint8_t pad2[60];
+  uint8_t data[EB_SHM_RING];
+};
+
+/* ring[0] carries packets to the listening side, ring[1] back */
+struct eb_shm_region {
+  struct eb_shm_ring ring[2];
+};
+
+struct eb_shm_channel {
+  struct eb_shm_region* region;
+  struct eb_shm_ring* rx;
+  struct eb_shm_ring* tx;
+  int sock;     /* readable once the peer has gone */
+  int rx_event; /* written by the peer when rx may have gone from empty to not */
+  int tx_event;
+  int buffering; /* between send_buffer(1) and send_buffer(0) */
+  int pending;   /* packets sent while buffering; the peer may need a signal */
+  int claimed;   /* 1 if claim handed out ring space, 2 if a bounce buffer */
+  int bounce_next;
+  uint32_t claim_skip;
+  uint8_t bounce[2][EB_SHM_MTU]; /* lent by claim while the ring is full */
+};
+
+static uint32_t eb_shm_size(uint32_t len) {
+  return 8 + ((len + 7) & ~7U);
+}
+
+/* Find room for a packet of len bytes at the tail of the ring */
+static uint8_t* eb_shm_reserve(struct eb_shm_ring* ring, uint32_t len, uint32_t* skip) {
+  uint32_t head, tail, pos, need, gap;
+  
+  tail = ring->tail;
+  head = ring->head;
+  __sync_synchronize(); /* read head before reusing the space it frees */
+  
+  pos = tail & (EB_SHM_RING-1);
+  need = eb_shm_size(len);
+  gap = (pos + need > EB_SHM_RING) ? EB_SHM_RING - pos : 0;
+  
+  if ((tail - head) + gap + need > EB_SHM_RING) return 0;
+  if (gap != 0) pos = 0;
+  
+  *skip = gap;
+  return &ring->data[pos + 8];
+}
+
+/* Nothing past the tail is written before this: a flush which claimed the
+ * next packet may still be moving records out of the space after the last.
+ */
+static void eb_shm_publish(struct eb_shm_ring* ring, uint32_t len, uint32_t skip) {
+  uint32_t tail;
+  
+  tail = ring->tail;
+  if (skip != 0) *(uint32_t*)&ring->data[tail & (EB_SHM_RING-1)] = EB_SHM_WRAP;
+  
+  tail += skip;
+  *(uint32_t*)&ring->data[tail & (EB_SHM_RING-1)] = len;
+  __sync_synchronize(); /* the packet is complete before the tail moves */
+  ring->tail = tail + eb_shm_size(len);
+}
+
+/* Copy out the oldest packet; 0 if the ring is empty, -1 if it is corrupt */
+static int eb_shm_take(struct eb_shm_ring* ring, uint8_t* buf, int len) {
+  uint32_t head, tail, pos, size;
+  
+  while (1) {
+    head = ring->head;
+    tail = ring->tail;
+    __sync_synchronize(); /* read tail before the packets it covers */
+  
+    if (head == tail) return 0;
+  
+    pos = head & (EB_SHM_RING-1);
+    size = *(uint32_t*)&ring->data[pos];
+  
+    if (size == EB_SHM_WRAP) {
+      ring->head = head + (EB_SHM_RING - pos);
+      continue;
+    }
+  
+    if (size == 0 || size > EB_SHM_MTU || pos + eb_shm_size(size) > EB_SHM_RING) return -1;
+  
+    if ((uint32_t)len > size) len = size;
+    memcpy(buf, &ring->data[pos + 8], len);
+  
+    __sync_synchronize(); /* finish copying before the writer may reuse the space */
+    ring->head = head + eb_shm_size(size);
+    return len;
+  }
+}
+
+static void eb_shm_signal(struct eb_shm_channel* channel) {
+  uint64_t one;
+  
+  /* Full barrier: the new tail is visible before the flag is tested */
+  if (__sync_fetch_and_or(&channel->tx->signalled, 1) == 0) {
+    one = 1;
+    if (write(channel->tx_event, &one, sizeof(one)) < 0) {
+      /* the eventfd cannot overflow from single increments */
+    }
+  }
+}
+
+static void eb_shm_notify(struct eb_shm_channel* channel) {
+  if (channel->buffering)
+    channel->pending = 1;
+  else
+    eb_shm_signal(channel);
+}
+
+static socklen_t eb_shm_address(struct sockaddr_un* sun, const char* name) {
+  memset(sun, 0, sizeof(*sun));
+  sun->sun_family = AF_UNIX;
+  
+  /* sun_path[0] = 0: the abstract namespace, so nothing is left behind in the filesystem */
+  memcpy(&sun->sun_path[1], EB_SHM_PREFIX, sizeof(EB_SHM_PREFIX)-1);
+  memcpy(&sun->sun_path[sizeof(EB_SHM_PREFIX)], name, strlen(name));
+  
+  return offsetof(struct sockaddr_un, sun_path) + sizeof(EB_SHM_PREFIX) + strlen(name);
+}
+
+static struct eb_shm_channel* eb_shm_channel(int sock, int memfd, int rx_event, int tx_event, int listening) {
+  struct eb_shm_channel* channel;
+  struct stat st;
+  void* region;
+  
+  if (fstat(memfd, &st) != 0 || st.st_size < (off_t)sizeof(struct eb_shm_region))
+    return 0;
+  
+  region = mmap(0, sizeof(struct eb_shm_region), PROT_READ|PROT_WRITE, MAP_SHARED, memfd, 0);
+  if (region == MAP_FAILED)
+    return 0;
+  
+  if ((channel = (struct eb_shm_channel*)malloc(sizeof(struct eb_shm_channel))) == 0) {
+    munmap(region, sizeof(struct eb_shm_region));
+    return 0;
+  }
+  
+  channel->region = (struct eb_shm_region*)region;
+  channel->rx = &channel->region->ring[!listening];
+  channel->tx = &channel->region->ring[listening];
+  channel->sock = sock;
+  channel->rx_event = rx_event;
+  channel->tx_event = tx_event;
+  channel->buffering = 0;
+  channel->pending = 0;
+  channel->claimed = 0;
+  channel->bounce_next = 0;
+  channel->claim_skip = 0;
+  
+  return channel;
+}
+
+eb_status_t eb_shm_open(struct eb_transport* transportp, const char* port) {
+  struct eb_shm_transport* transport;
+  struct sockaddr_un sun;
+  socklen_t len;
+  int sock;
+  
+  transport = (struct eb_shm_transport*)transportp;
+  transport->listen = -1;
+  
+  /* No port? only connect */
+  if (port == 0) return EB_OK;
+  if (strlen(port) == 0 || strlen(port) > EB_SHM_NAME) return EB_OK;
+  
+  if ((sock = socket(AF_UNIX, SOCK_SEQPACKET, 0)) == -1)
+    return EB_ADDRESS;
+  
+  len = eb_shm_address(&sun, port);
+  if (bind(sock, (struct sockaddr*)&sun, len) != 0) {
+    close(sock);
+    return errno == EADDRINUSE ? EB_BUSY : EB_ADDRESS;
+  }
+  
+  if (listen(sock, 5) != 0) {
+    close(sock);
+    return EB_ADDRESS;
+  }
+  
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+  transport->listen = sock;
+  
+  return EB_OK;
+}
+
+void eb_shm_close(struct eb_transport* transportp) {
+  struct eb_shm_transport* transport;
+  
+  transport = (struct eb_shm_transport*)transportp;
+  if (transport->listen != -1) close(transport->listen);
+}
+
+eb_status_t eb_shm_connect(struct eb_transport* transportp, struct eb_link* linkp, const char* address, int passive) {
+  struct eb_shm_link* link;
+  struct eb_shm_channel* channel;
+  struct sockaddr_un sun;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr* cmsg;
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(3*sizeof(int))];
+  } control;
+  const char* name;
+  socklen_t len;
+  int sock, memfd, up, down, fds[3];
+  char hello;
+  
+  link = (struct eb_shm_link*)linkp;
+  
+  if (eb_strncasecmp(address, "shm/", 4))
+    return EB_ADDRESS;
+  
+  name = address + 4;
+  if (strlen(name) == 0 || strlen(name) > EB_SHM_NAME)
+    return EB_ADDRESS;
+
+#ifdef SYS_memfd_create
+  if ((sock = socket(AF_UNIX, SOCK_SEQPACKET, 0)) == -1) goto fail0;
+  
+  len = eb_shm_address(&sun, name);
+  if (connect(sock, (struct sockaddr*)&sun, len) != 0) goto fail1;
+  
+  if ((memfd = syscall(SYS_memfd_create, "etherbone", 0)) == -1) goto fail1;
+  if (ftruncate(memfd, sizeof(struct eb_shm_region)) != 0) goto fail2;
+  if ((up   = eventfd(0, EFD_NONBLOCK)) == -1) goto fail2;
+  if ((down = eventfd(0, EFD_NONBLOCK)) == -1) goto fail3;
+  
+  /* The listener keeps the region mapped and both eventfds after we are gone */
+  fds[0] = memfd;
+  fds[1] = up;
+  fds[2] = down;
+  
+  hello = 0;
+  iov.iov_base = &hello;
+  iov.iov_len = 1;
+  
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  
+  /* Do not wait for the listener to accept: it might be us */
+  if (sendmsg(sock, &msg, MSG_NOSIGNAL) != 1) goto fail4;
+  
+  if ((channel = eb_shm_channel(sock, memfd, down, up, 0)) == 0) goto fail4;
+  close(memfd);
+  
+  link->channel = channel;
+  return EB_OK;
+
+fail4:
+  close(down);
+fail3:
+  close(up);
+fail2:
+  close(memfd);
+fail1:
+  close(sock);
+fail0:
+#endif
+  return EB_FAIL;
+}
+
+void eb_shm_disconnect(struct eb_transport* transport, struct eb_link* linkp) {
+  struct eb_shm_link* link;
+  struct eb_shm_channel* channel;
+  
+  link = (struct eb_shm_link*)linkp;
+  channel = link->channel;
+  
+  munmap(channel->region, sizeof(struct eb_shm_region));
+  close(channel->sock);
+  close(channel->rx_event);
+  close(channel->tx_event);
+  free(channel);
+}
+
+void eb_shm_fdes(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t cb) {
+  struct eb_shm_transport* transport;
+  struct eb_shm_link* link;
+  
+  if (linkp) {
+    link = (struct eb_shm_link*)linkp;
+    (*cb)(data, link->channel->rx_event, EB_DESCRIPTOR_IN);
+    (*cb)(data, link->channel->sock, EB_DESCRIPTOR_IN);
+  } else {
+    transport = (struct eb_shm_transport*)transportp;
+    if (transport->listen != -1)
+      (*cb)(data, transport->listen, EB_DESCRIPTOR_IN);
+  }
+}
+
+int eb_shm_accept(struct eb_transport* transportp, struct eb_link* result_linkp, eb_user_data_t data, eb_descriptor_callback_t ready) {
+  struct eb_shm_transport* transport;
+  struct eb_shm_link* link;
+  struct eb_shm_channel* channel;
+  struct pollfd pfd;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr* cmsg;
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(3*sizeof(int))];
+  } control;
+  int sock, fds[3];
+  char hello;
+  
+  transport = (struct eb_shm_transport*)transportp;
+  
+  if (transport->listen == -1) return 0;
+  if (!(*ready)(data, transport->listen, EB_DESCRIPTOR_IN)) return 0;
+  
+  if ((sock = accept(transport->listen, 0, 0)) == -1) return 0;
+  
+  /* connect sends the descriptors right away; do not hang on a peer which does not */
+  pfd.fd = sock;
+  pfd.events = POLLIN;
+  if (poll(&pfd, 1, 1000) != 1) goto fail0;
+  
+  iov.iov_base = &hello;
+  iov.iov_len = 1;
+  
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  
+  if (recvmsg(sock, &msg, MSG_DONTWAIT) != 1) goto fail0;
+  
+  cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == 0 || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) goto fail0;
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+  
+  if ((channel = eb_shm_channel(sock, fds[0], fds[1], fds[2], 1)) == 0) goto fail1;
+  close(fds[0]);
+  
+  link = (struct eb_shm_link*)result_linkp;
+  link->channel = channel;
+  return 1;
+
+fail1:
+  close(fds[0]);
+  close(fds[1]);
+  close(fds[2]);
+fail0:
+  close(sock);
+  return 0;
+}
+
+int eb_shm_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int len) {
+  struct eb_shm_link* link;
+  struct eb_shm_channel* channel;
+  uint64_t count;
+  int result;
+  char byte;
+  
+  /* Only links carry packets */
+  if (linkp == 0) return 0;
+  
+  link = (struct eb_shm_link*)linkp;
+  channel = link->channel;
+  
+  if ((result = eb_shm_take(channel->rx, buf, len)) != 0)
+    return result;
+  
+  /* Drained. Is the peer gone? */
+  if ((*ready)(data, channel->sock, EB_DESCRIPTOR_IN)) {
+    result = recv(channel->sock, &byte, 1, MSG_DONTWAIT);
+    if (result == 0 || (result == -1 && errno != EAGAIN && errno != EWOULDBLOCK)) return -1;
+  }
+  
+  /* Ask for a signal again. Empty the eventfd before clearing the flag,
+   * then look once more, so a packet sent meanwhile is not missed.
+   */
+  if (channel->rx->signalled) {
+    if (read(channel->rx_event, &count, sizeof(count)) < 0) {
+      /* already empty */
+    }
+    __sync_fetch_and_and(&channel->rx->signalled, 0);
+    return eb_shm_take(channel->rx, buf, len);
+  }
+  
+  return 0;
+}
+
+int eb_shm_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len) {
+  /* Should never happen on a non-stream socket */
+  return -1;
+}
+
+void eb_shm_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len) {
+  struct eb_shm_link* link;
+  struct eb_shm_channel* channel;
+  uint8_t* packet;
+  uint32_t skip;
+  
+  /* linkp == 0 impossible if poll == 0 returns 0 */
+  
+  link = (struct eb_shm_link*)linkp;
+  channel = link->channel;
+  
+  /* Like a full socket buffer, a full ring loses the packet */
+  if ((packet = eb_shm_reserve(channel->tx, len, &skip)) == 0) return;
+  
+  memcpy(packet, buf, len);
+  eb_shm_publish(channel->tx, len, skip);
+  eb_shm_notify(channel);
+}
+
+void eb_shm_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on) {
+  struct eb_shm_link* link;
+  struct eb_shm_channel* channel;
+  
+  link = (struct eb_shm_link*)linkp;
+  channel = link->channel;
+  
+  /* One signal for the whole flush */
+  channel->buffering = on;
+  if (!on && channel->pending) {
+    channel->pending = 0;
+    eb_shm_signal(channel);
+  }
+}
+
+uint8_t* eb_shm_claim(struct eb_transport* transportp, struct eb_link* linkp, int* len) {
+  struct eb_shm_link* link;
+  struct eb_shm_channel* channel;
+  uint8_t* packet;
+  
+  link = (struct eb_shm_link*)linkp;
+  channel = link->channel;
+  
+  if (channel->claimed) return 0;
+  
+  /* The flush formats straight into the ring.
+   * A flush must get a buffer whenever it has none, so lend it a bounce buffer while the
+   * ring is full; commit then drops the packet, as send would. Alternate between two,
+   * as the flush may still move records out of the packet it just committed.
+   */
+  if ((packet = eb_shm_reserve(channel->tx, EB_SHM_MTU, &channel->claim_skip)) != 0) {
+    channel->claimed = 1;
+  } else {
+    packet = channel->bounce[channel->bounce_next];
+    channel->bounce_next ^= 1;
+    channel->claimed = 2;
+  }
+  
+  *len = EB_SHM_MTU;
+  return packet;
+}
+
+void eb_shm_commit(struct eb_transport* transportp, struct eb_link* linkp, int len) {
+  struct eb_shm_link* link;
+  struct eb_shm_channel* channel;
+  
+  link = (struct eb_shm_link*)linkp;
+  channel = link->channel;
+  
+  if (channel->claimed == 2) {
+    channel->claimed = 0;
+    if (len != 0) eb_shm_send(transportp, linkp, channel->bounce[channel->bounce_next^1], len);
+    return;
+  }
+  
+  channel->claimed = 0;
+  if (len == 0) return;
+  
+  eb_shm_publish(channel->tx, len, channel->claim_skip);
+  eb_shm_notify(channel);
+}
+
+#endif
@@ -0,0 +1,62 @@
+/** @file shm.h
+ *  @brief This implements devices in another process on the same host.
+ *
+ *  Copyright (C) 2026 agent <agent@local>
+ *
+ *  A shm/<name> device exchanges packets through a pair of rings in shared
+ *  memory with the socket opened on port <name>. An eventfd wakes the peer
+ *  only when it has emptied its ring; a busy peer is never signalled.
+ *
+ *  @author agent <agent@local>
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#ifndef EB_SHM_H
+#define EB_SHM_H
+
+#include "transport.h"
+
+/* The largest packet master.c and slave.c can hold on their stacks */
+#define EB_SHM_MTU ((int)sizeof(eb_data_t)*512)
+
+/* Bytes in each direction; a power of two */
+#define EB_SHM_RING (1024*1024)
+
+EB_PRIVATE eb_status_t eb_shm_open(struct eb_transport* transport, const char* port);
+EB_PRIVATE void eb_shm_close(struct eb_transport* transport);
+EB_PRIVATE eb_status_t eb_shm_connect(struct eb_transport* transport, struct eb_link* link, const char* address, int passive);
+EB_PRIVATE void eb_shm_disconnect(struct eb_transport* transport, struct eb_link* link);
+EB_PRIVATE void eb_shm_fdes(struct eb_transport*, struct eb_link* link, eb_user_data_t data, eb_descriptor_callback_t cb);
+EB_PRIVATE int eb_shm_accept(struct eb_transport*, struct eb_link* result_link, eb_user_data_t data, eb_descriptor_callback_t ready);
+EB_PRIVATE int eb_shm_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int len);
+EB_PRIVATE int eb_shm_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len);
+EB_PRIVATE void eb_shm_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len);
+EB_PRIVATE void eb_shm_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on);
+EB_PRIVATE uint8_t* eb_shm_claim(struct eb_transport* transportp, struct eb_link* linkp, int* len);
+EB_PRIVATE void eb_shm_commit(struct eb_transport* transportp, struct eb_link* linkp, int len);
+
+struct eb_shm_transport {
+  /* Contents must fit in 16 bytes */
+  int listen; /* -1 if the socket has no port */
+};
+
+struct eb_shm_link {
+  /* Contents must fit in 12 bytes */
+  struct eb_shm_channel* channel;
+};
+
+#endif
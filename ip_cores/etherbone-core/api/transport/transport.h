@@ -37,10 +37,10 @@ struct eb_link {
   uint8_t raw[12];
 };
 
-/* The exact use of these 8-bytes is specific to the transport */
+/* The exact use of these 16-bytes is specific to the transport */
 typedef EB_POINTER(eb_transport) eb_transport_t;
 struct eb_transport {
-  uint8_t raw[9];
+  uint8_t raw[16];
   uint8_t link_type;
   eb_transport_t next;
 };
@@ -69,10 +69,35 @@ struct eb_transport_ops {
    /* This allows for a clear demarkation of where the socket should enable/disable buffering */
    void (*send)(struct eb_transport*, struct eb_link* link, const uint8_t* buf, int len);
    void (*send_buffer)(struct eb_transport*, struct eb_link* link, int start); /* upon creation, should be 0 */
+   
+   /* Optional (0 if unsupported): let the flush format directly into a transport-owned buffer.
+    * claim returns a buffer of *len (>= mtu) bytes, or 0 if one is already claimed.
+    * commit sends the first len bytes of the claimed buffer (0 just releases it).
+    * The next claim never returns the buffer just committed.
+    */
+   uint8_t* (*claim) (struct eb_transport*, struct eb_link* link, int* len);
+   void     (*commit)(struct eb_transport*, struct eb_link* link, int len);
 };
 
 /* The table of all supported transports */
 EB_PRIVATE extern struct eb_transport_ops eb_transports[];
 EB_PRIVATE extern const unsigned int eb_transport_size;
 
+/* Keep the event loop informed of links entering/leaving the socket (run.c) */
+EB_PRIVATE void eb_socket_run_add(eb_socket_t socket, eb_transport_t transport, eb_link_t link, eb_device_t device);
+EB_PRIVATE void eb_socket_run_del(eb_socket_t socket, eb_transport_t transport, eb_link_t link);
+EB_PRIVATE void eb_socket_run_free(eb_socket_t socket);
+EB_PRIVATE void eb_socket_run_descriptor(eb_socket_t socket, eb_descriptor_t fd, uint8_t mode); /* mode=0 to remove */
+EB_PRIVATE uint32_t eb_socket_run_clock(void); /* free-running microseconds; 0 if there is no clock */
+
+/* Cycles submitted by other threads (queue.c) */
+EB_PRIVATE void eb_socket_queue_drain(eb_socket_t socket);
+EB_PRIVATE void eb_socket_queue_free(eb_socket_t socket);
+EB_PRIVATE void eb_socket_queue_fdes(eb_socket_t socket, eb_user_data_t user, eb_descriptor_callback_t cb);
+
+/* Record packets passing through the transports (capture.c); devicep=EB_NULL for the transport itself */
+EB_PRIVATE void eb_socket_capture_packet(eb_socket_t socket, eb_transport_t transport, eb_device_t device, int outbound, const uint8_t* buf, int len);
+EB_PRIVATE void eb_socket_capture_device(eb_socket_t socket, eb_transport_t transport, eb_device_t device, const char* address); /* address=0 if accepted */
+EB_PRIVATE void eb_socket_capture_free(eb_socket_t socket);
+
 #endif
@@ -33,6 +33,8 @@
 #include "posix-tcp.h"
 #include "tunnel.h"
 #include "dev.h"
+#include "mux.h"
+#include "shm.h"
 
 struct eb_transport_ops eb_transports[] = {
 #ifndef __WIN32
@@ -47,7 +49,9 @@ struct eb_transport_ops eb_transports[] = {
     eb_dev_poll,
     eb_dev_recv,
     eb_dev_send,
-    eb_dev_send_buffer
+    eb_dev_send_buffer,
+    0,
+    0
   },
 #endif
   {
@@ -61,7 +65,9 @@ struct eb_transport_ops eb_transports[] = {
     eb_posix_udp_poll,
     eb_posix_udp_recv,
     eb_posix_udp_send,
-    eb_posix_udp_send_buffer
+    eb_posix_udp_send_buffer,
+    eb_posix_udp_claim,
+    eb_posix_udp_commit
   },
   {
     EB_POSIX_TCP_MTU,
@@ -74,7 +80,14 @@ struct eb_transport_ops eb_transports[] = {
     eb_posix_tcp_poll,
     eb_posix_tcp_recv,
     eb_posix_tcp_send,
-    eb_posix_tcp_send_buffer
+    eb_posix_tcp_send_buffer,
+#ifdef EB_POSIX_TCP_WRITEV
+    eb_posix_tcp_claim,
+    eb_posix_tcp_commit
+#else
+    0,
+    0
+#endif
   },
   {
     EB_TUNNEL_MTU,
@@ -87,8 +100,49 @@ struct eb_transport_ops eb_transports[] = {
     eb_tunnel_poll,
     eb_tunnel_recv,
     eb_tunnel_send,
-    eb_tunnel_send_buffer
-  }
+    eb_tunnel_send_buffer,
+#ifdef EB_POSIX_TCP_WRITEV
+    eb_tunnel_claim,
+    eb_tunnel_commit
+#else
+    0,
+    0
+#endif
+  },
+#ifndef __WIN32
+  {
+    EB_MUX_MTU,
+    eb_mux_open,
+    eb_mux_close,
+    eb_mux_connect,
+    eb_mux_disconnect,
+    eb_mux_fdes,
+    eb_mux_accept,
+    eb_mux_poll,
+    eb_mux_recv,
+    eb_mux_send,
+    eb_mux_send_buffer,
+    0,
+    0
+  },
+#endif
+#ifdef __linux__
+  {
+    EB_SHM_MTU,
+    eb_shm_open,
+    eb_shm_close,
+    eb_shm_connect,
+    eb_shm_disconnect,
+    eb_shm_fdes,
+    eb_shm_accept,
+    eb_shm_poll,
+    eb_shm_recv,
+    eb_shm_send,
+    eb_shm_send_buffer,
+    eb_shm_claim,
+    eb_shm_commit
+  },
+#endif
 };
 
 const unsigned int eb_transport_size = sizeof(eb_transports) / sizeof(struct eb_transport_ops);
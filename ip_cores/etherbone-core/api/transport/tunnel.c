@@ -33,18 +33,21 @@
 #include "tunnel.h"
 #include "../glue/strncasecmp.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 eb_status_t eb_tunnel_open(struct eb_transport* transportp, const char* port) {
-  /* noop */
-  return EB_OK;
+  /* A TCP transport without ports: it only holds the writev chunks */
+  return eb_posix_tcp_open(transportp, 0);
 }
 
 void eb_tunnel_close(struct eb_transport* transportp) {
-  /* noop */
+  eb_posix_tcp_close(transportp);
 }
 
 eb_status_t eb_tunnel_connect(struct eb_transport* transportp, struct eb_link* linkp, const char* address, int passive) {
+  struct eb_tunnel_link* link;
+  struct eb_tunnel_channel* channel;
   const char* slash;
   const char* host;
   const char* service;
@@ -52,6 +55,8 @@ eb_status_t eb_tunnel_connect(struct eb_transport* transportp, struct eb_link* l
   eb_status_t err;
   int len;
   
+  link = (struct eb_tunnel_link*)linkp;
+  
   if      (!eb_strncasecmp(address, "tunnel/",  7)) host = address + 7;
   else if (!eb_strncasecmp(address, "tunnel6/", 8)) host = address + 8;
   else if (!eb_strncasecmp(address, "tunnel4/", 8)) host = address + 8;
@@ -72,19 +77,38 @@ eb_status_t eb_tunnel_connect(struct eb_transport* transportp, struct eb_link* l
   strncat(tcpname, address + 6, host-(address+6));
   strncat(tcpname, host, slash-host);
   
-  if ((err = eb_posix_tcp_connect(0, linkp, tcpname, passive)) != EB_OK) return err;
+  if ((channel = (struct eb_tunnel_channel*)malloc(sizeof(struct eb_tunnel_channel))) == 0)
+    return EB_OOM;
+  
+  if ((err = eb_posix_tcp_connect(0, &channel->tcp, tcpname, passive)) != EB_OK) {
+    free(channel);
+    return err;
+  }
+  
+  channel->buffer = 0;
+  channel->head = 0;
+  channel->tail = 0;
+  link->channel = channel;
   
-  eb_posix_tcp_send(0, linkp, (const uint8_t*)service, strlen(service)+1);
+  eb_posix_tcp_send(transportp, &channel->tcp, (const uint8_t*)service, strlen(service)+1);
   return EB_OK;
 }
 
 void eb_tunnel_disconnect(struct eb_transport* transportp, struct eb_link* linkp) {
-  eb_posix_tcp_disconnect(0, linkp);
+  struct eb_tunnel_link* link;
+  
+  link = (struct eb_tunnel_link*)linkp;
+  eb_posix_tcp_disconnect(0, &link->channel->tcp);
+  free(link->channel);
 }
 
 void eb_tunnel_fdes(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t cb) {
+  struct eb_tunnel_link* link;
+  
   if (linkp == 0) return;
-  return eb_posix_tcp_fdes(0, linkp, data, cb);
+  
+  link = (struct eb_tunnel_link*)linkp;
+  eb_posix_tcp_fdes(0, &link->channel->tcp, data, cb);
 }
 
 int eb_tunnel_accept(struct eb_transport* transportp, struct eb_link* result_linkp, eb_user_data_t data, eb_descriptor_callback_t ready) {
@@ -92,28 +116,49 @@ int eb_tunnel_accept(struct eb_transport* transportp, struct eb_link* result_lin
   return 0;
 }
 
+/* Hand out the next whole frame already read, if any */
+static int eb_tunnel_take(struct eb_tunnel_channel* channel, uint8_t* buf, int maxlen) {
+  int len;
+  
+  while (channel->tail - channel->head >= EB_TUNNEL_HEADER) {
+    len = ((unsigned int)channel->rx[channel->head]) << 8 | channel->rx[channel->head+1];
+    if (len > maxlen) return -1;
+    if (channel->tail - channel->head < EB_TUNNEL_HEADER + len) break;
+    
+    memcpy(buf, &channel->rx[channel->head + EB_TUNNEL_HEADER], len);
+    channel->head += EB_TUNNEL_HEADER + len;
+    
+    if (len > 0) return len; /* empty frames carry nothing */
+  }
+  
+  return 0;
+}
+
 int eb_tunnel_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int maxlen) {
+  struct eb_tunnel_link* link;
+  struct eb_tunnel_channel* channel;
   int len;
-  uint8_t len_buf[2];
   
   /* No top-level to poll */
   if (linkp == 0) return 0;
   
-  if ((len = eb_posix_tcp_poll(0, linkp, data, ready, &len_buf[0], 2)) <= 0)
-    return len;
+  link = (struct eb_tunnel_link*)linkp;
+  channel = link->channel;
   
-  if (len == 1) {
-    if (eb_posix_tcp_recv(0, linkp, &len_buf[1], 1) != 1)
-      return -1;
-  }
+  /* The caller keeps polling until 0, so frames never linger here */
+  if ((len = eb_tunnel_take(channel, buf, maxlen)) != 0)
+    return len;
   
-  len = ((unsigned int)len_buf[0]) << 8 | len_buf[1];
-  if (len > maxlen) return -1;
+  /* Keep the partial frame, then read all that has arrived behind it */
+  memmove(&channel->rx[0], &channel->rx[channel->head], channel->tail - channel->head);
+  channel->tail -= channel->head;
+  channel->head = 0;
   
-  if (eb_posix_tcp_recv(0, linkp, buf, len) != len)
-    return -1;
+  if ((len = eb_posix_tcp_poll(0, &channel->tcp, data, ready, &channel->rx[channel->tail], sizeof(channel->rx) - channel->tail)) <= 0)
+    return len;
   
-  return len;
+  channel->tail += len;
+  return eb_tunnel_take(channel, buf, maxlen);
 }
 
 int eb_tunnel_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len) {
@@ -122,17 +167,69 @@ int eb_tunnel_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8
 }
 
 void eb_tunnel_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len) {
-  uint8_t len_buf[2];
-  len_buf[0] = (len >> 8) & 0xFF;
-  len_buf[1] = len & 0xFF;
-  
-  /* Not super efficient, but it will get the job done */
-  eb_posix_tcp_send_buffer(0, linkp, 1);
-  eb_posix_tcp_send(0, linkp, &len_buf[0], 2);
-  eb_posix_tcp_send(0, linkp, buf, len);
-  eb_posix_tcp_send_buffer(0, linkp, 0);
+  struct eb_tunnel_link* link;
+  uint8_t frame[EB_TUNNEL_HEADER+EB_TUNNEL_MTU];
+#ifdef EB_POSIX_TCP_WRITEV
+  uint8_t* out;
+  int room;
+#endif
+  
+  link = (struct eb_tunnel_link*)linkp;
+  
+#ifdef EB_POSIX_TCP_WRITEV
+  /* While buffering, queue the frame with the rest of the flush */
+  if (link->channel->buffer && (out = eb_posix_tcp_claim(transportp, &link->channel->tcp, &room)) != 0) {
+    out[0] = (len >> 8) & 0xFF;
+    out[1] = len & 0xFF;
+    memcpy(out + EB_TUNNEL_HEADER, buf, len);
+    eb_posix_tcp_commit(transportp, &link->channel->tcp, EB_TUNNEL_HEADER + len);
+    return;
+  }
+#endif
+  
+  frame[0] = (len >> 8) & 0xFF;
+  frame[1] = len & 0xFF;
+  memcpy(frame + EB_TUNNEL_HEADER, buf, len);
+  eb_posix_tcp_send(transportp, &link->channel->tcp, frame, EB_TUNNEL_HEADER + len);
 }
 
 void eb_tunnel_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on) {
-  /* no-op */
+  struct eb_tunnel_link* link;
+  
+  link = (struct eb_tunnel_link*)linkp;
+  link->channel->buffer = on;
+  eb_posix_tcp_send_buffer(transportp, &link->channel->tcp, on);
+}
+
+#ifdef EB_POSIX_TCP_WRITEV
+uint8_t* eb_tunnel_claim(struct eb_transport* transportp, struct eb_link* linkp, int* len) {
+  struct eb_tunnel_link* link;
+  uint8_t* out;
+  
+  link = (struct eb_tunnel_link*)linkp;
+  
+  if ((out = eb_posix_tcp_claim(transportp, &link->channel->tcp, len)) == 0) return 0;
+  
+  /* Leave room for the frame header */
+  *len -= EB_TUNNEL_HEADER;
+  link->channel->claimed = out + EB_TUNNEL_HEADER;
+  return link->channel->claimed;
+}
+
+void eb_tunnel_commit(struct eb_transport* transportp, struct eb_link* linkp, int len) {
+  struct eb_tunnel_link* link;
+  uint8_t* out;
+  
+  link = (struct eb_tunnel_link*)linkp;
+  
+  if (len == 0) {
+    eb_posix_tcp_commit(transportp, &link->channel->tcp, 0);
+    return;
+  }
+  
+  out = link->channel->claimed - EB_TUNNEL_HEADER;
+  out[0] = (len >> 8) & 0xFF;
+  out[1] = len & 0xFF;
+  eb_posix_tcp_commit(transportp, &link->channel->tcp, EB_TUNNEL_HEADER + len);
 }
+#endif
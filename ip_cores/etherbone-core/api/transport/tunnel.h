@@ -30,9 +30,17 @@
 
 #include "transport.h"
 #include "posix-udp.h"
+#include "posix-tcp.h"
 
 #define EB_TUNNEL_MTU EB_POSIX_UDP_MTU
 
+/* Each datagram travels as a 2-byte big-endian length followed by its bytes.
+ * Frames are batched: a flush leaves in one write, and a read takes as many
+ * frames as have arrived.
+ */
+#define EB_TUNNEL_HEADER 2
+#define EB_TUNNEL_RX     65536 /* bytes of frames read at once */
+
 EB_PRIVATE eb_status_t eb_tunnel_open(struct eb_transport* transport, const char* port);
 EB_PRIVATE void eb_tunnel_close(struct eb_transport* transport);
 EB_PRIVATE eb_status_t eb_tunnel_connect(struct eb_transport* transport, struct eb_link* link, const char* address, int passive);
@@ -43,5 +51,24 @@ EB_PRIVATE int eb_tunnel_poll(struct eb_transport* transportp, struct eb_link* l
 EB_PRIVATE int eb_tunnel_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len);
 EB_PRIVATE void eb_tunnel_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len);
 EB_PRIVATE void eb_tunnel_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on);
+#ifdef EB_POSIX_TCP_WRITEV
+EB_PRIVATE uint8_t* eb_tunnel_claim(struct eb_transport* transportp, struct eb_link* linkp, int* len);
+EB_PRIVATE void eb_tunnel_commit(struct eb_transport* transportp, struct eb_link* linkp, int len);
+#endif
+
+struct eb_tunnel_channel {
+  struct eb_link tcp;  /* the connection to eb-tunnel */
+  int buffer;          /* inside send_buffer(1) */
+#ifdef EB_POSIX_TCP_WRITEV
+  uint8_t* claimed;    /* the chunk handed out by eb_tunnel_claim, past its frame header */
+#endif
+  int head, tail;      /* unconsumed bytes of rx */
+  uint8_t rx[EB_TUNNEL_RX];
+};
+
+struct eb_tunnel_link {
+  /* Contents must fit in 12 bytes */
+  struct eb_tunnel_channel* channel;
+};
 
 #endif